@@ -0,0 +1,51 @@
+#ifndef R11F_AOT_H
+#define R11F_AOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "defs.h"
+#include "error.h"
+#include "forward.h"
+#include "vm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Ahead-of-time compiled modules. `r11f --aot` runs every method of a
+ * set of class files through the baseline JIT and writes the result as
+ * assembly, which the system C compiler turns into a shared object. The
+ * object exports r11f_aot_<content hash> for each class and
+ * r11f_aot_<content hash>_<method index> for each compiled method, the
+ * latter a record in the format of the on-disk code cache (jitcache.h)
+ * preceded by its size.
+ *
+ * A VM with vm->aot_modules opens them when it loads its first class.
+ * Methods of a class found in a module then run its code from their
+ * first call: always in R11F_EXEC_JIT and R11F_EXEC_TIERED, in
+ * R11F_EXEC_OPT where the optimizer gives up. The code is copied into
+ * the code cache and relocated like cached code. Methods without a
+ * record, or with one from another build, take the usual path.
+ */
+
+/* compiles the class files at `paths` to an assembly module, write
+   errors are left for the caller to check on `output` */
+R11F_EXPORT r11f_error_t r11f_aot_write(FILE *output,
+                                        char const* const* paths,
+                                        uint32_t count);
+
+/* implemented by aot.c, called from vm.c and vthread.c; r11f_aot_open
+   opens the modules of `vm` unless it has, false if there are none */
+R11F_INTERNAL bool r11f_aot_open(r11f_vm_t *vm);
+R11F_INTERNAL void r11f_aot_attach(r11f_vm_t *vm, r11f_class_t *clazz);
+R11F_INTERNAL r11f_jit_code_t *r11f_aot_load(r11f_linked_method_t *method);
+R11F_INTERNAL void r11f_aot_unload(r11f_vm_t *vm);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* R11F_AOT_H */
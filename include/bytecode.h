@@ -16,6 +16,9 @@ enum {
 };
 
 R11F_EXPORT char const* r11f_explain_bytecode(uint8_t bytecode);
+R11F_EXPORT uint32_t r11f_bytecode_length(uint8_t *code,
+                                          uint32_t code_length,
+                                          uint32_t pc);
 R11F_EXPORT void r11f_disassemble(r11f_class_t *clazz,
                                   r11f_method_info_t *method_info,
                                   size_t indent);
@@ -1,10 +1,12 @@
 #ifndef R11F_CLASS_H
 #define R11F_CLASS_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "class/cpool.h"
 #include "defs.h"
+#include "error.h"
 #include "forward.h"
 
 #ifdef __cplusplus
@@ -25,6 +27,11 @@ typedef struct st_r11f_method_info {
     uint16_t descriptor_index;
     uint16_t attributes_count;
     r11f_attribute_info_t **attributes;
+
+    /* filled by r11f_method_link, not part of the class file */
+    r11f_linked_method_t *linked;
+    /* set by r11f_class_verify for methods that cannot run, see verify.h */
+    r11f_error_t verify_error;
 } r11f_method_info_t;
 
 typedef struct st_r11f_class {
@@ -44,6 +51,19 @@ typedef struct st_r11f_class {
     r11f_method_info_t **methods;
     uint16_t attributes_count;
     r11f_attribute_info_t **attributes;
+
+    /* hash of the class file bytes, 0 if unknown; keys the on-disk code
+       cache, see jitcache.h */
+    uint64_t content_hash;
+    /* set by the VM when an AOT module has code for the class, see aot.h */
+    void *aot_module;
+    /* filled by r11f_class_verify: methods with code it checked and the
+       time that took */
+    uint16_t verified_methods;
+    uint64_t verify_nanos;
+    /* made up by the VM for an exception class missing from the
+       classpath, see except.h */
+    bool builtin;
 } r11f_class_t;
 
 enum {
@@ -84,6 +104,13 @@ R11F_EXPORT r11f_method_qual_name_t
 r11f_class_get_method_name(r11f_class_t *clazz,
                            r11f_constant_methodref_info_t *methodref_info);
 
+/* name of the CONSTANT_Class at `index`, false for index 0, which is
+   where the super_class of java/lang/Object points */
+R11F_EXPORT bool r11f_class_get_class_name(r11f_class_t *clazz,
+                                           uint16_t index,
+                                           char const **out_name,
+                                           uint16_t *out_name_len);
+
 R11F_EXPORT r11f_method_info_t*
 r11f_class_resolve_method2(r11f_class_t *clazz,
                            r11f_constant_methodref_info_t *methodref_info);
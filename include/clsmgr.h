@@ -1,6 +1,7 @@
 #ifndef R11F_CLASS_MANAGER_H
 #define R11F_CLASS_MANAGER_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -27,6 +28,39 @@ R11F_EXPORT r11f_class_t *r11f_classmgr_find_class_id(r11f_classmgr_t *mgr,
                                                           uint32_t classid);
 R11F_EXPORT void r11f_classmgr_free(r11f_classmgr_t *mgr);
 
+/* an assumption compiled code makes about the loaded classes: instances
+   of `clazz` and its subclasses dispatch name + descriptor to `target`
+   and nothing else */
+typedef struct {
+    r11f_class_t *clazz;
+    char const *name;
+    uint16_t name_len;
+    char const *descriptor;
+    uint16_t descriptor_len;
+    r11f_method_info_t *target;
+} r11f_cha_dependency_t;
+
+/* class hierarchy analysis: the one method an instance of `clazz` or of
+   any loaded subclass dispatches name + descriptor to, NULL when there
+   are several or none. Expects superclasses to be added before their
+   subclasses */
+R11F_EXPORT r11f_method_info_t*
+r11f_classmgr_unique_method(r11f_classmgr_t *mgr,
+                            r11f_class_t *clazz,
+                            char const *name,
+                            uint16_t name_len,
+                            char const *descriptor,
+                            uint16_t descriptor_len,
+                            r11f_class_t **out_class);
+
+/* keeps `code` valid as long as `dependency` holds. Adding a class that
+   breaks it invalidates the code, so does recording an already broken
+   one */
+R11F_EXPORT r11f_error_t
+r11f_classmgr_add_dependency(r11f_classmgr_t *mgr,
+                             r11f_cha_dependency_t const *dependency,
+                             r11f_jit_code_t *code);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,29 @@
+#ifndef R11F_CODECACHE_H
+#define R11F_CODECACHE_H
+
+#include <stddef.h>
+
+#include "defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Process wide cache of executable memory for generated code. Memory is
+ * carved out of mmap'ed chunks; where possible every chunk is mapped
+ * twice, once executable and once writable, so that code never becomes
+ * writable while other threads may be running it.
+ *
+ * r11f_codecache_alloc returns the executable address and stores the
+ * writable alias of the same memory to `out_writable`.
+ */
+R11F_EXPORT void *r11f_codecache_alloc(size_t size, void **out_writable);
+R11F_EXPORT void r11f_codecache_free(void *code, size_t size);
+R11F_EXPORT size_t r11f_codecache_used(void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* R11F_CODECACHE_H */
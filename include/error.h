@@ -24,6 +24,16 @@ enum {
 
     R11F_ERR_cannot_load_class = 9,
     R11F_ERR_not_implemented_instruction = 10,
+    R11F_ERR_division_by_zero = 11,
+    R11F_ERR_deoptimized = 12,
+    R11F_ERR_null_pointer = 13,
+    R11F_ERR_array_index_out_of_bounds = 14,
+    R11F_ERR_negative_array_size = 15,
+    R11F_ERR_verify_failed = 16,
+    R11F_ERR_uncaught_exception = 17,
+    R11F_ERR_stack_overflow = 18,
+    /* not a failure, the virtual thread running parked, see vthread.h */
+    R11F_ERR_parked = 19,
 };
 
 R11F_EXPORT
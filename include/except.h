@@ -0,0 +1,77 @@
+#ifndef R11F_EXCEPT_H
+#define R11F_EXCEPT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "defs.h"
+#include "error.h"
+#include "forward.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Exceptions. java/lang/Throwable and the exceptions the VM raises
+ * itself (exceptinc.h) are built in: a class file of the same name on
+ * the classpath takes precedence, otherwise the VM makes up an empty
+ * class with the right superclass, whose <init> does nothing. Classes
+ * of the program may extend them.
+ *
+ * Nothing is spent on exceptions until one is thrown. r11f_method_link
+ * sorts the exception table into disjoint pc ranges (link.h), the VM
+ * resolves their catch types when it first links the method, and a
+ * throw walks the frames outwards with one binary search per frame.
+ * Division by zero, null pointers and bad array accesses throw a single
+ * preallocated instance per type, so code catching them in a loop does
+ * not allocate. Unwound frames are only remembered as method and pc;
+ * r11f_vm_format_stack_trace makes text of them when asked to.
+ */
+
+enum {
+#define EXCEPTION(CODE,CLASS,SUPER,ERROR) R11F_EXCEPT_##CODE,
+#include "exceptinc.h"
+    R11F_EXCEPT_COUNT
+};
+
+#define R11F_EXCEPT_NONE UINT16_MAX
+
+/* a frame an exception went through, `pc` is a bytecode pc or
+   UINT32_MAX where optimized code does not know it */
+typedef struct {
+    r11f_linked_method_t *method;
+    uint32_t pc;
+} r11f_stack_entry_t;
+
+/* the frames of the last exception thrown, innermost first */
+typedef struct {
+    uint32_t count;
+    uint32_t capacity;
+    r11f_stack_entry_t *entries;
+} r11f_backtrace_t;
+
+R11F_EXPORT uint16_t r11f_except_find(char const *class_name,
+                                      uint16_t class_name_len);
+/* the exception the VM throws for `error`, R11F_EXCEPT_NONE for errors
+   that are not exceptions */
+R11F_EXPORT uint16_t r11f_except_from_error(r11f_error_t error);
+/* what r11f_vm_invoke_static reports for an uncaught instance of the
+   built in class itself, R11F_ERR_uncaught_exception if nothing more
+   specific */
+R11F_EXPORT r11f_error_t r11f_except_error(uint16_t builtin);
+R11F_EXPORT char const *r11f_except_name(uint16_t builtin);
+/* the class the VM makes up for `builtin`, marked builtin */
+R11F_EXPORT r11f_error_t r11f_except_make_class(uint16_t builtin,
+                                                r11f_class_t **output);
+
+R11F_INTERNAL bool r11f_backtrace_push(r11f_backtrace_t *backtrace,
+                                       r11f_linked_method_t *method,
+                                       uint32_t pc);
+R11F_INTERNAL void r11f_backtrace_free(r11f_backtrace_t *backtrace);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* R11F_EXCEPT_H */
@@ -0,0 +1,36 @@
+#ifndef EXCEPTION
+#define EXCEPTION(CODE,CLASS,SUPER,ERROR)
+#endif
+
+EXCEPTION(throwable, "java/lang/Throwable", "java/lang/Object", R11F_success)
+EXCEPTION(exception, "java/lang/Exception", "java/lang/Throwable",
+          R11F_success)
+EXCEPTION(error, "java/lang/Error", "java/lang/Throwable", R11F_success)
+EXCEPTION(runtime, "java/lang/RuntimeException", "java/lang/Exception",
+          R11F_success)
+
+EXCEPTION(arithmetic, "java/lang/ArithmeticException",
+          "java/lang/RuntimeException", R11F_ERR_division_by_zero)
+EXCEPTION(null_pointer, "java/lang/NullPointerException",
+          "java/lang/RuntimeException", R11F_ERR_null_pointer)
+EXCEPTION(index_out_of_bounds, "java/lang/IndexOutOfBoundsException",
+          "java/lang/RuntimeException", R11F_success)
+EXCEPTION(array_index_out_of_bounds,
+          "java/lang/ArrayIndexOutOfBoundsException",
+          "java/lang/IndexOutOfBoundsException",
+          R11F_ERR_array_index_out_of_bounds)
+EXCEPTION(negative_array_size, "java/lang/NegativeArraySizeException",
+          "java/lang/RuntimeException", R11F_ERR_negative_array_size)
+EXCEPTION(illegal_argument, "java/lang/IllegalArgumentException",
+          "java/lang/RuntimeException", R11F_success)
+EXCEPTION(illegal_state, "java/lang/IllegalStateException",
+          "java/lang/RuntimeException", R11F_success)
+EXCEPTION(unsupported_operation, "java/lang/UnsupportedOperationException",
+          "java/lang/RuntimeException", R11F_success)
+
+EXCEPTION(virtual_machine_error, "java/lang/VirtualMachineError",
+          "java/lang/Error", R11F_success)
+EXCEPTION(stack_overflow, "java/lang/StackOverflowError",
+          "java/lang/VirtualMachineError", R11F_ERR_stack_overflow)
+
+#undef EXCEPTION
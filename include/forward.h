@@ -10,6 +10,16 @@ typedef struct st_r11f_frame r11f_frame_t;
 typedef struct st_r11f_classmgr r11f_classmgr_t;
 typedef struct st_r11f_method_info r11f_method_info_t;
 typedef struct st_r11f_attribute_info r11f_attribute_info_t;
+typedef struct st_r11f_linked_method r11f_linked_method_t;
+typedef struct st_r11f_regir r11f_regir_t;
+typedef struct st_r11f_jit_code r11f_jit_code_t;
+typedef struct st_r11f_compiler r11f_compiler_t;
+typedef struct st_r11f_aot r11f_aot_t;
+typedef struct st_r11f_tracer r11f_tracer_t;
+typedef struct st_r11f_sched r11f_sched_t;
+typedef struct st_r11f_vthread r11f_vthread_t;
+typedef struct st_r11f_object r11f_object_t;
+typedef struct st_r11f_array r11f_array_t;
 typedef union u_r11f_value r11f_value_t;
 
 #ifdef __cplusplus
@@ -5,6 +5,7 @@
 #include <stdint.h>
 
 #include "defs.h"
+#include "error.h"
 #include "forward.h"
 
 #ifdef __cplusplus
@@ -40,11 +41,71 @@ struct st_r11f_frame {
     r11f_value_t *stack;
     r11f_value_t *locals;
 
-    r11f_value_t data[];
+    /* non-NULL when the frame runs register IR, pc then indexes into it */
+    r11f_regir_t *regir;
+    /* non-NULL when the method has been compiled to machine code */
+    r11f_jit_code_t *jit;
+
+    /* the frame's values, locals first and the operand stack after them.
+       A callee's locals may start on its caller's arguments */
+    r11f_value_t *data;
+    /* the stack's value top before the frame was pushed */
+    r11f_value_t *saved_top;
 };
 
-R11F_EXPORT r11f_frame_t*
-r11f_frame_alloc(r11f_class_t *clazz, r11f_method_info_t *method_info);
+/* the VM stack of the thread running a VM. Values grow up from `base`,
+   frame headers down from `limit`, both bumped on push and moved back on
+   pop, so frames are freed in the reverse order of allocation; a frame
+   that does not fit between the two is a stack overflow.
+
+   Like in the bytecode, the caller pushes the arguments of a call to its
+   operand stack, which is the end of the stack's values. The callee's
+   locals start on the first of them, so they are neither copied nor
+   popped: returning pops the callee, and the caller's stack pointer
+   goes back below the arguments */
+typedef struct {
+    uint8_t *base;
+    r11f_value_t *top;
+    r11f_frame_t *frames;
+    uint8_t *limit;
+} r11f_stack_t;
+
+/* the frames of a stack moved to the heap by r11f_stack_detach, the
+   values first and the frame headers after them, as they were between
+   `base` and `limit` */
+typedef struct {
+    uint8_t *bytes;
+    size_t values_size;
+    size_t frames_size;
+    uint8_t *base;
+    uint8_t *limit;
+} r11f_continuation_t;
+
+/* reserved per VM unless r11f_vm_t.stack_size says otherwise */
+#define R11F_STACK_DEFAULT_SIZE ((size_t)1 << 20)
+
+/* reserves `size` bytes, only touched pages take memory */
+R11F_EXPORT r11f_error_t r11f_stack_init(r11f_stack_t *stack, size_t size);
+R11F_EXPORT void r11f_stack_free(r11f_stack_t *stack);
+
+/* a frame for `method` on top of `stack`, NULL if it does not fit. With
+   `args` non-NULL its locals start there, which must be the caller's
+   last live values on the stack, one per local */
+R11F_EXPORT r11f_frame_t* r11f_frame_push(r11f_stack_t *stack,
+                                          r11f_linked_method_t *method,
+                                          r11f_value_t *args);
+/* pops `frame` and every frame pushed after it */
+R11F_EXPORT void r11f_frame_pop(r11f_stack_t *stack, r11f_frame_t *frame);
+
+/* moves every frame of `stack` to `output`, leaving it empty; the
+   stack is left alone when out of memory */
+R11F_EXPORT r11f_error_t r11f_stack_detach(r11f_stack_t *stack,
+                                           r11f_continuation_t *output);
+/* moves the frames of `cont` back onto empty `stack`, which may be
+   another one than they came from, and returns the last one pushed.
+   NULL if they do not fit, `cont` is kept then */
+R11F_EXPORT r11f_frame_t* r11f_stack_attach(r11f_stack_t *stack,
+                                            r11f_continuation_t *cont);
 
 #ifdef __cplusplus
 } /* extern "C" */
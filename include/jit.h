@@ -0,0 +1,180 @@
+#ifndef R11F_JIT_H
+#define R11F_JIT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "defs.h"
+#include "clsmgr.h"
+#include "error.h"
+#include "forward.h"
+#include "frame.h"
+#include "switch.h"
+#include "vm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* runs the method in `frame` to completion and stores the return value
+   to `result`, the frame itself is not freed */
+typedef r11f_error_t (*r11f_jit_entry_t)(r11f_vm_t *vm,
+                                         r11f_frame_t *frame,
+                                         r11f_value_t *result);
+
+/* an invokestatic or invokevirtual in compiled code, resolved on first
+   use. `caller` is the class whose constant pool holds the methodref.
+   Virtual calls cache the target for the last receiver class seen.
+   Baseline code passes the arguments in the caller's frame, where they
+   become the callee's locals (`args_in_frame`) */
+typedef struct {
+    r11f_class_t *caller;
+    uint16_t methodref_index;
+    bool has_result;
+    bool is_virtual;
+    bool args_in_frame;
+
+    r11f_class_t *clazz;
+    r11f_method_info_t *method_info;
+    r11f_class_t *receiver_class;
+} r11f_jit_callsite_t;
+
+/* entry at a loop header, taking over a frame the bytecode interpreter
+   has run up to `pc` (on-stack replacement) */
+typedef struct {
+    uint32_t pc;
+    r11f_jit_entry_t entry;
+} r11f_jit_osr_t;
+
+/* interpreter frame rebuilt at a speculation point: `method` continues
+   in register IR at instruction `pc`, `sp` is the register a pending
+   callee returns into. Its max_stack + max_locals register values are
+   passed along with the point */
+typedef struct {
+    r11f_linked_method_t *method;
+    uint32_t pc;
+    uint16_t sp;
+} r11f_deopt_frame_t;
+
+/* int[] optimized code keeps in registers, allocated again when it
+   deoptimizes: the value of `slot` becomes an array of `length` elements
+   taken from the values from `elements` on. Slots sharing `elements`
+   refer to the same array */
+typedef struct {
+    uint32_t slot;
+    uint32_t length;
+    uint32_t elements;
+} r11f_deopt_object_t;
+
+/* frame state of optimized code at a speculation point, frames ordered
+   outermost first; the first one is the compiled frame itself, the
+   others belong to inlined callees. Code compiled with vm->deopt_stress
+   deoptimizes at a point while `armed` is set, which the first
+   deoptimization there clears */
+typedef struct {
+    uint32_t frame_count;
+    r11f_deopt_frame_t *frames;
+    uint32_t object_count;
+    r11f_deopt_object_t *objects;
+    uint8_t armed;
+} r11f_deopt_point_t;
+
+/*
+ * x86-64 machine code of a method, generated from its register IR by
+ * stitching a template per instruction. Registers stay in the frame's
+ * value area, addressed through rbx.
+ */
+struct st_r11f_jit_code {
+    r11f_jit_entry_t entry;
+    size_t code_size;
+
+    /* switch targets are code offsets relative to `entry` */
+    uint32_t switch_count;
+    r11f_switch_t **switches;
+
+    uint32_t callsite_count;
+    r11f_jit_callsite_t *callsites;
+
+    /* calls inlined by the optimizing compiler, see opt.h */
+    uint32_t inlined_count;
+    /* null and bounds checks left in optimized code */
+    uint32_t check_count;
+    /* loops of optimized code given a SIMD version */
+    uint32_t vector_count;
+    /* allocations optimized code keeps in registers instead */
+    uint32_t replaced_count;
+
+    /* baseline code has one per loop header of the register IR, sorted
+       by pc */
+    uint32_t osr_count;
+    r11f_jit_osr_t *osr;
+
+    /* optimized code only, `deopt_frames` and `deopt_objects` back the
+       frames and objects of all points. Once `invalidated` is set every
+       speculation point deoptimizes */
+    uint32_t deopt_count;
+    r11f_deopt_point_t *deopt_points;
+    r11f_deopt_frame_t *deopt_frames;
+    r11f_deopt_object_t *deopt_objects;
+    uint8_t invalidated;
+};
+
+R11F_EXPORT r11f_error_t r11f_jit_compile(r11f_linked_method_t *method,
+                                          r11f_jit_code_t **output);
+R11F_EXPORT void r11f_jit_free(r11f_jit_code_t *jit);
+R11F_EXPORT r11f_jit_entry_t r11f_jit_find_osr(r11f_jit_code_t *jit,
+                                               uint32_t pc);
+/* makes running and future executions of `jit` leave it at their next
+   speculation point, new frames no longer pick it up */
+R11F_EXPORT void r11f_jit_invalidate(r11f_jit_code_t *jit);
+
+/* implemented by vm.c, called from compiled code. Arguments are one
+   value each, long included, the receiver of a virtual call first;
+   `result` is only written for non-void callees */
+R11F_INTERNAL r11f_error_t r11f_vm_jit_invoke(r11f_vm_t *vm,
+                                              r11f_jit_callsite_t *callsite,
+                                              r11f_value_t *args,
+                                              r11f_value_t *result);
+/* allocates a zeroed int[] of `length` elements into `result` */
+R11F_INTERNAL r11f_error_t r11f_vm_new_array(r11f_vm_t *vm,
+                                             int32_t length,
+                                             r11f_value_t *result);
+/* makes `exception` pending, returns R11F_ERR_uncaught_exception for
+   compiled code to pass on, or R11F_ERR_null_pointer for null */
+R11F_INTERNAL r11f_error_t r11f_vm_athrow(r11f_vm_t *vm,
+                                          r11f_object_t *exception);
+/* rebuilds the interpreter frames of `point` in place of `frame` from
+   `values` and makes the innermost one current. Returns
+   R11F_ERR_deoptimized, which compiled code passes on to its caller */
+R11F_INTERNAL r11f_error_t r11f_vm_deoptimize(r11f_vm_t *vm,
+                                              r11f_frame_t *frame,
+                                              r11f_deopt_point_t *point,
+                                              r11f_value_t *values);
+/* resolves and links a static callee at compile time and translates it
+   to register IR if possible, NULL when it cannot be resolved; safe to
+   call from compile threads */
+R11F_INTERNAL r11f_linked_method_t*
+r11f_vm_link_static(r11f_vm_t *vm,
+                    r11f_class_t *caller,
+                    uint16_t methodref_index);
+/* the same for the single implementation an invokevirtual can reach
+   with the classes loaded so far, NULL when there are several. The
+   assumption goes to `out_dependency` */
+R11F_INTERNAL r11f_linked_method_t*
+r11f_vm_link_virtual(r11f_vm_t *vm,
+                     r11f_class_t *caller,
+                     uint16_t methodref_index,
+                     r11f_cha_dependency_t *out_dependency);
+/* registers the assumptions `code` was compiled under, see clsmgr.h */
+R11F_INTERNAL r11f_error_t
+r11f_vm_add_dependencies(r11f_vm_t *vm,
+                         r11f_jit_code_t *code,
+                         r11f_cha_dependency_t const *dependencies,
+                         uint32_t count);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* R11F_JIT_H */
@@ -0,0 +1,41 @@
+#ifndef R11F_JITCACHE_H
+#define R11F_JITCACHE_H
+
+#include <stddef.h>
+
+#include "defs.h"
+#include "error.h"
+#include "forward.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Baseline JIT code kept on disk across runs. A method's code is stored
+ * in `dir` under the content hash of its class file, the build id of the
+ * library and the index of the method in its class, so a changed class
+ * or a rebuilt VM never picks up stale code. A later run copies the
+ * cached code into the code cache and patches in the addresses of the
+ * process instead of compiling.
+ *
+ * Optimized code is not cached: it inlines other classes and depends on
+ * the class hierarchy as loaded at the time.
+ *
+ * Unreadable, mismatching or unwritable cache files are skipped quietly.
+ * The cache is off for a library built without R11F_BUILD_ID, which the
+ * Makefile derives from the sources.
+ */
+
+/* r11f_jit_compile, through the cache in `dir` unless that is NULL */
+R11F_EXPORT r11f_error_t r11f_jitcache_compile(char const *dir,
+                                               r11f_linked_method_t *method,
+                                               r11f_jit_code_t **output);
+/* methods this process took from the cache so far */
+R11F_EXPORT size_t r11f_jitcache_hits(void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* R11F_JITCACHE_H */
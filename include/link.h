@@ -0,0 +1,159 @@
+#ifndef R11F_LINK_H
+#define R11F_LINK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "defs.h"
+#include "forward.h"
+#include "switch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* back edges taken to one loop header, for tiered execution, and the
+   optimized code entering the method there once the loop got hot */
+typedef struct {
+    uint32_t header_pc;
+    uint32_t count;
+    r11f_jit_code_t *osr;
+    bool osr_requested;
+    bool osr_failed;
+} r11f_loop_counter_t;
+
+/* an exception_table entry. The VM resolves `catch_class` when it first
+   links the method; it stays NULL for catch_type 0, which catches
+   everything, and for classes that cannot be loaded, which catch
+   nothing */
+typedef struct {
+    uint16_t start_pc;
+    uint16_t end_pc;
+    uint16_t handler_pc;
+    uint16_t catch_type;
+    r11f_class_t *catch_class;
+} r11f_handler_t;
+
+/* pcs in [start_pc, end_pc) all have the same handlers, the entries
+   handler_order[first, first + count) refers to, in table order */
+typedef struct {
+    uint32_t start_pc;
+    uint32_t end_pc;
+    uint32_t first;
+    uint32_t count;
+} r11f_handler_range_t;
+
+/* what the linker recognized a method as. A trivial method returns a
+   constant, or one of its arguments, possibly combined with a second
+   one or a constant by a single arithmetic bytecode; the VM runs it on
+   the caller's values without ever making a frame for it */
+enum {
+    R11F_TRIVIAL_NONE = 0,
+    R11F_TRIVIAL_CONSTANT = 1,
+    R11F_TRIVIAL_LEAF = 2
+};
+
+/* an operand of a trivial method that is `imm` rather than an argument */
+#define R11F_TRIVIAL_IMM UINT8_MAX
+
+typedef struct {
+    uint8_t kind;
+    /* the bytecode combining the operands, nop to return `a` as it is */
+    uint8_t op;
+    /* argument values, the receiver first, or R11F_TRIVIAL_IMM */
+    uint8_t a;
+    uint8_t b;
+    /* operands that go through i2l first */
+    bool widen_a;
+    bool widen_b;
+    int64_t imm;
+} r11f_trivial_t;
+
+/* runtime information of a method, computed once on first use */
+typedef struct st_r11f_linked_method {
+    r11f_class_t *clazz;
+    r11f_method_info_t *method_info;
+
+    char const *name;
+    uint16_t name_len;
+    char const *descriptor;
+    uint16_t descriptor_len;
+
+    uint16_t max_stack;
+    uint16_t max_locals;
+    uint32_t code_length;
+    uint8_t *code;
+
+    /* number of argument values (not slots) and the return type character */
+    uint16_t argc;
+    char return_type;
+    /* a long or double argument takes one stack value but two locals,
+       the arguments then cannot become the callee's locals in place;
+       only left set where the locals could not be compacted */
+    bool wide_args;
+    /* the locals are renumbered one per value, `code` and max_locals
+       are then the linker's own rather than the class file's */
+    bool compact_locals;
+    r11f_trivial_t trivial;
+
+    /* every tableswitch and lookupswitch in the code, sorted by pc */
+    r11f_switch_t **switches;
+    uint32_t switch_count;
+
+    /* the exception table as in the class file, and the disjoint pc
+       ranges it covers sorted by pc, see except.h */
+    r11f_handler_t *handlers;
+    uint16_t handler_count;
+    r11f_handler_range_t *handler_ranges;
+    uint32_t handler_range_count;
+    uint16_t *handler_order;
+    bool handlers_resolved;
+
+    r11f_regir_t *regir;
+    bool regir_failed;
+
+    r11f_jit_code_t *jit;
+    bool jit_failed;
+    /* the AOT module of the class was asked for `jit` */
+    bool aot_checked;
+
+    r11f_jit_code_t *opt;
+    bool opt_failed;
+
+    /* hotness counters of R11F_EXEC_TIERED, see tier.h; one loop counter
+       per target of a backward branch or switch, sorted by header_pc */
+    uint32_t invoke_count;
+    uint32_t backedge_count;
+    r11f_loop_counter_t *loops;
+    uint32_t loop_count;
+    uint8_t tier_requested;
+} r11f_linked_method_t;
+
+R11F_EXPORT r11f_error_t r11f_method_link(r11f_class_t *clazz,
+                                          r11f_method_info_t *method_info,
+                                          r11f_linked_method_t **output);
+
+R11F_EXPORT void r11f_method_unlink(r11f_method_info_t *method_info);
+
+R11F_EXPORT r11f_switch_t*
+r11f_method_find_switch(r11f_linked_method_t *linked, uint32_t pc);
+
+/* the handlers covering `pc`, NULL if there are none */
+R11F_EXPORT r11f_handler_range_t*
+r11f_method_find_handlers(r11f_linked_method_t *linked, uint32_t pc);
+
+R11F_EXPORT r11f_loop_counter_t*
+r11f_method_find_loop(r11f_linked_method_t *linked, uint32_t header_pc);
+
+/* the result of a trivial method called with `args` */
+R11F_EXPORT r11f_value_t
+r11f_method_run_trivial(r11f_linked_method_t const *linked,
+                        r11f_value_t const *args);
+
+R11F_EXPORT uint16_t r11f_descriptor_argc(char const *descriptor);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* R11F_LINK_H */
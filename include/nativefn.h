@@ -0,0 +1,58 @@
+#ifndef R11F_NATIVEFN_H
+#define R11F_NATIVEFN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "defs.h"
+#include "forward.h"
+#include "frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Intrinsics: JDK methods the VM implements itself, keyed by class, name
+ * and descriptor (nativefninc.h). An invokestatic naming one of them
+ * never resolves its class; the interpreters call r11f_nativefn_call,
+ * the baseline JIT calls it from the compiled code and the optimizing
+ * compiler emits the operation inline (popcnt, lzcnt, tzcnt and bswap
+ * where the CPU has them) or folds it when the arguments are constant.
+ *
+ * Thread.yield() has no result; the interpreters park the virtual
+ * thread calling it (vthread.h), compiled code goes on.
+ */
+
+enum {
+#define NATIVEFN(CODE,CLASS,NAME,DESCRIPTOR) R11F_NATIVEFN_##CODE,
+#include "nativefninc.h"
+    R11F_NATIVEFN_COUNT
+};
+
+#define R11F_NATIVEFN_NONE UINT16_MAX
+
+R11F_EXPORT uint16_t r11f_nativefn_find(char const *class_name,
+                                        uint16_t class_name_len,
+                                        char const *name,
+                                        uint16_t name_len,
+                                        char const *descriptor,
+                                        uint16_t descriptor_len);
+/* the intrinsic methodref `index` of `clazz` names, if any */
+R11F_EXPORT uint16_t r11f_nativefn_find_ref(r11f_class_t *clazz,
+                                            uint16_t index);
+
+R11F_EXPORT char const *r11f_nativefn_name(uint16_t fn);
+R11F_EXPORT uint16_t r11f_nativefn_argc(uint16_t fn);
+/* whether the result is a long, otherwise an int */
+R11F_EXPORT bool r11f_nativefn_wide(uint16_t fn);
+
+/* `args` holds one value per argument, longs included */
+R11F_EXPORT r11f_value_t r11f_nativefn_call(uint16_t fn,
+                                            r11f_value_t const *args);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* R11F_NATIVEFN_H */
@@ -0,0 +1,24 @@
+#ifndef NATIVEFN
+#define NATIVEFN(CODE,CLASS,NAME,DESCRIPTOR)
+#endif
+
+NATIVEFN(iabs, "java/lang/Math", "abs", "(I)I")
+NATIVEFN(labs, "java/lang/Math", "abs", "(J)J")
+NATIVEFN(imin, "java/lang/Math", "min", "(II)I")
+NATIVEFN(lmin, "java/lang/Math", "min", "(JJ)J")
+NATIVEFN(imax, "java/lang/Math", "max", "(II)I")
+NATIVEFN(lmax, "java/lang/Math", "max", "(JJ)J")
+
+NATIVEFN(ibitcount, "java/lang/Integer", "bitCount", "(I)I")
+NATIVEFN(inlz, "java/lang/Integer", "numberOfLeadingZeros", "(I)I")
+NATIVEFN(intz, "java/lang/Integer", "numberOfTrailingZeros", "(I)I")
+NATIVEFN(ibswap, "java/lang/Integer", "reverseBytes", "(I)I")
+
+NATIVEFN(lbitcount, "java/lang/Long", "bitCount", "(J)I")
+NATIVEFN(lnlz, "java/lang/Long", "numberOfLeadingZeros", "(J)I")
+NATIVEFN(lntz, "java/lang/Long", "numberOfTrailingZeros", "(J)I")
+NATIVEFN(lbswap, "java/lang/Long", "reverseBytes", "(J)J")
+
+NATIVEFN(yield, "java/lang/Thread", "yield", "()V")
+
+#undef NATIVEFN
@@ -0,0 +1,36 @@
+#ifndef R11F_OBJECT_H
+#define R11F_OBJECT_H
+
+#include <stdint.h>
+
+#include "defs.h"
+#include "forward.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Instance of a class. Fields are not supported yet, so an object is
+ * nothing but its class, which is what virtual calls dispatch on.
+ * Objects belong to the VM that allocated them and live until
+ * r11f_vm_cleanup, there is no garbage collection.
+ */
+struct st_r11f_object {
+    r11f_class_t *clazz;
+    r11f_object_t *next;
+};
+
+/* int[], the only array type so far. Arrays have no class, element
+   accesses check the index against `length` */
+struct st_r11f_array {
+    r11f_object_t object;
+    int32_t length;
+    int32_t data[];
+};
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* R11F_OBJECT_H */
@@ -0,0 +1,60 @@
+#ifndef R11F_OPT_H
+#define R11F_OPT_H
+
+#include "defs.h"
+#include "error.h"
+#include "forward.h"
+#include "jit.h"
+#include "link.h"
+#include "vm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Optimizing compiler. Translates the method's register IR to SSA form,
+ * inlining small static callees, folds constants and branches, removes
+ * dead code, and emits x86-64 code with values in machine registers.
+ * The result is run like baseline JIT code and freed with r11f_jit_free.
+ *
+ * Null and bounds checks of array accesses go away where an earlier
+ * check or the array's allocation already proves them, and inside
+ * counted loops (an index stepping by one from a non-negative start
+ * while below the length, or below a limit that a check ahead of the
+ * loop compares against the length). Such checks ahead of the loop
+ * leave to the interpreter at the loop header when they fail.
+ *
+ * Counted loops left without checks whose body only loads, stores and
+ * combines int[] elements at the index, or sums into one accumulator,
+ * run several iterations at a time in SSE4.1 or AVX2 registers, as wide
+ * as the CPU (and vm->simd_level) allows; the original loop finishes
+ * the iterations left over.
+ *
+ * int[] allocations of a small constant length whose elements are only
+ * accessed at constant indices are kept in registers instead, one value
+ * per element. Speculation points the array is live at allocate it
+ * again for the interpreter, see r11f_deopt_object_t.
+ *
+ * Calls of the intrinsics in nativefn.h become the instructions they
+ * stand for (cmov, popcnt, lzcnt, tzcnt, bswap), constant arguments fold.
+ *
+ * Callees are resolved (and their classes loaded) at compile time, so
+ * the method needs a VM to compile against.
+ */
+R11F_EXPORT r11f_error_t r11f_opt_compile(r11f_vm_t *vm,
+                                          r11f_linked_method_t *method,
+                                          r11f_jit_code_t **output);
+
+/* like r11f_opt_compile, but the entry of the code takes over a frame the
+   bytecode interpreter has run up to the loop header at `pc` */
+R11F_EXPORT r11f_error_t r11f_opt_compile_osr(r11f_vm_t *vm,
+                                              r11f_linked_method_t *method,
+                                              uint32_t pc,
+                                              r11f_jit_code_t **output);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* R11F_OPT_H */
@@ -0,0 +1,87 @@
+#ifndef R11F_REGIR_H
+#define R11F_REGIR_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "defs.h"
+#include "error.h"
+#include "forward.h"
+#include "link.h"
+#include "switch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+#define REGIR_OP(CODE) R11F_RI_##CODE,
+#include "regirinc.h"
+};
+
+/*
+ * Three-address register instruction. Registers index the frame's value
+ * area directly: [0, max_locals) are local variables and
+ * [max_locals, max_locals + max_stack) are operand stack slots.
+ *
+ * Branch instructions have no destination, so `dst` holds the index of
+ * the target instruction. `invokestatic` takes its arguments from the
+ * registers starting at `a`, stores its result to `dst`, and keeps the
+ * constant pool index of the methodref in `imm`. `invokevirtual` does
+ * the same with the receiver in register `a`, the arguments after it.
+ * `intrinsic` is an invokestatic of a nativefn.h method, which it calls
+ * as nativefn `imm` without ever resolving it.
+ * References are plain values, `areturn` becomes `lreturn`. `switch` looks up
+ * register `a` in switches[imm], whose targets are instruction indices.
+ * `iaload` reads element `b` of the int[] in `a`; `iastore` has nothing
+ * to write either and stores register `dst` there instead. `athrow`
+ * throws the reference in `a`. Exception handlers start with the
+ * exception in the first stack slot, locals are always in their
+ * registers when an instruction throws.
+ */
+typedef struct {
+    uint16_t op;
+    uint16_t dst;
+    uint16_t a;
+    uint16_t b;
+    int64_t imm;
+} r11f_regir_insn_t;
+
+/* instruction a loop header bytecode translated to. The operand stack
+   is flushed to its slots there, so a frame the bytecode interpreter ran
+   up to `pc` can continue at `insn` as it is */
+typedef struct {
+    uint32_t pc;
+    uint32_t insn;
+} r11f_regir_loop_t;
+
+struct st_r11f_regir {
+    uint32_t insn_count;
+    uint32_t bytecode_count;
+    uint32_t switch_count;
+    r11f_switch_t **switches;
+    /* one per reachable entry of linked->loops, sorted by pc */
+    uint32_t loop_count;
+    r11f_regir_loop_t *loops;
+    /* the bytecode pc each instruction came from, and the instruction
+       each entry of linked->handlers starts at, UINT32_MAX if its code
+       is unreachable */
+    uint32_t *pcs;
+    uint32_t *handler_insns;
+    uint32_t throw_count;
+    r11f_regir_insn_t insns[];
+};
+
+R11F_EXPORT r11f_error_t r11f_regir_compile(r11f_linked_method_t *method,
+                                            r11f_regir_t **output);
+R11F_EXPORT void r11f_regir_free(r11f_regir_t *regir);
+R11F_EXPORT r11f_regir_loop_t *r11f_regir_find_loop(r11f_regir_t *regir,
+                                                    uint32_t pc);
+R11F_EXPORT char const* r11f_regir_explain_op(uint16_t op);
+R11F_EXPORT void r11f_regir_dump(FILE *fp, r11f_regir_t *regir);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* R11F_REGIR_H */
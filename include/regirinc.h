@@ -0,0 +1,86 @@
+#ifndef REGIR_OP
+#define REGIR_OP(CODE)
+#endif
+
+REGIR_OP(nop)
+REGIR_OP(mov)
+REGIR_OP(movi)
+
+REGIR_OP(iadd)
+REGIR_OP(iaddi)
+REGIR_OP(isub)
+REGIR_OP(imul)
+REGIR_OP(imuli)
+REGIR_OP(idiv)
+REGIR_OP(irem)
+REGIR_OP(ineg)
+REGIR_OP(ishl)
+REGIR_OP(ishli)
+REGIR_OP(ishr)
+REGIR_OP(ishri)
+REGIR_OP(iushr)
+REGIR_OP(iushri)
+REGIR_OP(iand)
+REGIR_OP(iandi)
+REGIR_OP(ior)
+REGIR_OP(iori)
+REGIR_OP(ixor)
+REGIR_OP(ixori)
+
+REGIR_OP(ladd)
+REGIR_OP(laddi)
+REGIR_OP(lsub)
+REGIR_OP(lmul)
+REGIR_OP(ldiv)
+REGIR_OP(lrem)
+REGIR_OP(lneg)
+REGIR_OP(lshl)
+REGIR_OP(lshr)
+REGIR_OP(lushr)
+REGIR_OP(land)
+REGIR_OP(lor)
+REGIR_OP(lxor)
+
+REGIR_OP(i2l)
+REGIR_OP(l2i)
+REGIR_OP(i2b)
+REGIR_OP(i2c)
+REGIR_OP(i2s)
+REGIR_OP(lcmp)
+REGIR_OP(intrinsic)
+
+REGIR_OP(newarray)
+REGIR_OP(arraylength)
+REGIR_OP(iaload)
+
+REGIR_OP(ifeq)
+REGIR_OP(ifne)
+REGIR_OP(iflt)
+REGIR_OP(ifge)
+REGIR_OP(ifgt)
+REGIR_OP(ifle)
+REGIR_OP(if_icmpeq)
+REGIR_OP(if_icmpne)
+REGIR_OP(if_icmplt)
+REGIR_OP(if_icmpge)
+REGIR_OP(if_icmpgt)
+REGIR_OP(if_icmple)
+REGIR_OP(if_icmpeqi)
+REGIR_OP(if_icmpnei)
+REGIR_OP(if_icmplti)
+REGIR_OP(if_icmpgei)
+REGIR_OP(if_icmpgti)
+REGIR_OP(if_icmplei)
+REGIR_OP(goto)
+REGIR_OP(switch)
+
+REGIR_OP(return)
+REGIR_OP(ireturn)
+REGIR_OP(lreturn)
+REGIR_OP(invokestatic)
+REGIR_OP(invokevirtual)
+REGIR_OP(iastore)
+REGIR_OP(athrow)
+REGIR_OP(yield)
+
+#undef REGIR_OP
@@ -0,0 +1,50 @@
+#ifndef R11F_SWITCH_H
+#define R11F_SWITCH_H
+
+#include <stdint.h>
+
+#include "defs.h"
+#include "error.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    /* targets[key - low], for tableswitch and nearly contiguous keys */
+    R11F_SWITCH_TABLE = 0,
+    /* branchless binary search over the sorted keys */
+    R11F_SWITCH_BSEARCH = 1,
+    /* perfect hash: slot (key * hash_mul) >> hash_shift holds the key */
+    R11F_SWITCH_HASH = 2,
+};
+
+/* a tableswitch or lookupswitch compiled into a lookup structure, all
+   targets are absolute code positions */
+typedef struct {
+    uint32_t pc;
+    uint8_t kind;
+    uint8_t hash_shift;
+    uint32_t hash_mul;
+    int32_t low;
+    uint32_t count;
+    uint32_t default_target;
+    int32_t *keys;
+    uint32_t *targets;
+} r11f_switch_t;
+
+R11F_EXPORT r11f_error_t r11f_switch_compile(uint8_t *code,
+                                             uint32_t code_length,
+                                             uint32_t pc,
+                                             r11f_switch_t **output);
+R11F_EXPORT r11f_error_t r11f_switch_remap(r11f_switch_t *sw,
+                                           uint32_t const *target_map,
+                                           r11f_switch_t **output);
+R11F_EXPORT uint32_t r11f_switch_lookup(r11f_switch_t *sw, int32_t key);
+R11F_EXPORT void r11f_switch_free(r11f_switch_t *sw);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* R11F_SWITCH_H */
@@ -0,0 +1,80 @@
+#ifndef R11F_TIER_H
+#define R11F_TIER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "defs.h"
+#include "error.h"
+#include "forward.h"
+#include "jit.h"
+#include "vm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Tiered compilation for R11F_EXEC_TIERED. Every method starts in the
+ * bytecode interpreter, which counts its invocations and the back edges
+ * taken inside it. Once the sum reaches vm->tier1_threshold the method
+ * is queued for the baseline JIT, at vm->tier2_threshold for the
+ * optimizing compiler. Frames created afterwards pick up the best code
+ * published so far.
+ *
+ * A frame already running in the interpreter moves to compiled code at
+ * a loop header (on-stack replacement): baseline code has an entry at
+ * every loop header, and a loop whose own counter reaches
+ * vm->tier2_threshold gets optimized code entered right there.
+ *
+ * With vm->compile_threads set, compiling happens on that many background
+ * threads and the executing thread never waits for it; class loading and
+ * linking are then serialized by a VM wide lock. Without, the executing
+ * thread compiles synchronously when a threshold is crossed.
+ */
+
+#define R11F_TIER1_DEFAULT_THRESHOLD 1000
+#define R11F_TIER2_DEFAULT_THRESHOLD 10000
+#define R11F_MAX_COMPILE_THREADS 8
+
+enum {
+    R11F_TIER_BASELINE = 1,
+    R11F_TIER_OPT = 2,
+};
+
+/* one finished compilation, counters as of the time it was requested;
+   osr tells an entry at loop header osr_pc from a whole method */
+typedef struct {
+    r11f_linked_method_t *method;
+    uint8_t tier;
+    bool osr;
+    uint32_t osr_pc;
+    uint32_t invoke_count;
+    uint32_t backedge_count;
+    r11f_error_t result;
+} r11f_compile_event_t;
+
+/* blocks until every queued compilation has finished */
+R11F_EXPORT void r11f_vm_compile_wait(r11f_vm_t *vm);
+
+/* copies up to `max` recorded events to `output`, returns the total */
+R11F_EXPORT uint32_t r11f_vm_compile_events(r11f_vm_t *vm,
+                                            r11f_compile_event_t *output,
+                                            uint32_t max);
+
+/* implemented by tier.c, called from vm.c */
+R11F_INTERNAL void r11f_tier_invoke(r11f_vm_t *vm,
+                                    r11f_linked_method_t *method);
+/* returns the entry to continue the frame at header_pc with, if any */
+R11F_INTERNAL r11f_jit_entry_t r11f_tier_backedge(r11f_vm_t *vm,
+                                                  r11f_linked_method_t *method,
+                                                  uint32_t header_pc);
+R11F_INTERNAL void r11f_tier_lock(r11f_vm_t *vm);
+R11F_INTERNAL void r11f_tier_unlock(r11f_vm_t *vm);
+R11F_INTERNAL void r11f_tier_shutdown(r11f_vm_t *vm);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* R11F_TIER_H */
@@ -0,0 +1,77 @@
+#ifndef R11F_TRACE_H
+#define R11F_TRACE_H
+
+#include <stdint.h>
+
+#include "defs.h"
+#include "error.h"
+#include "forward.h"
+#include "jit.h"
+#include "vm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Trace compilation for R11F_EXEC_TRACE. Methods run in the register IR
+ * interpreter, which counts the back edges taken to each loop header.
+ * Once a header got vm->trace_threshold of them, the interpreter records
+ * the path the next iteration takes: the direction of every branch and
+ * every static call, on into the callee.
+ *
+ * That path is compiled as a loop of its own: callees are inlined along
+ * it, each branch becomes a guard leaving to the interpreter when an
+ * iteration goes the other way, computations and guards on values the
+ * loop never changes move ahead of it, and guards repeating an earlier
+ * one are dropped. Frames reaching the header afterwards continue in the
+ * trace, which only ever leaves through a guard.
+ *
+ * Recording gives up at virtual calls, switches, calls into methods
+ * without register IR, back edges of any other loop and returns from the
+ * recording frame; the header then stays interpreted for good.
+ */
+
+#define R11F_TRACE_DEFAULT_THRESHOLD 100
+#define R11F_TRACE_MAX_EVENTS 256
+#define R11F_TRACE_MAX_DEPTH 8
+
+/* one step of a recorded path: at instruction `pc` of `method` either a
+   jump continuing at `target`, taken or not, or with `callee` set a
+   static call into it */
+typedef struct {
+    r11f_linked_method_t *method;
+    r11f_linked_method_t *callee;
+    uint32_t pc;
+    uint32_t target;
+} r11f_trace_event_t;
+
+/* compiles the path recorded from instruction `header` of `method` back
+   to it; the code's entry takes over a frame at the header */
+R11F_EXPORT r11f_error_t r11f_trace_compile(r11f_linked_method_t *method,
+                                            uint32_t header,
+                                            r11f_trace_event_t const *events,
+                                            uint32_t event_count,
+                                            r11f_jit_code_t **output);
+
+/* implemented by trace.c, called by the register IR interpreter. Jumps
+   are reported before they are taken; the returned entry, if any,
+   continues the frame at `target` */
+R11F_INTERNAL r11f_jit_entry_t r11f_trace_jump(r11f_vm_t *vm,
+                                               r11f_frame_t *frame,
+                                               uint32_t pc,
+                                               uint32_t target);
+/* NULL `callee` for calls recording cannot follow */
+R11F_INTERNAL void r11f_trace_invoke(r11f_vm_t *vm,
+                                     r11f_frame_t *frame,
+                                     uint32_t pc,
+                                     r11f_linked_method_t *callee);
+R11F_INTERNAL void r11f_trace_return(r11f_vm_t *vm, r11f_frame_t *frame);
+R11F_INTERNAL void r11f_trace_abort(r11f_vm_t *vm);
+R11F_INTERNAL void r11f_trace_cleanup(r11f_vm_t *vm);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* R11F_TRACE_H */
@@ -0,0 +1,54 @@
+#ifndef R11F_VERIFY_H
+#define R11F_VERIFY_H
+
+#include <stdint.h>
+
+#include "defs.h"
+#include "error.h"
+#include "forward.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Load-time bytecode verification. The VM checks every method of a class
+ * once, before the class becomes visible, by type checking its code
+ * against the StackMapTable attribute the way the JVM does for class
+ * files of version 50 and later: one linear pass, with the frame at each
+ * branch target taken from the table instead of inferred. A method that
+ * passes has stack depths within max_stack, loads and stores within
+ * max_locals on slots of the right type, operands of the right type for
+ * every instruction, calls matching their descriptors, and branches and
+ * switch cases that land on instruction starts, and exception handlers
+ * whose frame holds just the exception and suits the locals of every
+ * instruction they cover. The interpreters rely on that and check
+ * nothing of it at run time.
+ *
+ * Class types are not checked against each other, the VM would need
+ * every class of the hierarchy loaded to do that. Calls dispatch on the
+ * class of the receiver object, so a wrongly typed receiver ends in
+ * R11F_ERR_method_not_found rather than in memory it should not touch.
+ * Arrays are told apart from objects.
+ *
+ * Methods using instructions the VM does not implement are not type
+ * checked; they keep R11F_ERR_not_implemented_instruction in
+ * method_info->verify_error and fail when invoked.
+ */
+
+/* verifies the code of every method of `clazz` and fills the counters
+   of r11f_class_t; R11F_ERR_verify_failed if any method is rejected */
+R11F_EXPORT r11f_error_t r11f_class_verify(r11f_class_t *clazz);
+
+/* R11F_ERR_verify_failed with the pc of the offending instruction in
+   `out_pc` (if not NULL), R11F_ERR_not_implemented_instruction, or
+   R11F_ERR_out_of_memory; succeeds for methods without code */
+R11F_EXPORT r11f_error_t r11f_method_verify(r11f_class_t *clazz,
+                                            r11f_method_info_t *method_info,
+                                            uint32_t *out_pc);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* R11F_VERIFY_H */
@@ -1,20 +1,121 @@
 #ifndef R11F_VM_H
 #define R11F_VM_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "defs.h"
+#include "except.h"
 #include "forward.h"
+#include "frame.h"
 #include <error.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define R11F_MAX_BATCH_THREADS 16
+/* fewer rows than this per thread are not worth a thread */
+#define R11F_BATCH_MIN_ROWS 16384
+
+enum {
+    R11F_EXEC_BYTECODE = 0,
+    R11F_EXEC_REGIR = 1,
+    R11F_EXEC_TOSCACHE = 2,
+    R11F_EXEC_JIT = 3,
+    R11F_EXEC_OPT = 4,
+    R11F_EXEC_TIERED = 5,
+    R11F_EXEC_TRACE = 6,
+};
+
+/* instruction sets optimized code may vectorize loops with, see opt.h */
+enum {
+    R11F_SIMD_DEFAULT = 0,
+    R11F_SIMD_SCALAR = 1,
+    R11F_SIMD_SSE41 = 2,
+    R11F_SIMD_AVX2 = 3,
+};
+
 typedef struct {
     char const* const* classpath;
     r11f_classmgr_t *classmgr;
     r11f_frame_t *current_frame;
+
+    /* R11F_EXEC_REGIR translates methods to register IR before running,
+       R11F_EXEC_TOSCACHE keeps the top of the operand stack in registers,
+       R11F_EXEC_JIT further compiles the register IR to machine code,
+       R11F_EXEC_OPT runs it through the optimizing compiler first,
+       R11F_EXEC_TIERED interprets until a method gets hot, see tier.h,
+       R11F_EXEC_TRACE compiles the hot paths through loops, see trace.h */
+    uint8_t exec_mode;
+
+    /* R11F_EXEC_TIERED only, zero picks the defaults of tier.h; without
+       compile threads the executing thread compiles synchronously */
+    uint32_t tier1_threshold;
+    uint32_t tier2_threshold;
+    uint8_t compile_threads;
+    r11f_compiler_t *compiler;
+
+    /* R11F_EXEC_TRACE only, zero picks the default of trace.h */
+    uint32_t trace_threshold;
+    r11f_tracer_t *tracer;
+
+    /* testing aid: optimized code compiled while this is set leaves to
+       the interpreter the first time it reaches each speculation point */
+    uint8_t deopt_stress;
+
+    /* the widest R11F_SIMD_* level optimized code may use, as far as the
+       CPU has it; R11F_SIMD_DEFAULT leaves it to the CPU alone */
+    uint8_t simd_level;
+
+    /* baseline code is kept in this directory across runs, see
+       jitcache.h; NULL compiles it anew every time */
+    char const *jit_cache_dir;
+
+    /* NULL terminated paths of AOT compiled shared objects, see aot.h;
+       `aot` holds them once opened */
+    char const* const* aot_modules;
+    r11f_aot_t *aot;
+
+    /* r11f_vm_invoke_batch spreads the rows of methods computing from
+       their arguments alone over up to this many threads, at most
+       R11F_MAX_BATCH_THREADS; zero or one keeps them on the caller */
+    uint8_t batch_threads;
+
+    /* bytes reserved for the frames of the thread running the VM, zero
+       picks R11F_STACK_DEFAULT_SIZE; calls nested deeper than that
+       throw StackOverflowError */
+    size_t stack_size;
+    r11f_stack_t stack;
+
+    /* while r11f_sched_run runs, its scheduler and the virtual thread
+       this VM, or the carrier's copy of it, is running, see vthread.h */
+    r11f_sched_t *sched;
+    r11f_vthread_t *vthread;
+
+    /* every object allocated so far, see object.h */
+    r11f_object_t *objects;
+
+    /* the exception of the last call that failed with
+       R11F_ERR_uncaught_exception or with the error of a built in
+       exception, and the frames it went through, see except.h */
+    r11f_object_t *exception;
+    r11f_backtrace_t backtrace;
+    /* the instances the VM throws for its own errors, made on first use */
+    r11f_object_t *fast_exceptions[R11F_EXCEPT_COUNT];
 } r11f_vm_t;
 
+/* a static method looked up, checked and linked by
+   r11f_vm_prepare_static, valid for as long as the VM */
+typedef struct {
+    r11f_class_t *clazz;
+    r11f_method_info_t *method_info;
+    r11f_linked_method_t *linked;
+} r11f_method_handle_t;
+
+/* looks up and runs a static method, storing its result to `output` as
+   an int32_t, int64_t or pointer; r11f_vm_prepare_static and
+   r11f_vm_call do the same in two steps */
 R11F_EXPORT
 r11f_error_t r11f_vm_invoke_static(r11f_vm_t *vm,
                                    char const *class_name,
@@ -22,6 +123,48 @@ r11f_error_t r11f_vm_invoke_static(r11f_vm_t *vm,
                                    char const *method_descriptor,
                                    r11f_value_t *argv,
                                    void *output);
+
+/* everything r11f_vm_invoke_static does before running the method,
+   done once for code calling it over and over */
+R11F_EXPORT
+r11f_error_t r11f_vm_prepare_static(r11f_vm_t *vm,
+                                    char const *class_name,
+                                    char const *method_name,
+                                    char const *method_descriptor,
+                                    r11f_method_handle_t *handle);
+
+/* runs a prepared method with one value per argument. Its result goes
+   to the member of `result` for its type, i32 for ints, i64 for longs
+   and ptr for references; `result` may be NULL */
+R11F_EXPORT
+r11f_error_t r11f_vm_call(r11f_vm_t *vm,
+                          r11f_method_handle_t const *handle,
+                          r11f_value_t *argv,
+                          r11f_value_t *result);
+
+/* runs a prepared method once per row. `columns` holds an array of
+   `nrows` values for each argument, the result of row i goes to
+   `results[i]` as with r11f_vm_call; `results` may be NULL. The first
+   row that fails stops the batch with its error, the rows before it
+   have their results */
+R11F_EXPORT
+r11f_error_t r11f_vm_invoke_batch(r11f_vm_t *vm,
+                                  r11f_method_handle_t const *handle,
+                                  r11f_value_t const* const* columns,
+                                  size_t nrows,
+                                  r11f_value_t *results);
+
+/* writes the class of vm->exception and the frames it went through to
+   `buf`, truncated to `size` bytes with the terminating NUL included;
+   returns the length the full text has, 0 without an exception */
+R11F_EXPORT size_t r11f_vm_format_stack_trace(r11f_vm_t *vm,
+                                              char *buf,
+                                              size_t size);
+
+/* waits for background compilation and releases what the VM created
+   lazily, objects included; the classes stay with the class manager */
+R11F_EXPORT void r11f_vm_cleanup(r11f_vm_t *vm);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
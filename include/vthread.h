@@ -0,0 +1,102 @@
+#ifndef R11F_VTHREAD_H
+#define R11F_VTHREAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "defs.h"
+#include "error.h"
+#include "forward.h"
+#include "frame.h"
+#include "vm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Virtual threads: calls of prepared static methods, any number of them,
+ * run interleaved on a few carrier threads. A virtual thread calling
+ * Thread.yield() in the interpreter parks: its frames are moved off the
+ * carrier's VM stack to the heap (r11f_stack_detach), and whichever
+ * carrier takes it up next moves them back onto its own and goes on
+ * after the call. A parked virtual thread costs the bytes its frames
+ * use, not a stack.
+ *
+ * Each carrier runs the virtual threads queued to it in turn, a parked
+ * one going to the back; a carrier out of work steals half the queue of
+ * another.
+ *
+ * Compiled code never parks: yield goes on there, as it does in frames
+ * called from compiled code, and under R11F_EXEC_TRACE, whose recorder
+ * follows a single thread of execution.
+ *
+ * Carriers share the classes and linked methods, with class loading,
+ * linking and translation serialized, but each has a stack, objects and
+ * exceptions of its own. Only R11F_EXEC_BYTECODE, R11F_EXEC_REGIR and
+ * R11F_EXEC_TOSCACHE, which keep no state per call site, run more than
+ * one carrier; the compiling modes run every virtual thread on the
+ * thread calling r11f_sched_run.
+ */
+
+#define R11F_MAX_CARRIERS 64
+
+struct st_r11f_vthread {
+    /* the next in the run queue of its carrier */
+    r11f_vthread_t *next;
+    /* the one spawned before it on the same scheduler */
+    r11f_vthread_t *spawned_before;
+
+    r11f_method_handle_t handle;
+    /* its frames while parked, bytes is NULL otherwise */
+    r11f_continuation_t cont;
+
+    bool done;
+    /* set once done, as r11f_vm_call would have; exception is the one
+       it failed with, if any, and backtrace the frames it went through */
+    r11f_error_t error;
+    r11f_value_t result;
+    r11f_object_t *exception;
+    r11f_backtrace_t backtrace;
+
+    r11f_value_t argv[];
+};
+
+/* a scheduler running the virtual threads spawned on `vm` on up to
+   `carriers` threads, as the execution mode at this point allows; NULL
+   when out of memory */
+R11F_EXPORT r11f_sched_t *r11f_sched_alloc(r11f_vm_t *vm, uint8_t carriers);
+
+/* a virtual thread calling `handle` with one value per argument, to run
+   on the next r11f_sched_run; NULL when out of memory */
+R11F_EXPORT r11f_vthread_t *r11f_sched_spawn(r11f_sched_t *sched,
+                                             r11f_method_handle_t const *handle,
+                                             r11f_value_t const *argv);
+
+/* runs every virtual thread spawned so far until it is done, each with
+   an error of its own, see r11f_vthread_result. The objects they made
+   belong to the VM afterwards */
+R11F_EXPORT void r11f_sched_run(r11f_sched_t *sched);
+
+/* the error `vthread` ended with, R11F_ERR_parked before it is done;
+   its result goes to `result` as with r11f_vm_call */
+R11F_EXPORT r11f_error_t r11f_vthread_result(r11f_vthread_t const *vthread,
+                                             r11f_value_t *result);
+
+/* frees the scheduler along with its virtual threads */
+R11F_EXPORT void r11f_sched_free(r11f_sched_t *sched);
+
+/* implemented by vm.c, called from vthread.c: runs `vthread` on `vm` from
+   the start or from where it parked, until it parks again or is done */
+R11F_INTERNAL r11f_error_t r11f_vm_run_vthread(r11f_vm_t *vm,
+                                               r11f_vthread_t *vthread);
+
+/* implemented by vthread.c, called from tier.c */
+R11F_INTERNAL void r11f_sched_lock(r11f_sched_t *sched);
+R11F_INTERNAL void r11f_sched_unlock(r11f_sched_t *sched);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* R11F_VTHREAD_H */
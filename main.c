@@ -1,18 +1,49 @@
 #include <assert.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <inttypes.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "aot.h"
+#include "bytecode.h"
 #include "clsfile.h"
 #include "class.h"
+#include "class/attrib.h"
 #include "cfdump.h"
 #include "clsmgr.h"
 #include "error.h"
 #include "forward.h"
 #include "frame.h"
+#include "jit.h"
+#include "jitcache.h"
+#include "link.h"
+#include "regir.h"
+#include "switch.h"
+#include "tier.h"
+#include "verify.h"
 #include "vm.h"
+#include "vthread.h"
+
+static char const *g_exec_mode_names[] = {
+    [R11F_EXEC_BYTECODE] = "bytecode",
+    [R11F_EXEC_REGIR] = "regir",
+    [R11F_EXEC_TOSCACHE] = "toscache",
+    [R11F_EXEC_JIT] = "jit",
+    [R11F_EXEC_OPT] = "opt",
+    [R11F_EXEC_TIERED] = "tiered",
+    [R11F_EXEC_TRACE] = "trace",
+};
 
 void drill_main(void);
+void bench_main(void);
+int aot_main(char const *output, char const* const* paths, int count);
+int verify_main(char const* const* paths, int count);
 
 int main(int argc, char *argv[]) {
     if (argc >= 3 && !strcmp(argv[1], "--dump")) {
@@ -47,35 +78,47 @@ int main(int argc, char *argv[]) {
     else if (argc == 2 && !strcmp(argv[1], "--drill")) {
         drill_main();
     }
+    else if (argc == 2 && !strcmp(argv[1], "--bench")) {
+        bench_main();
+    }
+    else if (argc >= 4 && !strcmp(argv[1], "--aot")) {
+        return aot_main(argv[2], (char const* const*)argv + 3, argc - 3);
+    }
+    else if (argc >= 3 && !strcmp(argv[1], "--verify")) {
+        return verify_main((char const* const*)argv + 2, argc - 2);
+    }
     else {
         fprintf(
             stderr,
             "R11F: JVM bytecode disassembler and interpreter\n"
             "usage:\n"
             "    %s --dump <classfile>...\tdisassemble class files\n"
-            "    %s --drill\trun drill tests\n",
+            "    %s --drill\trun drill tests\n"
+            "    %s --bench\tcompare execution modes\n"
+            "    %s --aot <output> <classfile>...\tcompile to a shared object\n"
+            "    %s --verify <classfile>...\tverify class files\n",
+            argv[0],
+            argv[0],
+            argv[0],
             argv[0],
             argv[0]
         );
     }
 }
 
-void drill_main(void) {
-    r11f_vm_t vm;
-    vm.classpath = (char const*[]){
-        "test",
-        NULL
-    };
-    vm.classmgr = r11f_classmgr_alloc();;
-    vm.current_frame = NULL;
-
-    int64_t output;
+static void drill_invoke(r11f_vm_t *vm,
+                         char const *class_name,
+                         char const *method_name,
+                         char const *descriptor,
+                         r11f_value_t *argv,
+                         int64_t expected) {
+    r11f_value_t output = { .i64 = 0 };
     r11f_error_t err = r11f_vm_invoke_static(
-        &vm,
-        "com/example/Add",
-        "add_mixed",
-        "(JI)J",
-        (r11f_value_t[]){{.i64=2147483648}, {.i32=124875}},
+        vm,
+        class_name,
+        method_name,
+        descriptor,
+        argv,
         &output
     );
 
@@ -84,8 +127,1588 @@ void drill_main(void) {
         assert(0 && "failed to invoke method");
     }
 
-    fprintf(stderr, "r11f_vm_invoke(&vm, \"com/example/Add\", \"add_mixed\", \"(JI)J\", { 2147483648, 124875 }, &output) = %" PRId64 "\n", output);
+    int64_t value = descriptor[strlen(descriptor) - 1] == 'J' ?
+        output.i64 :
+        output.i32;
+    fprintf(
+        stderr,
+        "[%s] %s.%s%s = %" PRId64 "\n",
+        g_exec_mode_names[vm->exec_mode],
+        class_name,
+        method_name,
+        descriptor,
+        value
+    );
+
+    assert(value == expected && "unexpected output");
+}
+
+static void drill_invoke_error(r11f_vm_t *vm,
+                               char const *class_name,
+                               char const *method_name,
+                               char const *descriptor,
+                               r11f_value_t *argv,
+                               r11f_error_t expected) {
+    r11f_value_t output = { .i64 = 0 };
+    r11f_error_t err = r11f_vm_invoke_static(
+        vm,
+        class_name,
+        method_name,
+        descriptor,
+        argv,
+        &output
+    );
+    fprintf(
+        stderr,
+        "[%s] %s.%s%s fails: %s\n",
+        g_exec_mode_names[vm->exec_mode],
+        class_name,
+        method_name,
+        descriptor,
+        r11f_explain_error(err)
+    );
+
+    assert(err == expected && "unexpected error");
+}
+
+/* runs one long call of Loop.sum_squares with synchronous compilation,
+   which has to leave the interpreter mid loop for code of `tier` */
+static void drill_osr(uint32_t tier1, uint32_t tier2, uint8_t tier) {
+    r11f_vm_t vm = { 0 };
+    vm.classpath = (char const*[]){
+        "test",
+        NULL
+    };
+    vm.classmgr = r11f_classmgr_alloc();
+    vm.exec_mode = R11F_EXEC_TIERED;
+    vm.tier1_threshold = tier1;
+    vm.tier2_threshold = tier2;
+
+    drill_invoke(&vm, "com/example/Loop", "sum_squares", "(I)J",
+                 (r11f_value_t[]){{.i32=100000}},
+                 333328333350000L);
+
+    r11f_class_t *clazz =
+        r11f_classmgr_find_class(vm.classmgr, "com/example/Loop");
+    r11f_method_info_t *method_info = r11f_class_resolve_method(
+        clazz, "sum_squares", 11, "(I)J", 4
+    );
+    r11f_linked_method_t *linked = method_info->linked;
+    assert(linked->loop_count == 1
+           && linked->loops[0].count < 100
+           && "sum_squares stayed in the interpreter");
+
+    r11f_compile_event_t events[4];
+    uint32_t count = r11f_vm_compile_events(&vm, events, 4);
+    bool found = false;
+    for (uint32_t i = 0; i < count && i < 4; i++) {
+        found |= events[i].method == linked
+            && events[i].tier == tier
+            && events[i].osr == (tier == R11F_TIER_OPT)
+            && events[i].result == R11F_success;
+    }
+    assert(found && "sum_squares not compiled for OSR");
+
+    r11f_vm_cleanup(&vm);
+    r11f_classmgr_free(vm.classmgr);
+}
+
+static r11f_jit_code_t *drill_find_opt(r11f_vm_t *vm,
+                                       char const *class_name,
+                                       char const *method_name,
+                                       char const *descriptor) {
+    r11f_class_t *clazz = r11f_classmgr_find_class(vm->classmgr, class_name);
+    r11f_method_info_t *method_info = r11f_class_resolve_method(
+        clazz,
+        method_name,
+        strlen(method_name),
+        descriptor,
+        strlen(descriptor)
+    );
+    return method_info->linked->opt;
+}
+
+static void drill_escape_cases(r11f_vm_t *vm) {
+    drill_invoke(vm, "com/example/Escape", "pairs", "(I)I",
+                 (r11f_value_t[]){{.i32=1000}},
+                 998498500);
+    drill_invoke(vm, "com/example/Escape", "holder", "(I)I",
+                 (r11f_value_t[]){{.i32=1000}},
+                 1496500);
+    drill_invoke(vm, "com/example/Escape", "helper", "(I)I",
+                 (r11f_value_t[]){{.i32=12}},
+                 313);
+    drill_invoke(vm, "com/example/Escape", "histogram", "(I)I",
+                 (r11f_value_t[]){{.i32=1000}},
+                 1250000);
+}
+
+/* optimized code compiled in stress mode leaves to the interpreter at
+   each of its speculation points once, inlined frames included */
+static void drill_deopt(void) {
+    r11f_vm_t vm = { 0 };
+    vm.classpath = (char const*[]){
+        "test",
+        NULL
+    };
+    vm.classmgr = r11f_classmgr_alloc();
+    vm.exec_mode = R11F_EXEC_OPT;
+    vm.deopt_stress = 1;
+
+    for (int i = 0; i < 2; i++) {
+        drill_invoke(&vm, "com/example/Add", "add_mixed", "(JI)J",
+                     (r11f_value_t[]){{.i64=2147483648}, {.i32=124875}},
+                     2147483648L + 124875L);
+        drill_invoke(&vm, "com/example/Inline", "shape", "(I)I",
+                     (r11f_value_t[]){{.i32=100}},
+                     77716);
+        drill_invoke(&vm, "com/example/Inline", "chain", "(I)I",
+                     (r11f_value_t[]){{.i32=10}},
+                     25343);
+        /* the array passed to the inlined norm gets allocated again */
+        drill_escape_cases(&vm);
+    }
+
+    /* chain inlines quad, which inlines sq twice */
+    r11f_class_t *clazz =
+        r11f_classmgr_find_class(vm.classmgr, "com/example/Inline");
+    r11f_method_info_t *method_info = r11f_class_resolve_method(
+        clazz, "chain", 5, "(I)I", 4
+    );
+    r11f_jit_code_t *opt = method_info->linked->opt;
+    assert(opt && opt->deopt_count == 3 && "chain not compiled as expected");
+    for (uint32_t i = 0; i < opt->deopt_count; i++) {
+        assert(opt->deopt_points[i].frame_count == (i == 0 ? 2 : 3)
+               && !opt->deopt_points[i].armed
+               && "chain not deoptimized at every point");
+    }
+
+    /* helper's array is in its local, the pushed argument and norm's
+       parameter, which all come back as one array */
+    opt = drill_find_opt(&vm, "com/example/Escape", "helper", "(I)I");
+    assert(opt && opt->replaced_count == 1 && opt->deopt_count == 1
+           && "helper not compiled as expected");
+    r11f_deopt_point_t *point = &opt->deopt_points[0];
+    assert(point->object_count == 3 && !point->armed
+           && "helper array not allocated again at its deopt point");
+    for (uint32_t i = 1; i < point->object_count; i++) {
+        assert(point->objects[i].elements == point->objects[0].elements
+               && "helper array allocated more than once");
+    }
+
+    /* invalidated code is not entered again */
+    r11f_jit_invalidate(opt);
+    drill_invoke(&vm, "com/example/Inline", "chain", "(I)I",
+                 (r11f_value_t[]){{.i32=10}},
+                 25343);
+
+    r11f_vm_cleanup(&vm);
+    r11f_classmgr_free(vm.classmgr);
+}
+
+static void drill_vector_cases(r11f_vm_t *vm) {
+    drill_invoke(vm, "com/example/Vector", "sum", "(I)I",
+                 (r11f_value_t[]){{.i32=7}},
+                 3517521);
+    drill_invoke(vm, "com/example/Vector", "dot", "(I)I",
+                 (r11f_value_t[]){{.i32=7}},
+                 -1944059170);
+    drill_invoke(vm, "com/example/Vector", "saxpy", "(I)I",
+                 (r11f_value_t[]){{.i32=7}},
+                 10552563);
+    drill_invoke(vm, "com/example/Vector", "map", "(I)I",
+                 (r11f_value_t[]){{.i32=7}},
+                 -316088630);
+}
+
+static void drill_intrinsic_cases(r11f_vm_t *vm) {
+    drill_invoke(vm, "com/example/Intrinsics", "ints", "(I)I",
+                 (r11f_value_t[]){{.i32=1000}},
+                 -489957429);
+    drill_invoke(vm, "com/example/Intrinsics", "longs", "(I)J",
+                 (r11f_value_t[]){{.i32=1000}},
+                 -591100703953710876L);
+    drill_invoke(vm, "com/example/Intrinsics", "folded", "()I",
+                 NULL,
+                 25);
+}
+
+static void drill_exception_cases(r11f_vm_t *vm) {
+    char const *ex = "com/example/Exceptions";
+    drill_invoke(vm, ex, "safe_div", "(II)I",
+                 (r11f_value_t[]){{.i32=84}, {.i32=2}},
+                 42);
+    drill_invoke(vm, ex, "safe_div", "(II)I",
+                 (r11f_value_t[]){{.i32=84}, {.i32=0}},
+                 -1);
+    drill_invoke(vm, ex, "probe", "(I)I",
+                 (r11f_value_t[]){{.i32=100}},
+                 5248);
+    for (int i = 0; i < 2; i++) {
+        drill_invoke(vm, ex, "find", "(II)I",
+                     (r11f_value_t[]){{.i32=100}, {.i32=7}},
+                     130);
+    }
+    drill_invoke(vm, ex, "deep", "(I)I",
+                 (r11f_value_t[]){{.i32=5}},
+                 -5);
+    drill_invoke(vm, ex, "guarded", "(I)I",
+                 (r11f_value_t[]){{.i32=4}},
+                 26);
+    drill_invoke_error(vm, ex, "guarded", "(I)I",
+                       (r11f_value_t[]){{.i32=0}},
+                       R11F_ERR_division_by_zero);
+    drill_invoke_error(vm, ex, "reject", "(I)I",
+                       (r11f_value_t[]){{.i32=-1}},
+                       R11F_ERR_uncaught_exception);
+    drill_invoke_error(vm, ex, "throw_null", "()I",
+                       NULL,
+                       R11F_ERR_null_pointer);
+
+    /* the VM stack has room for a few thousand frames */
+    drill_invoke_error(vm, ex, "overflow", "(I)I",
+                       (r11f_value_t[]){{.i32=0}},
+                       R11F_ERR_stack_overflow);
+    drill_invoke(vm, ex, "recover", "(I)I",
+                 (r11f_value_t[]){{.i32=7}},
+                 -7);
+    assert((uint8_t*)vm->stack.top == vm->stack.base
+           && "frames left on the VM stack");
+
+    /* the frames are only made text of here */
+    drill_invoke_error(vm, ex, "escape", "(I)I",
+                       (r11f_value_t[]){{.i32=3}},
+                       R11F_ERR_uncaught_exception);
+    char trace[512];
+    size_t length = r11f_vm_format_stack_trace(vm, trace, sizeof(trace));
+    assert(length < sizeof(trace)
+           && length == r11f_vm_format_stack_trace(vm, NULL, 0)
+           && vm->backtrace.count == 5
+           && "Exceptions.escape not unwound through every frame");
+    char const *top = "com/example/Stop\n"
+                      "\tat com/example/Exceptions.down(I)I (pc 11)\n"
+                      "\tat com/example/Exceptions.down(I)I (pc 15)\n";
+    /* optimized code keeps no pc */
+    char const *bottom = vm->exec_mode == R11F_EXEC_OPT ?
+        "\tat com/example/Exceptions.escape(I)I (compiled code)\n" :
+        "\tat com/example/Exceptions.escape(I)I (pc 1)\n";
+    assert(!strncmp(trace, top, strlen(top))
+           && !strcmp(trace + length - strlen(bottom), bottom)
+           && "unexpected stack trace");
+}
+
+/* a prepared handle is looked up once and called over and over, its
+   result typed by the method's return type */
+static void drill_prepared_cases(r11f_vm_t *vm) {
+    r11f_method_handle_t fib;
+    r11f_error_t err = r11f_vm_prepare_static(vm, "com/example/Calls", "fib",
+                                              "(I)I", &fib);
+    assert(err == R11F_success && "cannot prepare Calls.fib");
+    int32_t a = 0, b = 1;
+    for (int32_t n = 0; n < 20; n++) {
+        r11f_value_t result = { .i64 = -1 };
+        err = r11f_vm_call(vm, &fib, (r11f_value_t[]){{.i32=n}}, &result);
+        assert(err == R11F_success && result.i32 == a
+               && "unexpected output");
+        int32_t next = a + b;
+        a = b;
+        b = next;
+    }
+
+    r11f_method_handle_t add_mixed;
+    err = r11f_vm_prepare_static(vm, "com/example/Add2", "add_mixed",
+                                 "(JI)J", &add_mixed);
+    assert(err == R11F_success && "cannot prepare Add2.add_mixed");
+    r11f_value_t result = { .i64 = 0 };
+    err = r11f_vm_call(vm, &add_mixed,
+                       (r11f_value_t[]){{.i64=1LL << 40}, {.i32=-1}},
+                       &result);
+    assert(err == R11F_success && result.i64 == (1LL << 40) - 1
+           && "unexpected output");
+
+    r11f_method_handle_t overflow;
+    err = r11f_vm_prepare_static(vm, "com/example/Exceptions", "overflow",
+                                 "(I)I", &overflow);
+    assert(err == R11F_success && "cannot prepare Exceptions.overflow");
+    err = r11f_vm_call(vm, &overflow, (r11f_value_t[]){{.i32=1}}, NULL);
+    assert(err == R11F_ERR_stack_overflow && "unexpected error");
+
+    r11f_method_handle_t handle;
+    assert(r11f_vm_prepare_static(vm, "com/example/Calls", "fib", "(J)J",
+                                  &handle) == R11F_ERR_method_not_found
+           && r11f_vm_prepare_static(vm, "com/example/Shape", "sides", "()I",
+                                     &handle)
+              == R11F_ERR_cannot_invoke_non_static_method
+           && r11f_vm_prepare_static(vm, "com/example/Nope", "f", "()I",
+                                     &handle) != R11F_success
+           && "unexpected error");
+    fprintf(stderr, "[%s] prepared calls ok\n",
+            g_exec_mode_names[vm->exec_mode]);
+}
+
+/* a batch runs a prepared method once per row of argument columns, the
+   rows of a trivial one on several threads */
+static void drill_batch_cases(r11f_vm_t *vm) {
+    r11f_method_handle_t handle;
+    r11f_error_t err = r11f_vm_prepare_static(vm, "com/example/Calls", "fib",
+                                              "(I)I", &handle);
+    assert(err == R11F_success && "cannot prepare Calls.fib");
+    r11f_value_t ns[20];
+    r11f_value_t results[20];
+    for (int32_t n = 0; n < 20; n++) {
+        ns[n].i32 = n;
+    }
+    err = r11f_vm_invoke_batch(vm, &handle,
+                               (r11f_value_t const*[]){ ns }, 20, results);
+    assert(err == R11F_success && "unexpected error");
+    int32_t a = 0, b = 1;
+    for (int32_t n = 0; n < 20; n++) {
+        assert(results[n].i32 == a && "unexpected output");
+        int32_t next = a + b;
+        a = b;
+        b = next;
+    }
+
+    /* long arguments are one local each */
+    err = r11f_vm_prepare_static(vm, "com/example/Calls", "wide", "(J)J",
+                                 &handle);
+    assert(err == R11F_success && "cannot prepare Calls.wide");
+    r11f_value_t xs[4];
+    for (int32_t i = 0; i < 4; i++) {
+        xs[i].i64 = 5000000000 + i;
+    }
+    err = r11f_vm_invoke_batch(vm, &handle,
+                               (r11f_value_t const*[]){ xs }, 4, results);
+    assert(err == R11F_success && "unexpected error");
+    for (int32_t i = 0; i < 4; i++) {
+        assert(results[i].i64 == 4999999998 + i && "unexpected output");
+    }
+
+    /* the fourth row divides by zero, the three before it are done */
+    err = r11f_vm_prepare_static(vm, "com/example/Arith", "div", "(II)I",
+                                 &handle);
+    assert(err == R11F_success && "cannot prepare Arith.div");
+    memset(results, 0, sizeof(results));
+    err = r11f_vm_invoke_batch(
+        vm, &handle,
+        (r11f_value_t const*[]){
+            (r11f_value_t[]){{.i32=10}, {.i32=20}, {.i32=30}, {.i32=40}},
+            (r11f_value_t[]){{.i32=2}, {.i32=4}, {.i32=5}, {.i32=0}}
+        },
+        4, results
+    );
+    assert(err == R11F_ERR_division_by_zero
+           && results[0].i32 == 5 && results[1].i32 == 5
+           && results[2].i32 == 6 && results[3].i32 == 0
+           && "unexpected batch failure");
+
+    enum { ROWS = 100000 };
+    err = r11f_vm_prepare_static(vm, "com/example/Add2", "add_mixed",
+                                 "(JI)J", &handle);
+    assert(err == R11F_success && "cannot prepare Add2.add_mixed");
+    r11f_value_t *longs = malloc(ROWS * sizeof(r11f_value_t));
+    r11f_value_t *ints = malloc(ROWS * sizeof(r11f_value_t));
+    r11f_value_t *sums = malloc(ROWS * sizeof(r11f_value_t));
+    assert(longs && ints && sums);
+    for (int32_t i = 0; i < ROWS; i++) {
+        longs[i].i64 = (int64_t)i << 32;
+        ints[i].i32 = -i;
+    }
+    vm->batch_threads = 4;
+    err = r11f_vm_invoke_batch(vm, &handle,
+                               (r11f_value_t const*[]){ longs, ints },
+                               ROWS, sums);
+    vm->batch_threads = 0;
+    assert(err == R11F_success && "unexpected error");
+    for (int32_t i = 0; i < ROWS; i++) {
+        assert(sums[i].i64 == ((int64_t)i << 32) - i && "unexpected output");
+    }
+    free(longs);
+    free(ints);
+    free(sums);
+    fprintf(stderr, "[%s] batch calls ok\n",
+            g_exec_mode_names[vm->exec_mode]);
+}
+
+/* virtual threads park at Thread.yield() and go on on whichever carrier
+   takes them up, some failing and some catching what they threw */
+static void drill_vthread_cases(r11f_vm_t *vm) {
+    r11f_method_handle_t handles[4];
+    char const *names[4] = { "count", "nested", "fail", "caught" };
+    char const *descriptors[4] = { "(I)I", "(I)J", "(I)I", "(I)I" };
+    for (int i = 0; i < 4; i++) {
+        r11f_error_t err = r11f_vm_prepare_static(vm, "com/example/Tasks",
+                                                  names[i], descriptors[i],
+                                                  &handles[i]);
+        assert(err == R11F_success && "cannot prepare Tasks");
+    }
+
+    enum { TASKS = 10000 };
+    r11f_sched_t *sched = r11f_sched_alloc(vm, 4);
+    r11f_vthread_t **vthreads = malloc(TASKS * sizeof(r11f_vthread_t*));
+    assert(sched && vthreads);
+    for (int32_t i = 0; i < TASKS; i++) {
+        vthreads[i] = r11f_sched_spawn(sched, &handles[i % 4],
+                                       (r11f_value_t[]){{.i32=i % 50}});
+        assert(vthreads[i] && "cannot spawn");
+    }
+    assert(r11f_vthread_result(vthreads[0], NULL) == R11F_ERR_parked
+           && "done before running");
+    r11f_sched_run(sched);
+
+    for (int32_t i = 0; i < TASKS; i++) {
+        int64_t n = i % 50;
+        r11f_value_t result = { .i64 = 0 };
+        r11f_error_t err = r11f_vthread_result(vthreads[i], &result);
+        switch (i % 4) {
+            case 0:
+                assert(err == R11F_success && result.i32 == n * (n - 1) / 2
+                       && "unexpected output");
+                break;
+            case 1:
+                assert(err == R11F_success
+                       && result.i64 == n * (n + 1) / 2 + n
+                       && "unexpected output");
+                break;
+            case 2:
+                assert((n ? err == R11F_success && result.i32 == 100 / n
+                          : err == R11F_ERR_division_by_zero)
+                       && "unexpected output");
+                assert((n ? !vthreads[i]->exception
+                          : vthreads[i]->exception
+                            && vthreads[i]->backtrace.count > 0)
+                       && "no backtrace kept");
+                break;
+            case 3:
+                assert(err == R11F_success
+                       && result.i32 == (n ? 100 / n : -1)
+                       && "unexpected output");
+                break;
+        }
+    }
+    r11f_sched_free(sched);
+    free(vthreads);
+    fprintf(stderr, "[%s] virtual threads ok\n",
+            g_exec_mode_names[vm->exec_mode]);
+}
+
+/* optimized Vector loops run on SIMD registers up to the level the VM
+   allows, 1003 elements leaving a remainder for the scalar loop */
+static void drill_vector(uint8_t simd_level) {
+    r11f_vm_t vm = { 0 };
+    vm.classpath = (char const*[]){
+        "test",
+        NULL
+    };
+    vm.classmgr = r11f_classmgr_alloc();
+    vm.exec_mode = R11F_EXEC_OPT;
+    vm.simd_level = simd_level;
+
+    drill_vector_cases(&vm);
+    /* the bit count instructions are capped by the level as well */
+    drill_intrinsic_cases(&vm);
+
+    bool vectorized = simd_level != R11F_SIMD_SCALAR;
+#if defined(__x86_64__)
+    vectorized &= __builtin_cpu_supports("sse4.1") != 0;
+#else
+    vectorized = false;
+#endif
+    static char const *const methods[] = { "sum", "dot", "saxpy", "map" };
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++) {
+        r11f_jit_code_t *opt =
+            drill_find_opt(&vm, "com/example/Vector", methods[i], "(I)I");
+        assert(opt && (opt->vector_count > 0) == vectorized
+               && "Vector loops not vectorized as configured");
+        (void)opt;
+    }
+
+    r11f_vm_cleanup(&vm);
+    r11f_classmgr_free(vm.classmgr);
+}
+
+/* the one loop of an Inline method, static calls and all, has to have
+   been compiled into a trace */
+static void drill_trace(r11f_vm_t *vm,
+                        char const *method_name,
+                        char const *descriptor) {
+    r11f_class_t *clazz =
+        r11f_classmgr_find_class(vm->classmgr, "com/example/Inline");
+    r11f_method_info_t *method_info = r11f_class_resolve_method(
+        clazz,
+        method_name,
+        strlen(method_name),
+        descriptor,
+        strlen(descriptor)
+    );
+    r11f_linked_method_t *linked = method_info->linked;
+    assert(linked->loop_count == 1 && linked->loops[0].osr
+           && "loop not compiled into a trace");
+    (void)linked;
+}
+
+/* a class loaded while optimized code runs makes it leave for the
+   interpreter before dispatching to the new class */
+static void drill_cha(void) {
+    r11f_vm_t vm = { 0 };
+    vm.classpath = (char const*[]){
+        "test",
+        NULL
+    };
+    vm.classmgr = r11f_classmgr_alloc();
+    vm.exec_mode = R11F_EXEC_OPT;
+
+    drill_invoke(&vm, "com/example/Shape", "mixed", "(I)I",
+                 (r11f_value_t[]){{.i32=10}},
+                 17);
+    /* only make is left to call, sides got inlined */
+    r11f_jit_code_t *opt = drill_find_opt(&vm, "com/example/Shape", "mixed", "(I)I");
+    assert(opt && opt->callsite_count == 1 && opt->inlined_count == 1
+           && "Shape.sides not devirtualized");
+    assert(opt->invalidated && "Shape.mixed not invalidated by Triangle");
+    drill_invoke(&vm, "com/example/Shape", "mixed", "(I)I",
+                 (r11f_value_t[]){{.i32=10}},
+                 17);
+
+    r11f_vm_cleanup(&vm);
+    r11f_classmgr_free(vm.classmgr);
+}
+
+/* `dir` is a mkdtemp template, filled in with the directory made */
+static void drill_mkdtemp(char *dir) {
+    char *created = mkdtemp(dir);
+    assert(created && "cannot create temporary directory");
+    (void)created;
+}
+
+/* removes `path` and everything below it */
+static void drill_remove(char const *path) {
+    DIR *d = opendir(path);
+    for (struct dirent *entry; d && (entry = readdir(d));) {
+        if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
+            char child[strlen(path) + 2 + strlen(entry->d_name)];
+            snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+            drill_remove(child);
+        }
+    }
+    if (d) {
+        closedir(d);
+        rmdir(path);
+    }
+    else {
+        unlink(path);
+    }
+}
+
+/* copies test/`name`.class into `dir`, package directories and all, with
+   the first `len` bytes matching `from` replaced by `to` */
+static void drill_patch_class(char const *name,
+                              uint8_t const *from,
+                              uint8_t const *to,
+                              size_t len,
+                              char const *dir) {
+    char path[strlen(dir) + strlen(name) + 16];
+    snprintf(path, sizeof(path), "test/%s.class", name);
+    FILE *in = fopen(path, "rb");
+    assert(in && "cannot open class file");
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t *bytes = malloc(size > 0 ? (size_t)size : 1);
+    size_t got = bytes ? fread(bytes, 1, (size_t)size, in) : 0;
+    assert(size > 0 && got == (size_t)size && "cannot read class file");
+    (void)got;
+    fclose(in);
+
+    bool patched = false;
+    for (size_t i = 0; i + len <= (size_t)size && !patched; i++) {
+        if (!memcmp(bytes + i, from, len)) {
+            memcpy(bytes + i, to, len);
+            patched = true;
+        }
+    }
+    assert(patched && "bytes to patch not in class file");
+
+    snprintf(path, sizeof(path), "%s/%s.class", dir, name);
+    for (char *slash = path + strlen(dir) + 1;
+         (slash = strchr(slash, '/'));
+         slash++) {
+        *slash = '\0';
+        mkdir(path, 0700);
+        *slash = '/';
+    }
+    FILE *out = fopen(path, "wb");
+    assert(out && "cannot write class file");
+    size_t written = fwrite(bytes, 1, (size_t)size, out);
+    assert(written == (size_t)size && "cannot write class file");
+    (void)written;
+    fclose(out);
+    free(bytes);
+}
+
+static void drill_jitcache_run(char const *dir) {
+    r11f_vm_t vm = { 0 };
+    vm.classpath = (char const*[]){
+        "test",
+        NULL
+    };
+    vm.classmgr = r11f_classmgr_alloc();
+    vm.exec_mode = R11F_EXEC_JIT;
+    vm.jit_cache_dir = dir;
+
+    drill_invoke(&vm, "com/example/Loop", "collatz_steps", "(I)I",
+                 (r11f_value_t[]){{.i32=1000}},
+                 59431);
+    drill_invoke(&vm, "com/example/Switch", "keyword", "(I)I",
+                 (r11f_value_t[]){{.i32=94001407}},
+                 8);
+    drill_invoke(&vm, "com/example/Inline", "depth", "(I)I",
+                 (r11f_value_t[]){{.i32=30}},
+                 465);
+
+    r11f_vm_cleanup(&vm);
+    r11f_classmgr_free(vm.classmgr);
+}
+
+/* a second VM runs the baseline code the first one left on disk */
+static void drill_jitcache(void) {
+    char dir[] = "/tmp/r11f-jitcache-XXXXXX";
+    drill_mkdtemp(dir);
+
+    size_t hits = r11f_jitcache_hits();
+    drill_jitcache_run(dir);
+    assert(r11f_jitcache_hits() == hits && "empty cache hit");
+    drill_jitcache_run(dir);
+    assert(r11f_jitcache_hits() > hits && "cached code not used");
+
+    drill_remove(dir);
+}
+
+static void drill_aot_run(char const *module, uint8_t exec_mode) {
+    r11f_vm_t vm = { 0 };
+    vm.classpath = (char const*[]){
+        "test",
+        NULL
+    };
+    vm.classmgr = r11f_classmgr_alloc();
+    vm.exec_mode = exec_mode;
+    vm.tier1_threshold = UINT32_MAX;
+    vm.tier2_threshold = UINT32_MAX;
+    vm.aot_modules = (char const*[]){
+        module,
+        NULL
+    };
+
+    drill_invoke(&vm, "com/example/Loop", "collatz_steps", "(I)I",
+                 (r11f_value_t[]){{.i32=1000}},
+                 59431);
+    drill_invoke(&vm, "com/example/Switch", "keyword", "(I)I",
+                 (r11f_value_t[]){{.i32=-934396624}},
+                 4);
+    drill_invoke(&vm, "com/example/Inline", "depth", "(I)I",
+                 (r11f_value_t[]){{.i32=30}},
+                 465);
+
+    /* never hot, yet compiled from the first call */
+    r11f_class_t *clazz =
+        r11f_classmgr_find_class(vm.classmgr, "com/example/Loop");
+    r11f_method_info_t *method_info = r11f_class_resolve_method(
+        clazz, "collatz_steps", 13, "(I)I", 4
+    );
+    assert(clazz->aot_module && method_info->linked->jit
+           && "Loop.collatz_steps not loaded from the AOT module");
+    assert(r11f_vm_compile_events(&vm, NULL, 0) == 0
+           && "AOT compiled method compiled again");
+
+    r11f_vm_cleanup(&vm);
+    r11f_classmgr_free(vm.classmgr);
+}
+
+/* needs the C compiler to build the module */
+static void drill_aot(void) {
+    char dir[] = "/tmp/r11f-aot-XXXXXX";
+    drill_mkdtemp(dir);
+
+    char module[sizeof(dir) + 16];
+    snprintf(module, sizeof(module), "%s/example.so", dir);
+    int status = aot_main(module,
+                          (char const*[]){
+                              "test/com/example/Loop.class",
+                              "test/com/example/Switch.class",
+                              "test/com/example/Inline.class"
+                          },
+                          3);
+    assert(status == 0 && "AOT module not built");
+    (void)status;
+
+    drill_aot_run(module, R11F_EXEC_TIERED);
+    drill_aot_run(module, R11F_EXEC_JIT);
+
+    drill_remove(dir);
+}
+
+/* broken copies of Loop.sum are rejected, and a class file with one does
+   not load at all */
+static void drill_verify(void) {
+    r11f_vm_t vm = { 0 };
+    vm.classpath = (char const*[]){
+        "test",
+        NULL
+    };
+    vm.classmgr = r11f_classmgr_alloc();
+    vm.exec_mode = R11F_EXEC_BYTECODE;
+
+    drill_invoke(&vm, "com/example/Loop", "sum", "(I)I",
+                 (r11f_value_t[]){{.i32=100}},
+                 4950);
+    r11f_class_t *clazz =
+        r11f_classmgr_find_class(vm.classmgr, "com/example/Loop");
+    assert(clazz->verified_methods == 6 && "Loop not verified");
+    r11f_method_info_t *method_info =
+        r11f_class_resolve_method(clazz, "sum", 3, "(I)I", 4);
+
+    /* the Code attribute header is in host byte order, see clsfile.c */
+    uint8_t *info =
+        r11f_method_find_attribute(clazz, method_info, "Code")->info;
+    uint32_t code_length;
+    memcpy(&code_length, info + 4, sizeof(code_length));
+    uint8_t *code = info + 8;
+    uint32_t branch_pc = 0;
+    while (code[branch_pc] != R11F_if_icmpge) {
+        branch_pc += r11f_bytecode_length(code, code_length, branch_pc);
+    }
+
+    struct {
+        uint8_t *byte;
+        uint8_t value;
+    } const patches[] = {
+        /* ireturn of the int sum as a long */
+        { code + code_length - 1, R11F_lreturn },
+        /* loop exit one byte past its frame */
+        { code + branch_pc + 2, code[branch_pc + 2] + 1 },
+        /* max_stack of 1 for a loop adding two locals */
+        { info, 1 },
+    };
+    for (size_t i = 0; i < sizeof(patches) / sizeof(patches[0]); i++) {
+        uint8_t saved = *patches[i].byte;
+        *patches[i].byte = patches[i].value;
+        r11f_error_t err = r11f_method_verify(clazz, method_info, NULL);
+        *patches[i].byte = saved;
+        assert(err == R11F_ERR_verify_failed && "broken Loop.sum verified");
+        (void)err;
+    }
+    assert(r11f_method_verify(clazz, method_info, NULL) == R11F_success
+           && "Loop.sum not restored");
+
+    r11f_vm_cleanup(&vm);
+    r11f_classmgr_free(vm.classmgr);
+
+    /* the same first patch on the class file */
+    char dir[] = "/tmp/r11f-verify-XXXXXX";
+    drill_mkdtemp(dir);
+    drill_patch_class("com/example/Loop",
+                      (uint8_t[]){ R11F_iload_1, R11F_ireturn },
+                      (uint8_t[]){ R11F_iload_1, R11F_lreturn },
+                      2,
+                      dir);
+
+    vm = (r11f_vm_t) { 0 };
+    vm.classpath = (char const*[]){
+        dir,
+        NULL
+    };
+    vm.classmgr = r11f_classmgr_alloc();
+    vm.exec_mode = R11F_EXEC_BYTECODE;
+    drill_invoke_error(&vm, "com/example/Loop", "sum", "(I)I",
+                       (r11f_value_t[]){{.i32=100}},
+                       R11F_ERR_verify_failed);
+    assert(!r11f_classmgr_find_class(vm.classmgr, "com/example/Loop")
+           && "unverified class loaded");
+    r11f_vm_cleanup(&vm);
+    r11f_classmgr_free(vm.classmgr);
+
+    drill_remove(dir);
+}
+
+/* Reuse.low with y moved into the second half of its long argument, as
+   javac never does, keeps its locals two per long in every mode */
+static void drill_locals_fallback(void) {
+    char dir[] = "/tmp/r11f-reuse-XXXXXX";
+    drill_mkdtemp(dir);
+    drill_patch_class("com/example/Reuse",
+                      (uint8_t[]){ R11F_l2i, R11F_istore_2, R11F_iload_2 },
+                      (uint8_t[]){ R11F_l2i, R11F_istore_1, R11F_iload_1 },
+                      3,
+                      dir);
+
+    for (uint8_t exec_mode = R11F_EXEC_BYTECODE;
+         exec_mode <= R11F_EXEC_TRACE;
+         exec_mode++) {
+        r11f_vm_t vm = { 0 };
+        vm.classpath = (char const*[]){
+            dir,
+            NULL
+        };
+        vm.classmgr = r11f_classmgr_alloc();
+        vm.exec_mode = exec_mode;
+        vm.tier1_threshold = 10;
+        vm.tier2_threshold = 50;
+        vm.compile_threads = 1;
+        vm.trace_threshold = 10;
+
+        for (int i = 0; i < 3; i++) {
+            drill_invoke(&vm, "com/example/Reuse", "sum", "(I)I",
+                         (r11f_value_t[]){{.i32=1000}},
+                         500500);
+        }
+        r11f_class_t *clazz =
+            r11f_classmgr_find_class(vm.classmgr, "com/example/Reuse");
+        r11f_method_info_t *method_info =
+            r11f_class_resolve_method(clazz, "low", 3, "(J)I", 4);
+        assert(method_info->linked
+               && method_info->linked->wide_args
+               && !method_info->linked->compact_locals
+               && "reused half of a long argument compacted");
+
+        r11f_vm_cleanup(&vm);
+        r11f_classmgr_free(vm.classmgr);
+    }
+
+    drill_remove(dir);
+}
+
+/* Switch.spin with its lookupswitch jumping straight back to the loop
+   header, as javac never does, counts and leaves that loop like a goto */
+static void drill_switch_loop(void) {
+    char dir[] = "/tmp/r11f-spin-XXXXXX";
+    drill_mkdtemp(dir);
+    drill_patch_class("com/example/Switch",
+                      (uint8_t[]){
+                          0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 17,
+                          R11F_goto, 0xff, 0xe2
+                      },
+                      (uint8_t[]){
+                          0, 0, 0, 1, 0, 0, 0, 1, 0xff, 0xff, 0xff, 0xf3,
+                          R11F_nop, R11F_nop, R11F_nop
+                      },
+                      15,
+                      dir);
+
+    for (uint8_t exec_mode = R11F_EXEC_BYTECODE;
+         exec_mode <= R11F_EXEC_TRACE;
+         exec_mode++) {
+        r11f_vm_t vm = { 0 };
+        vm.classpath = (char const*[]){
+            dir,
+            NULL
+        };
+        vm.classmgr = r11f_classmgr_alloc();
+        vm.exec_mode = exec_mode;
+        vm.tier1_threshold = 10;
+        vm.tier2_threshold = UINT32_MAX;
+        vm.trace_threshold = 10;
+
+        drill_invoke(&vm, "com/example/Switch", "spin", "(I)I",
+                     (r11f_value_t[]){{.i32=100000}},
+                     100000);
+
+        r11f_class_t *clazz =
+            r11f_classmgr_find_class(vm.classmgr, "com/example/Switch");
+        r11f_method_info_t *method_info =
+            r11f_class_resolve_method(clazz, "spin", 4, "(I)I", 4);
+        r11f_linked_method_t *linked = method_info->linked;
+        assert(linked->loop_count == 1
+               && linked->loops[0].header_pc == 2
+               && "switch back edge not a loop");
+        assert((exec_mode != R11F_EXEC_TIERED
+                || (linked->loops[0].count > 0
+                    && linked->loops[0].count < 100))
+               && "spin stayed in the interpreter");
+
+        r11f_vm_cleanup(&vm);
+        r11f_classmgr_free(vm.classmgr);
+    }
+
+    drill_remove(dir);
+}
+
+/* switches whose counts run past the code end are rejected before their
+   pairs are read */
+static void drill_switch_bounds(void) {
+    /* one pair of a million, and a table of 0..0xffff with one target */
+    uint8_t lookup[] = {
+        R11F_lookupswitch, 0, 0, 0,
+        0, 0, 0, 12,
+        0, 0x0f, 0x42, 0x40,
+        0, 0, 0, 1,
+        0, 0, 0, 12,
+    };
+    uint8_t table[] = {
+        R11F_tableswitch, 0, 0, 0,
+        0, 0, 0, 12,
+        0, 0, 0, 0,
+        0, 0, 0xff, 0xff,
+        0, 0, 0, 12,
+    };
+    uint8_t *codes[] = { lookup, table };
+    for (size_t i = 0; i < sizeof(codes) / sizeof(codes[0]); i++) {
+        r11f_switch_t *sw = NULL;
+        r11f_error_t err = r11f_switch_compile(codes[i], 20, 0, &sw);
+        assert(err == R11F_ERR_malformed_classfile && !sw
+               && "truncated switch compiled");
+        assert(r11f_bytecode_length(codes[i], 20, 0) > 20
+               && "truncated switch fits its code");
+        (void)err;
+    }
+
+    /* the header alone cut short */
+    r11f_switch_t *sw = NULL;
+    assert(r11f_switch_compile(lookup, 6, 0, &sw)
+           == R11F_ERR_malformed_classfile && !sw
+           && "switch header read past the code");
+    assert(r11f_bytecode_length(lookup, 6, 0) > 6
+           && "switch header fits its code");
+    (void)sw;
+}
+
+void drill_main(void) {
+    for (uint8_t exec_mode = R11F_EXEC_BYTECODE;
+         exec_mode <= R11F_EXEC_TRACE;
+         exec_mode++) {
+        r11f_vm_t vm = { 0 };
+        vm.classpath = (char const*[]){
+            "test",
+            NULL
+        };
+        vm.classmgr = r11f_classmgr_alloc();
+        vm.current_frame = NULL;
+        vm.exec_mode = exec_mode;
+        vm.tier1_threshold = 10;
+        vm.tier2_threshold = 50;
+        vm.compile_threads = 1;
+        vm.trace_threshold = 10;
+
+        drill_invoke(&vm, "com/example/Add", "add_mixed", "(JI)J",
+                     (r11f_value_t[]){{.i64=2147483648}, {.i32=124875}},
+                     2147483648L + 124875L);
+        if (exec_mode == R11F_EXEC_OPT) {
+            /* the forwarding call to Add2 should be gone entirely */
+            r11f_class_t *clazz =
+                r11f_classmgr_find_class(vm.classmgr, "com/example/Add");
+            r11f_method_info_t *method_info = r11f_class_resolve_method(
+                clazz, "add_mixed", 9, "(JI)J", 5
+            );
+            r11f_jit_code_t *opt = method_info->linked->opt;
+            assert(opt && "add_mixed not compiled by the optimizer");
+            assert(opt->callsite_count == 0 && opt->inlined_count == 1
+                   && "add_mixed call not inlined");
+        }
+        drill_invoke(&vm, "com/example/Loop", "sum", "(I)I",
+                     (r11f_value_t[]){{.i32=100}},
+                     4950);
+        drill_invoke(&vm, "com/example/Loop", "sum_squares", "(I)J",
+                     (r11f_value_t[]){{.i32=100000}},
+                     333328333350000L);
+        drill_invoke(&vm, "com/example/Loop", "collatz_steps", "(I)I",
+                     (r11f_value_t[]){{.i32=1000}},
+                     59431);
+        drill_invoke(&vm, "com/example/Loop", "gcd", "(II)I",
+                     (r11f_value_t[]){{.i32=1071}, {.i32=462}},
+                     21);
+        drill_invoke(&vm, "com/example/Loop", "lcg", "(JI)J",
+                     (r11f_value_t[]){{.i64=42}, {.i32=3}},
+                     7615522811268512075L);
+        drill_invoke(&vm, "com/example/Switch", "day_kind", "(I)I",
+                     (r11f_value_t[]){{.i32=3}},
+                     20);
+        drill_invoke(&vm, "com/example/Switch", "day_kind", "(I)I",
+                     (r11f_value_t[]){{.i32=7}},
+                     -1);
+        drill_invoke(&vm, "com/example/Switch", "keyword", "(I)I",
+                     (r11f_value_t[]){{.i32=-934396624}},
+                     4);
+        drill_invoke(&vm, "com/example/Switch", "keyword", "(I)I",
+                     (r11f_value_t[]){{.i32=94001407}},
+                     8);
+        drill_invoke(&vm, "com/example/Switch", "keyword", "(I)I",
+                     (r11f_value_t[]){{.i32=0}},
+                     0);
+        drill_invoke(&vm, "com/example/Switch", "sparse", "(I)I",
+                     (r11f_value_t[]){{.i32=-1000}},
+                     1);
+        drill_invoke(&vm, "com/example/Switch", "sparse", "(I)I",
+                     (r11f_value_t[]){{.i32=8}},
+                     0);
+        drill_invoke(&vm, "com/example/Switch", "classify", "(I)I",
+                     (r11f_value_t[]){{.i32=100000}},
+                     -95702);
+        drill_invoke(&vm, "com/example/Arith", "div", "(II)I",
+                     (r11f_value_t[]){{.i32=INT32_MIN}, {.i32=-1}},
+                     INT32_MIN);
+        drill_invoke(&vm, "com/example/Arith", "ldiv", "(JJ)J",
+                     (r11f_value_t[]){{.i64=INT64_MIN}, {.i64=-1}},
+                     INT64_MIN);
+        drill_invoke(&vm, "com/example/Arith", "mix", "(I)J",
+                     (r11f_value_t[]){{.i32=1000}},
+                     -6456294902495874425L);
+        drill_invoke(&vm, "com/example/Inline", "depth", "(I)I",
+                     (r11f_value_t[]){{.i32=30}},
+                     465);
+
+        drill_invoke(&vm, "com/example/Arrays", "fill_sum", "(I)I",
+                     (r11f_value_t[]){{.i32=1000}},
+                     1498500);
+        drill_invoke(&vm, "com/example/Arrays", "prefix", "(II)I",
+                     (r11f_value_t[]){{.i32=1000}, {.i32=500}},
+                     124750);
+        drill_invoke(&vm, "com/example/Arrays", "gather", "(I)I",
+                     (r11f_value_t[]){{.i32=1000}},
+                     449500);
+        drill_invoke(&vm, "com/example/Arrays", "sum_null", "(I)I",
+                     (r11f_value_t[]){{.i32=0}},
+                     0);
+        drill_invoke_error(&vm, "com/example/Arrays", "prefix", "(II)I",
+                           (r11f_value_t[]){{.i32=1000}, {.i32=1001}},
+                           R11F_ERR_array_index_out_of_bounds);
+        drill_invoke_error(&vm, "com/example/Arrays", "sum_null", "(I)I",
+                           (r11f_value_t[]){{.i32=1}},
+                           R11F_ERR_null_pointer);
+        drill_invoke_error(&vm, "com/example/Arrays", "fill_sum", "(I)I",
+                           (r11f_value_t[]){{.i32=-1}},
+                           R11F_ERR_negative_array_size);
+        drill_vector_cases(&vm);
+        drill_escape_cases(&vm);
+        drill_intrinsic_cases(&vm);
+        drill_exception_cases(&vm);
+        drill_prepared_cases(&vm);
+        drill_batch_cases(&vm);
+        drill_vthread_cases(&vm);
+        drill_invoke(&vm, "com/example/Calls", "fib", "(I)I",
+                     (r11f_value_t[]){{.i32=20}},
+                     6765);
+        /* long arguments are one local each, passed in place */
+        drill_invoke(&vm, "com/example/Calls", "wide", "(J)J",
+                     (r11f_value_t[]){{.i64=5000000000}},
+                     4999999998);
+        drill_invoke(&vm, "com/example/Calls", "trivial", "(I)I",
+                     (r11f_value_t[]){{.i32=10}},
+                     1475);
+        if (exec_mode == R11F_EXEC_BYTECODE) {
+            /* the callees of the loop are run without frames */
+            r11f_class_t *clazz =
+                r11f_classmgr_find_class(vm.classmgr, "com/example/Calls");
+            static struct {
+                char const *name;
+                char const *descriptor;
+                uint8_t kind;
+            } const trivials[] = {
+                { "seven", "()I", R11F_TRIVIAL_CONSTANT },
+                { "same", "(I)I", R11F_TRIVIAL_LEAF },
+                { "shl3", "(I)I", R11F_TRIVIAL_LEAF },
+                { "sub_from", "(I)I", R11F_TRIVIAL_LEAF },
+                { "widen", "(IJ)J", R11F_TRIVIAL_LEAF },
+                { "trivial", "(I)I", R11F_TRIVIAL_NONE }
+            };
+            for (size_t i = 0; i < sizeof(trivials) / sizeof(trivials[0]);
+                 i++) {
+                r11f_method_info_t *method_info = r11f_class_resolve_method(
+                    clazz,
+                    trivials[i].name,
+                    (uint16_t)strlen(trivials[i].name),
+                    trivials[i].descriptor,
+                    (uint16_t)strlen(trivials[i].descriptor)
+                );
+                assert(method_info->linked
+                       && method_info->linked->trivial.kind
+                          == trivials[i].kind
+                       && "method classified wrong");
+            }
+
+            /* the second halves of longs are gone from the locals */
+            static struct {
+                char const *name;
+                char const *descriptor;
+                uint16_t max_locals;
+            } const compacts[] = {
+                { "scale", "(JI)J", 2 },
+                { "wide", "(J)J", 1 },
+                { "widen", "(IJ)J", 2 }
+            };
+            for (size_t i = 0; i < sizeof(compacts) / sizeof(compacts[0]);
+                 i++) {
+                r11f_method_info_t *method_info = r11f_class_resolve_method(
+                    clazz,
+                    compacts[i].name,
+                    (uint16_t)strlen(compacts[i].name),
+                    compacts[i].descriptor,
+                    (uint16_t)strlen(compacts[i].descriptor)
+                );
+                assert(method_info->linked
+                       && method_info->linked->compact_locals
+                       && !method_info->linked->wide_args
+                       && method_info->linked->max_locals
+                          == compacts[i].max_locals
+                       && "locals not compacted");
+            }
+        }
+        if (exec_mode == R11F_EXEC_OPT) {
+            /* intrinsics are computed inline, not called */
+            r11f_jit_code_t *opt = drill_find_opt(&vm,
+                                                  "com/example/Intrinsics",
+                                                  "longs",
+                                                  "(I)J");
+            assert(opt && opt->callsite_count == 0
+                   && "Intrinsics not inlined");
+        }
+        if (exec_mode == R11F_EXEC_OPT) {
+            /* small arrays only accessed at constant indices are kept in
+               registers, the histogram's variable index keeps it */
+            char const *methods[] = { "pairs", "holder", "helper", "histogram" };
+            for (int i = 0; i < 4; i++) {
+                r11f_jit_code_t *opt = drill_find_opt(&vm,
+                                                      "com/example/Escape",
+                                                      methods[i],
+                                                      "(I)I");
+                assert(opt && opt->replaced_count == (i < 3)
+                       && "Escape allocations not replaced as expected");
+            }
+        }
+        if (exec_mode == R11F_EXEC_OPT) {
+            /* loops over fresh arrays need no checks at all, a limit
+               the array length is not known to cover is guarded once
+               ahead of the loop, whose exit the out of bounds call took */
+            r11f_jit_code_t *opt =
+                drill_find_opt(&vm, "com/example/Arrays", "fill_sum", "(I)I");
+            assert(opt && opt->check_count == 0
+                   && "fill_sum checks not eliminated");
+            opt = drill_find_opt(&vm, "com/example/Arrays", "prefix", "(II)I");
+            assert(opt && opt->check_count == 0
+                   && "prefix checks not moved ahead of the loop");
+            opt = drill_find_opt(&vm, "com/example/Arrays", "gather", "(I)I");
+            assert(opt && opt->check_count == 1
+                   && "gather index checked more than once");
+        }
+
+        drill_invoke(&vm, "com/example/Inline", "shape", "(I)I",
+                     (r11f_value_t[]){{.i32=100}},
+                     77716);
+        drill_invoke(&vm, "com/example/Inline", "chain", "(I)I",
+                     (r11f_value_t[]){{.i32=10}},
+                     25343);
+        drill_invoke(&vm, "com/example/Inline", "scaled", "(II)I",
+                     (r11f_value_t[]){{.i32=200}, {.i32=3}},
+                     78525);
+        drill_invoke(&vm, "com/example/Inline", "scaled", "(II)I",
+                     (r11f_value_t[]){{.i32=200}, {.i32=101}},
+                     89003525);
+        if (exec_mode == R11F_EXEC_TRACE) {
+            drill_trace(&vm, "shape", "(I)I");
+            drill_trace(&vm, "scaled", "(II)I");
+        }
+
+        /* Triangle is loaded only after run got compiled with
+           Shape.sides inlined as the one implementation */
+        drill_invoke(&vm, "com/example/Shape", "run", "(II)I",
+                     (r11f_value_t[]){{.i32=0}, {.i32=100}},
+                     0);
+        drill_invoke(&vm, "com/example/Shape", "run", "(II)I",
+                     (r11f_value_t[]){{.i32=5}, {.i32=100}},
+                     300);
+        drill_invoke(&vm, "com/example/Shape", "run", "(II)I",
+                     (r11f_value_t[]){{.i32=8}, {.i32=100}},
+                     400);
+        drill_invoke(&vm, "com/example/Shape", "mixed", "(I)I",
+                     (r11f_value_t[]){{.i32=10}},
+                     17);
+        if (exec_mode == R11F_EXEC_OPT) {
+            r11f_jit_code_t *opt =
+                drill_find_opt(&vm, "com/example/Shape", "run", "(II)I");
+            assert(opt && opt->invalidated
+                   && "Shape.run not invalidated by Triangle");
+        }
+
+        if (exec_mode == R11F_EXEC_TIERED) {
+            r11f_vm_compile_wait(&vm);
+
+            r11f_compile_event_t events[64];
+            uint32_t count = r11f_vm_compile_events(&vm, events, 64);
+            r11f_class_t *loop_class =
+                r11f_classmgr_find_class(vm.classmgr, "com/example/Loop");
+            r11f_compile_event_t *sum_event = NULL;
+            for (uint32_t i = 0; i < count && i < 64; i++) {
+                if (events[i].tier == R11F_TIER_OPT
+                    && events[i].method->clazz == loop_class
+                    && events[i].method->name_len == 3
+                    && !strncmp(events[i].method->name, "sum", 3)) {
+                    sum_event = &events[i];
+                }
+            }
+            assert(sum_event && sum_event->result == R11F_success
+                   && "Loop.sum not compiled by the optimizer");
+            assert(sum_event->backedge_count > sum_event->invoke_count
+                   && "Loop.sum back edges not counted");
+
+            /* and the next call runs the compiled code */
+            drill_invoke(&vm, "com/example/Loop", "sum", "(I)I",
+                         (r11f_value_t[]){{.i32=100}},
+                         4950);
+        }
+
+        r11f_vm_cleanup(&vm);
+        r11f_classmgr_free(vm.classmgr);
+    }
+
+    drill_osr(10, UINT32_MAX, R11F_TIER_BASELINE);
+    drill_osr(UINT32_MAX, 50, R11F_TIER_OPT);
+    drill_deopt();
+    drill_vector(R11F_SIMD_DEFAULT);
+    drill_vector(R11F_SIMD_SSE41);
+    drill_vector(R11F_SIMD_SCALAR);
+    drill_cha();
+    drill_jitcache();
+    drill_aot();
+    drill_verify();
+    drill_locals_fallback();
+    drill_switch_bounds();
+    drill_switch_loop();
+}
+
+typedef struct {
+    char const *class_name;
+    char const *method_name;
+    char const *descriptor;
+    r11f_value_t argv[2];
+} bench_case_t;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+void bench_main(void) {
+    static const bench_case_t cases[] = {
+        { "com/example/Loop", "sum", "(I)I", {{.i32=10000000}} },
+        { "com/example/Loop", "sum_squares", "(I)J", {{.i32=10000000}} },
+        { "com/example/Loop", "collatz_steps", "(I)I", {{.i32=100000}} },
+        { "com/example/Loop", "lcg", "(JI)J", {{.i64=42}, {.i32=10000000}} },
+        { "com/example/Switch", "classify", "(I)I", {{.i32=10000000}} },
+        { "com/example/Arith", "mix", "(I)J", {{.i32=1000000}} },
+        { "com/example/Vector", "sum", "(I)I", {{.i32=20000}} },
+        { "com/example/Vector", "dot", "(I)I", {{.i32=20000}} },
+        { "com/example/Vector", "saxpy", "(I)I", {{.i32=20000}} },
+        { "com/example/Vector", "map", "(I)I", {{.i32=20000}} },
+        { "com/example/Escape", "pairs", "(I)I", {{.i32=10000000}} },
+        { "com/example/Intrinsics", "longs", "(I)J", {{.i32=1000000}} },
+        { "com/example/Calls", "fib", "(I)I", {{.i32=27}} },
+        { "com/example/Calls", "trivial", "(I)I", {{.i32=1000000}} },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        bench_case_t const *bench_case = &cases[i];
+        double elapsed[R11F_EXEC_TRACE + 1];
+
+        for (uint8_t exec_mode = R11F_EXEC_BYTECODE;
+             exec_mode <= R11F_EXEC_TRACE;
+             exec_mode++) {
+            r11f_vm_t vm = { 0 };
+            vm.classpath = (char const*[]){
+                "test",
+                NULL
+            };
+            vm.classmgr = r11f_classmgr_alloc();
+            vm.current_frame = NULL;
+            vm.exec_mode = exec_mode;
+            vm.compile_threads = 1;
+
+            r11f_value_t argv[2];
+            memcpy(argv, bench_case->argv, sizeof(argv));
+            r11f_value_t output;
+
+            double start = now_seconds();
+            r11f_error_t err = r11f_vm_invoke_static(
+                &vm,
+                bench_case->class_name,
+                bench_case->method_name,
+                bench_case->descriptor,
+                argv,
+                &output
+            );
+            elapsed[exec_mode] = now_seconds() - start;
+
+            if (err != R11F_success) {
+                fprintf(stderr, "error: %s\n", r11f_explain_error(err));
+                assert(0 && "failed to invoke method");
+            }
+
+            if (exec_mode == R11F_EXEC_REGIR) {
+                r11f_class_t *clazz =
+                    r11f_classmgr_find_class(vm.classmgr,
+                                             bench_case->class_name);
+                r11f_method_info_t *method_info = r11f_class_resolve_method(
+                    clazz,
+                    bench_case->method_name,
+                    strlen(bench_case->method_name),
+                    bench_case->descriptor,
+                    strlen(bench_case->descriptor)
+                );
+                r11f_regir_t *regir = method_info->linked->regir;
+                fprintf(
+                    stderr,
+                    "%-16s insns %u -> %u\n",
+                    bench_case->method_name,
+                    regir->bytecode_count,
+                    regir->insn_count
+                );
+            }
+
+            r11f_vm_cleanup(&vm);
+            r11f_classmgr_free(vm.classmgr);
+        }
+
+        fprintf(stderr, "%-16s", bench_case->method_name);
+        for (uint8_t exec_mode = R11F_EXEC_BYTECODE;
+             exec_mode <= R11F_EXEC_TRACE;
+             exec_mode++) {
+            fprintf(
+                stderr,
+                " %s %8.3f ms (%.2fx)",
+                g_exec_mode_names[exec_mode],
+                elapsed[exec_mode] * 1e3,
+                elapsed[R11F_EXEC_BYTECODE] / elapsed[exec_mode]
+            );
+        }
+        fprintf(stderr, "\n");
+    }
+
+    /* the embedding API itself, a call per sum: looking the method up
+       every time against a prepared handle */
+    r11f_vm_t vm = { 0 };
+    vm.classpath = (char const*[]){
+        "test",
+        NULL
+    };
+    vm.classmgr = r11f_classmgr_alloc();
+    vm.exec_mode = R11F_EXEC_JIT;
+    vm.compile_threads = 1;
+
+    enum { CALLS = 1000000 };
+    double start = now_seconds();
+    for (int32_t i = 0; i < CALLS; i++) {
+        r11f_value_t output;
+        r11f_error_t err = r11f_vm_invoke_static(
+            &vm, "com/example/Add2", "add", "(II)I",
+            (r11f_value_t[]){{.i32=i}, {.i32=1}}, &output
+        );
+        assert(err == R11F_success && output.i32 == i + 1);
+    }
+    double lookup = now_seconds() - start;
+
+    r11f_method_handle_t add;
+    r11f_error_t err = r11f_vm_prepare_static(&vm, "com/example/Add2", "add",
+                                              "(II)I", &add);
+    assert(err == R11F_success && "cannot prepare Add2.add");
+    start = now_seconds();
+    for (int32_t i = 0; i < CALLS; i++) {
+        r11f_value_t result;
+        err = r11f_vm_call(&vm, &add, (r11f_value_t[]){{.i32=i}, {.i32=1}},
+                           &result);
+        assert(err == R11F_success && result.i32 == i + 1);
+    }
+    double prepared = now_seconds() - start;
+    (void)err;
+
+    /* the same sums as columns, on one thread and on four */
+    r11f_value_t *as = malloc(CALLS * sizeof(r11f_value_t));
+    r11f_value_t *bs = malloc(CALLS * sizeof(r11f_value_t));
+    r11f_value_t *sums = malloc(CALLS * sizeof(r11f_value_t));
+    assert(as && bs && sums);
+    for (int32_t i = 0; i < CALLS; i++) {
+        as[i].i32 = i;
+        bs[i].i32 = 1;
+    }
+    double batch[2];
+    for (int i = 0; i < 2; i++) {
+        vm.batch_threads = i ? 4 : 0;
+        start = now_seconds();
+        err = r11f_vm_invoke_batch(&vm, &add,
+                                   (r11f_value_t const*[]){ as, bs },
+                                   CALLS, sums);
+        batch[i] = now_seconds() - start;
+        assert(err == R11F_success && sums[CALLS - 1].i32 == CALLS);
+    }
+    free(as);
+    free(bs);
+    free(sums);
+
+    fprintf(stderr, "%-16s invoke_static %8.3f ms call %8.3f ms (%.2fx)"
+            " batch %8.3f ms (%.2fx) 4 threads %8.3f ms (%.2fx)\n",
+            "embedding", lookup * 1e3, prepared * 1e3, lookup / prepared,
+            batch[0] * 1e3, lookup / batch[0],
+            batch[1] * 1e3, lookup / batch[1]);
+    r11f_vm_cleanup(&vm);
     r11f_classmgr_free(vm.classmgr);
 
-    assert(output == 2147483648L + 124875L && "unexpected output");
+    /* virtual threads parking at every step of their loop, all of them
+       parked at once, on one carrier and on four */
+    vm = (r11f_vm_t){ 0 };
+    vm.classpath = (char const*[]){
+        "test",
+        NULL
+    };
+    vm.classmgr = r11f_classmgr_alloc();
+    vm.exec_mode = R11F_EXEC_REGIR;
+
+    enum { TASKS = 100000 };
+    r11f_method_handle_t count;
+    err = r11f_vm_prepare_static(&vm, "com/example/Tasks", "count", "(I)I",
+                                 &count);
+    assert(err == R11F_success && "cannot prepare Tasks.count");
+    double tasks[2];
+    for (int i = 0; i < 2; i++) {
+        r11f_sched_t *sched = r11f_sched_alloc(&vm, i ? 4 : 1);
+        assert(sched);
+        for (int32_t j = 0; j < TASKS; j++) {
+            r11f_vthread_t *vthread =
+                r11f_sched_spawn(sched, &count, (r11f_value_t[]){{.i32=20}});
+            assert(vthread);
+            (void)vthread;
+        }
+        start = now_seconds();
+        r11f_sched_run(sched);
+        tasks[i] = now_seconds() - start;
+        r11f_sched_free(sched);
+    }
+    fprintf(stderr, "%-16s %d x 20 yields, 1 carrier %8.3f ms"
+            " 4 carriers %8.3f ms (%.2fx)\n",
+            "vthreads", TASKS, tasks[0] * 1e3, tasks[1] * 1e3,
+            tasks[0] / tasks[1]);
+    r11f_vm_cleanup(&vm);
+    r11f_classmgr_free(vm.classmgr);
+}
+
+/* writes the module as assembly and has the C compiler (CC, or cc) build
+   the shared object from it */
+int aot_main(char const *output, char const* const* paths, int count) {
+    char asm_path[] = "/tmp/r11f-aot-XXXXXX.s";
+    int fd = mkstemps(asm_path, 2);
+    FILE *fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!fp) {
+        fprintf(stderr, "error: cannot create %s\n", asm_path);
+        return 1;
+    }
+
+    r11f_error_t err = r11f_aot_write(fp, paths, (uint32_t)count);
+    bool written = !ferror(fp);
+    written = fclose(fp) == 0 && written;
+    if (err != R11F_success || !written) {
+        fprintf(
+            stderr,
+            "error: write %s: %s\n",
+            asm_path,
+            err != R11F_success ? r11f_explain_error(err) : "I/O error"
+        );
+        unlink(asm_path);
+        return 1;
+    }
+
+    char const *cc = getenv("CC");
+    if (!cc) {
+        cc = "cc";
+    }
+    int status = -1;
+    pid_t pid = fork();
+    if (pid == 0) {
+        execlp(cc, cc, "-shared", "-o", output, asm_path, (char*)NULL);
+        _exit(127);
+    }
+    if (pid > 0) {
+        waitpid(pid, &status, 0);
+    }
+    unlink(asm_path);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "error: %s failed to build %s\n", cc, output);
+        return 1;
+    }
+    return 0;
+}
+
+/* the names of a class that failed verification may be anything */
+static r11f_constant_utf8_info_t *verify_utf8(r11f_class_t *clazz,
+                                              uint16_t index) {
+    if (index == 0 || index >= clazz->constant_pool_count) {
+        return NULL;
+    }
+    r11f_constant_utf8_info_t *utf8_info = clazz->constant_pool[index];
+    return utf8_info && utf8_info->tag == R11F_CONSTANT_Utf8 ?
+        utf8_info :
+        NULL;
+}
+
+/* verifies the class files and reports what it cost per class */
+int verify_main(char const* const* paths, int count) {
+    int status = 0;
+    for (int i = 0; i < count; i++) {
+        r11f_class_t clazz;
+        memset(&clazz, 0, sizeof(r11f_class_t));
+
+        FILE *fp = fopen(paths[i], "rb");
+        if (!fp) {
+            fprintf(stderr, "error: failed to open file %s\n", paths[i]);
+            status = 1;
+            continue;
+        }
+        r11f_error_t err = r11f_classfile_read(fp, &clazz);
+        fclose(fp);
+        if (err == R11F_success) {
+            err = r11f_class_verify(&clazz);
+        }
+        if (err != R11F_success) {
+            fprintf(stderr,
+                    "error: verify %s: %s\n",
+                    paths[i],
+                    r11f_explain_error(err));
+            status = 1;
+        } else {
+            fprintf(stderr,
+                    "%s: %" PRIu16 " methods verified in %.1f us\n",
+                    paths[i],
+                    clazz.verified_methods,
+                    (double)clazz.verify_nanos / 1000.0);
+        }
+
+        for (uint16_t j = 0;
+             err != R11F_ERR_malformed_classfile && j < clazz.methods_count;
+             j++) {
+            r11f_method_info_t *method_info = clazz.methods[j];
+            uint32_t pc;
+            r11f_error_t method_err =
+                r11f_method_verify(&clazz, method_info, &pc);
+            if (method_err == R11F_success) {
+                continue;
+            }
+            r11f_constant_utf8_info_t *name_info =
+                verify_utf8(&clazz, method_info->name_index);
+            r11f_constant_utf8_info_t *desc_info =
+                verify_utf8(&clazz, method_info->descriptor_index);
+            if (!name_info || !desc_info) {
+                fprintf(stderr,
+                        "    method %" PRIu16 ": %s\n",
+                        j,
+                        r11f_explain_error(method_err));
+                continue;
+            }
+            fprintf(stderr,
+                    "    %.*s%.*s at pc %" PRIu32 ": %s\n",
+                    (int)name_info->length,
+                    (char const*)name_info->bytes,
+                    (int)desc_info->length,
+                    (char const*)desc_info->bytes,
+                    pc,
+                    r11f_explain_error(method_err));
+        }
+        r11f_class_cleanup(&clazz);
+    }
+    return status;
 }
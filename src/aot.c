@@ -0,0 +1,243 @@
+#include "aot.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "class.h"
+#include "clsfile.h"
+#include "jit.h"
+#include "link.h"
+#include "regir.h"
+#include "verify.h"
+#include "vm.h"
+
+#if defined(__x86_64__) && !defined(WIN32)
+
+#include <dlfcn.h>
+#include "jitimage.h"
+
+struct st_r11f_aot {
+    uint32_t module_count;
+    void *modules[];
+};
+
+static r11f_error_t write_class(FILE *output, r11f_class_t *clazz);
+static void write_record(FILE *output,
+                         r11f_jit_record_t const *key,
+                         r11f_jit_image_t const *image);
+static r11f_aot_t *aot_open(char const* const* paths);
+
+R11F_EXPORT r11f_error_t r11f_aot_write(FILE *output,
+                                        char const* const* paths,
+                                        uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        FILE *fp = fopen(paths[i], "rb");
+        if (!fp) {
+            return R11F_ERR_cannot_load_class;
+        }
+
+        r11f_class_t clazz;
+        memset(&clazz, 0, sizeof(r11f_class_t));
+        r11f_error_t err = r11f_classfile_read(fp, &clazz);
+        fclose(fp);
+        if (err == R11F_success) {
+            err = r11f_class_verify(&clazz);
+        }
+        if (err == R11F_success) {
+            err = write_class(output, &clazz);
+        }
+        r11f_class_cleanup(&clazz);
+        if (err != R11F_success) {
+            return err;
+        }
+    }
+
+    /* no executable stack wanted */
+    fprintf(output, "\t.section .note.GNU-stack,\"\",@progbits\n");
+    return R11F_success;
+}
+
+R11F_INTERNAL bool r11f_aot_open(r11f_vm_t *vm) {
+    if (!vm->aot && vm->aot_modules) {
+        vm->aot = aot_open(vm->aot_modules);
+    }
+    return vm->aot != NULL;
+}
+
+R11F_INTERNAL void r11f_aot_attach(r11f_vm_t *vm, r11f_class_t *clazz) {
+    clazz->aot_module = NULL;
+    if (!clazz->content_hash || !r11f_aot_open(vm)) {
+        return;
+    }
+
+    char symbol[32];
+    snprintf(symbol, sizeof(symbol), "r11f_aot_%016" PRIx64,
+             clazz->content_hash);
+    for (uint32_t i = 0; i < vm->aot->module_count; i++) {
+        if (vm->aot->modules[i] && dlsym(vm->aot->modules[i], symbol)) {
+            clazz->aot_module = vm->aot->modules[i];
+            return;
+        }
+    }
+}
+
+R11F_INTERNAL r11f_jit_code_t *r11f_aot_load(r11f_linked_method_t *method) {
+    r11f_jit_record_t key;
+    if (!method->clazz->aot_module
+        || !method->regir
+        || !r11f_jit_record_key(method, &key)) {
+        return NULL;
+    }
+
+    char symbol[48];
+    snprintf(symbol, sizeof(symbol), "r11f_aot_%016" PRIx64 "_%" PRIu32,
+             key.content_hash, key.method_index);
+    uint64_t const *size = dlsym(method->clazz->aot_module, symbol);
+    if (!size) {
+        return NULL;
+    }
+
+    r11f_jit_image_t image;
+    r11f_jit_code_t *code;
+    if (!r11f_jit_record_read((uint8_t const*)(size + 1),
+                              (size_t)*size,
+                              &key,
+                              method,
+                              &image)
+        || r11f_jit_load_image(method, &image, &code) != R11F_success) {
+        return NULL;
+    }
+    return code;
+}
+
+R11F_INTERNAL void r11f_aot_unload(r11f_vm_t *vm) {
+    if (!vm->aot) {
+        return;
+    }
+
+    /* loaded code lives in the code cache, not in the modules */
+    for (uint32_t i = 0; i < vm->aot->module_count; i++) {
+        if (vm->aot->modules[i]) {
+            dlclose(vm->aot->modules[i]);
+        }
+    }
+    r11f_free(vm->aot);
+    vm->aot = NULL;
+}
+
+/* every method the baseline JIT takes, the others are left out */
+static r11f_error_t write_class(FILE *output, r11f_class_t *clazz) {
+    fprintf(output,
+            "\t.section .rodata\n"
+            "\t.globl r11f_aot_%016" PRIx64 "\n"
+            "r11f_aot_%016" PRIx64 ":\n"
+            "\t.quad %" PRIu16 "\n",
+            clazz->content_hash,
+            clazz->content_hash,
+            clazz->methods_count);
+
+    for (uint16_t i = 0; i < clazz->methods_count; i++) {
+        r11f_linked_method_t *method;
+        r11f_error_t err = r11f_method_link(clazz, clazz->methods[i], &method);
+        if (err != R11F_success) {
+            return err;
+        }
+
+        r11f_jit_record_t key;
+        r11f_jit_image_t image;
+        if (!method->code
+            || clazz->methods[i]->verify_error != R11F_success
+            || !r11f_jit_record_key(method, &key)
+            || r11f_regir_compile(method, &method->regir) != R11F_success) {
+            method->regir = NULL;
+            continue;
+        }
+        if (r11f_jit_compile_image(method, &image) != R11F_success) {
+            continue;
+        }
+        write_record(output, &key, &image);
+        r11f_jit_image_free(&image);
+    }
+    return R11F_success;
+}
+
+static void write_record(FILE *output,
+                         r11f_jit_record_t const *key,
+                         r11f_jit_image_t const *image) {
+    char *data = NULL;
+    size_t size = 0;
+    FILE *record = open_memstream(&data, &size);
+    if (!record) {
+        return;
+    }
+    bool ok = r11f_jit_record_write(record, key, image);
+    ok = fclose(record) == 0 && ok;
+    if (!ok) {
+        free(data);
+        return;
+    }
+
+    fprintf(output,
+            "\t.balign 8\n"
+            "\t.globl r11f_aot_%016" PRIx64 "_%" PRIu32 "\n"
+            "r11f_aot_%016" PRIx64 "_%" PRIu32 ":\n"
+            "\t.quad %zu",
+            key->content_hash,
+            key->method_index,
+            key->content_hash,
+            key->method_index,
+            size);
+    for (size_t i = 0; i < size; i++) {
+        fprintf(output, i % 16 ? ",%u" : "\n\t.byte %u", (uint8_t)data[i]);
+    }
+    fprintf(output, "\n");
+    /* open_memstream allocates with malloc */
+    free(data);
+}
+
+/* modules that fail to open are kept as NULL */
+static r11f_aot_t *aot_open(char const* const* paths) {
+    uint32_t count = 0;
+    while (paths[count]) {
+        count++;
+    }
+
+    r11f_aot_t *aot = r11f_alloc(sizeof(r11f_aot_t) + count * sizeof(void*));
+    if (!aot) {
+        return NULL;
+    }
+    aot->module_count = count;
+    for (uint32_t i = 0; i < count; i++) {
+        aot->modules[i] = dlopen(paths[i], RTLD_NOW | RTLD_LOCAL);
+    }
+    return aot;
+}
+
+#else /* __x86_64__ && !WIN32 */
+
+R11F_EXPORT r11f_error_t r11f_aot_write(FILE *output,
+                                        char const* const* paths,
+                                        uint32_t count) {
+    (void)output;
+    (void)paths;
+    (void)count;
+    return R11F_ERR_not_implemented_instruction;
+}
+
+R11F_INTERNAL void r11f_aot_attach(r11f_vm_t *vm, r11f_class_t *clazz) {
+    (void)vm;
+    clazz->aot_module = NULL;
+}
+
+R11F_INTERNAL r11f_jit_code_t *r11f_aot_load(r11f_linked_method_t *method) {
+    (void)method;
+    return NULL;
+}
+
+R11F_INTERNAL void r11f_aot_unload(r11f_vm_t *vm) {
+    (void)vm;
+}
+
+#endif /* __x86_64__ && !WIN32 */
@@ -60,6 +60,108 @@ R11F_EXPORT char const* r11f_explain_bytecode(uint8_t bytecode) {
     }
 }
 
+R11F_EXPORT uint32_t r11f_bytecode_length(uint8_t *code,
+                                          uint32_t code_length,
+                                          uint32_t pc) {
+    /* a switch running past the end reports a length that does too, so
+       walks stop and length checks fail without reading beyond the code */
+    uint32_t overrun = code_length + 1 - pc;
+    switch (code[pc]) {
+        case R11F_wide:
+            return code[pc + 1] == R11F_iinc ? 6 : 4;
+
+        case R11F_tableswitch: {
+            uint32_t operands = (pc + 4) & ~(uint32_t)3;
+            if ((uint64_t)operands + 12 > code_length) {
+                return overrun;
+            }
+            int32_t low = (int32_t)read_unaligned_be4(code + operands + 4);
+            int32_t high = (int32_t)read_unaligned_be4(code + operands + 8);
+            uint64_t end = operands + 12 + 4 * ((int64_t)high - low + 1);
+            if (high < low || end > code_length) {
+                return overrun;
+            }
+            return (uint32_t)end - pc;
+        }
+
+        case R11F_lookupswitch: {
+            uint32_t operands = (pc + 4) & ~(uint32_t)3;
+            if ((uint64_t)operands + 8 > code_length) {
+                return overrun;
+            }
+            uint32_t npairs = read_unaligned_be4(code + operands + 4);
+            uint64_t end = operands + 8 + 8 * (uint64_t)npairs;
+            if (end > code_length) {
+                return overrun;
+            }
+            return (uint32_t)end - pc;
+        }
+
+        case R11F_aload:
+        case R11F_astore:
+        case R11F_bipush:
+        case R11F_dload:
+        case R11F_dstore:
+        case R11F_fload:
+        case R11F_fstore:
+        case R11F_iload:
+        case R11F_istore:
+        case R11F_lload:
+        case R11F_lstore:
+        case R11F_ret:
+        case R11F_ldc:
+        case R11F_newarray:
+            return 2;
+
+        case R11F_iinc:
+        case R11F_sipush:
+        case R11F_new:
+        case R11F_anewarray:
+        case R11F_instanceof:
+        case R11F_ldc_w:
+        case R11F_ldc2_w:
+        case R11F_checkcast:
+        case R11F_getfield:
+        case R11F_putfield:
+        case R11F_getstatic:
+        case R11F_putstatic:
+        case R11F_invokespecial:
+        case R11F_invokestatic:
+        case R11F_invokevirtual:
+        case R11F_goto:
+        case R11F_if_acmpeq:
+        case R11F_if_acmpne:
+        case R11F_if_icmpeq:
+        case R11F_if_icmpne:
+        case R11F_if_icmplt:
+        case R11F_if_icmpge:
+        case R11F_if_icmpgt:
+        case R11F_if_icmple:
+        case R11F_ifeq:
+        case R11F_ifne:
+        case R11F_iflt:
+        case R11F_ifge:
+        case R11F_ifgt:
+        case R11F_ifle:
+        case R11F_ifnonnull:
+        case R11F_ifnull:
+        case R11F_jsr:
+            return 3;
+
+        case R11F_multianewarray:
+            return 4;
+
+        case R11F_invokedynamic:
+        case R11F_invokeinterface:
+        case R11F_goto_w:
+        case R11F_jsr_w:
+            return 5;
+
+        default:
+            return 1;
+    }
+}
+
 R11F_EXPORT void r11f_disassemble(r11f_class_t *clazz,
                                   r11f_method_info_t *method_info,
                                   size_t indent) {
@@ -326,10 +428,8 @@ R11F_EXPORT void r11f_disassemble(r11f_class_t *clazz,
             }
 
             case R11F_lookupswitch: {
-                size_t padding = (idx + 4) % 4;
-                if (padding) {
-                    padding = 4 - padding;
-                }
+                size_t pc = idx;
+                size_t padding = 4 - idx % 4;
 
                 uint8_t defaultbyte1 = code[idx + padding];
                 uint8_t defaultbyte2 = code[idx + padding + 1];
@@ -352,12 +452,12 @@ R11F_EXPORT void r11f_disassemble(r11f_class_t *clazz,
                     | ((uint32_t)npairsbyte3 << 8)
                     | npairsbyte4;
 
-                printf("tableswitch\n");
+                printf("lookupswitch\n");
                 printf(
                     "%.*sdefault: %d\n",
                     (int)indent + 2,
                     g_indent_str,
-                    (int)(idx + default_offset)
+                    (int)(pc + default_offset)
                 );
 
                 idx += padding + 8;
@@ -389,7 +489,7 @@ R11F_EXPORT void r11f_disassemble(r11f_class_t *clazz,
                         (int)indent + 2,
                         g_indent_str,
                         key,
-                        (int)(offset + 1)
+                        (int)(pc + offset)
                     );
 
                     idx += 8;
@@ -399,10 +499,8 @@ R11F_EXPORT void r11f_disassemble(r11f_class_t *clazz,
             }
 
             case R11F_tableswitch: {
-                size_t padding = (idx + 4) % 4;
-                if (padding) {
-                    padding = 4 - padding;
-                }
+                size_t pc = idx;
+                size_t padding = 4 - idx % 4;
 
                 uint8_t defaultbyte1 = code[idx + padding];
                 uint8_t defaultbyte2 = code[idx + padding + 1];
@@ -442,7 +540,7 @@ R11F_EXPORT void r11f_disassemble(r11f_class_t *clazz,
                     "%.*sdefault: %d\n",
                     (int)indent + 2,
                     g_indent_str,
-                    (int)(default_offset + 1)
+                    (int)(pc + default_offset)
                 );
                 printf(
                     "%.*slow: %d\n",
@@ -475,7 +573,7 @@ R11F_EXPORT void r11f_disassemble(r11f_class_t *clazz,
                         (int)indent + 2,
                         g_indent_str,
                         i,
-                        (int)(offset + 1)
+                        (int)(pc + offset)
                     );
                     idx += 4;
                 }
@@ -50,6 +50,19 @@ R11F_INTERNAL void write_unaligned8(void* addr, uint64_t value) {
     memcpy(addr, &value, sizeof(uint64_t));
 }
 
+R11F_INTERNAL uint16_t read_unaligned_be2(void* addr) {
+    uint8_t *buf = (uint8_t *)addr;
+    return ((uint16_t)buf[0] << 8) | buf[1];
+}
+
+R11F_INTERNAL uint32_t read_unaligned_be4(void* addr) {
+    uint8_t *buf = (uint8_t *)addr;
+    return ((uint32_t)buf[0] << 24)
+        | ((uint32_t)buf[1] << 16)
+        | ((uint32_t)buf[2] << 8)
+        | buf[3];
+}
+
 R11F_INTERNAL void flip2_unaligned(void* addr) {
     uint16_t value = read_unaligned2(addr);
     flip2(&value);
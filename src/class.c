@@ -5,6 +5,7 @@
 #include "alloc.h"
 #include "class/attrib.h"
 #include "class/cpool.h"
+#include "link.h"
 
 R11F_EXPORT void r11f_class_cleanup(r11f_class_t *clazz) {
     if (clazz->constant_pool) {
@@ -37,6 +38,7 @@ R11F_EXPORT void r11f_class_cleanup(r11f_class_t *clazz) {
     if (clazz->methods) {
         for (uint16_t i = 0; i < clazz->methods_count; i++) {
             r11f_method_info_t *method_info = clazz->methods[i];
+            r11f_method_unlink(method_info);
             if (method_info->attributes) {
                 for (uint16_t j = 0; j < method_info->attributes_count; j++) {
                     r11f_free(method_info->attributes[j]);
@@ -98,6 +100,22 @@ r11f_class_get_method_name(r11f_class_t *clazz,
     };
 }
 
+R11F_EXPORT bool r11f_class_get_class_name(r11f_class_t *clazz,
+                                           uint16_t index,
+                                           char const **out_name,
+                                           uint16_t *out_name_len) {
+    if (!index) {
+        return false;
+    }
+
+    r11f_constant_class_info_t *class_info = clazz->constant_pool[index];
+    r11f_constant_utf8_info_t *name_info =
+        clazz->constant_pool[class_info->name_index];
+    *out_name = (char const*)name_info->bytes;
+    *out_name_len = name_info->length;
+    return true;
+}
+
 R11F_EXPORT r11f_method_info_t*
 r11f_class_resolve_method2(r11f_class_t *clazz,
                            r11f_constant_methodref_info_t *methodref_info) {
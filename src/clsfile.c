@@ -52,10 +52,13 @@ static r11f_error_t imp_read_attributes(FILE *file,
                                         r11f_class_t *clazz);
 
 #ifdef R11F_LITTLE_ENDIAN
-static void preprocess_code_attribute(r11f_attribute_info_t *attribute);
+static bool preprocess_code_attribute(r11f_attribute_info_t *attribute);
 #endif
 
+static uint64_t hash_file(FILE *file, long start, long end);
+
 R11F_EXPORT r11f_error_t r11f_classfile_read(FILE *file, r11f_class_t *clazz) {
+    long start = ftell(file);
     CHKERR_RET(read_header(file, clazz))
     CHKERR_RET(read_constant_pool(file, clazz))
     CHKERR_RET(read_classinfo(file, clazz))
@@ -64,9 +67,30 @@ R11F_EXPORT r11f_error_t r11f_classfile_read(FILE *file, r11f_class_t *clazz) {
     CHKERR_RET(read_methods(file, clazz))
     CHKERR_RET(read_attributes(file, clazz))
 
+    clazz->content_hash = hash_file(file, start, ftell(file));
+    clazz->verified_methods = 0;
+    clazz->verify_nanos = 0;
+    clazz->builtin = false;
     return R11F_success;
 }
 
+/* FNV-1a over the bytes just read, 0 if the file cannot seek back */
+static uint64_t hash_file(FILE *file, long start, long end) {
+    if (start < 0 || end < start || fseek(file, start, SEEK_SET) != 0) {
+        return 0;
+    }
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (long i = start; i < end; i++) {
+        int c = fgetc(file);
+        if (c == EOF) {
+            return 0;
+        }
+        hash = (hash ^ (uint8_t)c) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
 static r11f_error_t read_header(FILE *file, r11f_class_t *clazz) {
     if (!read_u4(file, &clazz->magic)
         || clazz->magic != 0xCAFEBABE) {
@@ -118,13 +142,13 @@ read_constant_pool(FILE *file, r11f_class_t *clazz) {
                 size = sizeof(r11f_constant_integer_info_t);
                 break;
             case R11F_CONSTANT_Float:
-                size = sizeof(r11f_constant_integer_info_t);
+                size = sizeof(r11f_constant_float_info_t);
                 break;
             case R11F_CONSTANT_Long:
-                size = sizeof(r11f_constant_integer_info_t);
+                size = sizeof(r11f_constant_long_info_t);
                 break;
             case R11F_CONSTANT_Double:
-                size = sizeof(r11f_constant_integer_info_t);
+                size = sizeof(r11f_constant_double_info_t);
                 break;
             case R11F_CONSTANT_NameAndType:
                 size = sizeof(r11f_constant_name_and_type_info_t);
@@ -339,6 +363,8 @@ read_methods(FILE *file, r11f_class_t *clazz) {
         r11f_method_info_t *method_info = r11f_alloc(sizeof(r11f_method_info_t));
         CHKFALSE_RET(clazz->methods[i] = method_info,
                      R11F_ERR_out_of_memory)
+        method_info->linked = NULL;
+        method_info->verify_error = R11F_success;
 
         CHKREAD(read_u2, file, &method_info->access_flags)
         CHKREAD(read_u2, file, &method_info->name_index)
@@ -386,7 +412,7 @@ static r11f_error_t imp_read_attributes(FILE *file,
             return R11F_ERR_malformed_classfile;
         }
         r11f_cpinfo_t *cpinfo = clazz->constant_pool[attribute_name_index];
-        if (cpinfo->tag != R11F_CONSTANT_Utf8) {
+        if (!cpinfo || cpinfo->tag != R11F_CONSTANT_Utf8) {
             return R11F_ERR_malformed_classfile;
         }
 
@@ -407,8 +433,9 @@ static r11f_error_t imp_read_attributes(FILE *file,
         r11f_constant_utf8_info_t *utf8_info =
             (r11f_constant_utf8_info_t*)cpinfo;
         if (utf8_info->length == 4 &&
-            !strncmp((char*)utf8_info->bytes, "Code", 4)) {
-            preprocess_code_attribute(attribute_info);
+            !strncmp((char*)utf8_info->bytes, "Code", 4)
+            && !preprocess_code_attribute(attribute_info)) {
+            return R11F_ERR_malformed_classfile;
         }
     }
 #endif
@@ -417,17 +444,28 @@ static r11f_error_t imp_read_attributes(FILE *file,
 }
 
 #ifdef R11F_LITTLE_ENDIAN
-static void preprocess_code_attribute(r11f_attribute_info_t *attribute) {
+/* false if the fields do not fit in the attribute */
+static bool preprocess_code_attribute(r11f_attribute_info_t *attribute) {
     uint8_t *info = attribute->info;
+    uint32_t length = attribute->attribute_length;
+    if (length < 10) {
+        return false;
+    }
     flip2_unaligned(info); /* Code_attribute->max_stack */
     flip2_unaligned(info + 2); /* Code_attribute->max_locals */
     flip4_unaligned(info + 4); /* Code_attribute->code_length */
     uint32_t code_length = read_unaligned4(info + 4);
+    if (code_length > length - 10) {
+        return false;
+    }
 
     /* info = Code_attribute->exception_table_length */
     info = info + 8 + code_length;
     flip2_unaligned(info); /* Code_attribute->exception_table_length */
     uint16_t exception_table_length = read_unaligned2(info);
+    if ((length - 10 - code_length) / 8 < exception_table_length) {
+        return false;
+    }
 
     /* info = Code_attribute->exception_table */
     info = info + 2;
@@ -439,6 +477,8 @@ static void preprocess_code_attribute(r11f_attribute_info_t *attribute) {
         info = info + 8;
     }
 
-    /* TODO: we ignore Code_attribute->attributes for now */
+    /* Code_attribute->attributes stay big-endian, verify.c reads the
+       StackMapTable from them */
+    return true;
 }
 #endif
@@ -7,6 +7,7 @@
 #include "class.h"
 #include "class/cpool.h"
 #include "defs.h"
+#include "jit.h"
 
 typedef struct st_imp_hashtable_node hashtable_node_t;
 
@@ -19,9 +20,18 @@ struct st_imp_hashtable_node {
     r11f_class_t *class;
 };
 
+typedef struct st_imp_dependency dependency_t;
+
+struct st_imp_dependency {
+    dependency_t *next;
+    r11f_cha_dependency_t dependency;
+    r11f_jit_code_t *code;
+};
+
 struct st_r11f_classmgr {
     size_t hash_size;
     uint32_t next_classid;
+    dependency_t *dependencies;
 
     hashtable_node_t *hash_table_name;
     hashtable_node_t *hash_table_id;
@@ -30,6 +40,16 @@ struct st_r11f_classmgr {
 
 static size_t bkdr_hash(char const *str);
 static size_t bkdr_hash2(char const *str, size_t len);
+static r11f_class_t *super_of(r11f_classmgr_t *mgr, r11f_class_t *clazz);
+static bool is_subclass(r11f_classmgr_t *mgr,
+                        r11f_class_t *sub,
+                        r11f_class_t *clazz);
+static r11f_method_info_t *find_virtual(r11f_class_t *clazz,
+                                        char const *name,
+                                        uint16_t name_len,
+                                        char const *descriptor,
+                                        uint16_t descriptor_len);
+static void invalidate_broken(r11f_classmgr_t *mgr);
 
 R11F_EXPORT r11f_classmgr_t *r11f_classmgr_alloc(void) {
     return r11f_classmgr_alloc_hash_size(1024);
@@ -108,6 +128,7 @@ R11F_EXPORT r11f_error_t r11f_classmgr_add_class(r11f_classmgr_t *mgr,
     updated_id_node->class = classfile;
 
     mgr->next_classid++;
+    invalidate_broken(mgr);
     return R11F_success;
 }
 
@@ -155,6 +176,12 @@ R11F_EXPORT r11f_class_t *r11f_classmgr_find_class2(r11f_classmgr_t *mgr,
 }
 
 R11F_EXPORT void r11f_classmgr_free(r11f_classmgr_t *mgr) {
+    while (mgr->dependencies) {
+        dependency_t *next = mgr->dependencies->next;
+        r11f_free(mgr->dependencies);
+        mgr->dependencies = next;
+    }
+
     for (size_t i = 0; i < mgr->hash_size; i++) {
         hashtable_node_t *node = &mgr->hash_table_name[i];
         if (node->class) {
@@ -186,6 +213,129 @@ R11F_EXPORT void r11f_classmgr_free(r11f_classmgr_t *mgr) {
     r11f_free(mgr);
 }
 
+R11F_EXPORT r11f_method_info_t*
+r11f_classmgr_unique_method(r11f_classmgr_t *mgr,
+                            r11f_class_t *clazz,
+                            char const *name,
+                            uint16_t name_len,
+                            char const *descriptor,
+                            uint16_t descriptor_len,
+                            r11f_class_t **out_class) {
+    r11f_method_info_t *found = NULL;
+    r11f_class_t *owner = clazz;
+    for (; owner; owner = super_of(mgr, owner)) {
+        found = find_virtual(owner, name, name_len, descriptor, descriptor_len);
+        if (found) {
+            break;
+        }
+    }
+    if (!found || (found->access_flags & R11F_ACC_ABSTRACT)) {
+        return NULL;
+    }
+
+    /* any loaded subclass overriding it makes a second implementation */
+    for (uint32_t id = 0; id < mgr->next_classid; id++) {
+        r11f_class_t *sub = r11f_classmgr_find_class_id(mgr, id);
+        if (sub
+            && sub != clazz
+            && find_virtual(sub, name, name_len, descriptor, descriptor_len)
+            && is_subclass(mgr, sub, clazz)) {
+            return NULL;
+        }
+    }
+
+    *out_class = owner;
+    return found;
+}
+
+R11F_EXPORT r11f_error_t
+r11f_classmgr_add_dependency(r11f_classmgr_t *mgr,
+                             r11f_cha_dependency_t const *dependency,
+                             r11f_jit_code_t *code) {
+    r11f_class_t *owner;
+    if (r11f_classmgr_unique_method(mgr,
+                                    dependency->clazz,
+                                    dependency->name,
+                                    dependency->name_len,
+                                    dependency->descriptor,
+                                    dependency->descriptor_len,
+                                    &owner) != dependency->target) {
+        r11f_jit_invalidate(code);
+        return R11F_success;
+    }
+
+    dependency_t *node = r11f_alloc(sizeof(dependency_t));
+    if (!node) {
+        return R11F_ERR_out_of_memory;
+    }
+    node->next = mgr->dependencies;
+    node->dependency = *dependency;
+    node->code = code;
+    mgr->dependencies = node;
+    return R11F_success;
+}
+
+static r11f_class_t *super_of(r11f_classmgr_t *mgr, r11f_class_t *clazz) {
+    char const *name;
+    uint16_t name_len;
+    if (!r11f_class_get_class_name(clazz,
+                                   clazz->super_class,
+                                   &name,
+                                   &name_len)) {
+        return NULL;
+    }
+    return r11f_classmgr_find_class2(mgr, name, name_len);
+}
+
+static bool is_subclass(r11f_classmgr_t *mgr,
+                        r11f_class_t *sub,
+                        r11f_class_t *clazz) {
+    for (r11f_class_t *c = super_of(mgr, sub); c; c = super_of(mgr, c)) {
+        if (c == clazz) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static r11f_method_info_t *find_virtual(r11f_class_t *clazz,
+                                        char const *name,
+                                        uint16_t name_len,
+                                        char const *descriptor,
+                                        uint16_t descriptor_len) {
+    r11f_method_info_t *method_info = r11f_class_resolve_method(
+        clazz, name, name_len, descriptor, descriptor_len
+    );
+    if (method_info && (method_info->access_flags & R11F_ACC_STATIC)) {
+        return NULL;
+    }
+    return method_info;
+}
+
+/* re-checks every dependency against the classes loaded now */
+static void invalidate_broken(r11f_classmgr_t *mgr) {
+    dependency_t **link = &mgr->dependencies;
+    while (*link) {
+        dependency_t *node = *link;
+        r11f_cha_dependency_t *dependency = &node->dependency;
+        r11f_class_t *owner;
+        if (r11f_classmgr_unique_method(mgr,
+                                        dependency->clazz,
+                                        dependency->name,
+                                        dependency->name_len,
+                                        dependency->descriptor,
+                                        dependency->descriptor_len,
+                                        &owner) == dependency->target) {
+            link = &node->next;
+            continue;
+        }
+
+        r11f_jit_invalidate(node->code);
+        *link = node->next;
+        r11f_free(node);
+    }
+}
+
 static size_t bkdr_hash(char const *str) {
     size_t hash = 0;
     for (size_t i = 0; str[i]; i++) {
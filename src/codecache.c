@@ -0,0 +1,169 @@
+#ifndef WIN32
+#   define _GNU_SOURCE
+#endif
+
+#include "codecache.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "alloc.h"
+
+#ifndef WIN32
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define CODECACHE_CHUNK_SIZE ((size_t)1 << 20)
+#define CODECACHE_ALIGN ((size_t)16)
+
+typedef struct st_codecache_chunk {
+    struct st_codecache_chunk *next;
+    uint8_t *exec;
+    uint8_t *write;
+    size_t size;
+    size_t used;
+    size_t live;
+} codecache_chunk_t;
+
+static pthread_mutex_t g_codecache_lock = PTHREAD_MUTEX_INITIALIZER;
+static codecache_chunk_t *g_chunks = NULL;
+static size_t g_used = 0;
+
+static codecache_chunk_t *chunk_alloc(size_t size);
+static void chunk_free(codecache_chunk_t *chunk);
+
+R11F_EXPORT void *r11f_codecache_alloc(size_t size, void **out_writable) {
+    size = (size + CODECACHE_ALIGN - 1) & ~(CODECACHE_ALIGN - 1);
+
+    pthread_mutex_lock(&g_codecache_lock);
+    /* only the newest chunk is bumped, older ones just wait to be freed */
+    codecache_chunk_t *chunk = g_chunks;
+    if (!chunk || chunk->size - chunk->used < size) {
+        chunk = chunk_alloc(size);
+        if (!chunk) {
+            pthread_mutex_unlock(&g_codecache_lock);
+            return NULL;
+        }
+        chunk->next = g_chunks;
+        g_chunks = chunk;
+    }
+
+    void *code = chunk->exec + chunk->used;
+    *out_writable = chunk->write + chunk->used;
+    chunk->used += size;
+    chunk->live += size;
+    g_used += size;
+    pthread_mutex_unlock(&g_codecache_lock);
+    return code;
+}
+
+R11F_EXPORT void r11f_codecache_free(void *code, size_t size) {
+    if (!code) {
+        return;
+    }
+    size = (size + CODECACHE_ALIGN - 1) & ~(CODECACHE_ALIGN - 1);
+
+    pthread_mutex_lock(&g_codecache_lock);
+    codecache_chunk_t **link = &g_chunks;
+    while (*link) {
+        codecache_chunk_t *chunk = *link;
+        if ((uint8_t*)code >= chunk->exec
+            && (uint8_t*)code < chunk->exec + chunk->size) {
+            chunk->live -= size;
+            g_used -= size;
+            if (!chunk->live && chunk != g_chunks) {
+                *link = chunk->next;
+                chunk_free(chunk);
+            }
+            break;
+        }
+        link = &chunk->next;
+    }
+    pthread_mutex_unlock(&g_codecache_lock);
+}
+
+R11F_EXPORT size_t r11f_codecache_used(void) {
+    pthread_mutex_lock(&g_codecache_lock);
+    size_t used = g_used;
+    pthread_mutex_unlock(&g_codecache_lock);
+    return used;
+}
+
+static codecache_chunk_t *chunk_alloc(size_t size) {
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size = size < CODECACHE_CHUNK_SIZE ? CODECACHE_CHUNK_SIZE : size;
+    size = (size + page_size - 1) & ~(page_size - 1);
+
+    codecache_chunk_t *chunk = r11f_alloc(sizeof(codecache_chunk_t));
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->live = 0;
+
+    int fd = memfd_create("r11f-codecache", MFD_CLOEXEC);
+    if (fd >= 0) {
+        bool ok = ftruncate(fd, (off_t)size) == 0;
+        void *exec = ok ?
+            mmap(NULL, size, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0) :
+            MAP_FAILED;
+        void *write = exec != MAP_FAILED ?
+            mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) :
+            MAP_FAILED;
+        close(fd);
+
+        if (write != MAP_FAILED) {
+            chunk->exec = exec;
+            chunk->write = write;
+            return chunk;
+        }
+        if (exec != MAP_FAILED) {
+            munmap(exec, size);
+        }
+    }
+
+    /* no memfd (old kernel, sandbox): fall back to a single RWX mapping */
+    void *rwx = mmap(NULL,
+                     size,
+                     PROT_READ | PROT_WRITE | PROT_EXEC,
+                     MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1,
+                     0);
+    if (rwx == MAP_FAILED) {
+        r11f_free(chunk);
+        return NULL;
+    }
+    chunk->exec = rwx;
+    chunk->write = rwx;
+    return chunk;
+}
+
+static void chunk_free(codecache_chunk_t *chunk) {
+    if (chunk->write != chunk->exec) {
+        munmap(chunk->write, chunk->size);
+    }
+    munmap(chunk->exec, chunk->size);
+    r11f_free(chunk);
+}
+
+#else /* WIN32 */
+
+R11F_EXPORT void *r11f_codecache_alloc(size_t size, void **out_writable) {
+    (void)size;
+    *out_writable = NULL;
+    return NULL;
+}
+
+R11F_EXPORT void r11f_codecache_free(void *code, size_t size) {
+    (void)code;
+    (void)size;
+}
+
+R11F_EXPORT size_t r11f_codecache_used(void) {
+    return 0;
+}
+
+#endif /* WIN32 */
@@ -14,7 +14,16 @@ static const char* g_error_strings_zh_cn[] = {
     [R11F_ERR_cannot_invoke_native_method] = "不能调用本地方法",
     [R11F_ERR_cannot_invoke_non_static_method] = "不能调用非静态方法",
     [R11F_ERR_cannot_load_class] = "不能加载类",
-    [R11F_ERR_not_implemented_instruction] = "未实现的指令"
+    [R11F_ERR_not_implemented_instruction] = "未实现的指令",
+    [R11F_ERR_division_by_zero] = "除以零",
+    [R11F_ERR_deoptimized] = "已去优化",
+    [R11F_ERR_null_pointer] = "空指针",
+    [R11F_ERR_array_index_out_of_bounds] = "数组下标越界",
+    [R11F_ERR_negative_array_size] = "数组长度为负",
+    [R11F_ERR_verify_failed] = "字节码校验失败",
+    [R11F_ERR_uncaught_exception] = "未捕获的异常",
+    [R11F_ERR_stack_overflow] = "栈溢出",
+    [R11F_ERR_parked] = "虚拟线程已挂起"
 };
 
 static const char* g_error_strings_en_us[] = {
@@ -28,7 +37,16 @@ static const char* g_error_strings_en_us[] = {
     [R11F_ERR_cannot_invoke_native_method] = "cannot invoke native method",
     [R11F_ERR_cannot_invoke_non_static_method] = "cannot invoke non-static method",
     [R11F_ERR_cannot_load_class] = "cannot load class",
-    [R11F_ERR_not_implemented_instruction] = "not implemented instruction"
+    [R11F_ERR_not_implemented_instruction] = "not implemented instruction",
+    [R11F_ERR_division_by_zero] = "division by zero",
+    [R11F_ERR_deoptimized] = "deoptimized",
+    [R11F_ERR_null_pointer] = "null pointer",
+    [R11F_ERR_array_index_out_of_bounds] = "array index out of bounds",
+    [R11F_ERR_negative_array_size] = "negative array size",
+    [R11F_ERR_verify_failed] = "bytecode verification failed",
+    [R11F_ERR_uncaught_exception] = "uncaught exception",
+    [R11F_ERR_stack_overflow] = "stack overflow",
+    [R11F_ERR_parked] = "virtual thread parked"
 };
 
 R11F_EXPORT
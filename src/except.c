@@ -0,0 +1,145 @@
+#include "except.h"
+
+#include <string.h>
+#include "alloc.h"
+#include "class.h"
+#include "class/cpool.h"
+
+typedef struct {
+    char const *class_name;
+    char const *super_name;
+    r11f_error_t error;
+} builtin_t;
+
+static builtin_t const builtins[] = {
+#define EXCEPTION(CODE,CLASS,SUPER,ERROR) { CLASS, SUPER, ERROR },
+#include "exceptinc.h"
+};
+
+static r11f_constant_class_info_t *make_class_info(uint16_t name_index);
+static r11f_constant_utf8_info_t *make_utf8(char const *bytes);
+
+R11F_EXPORT uint16_t r11f_except_find(char const *class_name,
+                                      uint16_t class_name_len) {
+    for (uint16_t i = 0; i < R11F_EXCEPT_COUNT; i++) {
+        if (strlen(builtins[i].class_name) == class_name_len
+            && !memcmp(builtins[i].class_name, class_name, class_name_len)) {
+            return i;
+        }
+    }
+    return R11F_EXCEPT_NONE;
+}
+
+R11F_EXPORT uint16_t r11f_except_from_error(r11f_error_t error) {
+    if (error == R11F_success) {
+        return R11F_EXCEPT_NONE;
+    }
+    for (uint16_t i = 0; i < R11F_EXCEPT_COUNT; i++) {
+        if (builtins[i].error == error) {
+            return i;
+        }
+    }
+    return R11F_EXCEPT_NONE;
+}
+
+R11F_EXPORT r11f_error_t r11f_except_error(uint16_t builtin) {
+    if (builtin >= R11F_EXCEPT_COUNT
+        || builtins[builtin].error == R11F_success) {
+        return R11F_ERR_uncaught_exception;
+    }
+    return builtins[builtin].error;
+}
+
+R11F_EXPORT char const *r11f_except_name(uint16_t builtin) {
+    return builtin < R11F_EXCEPT_COUNT ? builtins[builtin].class_name : NULL;
+}
+
+R11F_EXPORT r11f_error_t r11f_except_make_class(uint16_t builtin,
+                                                r11f_class_t **output) {
+    r11f_class_t *clazz = r11f_alloc_zeroed(sizeof(r11f_class_t));
+    if (!clazz) {
+        return R11F_ERR_out_of_memory;
+    }
+
+    /* [1] this class, [2] its name, [3] the superclass, [4] its name */
+    clazz->constant_pool_count = 5;
+    clazz->constant_pool = r11f_alloc_zeroed(5 * sizeof(void*));
+    if (clazz->constant_pool) {
+        clazz->constant_pool[1] = make_class_info(2);
+        clazz->constant_pool[2] = make_utf8(builtins[builtin].class_name);
+        clazz->constant_pool[3] = make_class_info(4);
+        clazz->constant_pool[4] = make_utf8(builtins[builtin].super_name);
+    }
+    if (!clazz->constant_pool
+        || !clazz->constant_pool[1] || !clazz->constant_pool[2]
+        || !clazz->constant_pool[3] || !clazz->constant_pool[4]) {
+        r11f_class_cleanup(clazz);
+        r11f_free(clazz);
+        return R11F_ERR_out_of_memory;
+    }
+
+    clazz->magic = 0xcafebabe;
+    clazz->major_version = 52;
+    clazz->access_flags = R11F_ACC_PUBLIC | R11F_ACC_SUPER;
+    clazz->this_class = 1;
+    clazz->super_class = 3;
+    clazz->builtin = true;
+    *output = clazz;
+    return R11F_success;
+}
+
+R11F_INTERNAL bool r11f_backtrace_push(r11f_backtrace_t *backtrace,
+                                       r11f_linked_method_t *method,
+                                       uint32_t pc) {
+    if (backtrace->count == backtrace->capacity) {
+        uint32_t capacity = backtrace->capacity ? backtrace->capacity * 2 : 16;
+        r11f_stack_entry_t *entries =
+            r11f_alloc(capacity * sizeof(r11f_stack_entry_t));
+        if (!entries) {
+            return false;
+        }
+        if (backtrace->entries) {
+            memcpy(entries,
+                   backtrace->entries,
+                   backtrace->count * sizeof(r11f_stack_entry_t));
+            r11f_free(backtrace->entries);
+        }
+        backtrace->entries = entries;
+        backtrace->capacity = capacity;
+    }
+
+    backtrace->entries[backtrace->count++] = (r11f_stack_entry_t) {
+        .method = method,
+        .pc = pc
+    };
+    return true;
+}
+
+R11F_INTERNAL void r11f_backtrace_free(r11f_backtrace_t *backtrace) {
+    r11f_free(backtrace->entries);
+    backtrace->entries = NULL;
+    backtrace->count = 0;
+    backtrace->capacity = 0;
+}
+
+static r11f_constant_class_info_t *make_class_info(uint16_t name_index) {
+    r11f_constant_class_info_t *class_info =
+        r11f_alloc(sizeof(r11f_constant_class_info_t));
+    if (class_info) {
+        class_info->tag = R11F_CONSTANT_Class;
+        class_info->name_index = name_index;
+    }
+    return class_info;
+}
+
+static r11f_constant_utf8_info_t *make_utf8(char const *bytes) {
+    size_t length = strlen(bytes);
+    r11f_constant_utf8_info_t *utf8_info =
+        r11f_alloc(sizeof(r11f_constant_utf8_info_t) + length);
+    if (utf8_info) {
+        utf8_info->tag = R11F_CONSTANT_Utf8;
+        utf8_info->length = (uint16_t)length;
+        memcpy(utf8_info->bytes, bytes, length);
+    }
+    return utf8_info;
+}
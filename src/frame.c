@@ -1,42 +1,158 @@
+#ifndef WIN32
+#   define _GNU_SOURCE
+#endif
+
 #include "frame.h"
 
 #include <assert.h>
-#include <stdlib.h>
 #include <string.h>
 #include "alloc.h"
-#include "byteutil.h"
-#include "class.h"
-#include "class/attrib.h"
-
-R11F_EXPORT r11f_frame_t*
-r11f_frame_alloc(r11f_class_t *clazz, r11f_method_info_t *method_info) {
-    r11f_attribute_info_t *code_info =
-        r11f_method_find_attribute(clazz, method_info, "Code");
-    assert(code_info && "attribute Code not found in method"
-                        ", is this method abstract or native?");
-
-    uint16_t max_stack = read_unaligned2(code_info->info);
-    uint16_t max_locals = read_unaligned2(code_info->info + 2);
-    uint16_t code_length = read_unaligned2(code_info->info + 4);
-    uint8_t *code = code_info->info + 8;
-
-    size_t vla_size = (max_stack + max_locals) * sizeof(r11f_value_t);
-    r11f_frame_t *frame = r11f_alloc(sizeof(r11f_frame_t) + vla_size);
-    if (!frame) {
+#include "link.h"
+
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+R11F_EXPORT r11f_error_t r11f_stack_init(r11f_stack_t *stack, size_t size) {
+#ifndef WIN32
+    void *base = mmap(NULL,
+                      size,
+                      PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                      -1,
+                      0);
+    if (base == MAP_FAILED) {
+        return R11F_ERR_out_of_memory;
+    }
+#else
+    void *base = r11f_alloc(size);
+    if (!base) {
+        return R11F_ERR_out_of_memory;
+    }
+#endif
+    stack->base = base;
+    stack->top = base;
+    stack->limit = stack->base + size;
+    stack->frames = (r11f_frame_t*)stack->limit;
+    return R11F_success;
+}
+
+R11F_EXPORT void r11f_stack_free(r11f_stack_t *stack) {
+    if (!stack->base) {
+        return;
+    }
+#ifndef WIN32
+    munmap(stack->base, (size_t)(stack->limit - stack->base));
+#else
+    r11f_free(stack->base);
+#endif
+    stack->base = NULL;
+    stack->top = NULL;
+    stack->frames = NULL;
+    stack->limit = NULL;
+}
+
+R11F_EXPORT r11f_frame_t* r11f_frame_push(r11f_stack_t *stack,
+                                          r11f_linked_method_t *method,
+                                          r11f_value_t *args) {
+    assert(!args || (args >= (r11f_value_t*)stack->base && args <= stack->top));
+
+    r11f_value_t *data = args ? args : stack->top;
+    r11f_value_t *end = data + method->max_locals + method->max_stack;
+    r11f_frame_t *frame = stack->frames - 1;
+    if (end > (r11f_value_t*)frame) {
         return NULL;
     }
 
     frame->parent = NULL;
-    frame->clazz = clazz;
-    frame->method_info = method_info;
+    frame->clazz = method->clazz;
+    frame->method_info = method->method_info;
     frame->pc = 0;
-    frame->code_length = code_length;
-    frame->code = code;
-    frame->max_locals = max_locals;
-    frame->max_stack = max_stack;
+    frame->code_length = method->code_length;
+    frame->code = method->code;
+    frame->max_locals = method->max_locals;
+    frame->max_stack = method->max_stack;
     frame->sp = 0;
+    frame->regir = NULL;
+    frame->jit = NULL;
 
-    frame->stack = (r11f_value_t*)(frame->data);
-    frame->locals = (r11f_value_t*)(frame->data + max_stack);
+    frame->data = data;
+    frame->locals = data;
+    frame->stack = data + method->max_locals;
+    frame->saved_top = stack->top;
+
+    /* whatever the caller has past its arguments is dead */
+    stack->frames = frame;
+    if (end > stack->top) {
+        stack->top = end;
+    }
     return frame;
 }
+
+R11F_EXPORT void r11f_frame_pop(r11f_stack_t *stack, r11f_frame_t *frame) {
+    assert(frame >= stack->frames && (uint8_t*)frame < stack->limit);
+    stack->frames = frame + 1;
+    stack->top = frame->saved_top;
+}
+
+R11F_EXPORT r11f_error_t r11f_stack_detach(r11f_stack_t *stack,
+                                           r11f_continuation_t *output) {
+    size_t values_size = (size_t)((uint8_t*)stack->top - stack->base);
+    size_t frames_size = (size_t)(stack->limit - (uint8_t*)stack->frames);
+    uint8_t *bytes = r11f_alloc(values_size + frames_size);
+    if (!bytes) {
+        return R11F_ERR_out_of_memory;
+    }
+    memcpy(bytes, stack->base, values_size);
+    memcpy(bytes + values_size, stack->frames, frames_size);
+
+    *output = (r11f_continuation_t) {
+        .bytes = bytes,
+        .values_size = values_size,
+        .frames_size = frames_size,
+        .base = stack->base,
+        .limit = stack->limit
+    };
+    stack->top = (r11f_value_t*)stack->base;
+    stack->frames = (r11f_frame_t*)stack->limit;
+    return R11F_success;
+}
+
+R11F_EXPORT r11f_frame_t* r11f_stack_attach(r11f_stack_t *stack,
+                                            r11f_continuation_t *cont) {
+    assert(stack->top == (r11f_value_t*)stack->base);
+    assert(stack->frames == (r11f_frame_t*)stack->limit);
+    if (cont->values_size + cont->frames_size
+        > (size_t)(stack->limit - stack->base)) {
+        return NULL;
+    }
+
+    memcpy(stack->base, cont->bytes, cont->values_size);
+    stack->top = (r11f_value_t*)(stack->base + cont->values_size);
+    stack->frames = (r11f_frame_t*)(stack->limit - cont->frames_size);
+    memcpy(stack->frames, cont->bytes + cont->values_size, cont->frames_size);
+
+    /* frames point at their values and at their parent header, which
+       moved by as much as the stack's two ends did */
+    uintptr_t values_delta = (uintptr_t)stack->base - (uintptr_t)cont->base;
+    uintptr_t frames_delta = (uintptr_t)stack->limit - (uintptr_t)cont->limit;
+    size_t count = cont->frames_size / sizeof(r11f_frame_t);
+    for (size_t i = 0; i < count; i++) {
+        r11f_frame_t *frame = &stack->frames[i];
+        if (frame->parent) {
+            frame->parent = (r11f_frame_t*)
+                ((uintptr_t)frame->parent + frames_delta);
+        }
+        frame->data = (r11f_value_t*)((uintptr_t)frame->data + values_delta);
+        frame->locals =
+            (r11f_value_t*)((uintptr_t)frame->locals + values_delta);
+        frame->stack =
+            (r11f_value_t*)((uintptr_t)frame->stack + values_delta);
+        frame->saved_top =
+            (r11f_value_t*)((uintptr_t)frame->saved_top + values_delta);
+    }
+
+    r11f_free(cont->bytes);
+    cont->bytes = NULL;
+    return count ? stack->frames : NULL;
+}
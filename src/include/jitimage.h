@@ -0,0 +1,88 @@
+#ifndef R11F_INTERNAL_JITIMAGE_H
+#define R11F_INTERNAL_JITIMAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "defs.h"
+#include "error.h"
+#include "forward.h"
+
+/* absolute addresses baseline code loads with movabs, patched in once
+   the code is placed */
+enum {
+    R11F_JIT_RELOC_SWITCH = 0,         /* &jit->switches[index] */
+    R11F_JIT_RELOC_CALLSITE = 1,       /* &jit->callsites[index] */
+    R11F_JIT_RELOC_SWITCH_LOOKUP = 2,  /* r11f_switch_lookup */
+    R11F_JIT_RELOC_JIT_INVOKE = 3,     /* r11f_vm_jit_invoke */
+    R11F_JIT_RELOC_NEW_ARRAY = 4,      /* r11f_vm_new_array */
+    R11F_JIT_RELOC_NATIVEFN = 5,       /* r11f_nativefn_call */
+    R11F_JIT_RELOC_ATHROW = 6,         /* r11f_vm_athrow */
+};
+
+/* the 8-byte immediate at code offset `at` */
+typedef struct {
+    uint32_t at;
+    uint32_t index;
+    uint32_t kind;
+} r11f_jit_reloc_t;
+
+/* baseline code of a method before it is placed in the code cache,
+   position independent except for `relocs`. offsets[i] is where register
+   IR instruction i starts, osr[i] the entry for regir->loops[i] */
+typedef struct {
+    uint8_t *code;
+    uint32_t code_size;
+    uint32_t insn_count;
+    uint32_t *offsets;
+    uint32_t reloc_count;
+    r11f_jit_reloc_t *relocs;
+    uint32_t osr_count;
+    uint32_t *osr;
+} r11f_jit_image_t;
+
+R11F_INTERNAL r11f_error_t
+r11f_jit_compile_image(r11f_linked_method_t *method,
+                       r11f_jit_image_t *output);
+/* `image` has to be compiled from the same register IR, its counts are
+   trusted as they are */
+R11F_INTERNAL r11f_error_t
+r11f_jit_load_image(r11f_linked_method_t *method,
+                    r11f_jit_image_t const *image,
+                    r11f_jit_code_t **output);
+R11F_INTERNAL void r11f_jit_image_free(r11f_jit_image_t *image);
+
+/* serialized image, shared by the code cache on disk and AOT modules:
+   this header, then the code, offsets, relocations and OSR entries, each
+   padded to 8 bytes. The build id pins the layout, so everything is
+   stored as it is in memory */
+typedef struct {
+    char magic[8];
+    uint64_t content_hash;
+    uint64_t build_id;
+    uint32_t method_index;
+    uint32_t code_size;
+    uint32_t insn_count;
+    uint32_t reloc_count;
+    uint32_t osr_count;
+    uint32_t reserved;
+} r11f_jit_record_t;
+
+/* the header of a record for `method` with the sizes left zero, false
+   if the method has no key: unknown content hash or no build id */
+R11F_INTERNAL bool r11f_jit_record_key(r11f_linked_method_t *method,
+                                       r11f_jit_record_t *output);
+R11F_INTERNAL bool r11f_jit_record_write(FILE *file,
+                                         r11f_jit_record_t const *key,
+                                         r11f_jit_image_t const *image);
+/* checks that `data` holds a sound record for `key` and the register IR
+   of `method`; the image then points into `data` and is not freed */
+R11F_INTERNAL bool r11f_jit_record_read(uint8_t const *data,
+                                        size_t size,
+                                        r11f_jit_record_t const *key,
+                                        r11f_linked_method_t *method,
+                                        r11f_jit_image_t *output);
+
+#endif /* R11F_INTERNAL_JITIMAGE_H */
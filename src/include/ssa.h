@@ -0,0 +1,230 @@
+#ifndef R11F_INTERNAL_SSA_H
+#define R11F_INTERNAL_SSA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "defs.h"
+#include "error.h"
+#include "forward.h"
+#include "jit.h"
+#include "trace.h"
+#include "vm.h"
+
+/*
+ * SSA form used by the optimizing compiler (opt.c builds and optimizes
+ * it, ssagen.c turns it into machine code). Values and blocks are
+ * referred to by index. Integer values are kept sign extended to 64 bits
+ * in constants, only their low 32 bits are meaningful otherwise.
+ *
+ * Phis sit at the front of their block and have one argument per
+ * predecessor, in the order of `preds`. A value replaced by another one
+ * during optimization keeps existing with `forward` set, uses get
+ * redirected lazily through r11f_ssa_resolve.
+ */
+
+#define R11F_SSA_NONE UINT32_MAX
+
+enum {
+#define SSA_OP(CODE) R11F_SSA_##CODE,
+#include "ssainc.h"
+};
+
+enum {
+    R11F_SSA_JUMP = 0,
+    R11F_SSA_BRANCH = 1,
+    R11F_SSA_RETURN = 2,
+    /* ends a block whose exit value has left already */
+    R11F_SSA_EXIT = 3,
+};
+
+/* branch conditions, in the order of ifeq...ifle */
+enum {
+    R11F_SSA_EQ = 0,
+    R11F_SSA_NE = 1,
+    R11F_SSA_LT = 2,
+    R11F_SSA_GE = 3,
+    R11F_SSA_GT = 4,
+    R11F_SSA_LE = 5,
+};
+
+typedef struct {
+    uint16_t op;
+    bool dead;
+    uint32_t block;
+    uint32_t forward;
+
+    uint32_t argc;
+    uint32_t *args;
+    /* constant value, frame value of a param (locals first, the operand
+       stack after them), methodref index of a call, point index of a
+       deopt */
+    int64_t imm;
+
+    /* calls only, the receiver of a virtual call is args[0] */
+    r11f_class_t *caller;
+    bool has_result;
+    bool is_virtual;
+} r11f_ssa_value_t;
+
+typedef struct {
+    uint32_t *values;
+    uint32_t value_count;
+    uint32_t value_capacity;
+
+    uint32_t *preds;
+    uint32_t pred_count;
+    uint32_t pred_capacity;
+
+    uint8_t term;
+    uint8_t cond;
+    /* compared operands of a branch, args[0] is the returned value */
+    uint32_t term_args[2];
+    /* succs[0] is taken when the branch condition holds */
+    uint32_t succs[2];
+    bool returns_value;
+    /* the branch compares all 64 bits, references against null */
+    bool wide;
+} r11f_ssa_block_t;
+
+/* frame state at the entry of a loop header `block`, for checks moved
+   ahead of the loop to leave through; laid out like a deopt point, the
+   header's phis stand for the values the loop is entered with */
+typedef struct {
+    uint32_t block;
+    uint32_t frame_count;
+    r11f_deopt_frame_t *frames;
+    uint32_t argc;
+    uint32_t *args;
+} r11f_ssa_loop_t;
+
+/* instructions of a vectorized loop on SIMD registers 0 - 14, register
+   15 is scratch. Loads, stores and broadcasts take argument `a` of the
+   vloop value, shifts count `imm` bits */
+enum {
+    R11F_VEC_BCAST = 0,
+    /* the loop index plus the lane number */
+    R11F_VEC_IOTA = 1,
+    R11F_VEC_ZERO = 2,
+    R11F_VEC_LOAD = 3,
+    /* register b to the elements of array a */
+    R11F_VEC_STORE = 4,
+    R11F_VEC_ADD = 5,
+    R11F_VEC_SUB = 6,
+    R11F_VEC_MUL = 7,
+    R11F_VEC_AND = 8,
+    R11F_VEC_OR = 9,
+    R11F_VEC_XOR = 10,
+    R11F_VEC_SHL = 11,
+    R11F_VEC_SHR = 12,
+    R11F_VEC_USHR = 13,
+};
+
+typedef struct {
+    uint8_t op;
+    uint8_t dst;
+    uint8_t a;
+    uint8_t b;
+    uint8_t imm;
+} r11f_ssa_vinsn_t;
+
+/* the lanes of register `reg` plus argument `init` are the result of
+   vreduce value `value` */
+typedef struct {
+    uint32_t value;
+    uint8_t reg;
+    uint8_t init;
+} r11f_ssa_reduce_t;
+
+/* SIMD version of a counted loop over int[] elements. Its vloop value
+   runs `setup_count` instructions once, then the rest for as long as a
+   whole vector of indices from args[0] on stays below args[1], and
+   yields the index it stopped at; the scalar loop does the remainder */
+typedef struct {
+    r11f_ssa_vinsn_t *insns;
+    uint32_t insn_count;
+    uint32_t setup_count;
+    /* lanes of the index, R11F_VEC_NO_REG if the body does not use it,
+       and the register they step by each vector */
+    uint8_t iv_reg;
+    uint8_t step_reg;
+    r11f_ssa_reduce_t *reduces;
+    uint32_t reduce_count;
+} r11f_ssa_vloop_t;
+
+#define R11F_VEC_NO_REG 0xff
+#define R11F_VEC_REGS 15
+
+typedef struct {
+    r11f_ssa_value_t *values;
+    uint32_t value_count;
+    uint32_t value_capacity;
+
+    r11f_ssa_block_t *blocks;
+    uint32_t block_count;
+    uint32_t block_capacity;
+
+    r11f_linked_method_t *method;
+    uint32_t inlined_count;
+    uint32_t replaced_count;
+    bool oom;
+
+    /* frame states of the deopt values, which take the values of all
+       their frames as arguments, see vm->deopt_stress */
+    r11f_deopt_point_t *deopt_points;
+    uint32_t deopt_count;
+    uint32_t deopt_capacity;
+    bool deopt_stress;
+
+    r11f_ssa_loop_t *loops;
+    uint32_t loop_count;
+    uint32_t loop_capacity;
+
+    /* R11F_SIMD_* level loops get vectorized for */
+    uint8_t simd;
+    r11f_ssa_vloop_t *vloops;
+    uint32_t vloop_count;
+    uint32_t vloop_capacity;
+
+    /* class hierarchy assumptions of devirtualized calls */
+    r11f_cha_dependency_t *dependencies;
+    uint32_t dependency_count;
+    uint32_t dependency_capacity;
+
+    /* everything above lives here, freed at once by r11f_ssa_cleanup */
+    void *arena;
+} r11f_ssa_t;
+
+/* with osr_pc other than R11F_SSA_NONE the method is entered at that
+   loop header instead, every register loaded from the frame */
+R11F_INTERNAL r11f_error_t r11f_ssa_build(r11f_vm_t *vm,
+                                          r11f_linked_method_t *method,
+                                          uint32_t osr_pc,
+                                          r11f_ssa_t *ssa);
+/* the loop of a recorded trace, see trace.h: entered at register IR
+   instruction `header` of `method` with every register loaded from the
+   frame, it follows `events` back to the header. Branches become guards
+   leaving through exit values, loop invariant values and guards go
+   ahead of the loop */
+R11F_INTERNAL r11f_error_t
+r11f_ssa_build_trace(r11f_linked_method_t *method,
+                     uint32_t header,
+                     r11f_trace_event_t const *events,
+                     uint32_t event_count,
+                     r11f_ssa_t *ssa);
+R11F_INTERNAL void r11f_ssa_optimize(r11f_ssa_t *ssa);
+R11F_INTERNAL void r11f_ssa_cleanup(r11f_ssa_t *ssa);
+
+R11F_INTERNAL uint32_t r11f_ssa_resolve(r11f_ssa_t *ssa, uint32_t value);
+R11F_INTERNAL uint32_t r11f_ssa_succ_count(r11f_ssa_block_t *block);
+R11F_INTERNAL uint32_t r11f_ssa_new_block(r11f_ssa_t *ssa);
+R11F_INTERNAL void r11f_ssa_add_pred(r11f_ssa_t *ssa,
+                                     uint32_t block,
+                                     uint32_t pred);
+
+R11F_INTERNAL r11f_error_t r11f_ssa_codegen(r11f_ssa_t *ssa,
+                                            r11f_jit_code_t **output);
+/* the widest R11F_SIMD_* level codegen can use on this CPU */
+R11F_INTERNAL uint8_t r11f_ssa_simd_level(void);
+
+#endif /* R11F_INTERNAL_SSA_H */
@@ -0,0 +1,77 @@
+/*
+ * Operations of the SSA IR, see ssa.h. Arithmetic ops take their operands
+ * in args[0] and args[1] and share their semantics with the register IR
+ * ops of the same name; immediate forms do not exist, constants are
+ * values of their own.
+ *
+ * deopt leaves to the interpreter when its code has been invalidated,
+ * see r11f_deopt_point_t, exit leaves there unconditionally (the side
+ * exits of traces, see trace.h), nullchk fails with R11F_ERR_null_pointer
+ * when args[0] is null; all of them stay ahead of the arithmetic ops.
+ *
+ * Array accesses come apart into their checks and the access itself:
+ * boundschk fails with R11F_ERR_array_index_out_of_bounds unless args[0]
+ * lies in [0, args[1]), alength, iaload and iastore (array, index, value)
+ * trust their operands. newarray calls out like a call does.
+ *
+ * intrinsic computes nativefn `imm` of its arguments, see nativefn.h;
+ * pure like the arithmetic ops it follows.
+ *
+ * vloop runs the SIMD version of a loop, see r11f_ssa_vloop_t; the
+ * vreduce values following it are the sums it reduced.
+ */
+
+#ifndef SSA_OP
+#define SSA_OP(CODE)
+#endif
+
+SSA_OP(const)
+SSA_OP(param)
+SSA_OP(phi)
+SSA_OP(call)
+SSA_OP(deopt)
+SSA_OP(exit)
+SSA_OP(nullchk)
+SSA_OP(boundschk)
+SSA_OP(newarray)
+SSA_OP(alength)
+SSA_OP(iaload)
+SSA_OP(iastore)
+SSA_OP(vloop)
+SSA_OP(vreduce)
+
+SSA_OP(iadd)
+SSA_OP(isub)
+SSA_OP(imul)
+SSA_OP(idiv)
+SSA_OP(irem)
+SSA_OP(ineg)
+SSA_OP(ishl)
+SSA_OP(ishr)
+SSA_OP(iushr)
+SSA_OP(iand)
+SSA_OP(ior)
+SSA_OP(ixor)
+
+SSA_OP(ladd)
+SSA_OP(lsub)
+SSA_OP(lmul)
+SSA_OP(ldiv)
+SSA_OP(lrem)
+SSA_OP(lneg)
+SSA_OP(lshl)
+SSA_OP(lshr)
+SSA_OP(lushr)
+SSA_OP(land)
+SSA_OP(lor)
+SSA_OP(lxor)
+
+SSA_OP(i2l)
+SSA_OP(l2i)
+SSA_OP(i2b)
+SSA_OP(i2c)
+SSA_OP(i2s)
+SSA_OP(lcmp)
+SSA_OP(intrinsic)
+
+#undef SSA_OP
@@ -0,0 +1,9 @@
+#ifndef R11F_INTERNAL_TOS_H
+#define R11F_INTERNAL_TOS_H
+
+#include "defs.h"
+#include "forward.h"
+
+R11F_INTERNAL void r11f_tos_execute(r11f_frame_t *frame);
+
+#endif /* R11F_INTERNAL_TOS_H */
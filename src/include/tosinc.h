@@ -0,0 +1,191 @@
+/*
+ * Bytecodes handled by the stack caching interpreter, see tos.c. Each
+ * entry describes an instruction by its stack effect only; tos.c expands
+ * this list once per cache state to get the specialised handlers.
+ *
+ *   TOS_PUSH(CODE, LENGTH, VALUE)      push VALUE
+ *   TOS_POP(CODE, LENGTH, STMT)        pop `v`, then run STMT
+ *   TOS_DUP(CODE)                      push a copy of the top value
+ *   TOS_UNOP(CODE, EXPR)               replace the top value `a` by EXPR
+ *   TOS_CHKUNOP(CODE, FAIL, EXPR)      like TOS_UNOP but bails out to the
+ *                                      generic interpreter when FAIL holds
+ *   TOS_BINOP(CODE, EXPR)              pop `b` and `a`, push EXPR
+ *   TOS_CHKBINOP(CODE, FAIL, EXPR)     like TOS_BINOP, bailing out the same
+ *   TOS_POP3(CODE, FAIL, STMT)         pop `c`, `b` and `a`, then run STMT,
+ *                                      bailing out first when FAIL holds
+ *   TOS_IF1(CODE, COND)                pop `a`, branch if COND
+ *   TOS_IF2(CODE, COND)                pop `b` and `a`, branch if COND
+ *   TOS_JUMP1(CODE, TARGET)            pop `a`, continue at TARGET
+ *   TOS_NOSTACK(CODE, STMT)            does not touch the operand stack,
+ *                                      STMT updates pc itself
+ */
+
+#ifndef TOS_PUSH
+#define TOS_PUSH(CODE, LENGTH, VALUE)
+#endif
+#ifndef TOS_POP
+#define TOS_POP(CODE, LENGTH, STMT)
+#endif
+#ifndef TOS_DUP
+#define TOS_DUP(CODE)
+#endif
+#ifndef TOS_UNOP
+#define TOS_UNOP(CODE, EXPR)
+#endif
+#ifndef TOS_BINOP
+#define TOS_BINOP(CODE, EXPR)
+#endif
+#ifndef TOS_CHKUNOP
+#define TOS_CHKUNOP(CODE, FAIL, EXPR)
+#endif
+#ifndef TOS_CHKBINOP
+#define TOS_CHKBINOP(CODE, FAIL, EXPR)
+#endif
+#ifndef TOS_POP3
+#define TOS_POP3(CODE, FAIL, STMT)
+#endif
+#ifndef TOS_IF1
+#define TOS_IF1(CODE, COND)
+#endif
+#ifndef TOS_IF2
+#define TOS_IF2(CODE, COND)
+#endif
+#ifndef TOS_JUMP1
+#define TOS_JUMP1(CODE, TARGET)
+#endif
+#ifndef TOS_NOSTACK
+#define TOS_NOSTACK(CODE, STMT)
+#endif
+
+#define TOS_I32(X) ((r11f_value_t) { .i32 = (X) })
+#define TOS_I64(X) ((r11f_value_t) { .i64 = (X) })
+#define TOS_ARRAY(X) ((r11f_array_t*)(X).ptr)
+
+TOS_PUSH(aconst_null, 1, ((r11f_value_t) { .ptr = NULL }))
+TOS_PUSH(iconst_m1, 1, TOS_I32(-1))
+TOS_PUSH(iconst_0, 1, TOS_I32(0))
+TOS_PUSH(iconst_1, 1, TOS_I32(1))
+TOS_PUSH(iconst_2, 1, TOS_I32(2))
+TOS_PUSH(iconst_3, 1, TOS_I32(3))
+TOS_PUSH(iconst_4, 1, TOS_I32(4))
+TOS_PUSH(iconst_5, 1, TOS_I32(5))
+TOS_PUSH(lconst_0, 1, TOS_I64(0))
+TOS_PUSH(lconst_1, 1, TOS_I64(1))
+TOS_PUSH(bipush, 2, TOS_I32((int8_t)code[pc + 1]))
+TOS_PUSH(sipush, 3, TOS_I32((int16_t)read_unaligned_be2(code + pc + 1)))
+TOS_PUSH(ldc2_w, 3, tos_ldc2_w(frame, code + pc + 1))
+
+TOS_PUSH(iload_0, 1, locals[0])
+TOS_PUSH(iload_1, 1, locals[1])
+TOS_PUSH(iload_2, 1, locals[2])
+TOS_PUSH(iload_3, 1, locals[3])
+TOS_PUSH(lload_0, 1, locals[0])
+TOS_PUSH(lload_1, 1, locals[1])
+TOS_PUSH(lload_2, 1, locals[2])
+TOS_PUSH(lload_3, 1, locals[3])
+TOS_PUSH(aload_0, 1, locals[0])
+TOS_PUSH(aload_1, 1, locals[1])
+TOS_PUSH(aload_2, 1, locals[2])
+TOS_PUSH(aload_3, 1, locals[3])
+TOS_PUSH(iload, 2, locals[code[pc + 1]])
+TOS_PUSH(lload, 2, locals[code[pc + 1]])
+TOS_PUSH(aload, 2, locals[code[pc + 1]])
+
+TOS_POP(istore_0, 1, locals[0] = v)
+TOS_POP(istore_1, 1, locals[1] = v)
+TOS_POP(istore_2, 1, locals[2] = v)
+TOS_POP(istore_3, 1, locals[3] = v)
+TOS_POP(lstore_0, 1, locals[0] = v)
+TOS_POP(lstore_1, 1, locals[1] = v)
+TOS_POP(lstore_2, 1, locals[2] = v)
+TOS_POP(lstore_3, 1, locals[3] = v)
+TOS_POP(astore_0, 1, locals[0] = v)
+TOS_POP(astore_1, 1, locals[1] = v)
+TOS_POP(astore_2, 1, locals[2] = v)
+TOS_POP(astore_3, 1, locals[3] = v)
+TOS_POP(istore, 2, locals[code[pc + 1]] = v)
+TOS_POP(lstore, 2, locals[code[pc + 1]] = v)
+TOS_POP(astore, 2, locals[code[pc + 1]] = v)
+TOS_POP(pop, 1, (void)v)
+TOS_DUP(dup)
+
+TOS_BINOP(iadd, TOS_I32((int32_t)((uint32_t)a.i32 + (uint32_t)b.i32)))
+TOS_BINOP(isub, TOS_I32((int32_t)((uint32_t)a.i32 - (uint32_t)b.i32)))
+TOS_BINOP(imul, TOS_I32((int32_t)((uint32_t)a.i32 * (uint32_t)b.i32)))
+TOS_BINOP(ishl, TOS_I32((int32_t)((uint32_t)a.i32 << (b.i32 & 31))))
+TOS_BINOP(ishr, TOS_I32(a.i32 >> (b.i32 & 31)))
+TOS_BINOP(iushr, TOS_I32((int32_t)((uint32_t)a.i32 >> (b.i32 & 31))))
+TOS_BINOP(iand, TOS_I32(a.i32 & b.i32))
+TOS_BINOP(ior, TOS_I32(a.i32 | b.i32))
+TOS_BINOP(ixor, TOS_I32(a.i32 ^ b.i32))
+TOS_BINOP(ladd, TOS_I64((int64_t)((uint64_t)a.i64 + (uint64_t)b.i64)))
+TOS_BINOP(lsub, TOS_I64((int64_t)((uint64_t)a.i64 - (uint64_t)b.i64)))
+TOS_BINOP(lmul, TOS_I64((int64_t)((uint64_t)a.i64 * (uint64_t)b.i64)))
+TOS_BINOP(lshl, TOS_I64((int64_t)((uint64_t)a.i64 << (b.i32 & 63))))
+TOS_BINOP(lshr, TOS_I64(a.i64 >> (b.i32 & 63)))
+TOS_BINOP(lushr, TOS_I64((int64_t)((uint64_t)a.i64 >> (b.i32 & 63))))
+TOS_BINOP(land, TOS_I64(a.i64 & b.i64))
+TOS_BINOP(lor, TOS_I64(a.i64 | b.i64))
+TOS_BINOP(lxor, TOS_I64(a.i64 ^ b.i64))
+TOS_BINOP(lcmp, TOS_I32((a.i64 > b.i64) - (a.i64 < b.i64)))
+
+TOS_CHKBINOP(idiv, b.i32 == 0, TOS_I32(b.i32 == -1 ?
+                                       (int32_t)(0u - (uint32_t)a.i32) :
+                                       a.i32 / b.i32))
+TOS_CHKBINOP(irem, b.i32 == 0, TOS_I32(b.i32 == -1 ? 0 : a.i32 % b.i32))
+TOS_CHKBINOP(ldiv, b.i64 == 0, TOS_I64(b.i64 == -1 ?
+                                       (int64_t)(0ull - (uint64_t)a.i64) :
+                                       a.i64 / b.i64))
+TOS_CHKBINOP(lrem, b.i64 == 0, TOS_I64(b.i64 == -1 ? 0 : a.i64 % b.i64))
+
+TOS_CHKUNOP(arraylength, !a.ptr, TOS_I32(TOS_ARRAY(a)->length))
+TOS_CHKBINOP(iaload, tos_bad_index(a, b),
+             TOS_I32(TOS_ARRAY(a)->data[b.i32]))
+TOS_POP3(iastore, tos_bad_index(a, b), TOS_ARRAY(a)->data[b.i32] = c.i32)
+
+TOS_UNOP(ineg, TOS_I32((int32_t)(0u - (uint32_t)a.i32)))
+TOS_UNOP(lneg, TOS_I64((int64_t)(0ull - (uint64_t)a.i64)))
+TOS_UNOP(i2l, TOS_I64(a.i32))
+TOS_UNOP(l2i, TOS_I32((int32_t)a.i64))
+TOS_UNOP(i2b, TOS_I32((int8_t)a.i32))
+TOS_UNOP(i2c, TOS_I32((uint16_t)a.i32))
+TOS_UNOP(i2s, TOS_I32((int16_t)a.i32))
+
+TOS_IF1(ifeq, a.i32 == 0)
+TOS_IF1(ifne, a.i32 != 0)
+TOS_IF1(iflt, a.i32 < 0)
+TOS_IF1(ifge, a.i32 >= 0)
+TOS_IF1(ifgt, a.i32 > 0)
+TOS_IF1(ifle, a.i32 <= 0)
+TOS_IF2(if_icmpeq, a.i32 == b.i32)
+TOS_IF2(if_icmpne, a.i32 != b.i32)
+TOS_IF2(if_icmplt, a.i32 < b.i32)
+TOS_IF2(if_icmpge, a.i32 >= b.i32)
+TOS_IF2(if_icmpgt, a.i32 > b.i32)
+TOS_IF2(if_icmple, a.i32 <= b.i32)
+
+TOS_NOSTACK(nop, pc += 1)
+TOS_JUMP1(tableswitch, tos_switch(frame, pc, a.i32))
+TOS_JUMP1(lookupswitch, tos_switch(frame, pc, a.i32))
+TOS_NOSTACK(goto, pc += (int16_t)read_unaligned_be2(code + pc + 1))
+TOS_NOSTACK(iinc, locals[code[pc + 1]].i32 =
+                      (int32_t)((uint32_t)locals[code[pc + 1]].i32
+                                + (uint32_t)(int8_t)code[pc + 2]);
+                  pc += 3)
+
+#undef TOS_I32
+#undef TOS_I64
+#undef TOS_ARRAY
+
+#undef TOS_PUSH
+#undef TOS_POP
+#undef TOS_DUP
+#undef TOS_UNOP
+#undef TOS_BINOP
+#undef TOS_CHKUNOP
+#undef TOS_CHKBINOP
+#undef TOS_POP3
+#undef TOS_IF1
+#undef TOS_IF2
+#undef TOS_JUMP1
+#undef TOS_NOSTACK
@@ -0,0 +1,998 @@
+#include "jit.h"
+
+#include <stddef.h>
+#include <string.h>
+#include "alloc.h"
+#include "class.h"
+#include "class/cpool.h"
+#include "codecache.h"
+#include "jitimage.h"
+#include "link.h"
+#include "nativefn.h"
+#include "object.h"
+#include "regir.h"
+
+#if defined(__x86_64__) && !defined(WIN32)
+
+/*
+ * Baseline template compiler. Each register IR instruction expands to a
+ * fixed machine code sequence working on the frame slots:
+ *
+ *   rbx  frame->data, register n lives at [rbx + n * 8]
+ *   r12  vm
+ *   r13  frame
+ *   r14  result pointer
+ *
+ * All four are callee saved, so helper calls need no spilling. Together
+ * with r15 they are pushed by the prologue, which leaves the stack
+ * 16-byte aligned for those calls.
+ */
+
+enum {
+    RAX = 0,
+    RCX = 1,
+    RDX = 2,
+    RBX = 3,
+    RSI = 6,
+    RDI = 7
+};
+
+enum {
+    REX_W = 0x48
+};
+
+/* rel32 placeholders, patched once every instruction has an offset.
+   TARGET_STUB + n is the nth jit_stub_t */
+enum {
+    TARGET_EXIT = UINT32_MAX,
+    TARGET_DIV0 = UINT32_MAX - 1,
+    TARGET_NULL = UINT32_MAX - 2,
+    TARGET_BOUNDS = UINT32_MAX - 3,
+    TARGET_STUB = UINT32_C(1) << 31
+};
+
+typedef struct {
+    uint32_t at;
+    uint32_t target;
+} jit_fixup_t;
+
+/* out of line on the way to a failing exit: stores the instruction
+   index in frame->pc for the VM to find a handler, so code that does
+   not throw never does */
+typedef struct {
+    uint32_t insn;
+    uint32_t target;
+} jit_stub_t;
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+
+    jit_fixup_t *fixups;
+    uint32_t fixup_count;
+    uint32_t fixup_capacity;
+
+    r11f_jit_reloc_t *relocs;
+    uint32_t reloc_count;
+    uint32_t reloc_capacity;
+
+    jit_stub_t *stubs;
+    uint32_t stub_count;
+    uint32_t stub_capacity;
+    /* the instruction being emitted */
+    uint32_t insn;
+
+    bool oom;
+} jit_buf_t;
+
+/* jcc opcodes (second byte after 0x0f) for eq, ne, lt, ge, gt, le */
+static const uint8_t g_jcc[] = { 0x84, 0x85, 0x8c, 0x8d, 0x8f, 0x8e };
+
+static void emit_u8(jit_buf_t *buf, uint8_t value);
+static void emit_u32(jit_buf_t *buf, uint32_t value);
+static void emit_u64(jit_buf_t *buf, uint64_t value);
+static void emit_bytes(jit_buf_t *buf, uint8_t const *bytes, size_t count);
+static void emit_mem(jit_buf_t *buf,
+                     uint8_t rex,
+                     uint16_t opcode,
+                     uint8_t reg,
+                     uint16_t slot);
+static void emit_rel32(jit_buf_t *buf, uint32_t target);
+static void emit_throw_rel32(jit_buf_t *buf, uint32_t target);
+static void emit_movabs(jit_buf_t *buf, uint8_t reg, uint64_t value);
+static void emit_reloc(jit_buf_t *buf,
+                       uint8_t reg,
+                       uint32_t kind,
+                       uint32_t index);
+static void emit_insn(jit_buf_t *buf,
+                      r11f_regir_insn_t *insn,
+                      uint32_t *switch_index,
+                      uint32_t *callsite_index);
+static void emit_alu(jit_buf_t *buf,
+                     uint8_t rex,
+                     uint16_t opcode,
+                     r11f_regir_insn_t *insn);
+static void emit_alu_imm(jit_buf_t *buf,
+                         uint8_t rex,
+                         uint8_t digit,
+                         r11f_regir_insn_t *insn);
+static void emit_shift(jit_buf_t *buf,
+                       uint8_t rex,
+                       uint8_t digit,
+                       r11f_regir_insn_t *insn,
+                       bool immediate);
+static void emit_div(jit_buf_t *buf, uint8_t rex, r11f_regir_insn_t *insn,
+                     bool rem);
+static void emit_element(jit_buf_t *buf, r11f_regir_insn_t *insn);
+static void emit_error(jit_buf_t *buf, r11f_error_t error);
+static void emit_prologue(jit_buf_t *buf);
+static void init_callsite(r11f_linked_method_t *method,
+                          r11f_regir_insn_t *insn,
+                          r11f_jit_callsite_t *callsite);
+
+R11F_EXPORT r11f_error_t r11f_jit_compile(r11f_linked_method_t *method,
+                                          r11f_jit_code_t **output) {
+    r11f_jit_image_t image;
+    r11f_error_t err = r11f_jit_compile_image(method, &image);
+    if (err != R11F_success) {
+        return err;
+    }
+
+    err = r11f_jit_load_image(method, &image, output);
+    r11f_jit_image_free(&image);
+    return err;
+}
+
+R11F_INTERNAL r11f_error_t
+r11f_jit_compile_image(r11f_linked_method_t *method,
+                       r11f_jit_image_t *output) {
+    memset(output, 0, sizeof(r11f_jit_image_t));
+
+    r11f_regir_t *regir = method->regir;
+    if (!regir) {
+        return R11F_ERR_not_implemented_instruction;
+    }
+
+    uint32_t *offsets = r11f_alloc((regir->insn_count + 1) * sizeof(uint32_t));
+    uint32_t *osr = NULL;
+    if (regir->loop_count) {
+        osr = r11f_alloc(regir->loop_count * sizeof(uint32_t));
+    }
+    jit_buf_t buf = { 0 };
+    r11f_error_t err = R11F_success;
+    if (!offsets || (regir->loop_count && !osr)) {
+        err = R11F_ERR_out_of_memory;
+        goto cleanup;
+    }
+
+    emit_prologue(&buf);
+
+    uint32_t switch_index = 0;
+    uint32_t callsite_index = 0;
+    for (uint32_t i = 0; i < regir->insn_count; i++) {
+        offsets[i] = (uint32_t)buf.size;
+        buf.insn = i;
+        emit_insn(&buf, &regir->insns[i], &switch_index, &callsite_index);
+    }
+
+    /* stub n starts at stubs_offset + n * 13 */
+    uint32_t stubs_offset = (uint32_t)buf.size;
+    for (uint32_t i = 0; i < buf.stub_count; i++) {
+        /* mov dword [r13 + pc], insn; jmp target */
+        emit_bytes(&buf, (uint8_t[]){ 0x41, 0xc7, 0x45,
+                                      offsetof(r11f_frame_t, pc) }, 4);
+        emit_u32(&buf, buf.stubs[i].insn);
+        emit_u8(&buf, 0xe9);
+        emit_rel32(&buf, buf.stubs[i].target);
+    }
+
+    uint32_t null_offset = (uint32_t)buf.size;
+    emit_error(&buf, R11F_ERR_null_pointer);
+    uint32_t bounds_offset = (uint32_t)buf.size;
+    emit_error(&buf, R11F_ERR_array_index_out_of_bounds);
+
+    uint32_t div0_offset = (uint32_t)buf.size;
+    /* mov eax, R11F_ERR_division_by_zero; then fall into the exit */
+    emit_u8(&buf, 0xb8);
+    emit_u32(&buf, R11F_ERR_division_by_zero);
+
+    uint32_t exit_offset = (uint32_t)buf.size;
+    /* pop r15; pop r14; pop r13; pop r12; pop rbx; ret */
+    emit_bytes(&buf, (uint8_t[]){ 0x41, 0x5f, 0x41, 0x5e, 0x41, 0x5d,
+                                  0x41, 0x5c, 0x5b, 0xc3 }, 10);
+
+    /* registers live in the frame either way, so entering at a loop
+       header takes nothing but the prologue and a jump */
+    for (uint32_t i = 0; i < regir->loop_count; i++) {
+        osr[i] = (uint32_t)buf.size;
+        emit_prologue(&buf);
+        /* jmp rel32 */
+        emit_u8(&buf, 0xe9);
+        emit_rel32(&buf, regir->loops[i].insn);
+    }
+
+    if (buf.oom) {
+        err = R11F_ERR_out_of_memory;
+        goto cleanup;
+    }
+
+    for (uint32_t i = 0; i < buf.fixup_count; i++) {
+        jit_fixup_t *fixup = &buf.fixups[i];
+        uint32_t target = fixup->target == TARGET_EXIT ? exit_offset :
+            fixup->target == TARGET_DIV0 ? div0_offset :
+            fixup->target == TARGET_NULL ? null_offset :
+            fixup->target == TARGET_BOUNDS ? bounds_offset :
+            fixup->target >= TARGET_STUB ?
+                stubs_offset + (fixup->target - TARGET_STUB) * 13 :
+            offsets[fixup->target];
+        uint32_t rel = target - (fixup->at + 4);
+        memcpy(buf.data + fixup->at, &rel, 4);
+    }
+
+    output->code = buf.data;
+    output->code_size = (uint32_t)buf.size;
+    output->insn_count = regir->insn_count;
+    output->offsets = offsets;
+    output->reloc_count = buf.reloc_count;
+    output->relocs = buf.relocs;
+    output->osr_count = regir->loop_count;
+    output->osr = osr;
+    buf.data = NULL;
+    buf.relocs = NULL;
+    offsets = NULL;
+    osr = NULL;
+
+cleanup:
+    r11f_free(offsets);
+    r11f_free(osr);
+    r11f_free(buf.data);
+    r11f_free(buf.fixups);
+    r11f_free(buf.relocs);
+    r11f_free(buf.stubs);
+    return err;
+}
+
+R11F_INTERNAL r11f_error_t
+r11f_jit_load_image(r11f_linked_method_t *method,
+                    r11f_jit_image_t const *image,
+                    r11f_jit_code_t **output) {
+    r11f_regir_t *regir = method->regir;
+    uint32_t callsite_count = 0;
+    for (uint32_t i = 0; i < regir->insn_count; i++) {
+        if (regir->insns[i].op == R11F_RI_invokestatic
+            || regir->insns[i].op == R11F_RI_invokevirtual) {
+            callsite_count++;
+        }
+    }
+
+    r11f_jit_code_t *jit = r11f_alloc_zeroed(sizeof(r11f_jit_code_t));
+    r11f_error_t err = R11F_success;
+    if (!jit) {
+        return R11F_ERR_out_of_memory;
+    }
+
+    if (regir->switch_count) {
+        jit->switches =
+            r11f_alloc_zeroed(regir->switch_count * sizeof(r11f_switch_t*));
+    }
+    if (callsite_count) {
+        jit->callsites =
+            r11f_alloc_zeroed(callsite_count * sizeof(r11f_jit_callsite_t));
+    }
+    if (regir->loop_count) {
+        jit->osr = r11f_alloc(regir->loop_count * sizeof(r11f_jit_osr_t));
+    }
+    if ((regir->switch_count && !jit->switches)
+        || (callsite_count && !jit->callsites)
+        || (regir->loop_count && !jit->osr)) {
+        err = R11F_ERR_out_of_memory;
+        goto cleanup;
+    }
+
+    uint32_t callsite_index = 0;
+    for (uint32_t i = 0; i < regir->insn_count; i++) {
+        r11f_regir_insn_t *insn = &regir->insns[i];
+        if (insn->op == R11F_RI_invokestatic
+            || insn->op == R11F_RI_invokevirtual) {
+            init_callsite(method, insn, &jit->callsites[callsite_index++]);
+        }
+    }
+    jit->callsite_count = callsite_count;
+
+    for (uint32_t i = 0; i < regir->switch_count; i++) {
+        err = r11f_switch_remap(regir->switches[i],
+                                image->offsets,
+                                &jit->switches[i]);
+        if (err != R11F_success) {
+            goto cleanup;
+        }
+        jit->switch_count++;
+    }
+
+    void *writable;
+    uint8_t *code = r11f_codecache_alloc(image->code_size, &writable);
+    if (!code) {
+        err = R11F_ERR_out_of_memory;
+        goto cleanup;
+    }
+    memcpy(writable, image->code, image->code_size);
+    jit->entry = (r11f_jit_entry_t)code;
+    jit->code_size = image->code_size;
+
+    for (uint32_t i = 0; i < image->reloc_count; i++) {
+        r11f_jit_reloc_t *reloc = &image->relocs[i];
+        uint64_t value = 0;
+        switch (reloc->kind) {
+            case R11F_JIT_RELOC_SWITCH:
+                value = (uint64_t)&jit->switches[reloc->index];
+                break;
+            case R11F_JIT_RELOC_CALLSITE:
+                value = (uint64_t)&jit->callsites[reloc->index];
+                break;
+            case R11F_JIT_RELOC_SWITCH_LOOKUP:
+                value = (uint64_t)&r11f_switch_lookup;
+                break;
+            case R11F_JIT_RELOC_JIT_INVOKE:
+                value = (uint64_t)&r11f_vm_jit_invoke;
+                break;
+            case R11F_JIT_RELOC_NEW_ARRAY:
+                value = (uint64_t)&r11f_vm_new_array;
+                break;
+            case R11F_JIT_RELOC_NATIVEFN:
+                value = (uint64_t)&r11f_nativefn_call;
+                break;
+            case R11F_JIT_RELOC_ATHROW:
+                value = (uint64_t)&r11f_vm_athrow;
+                break;
+        }
+        memcpy((uint8_t*)writable + reloc->at, &value, 8);
+    }
+
+    for (uint32_t i = 0; i < regir->loop_count; i++) {
+        jit->osr[i].pc = regir->loops[i].pc;
+        jit->osr[i].entry = (r11f_jit_entry_t)(code + image->osr[i]);
+    }
+    jit->osr_count = regir->loop_count;
+
+    *output = jit;
+    jit = NULL;
+
+cleanup:
+    r11f_jit_free(jit);
+    return err;
+}
+
+R11F_INTERNAL void r11f_jit_image_free(r11f_jit_image_t *image) {
+    r11f_free(image->code);
+    r11f_free(image->offsets);
+    r11f_free(image->relocs);
+    r11f_free(image->osr);
+}
+
+static void emit_insn(jit_buf_t *buf,
+                      r11f_regir_insn_t *insn,
+                      uint32_t *switch_index,
+                      uint32_t *callsite_index) {
+    switch (insn->op) {
+        case R11F_RI_nop:
+        /* compiled code never parks */
+        case R11F_RI_yield:
+            break;
+
+        case R11F_RI_mov:
+            emit_mem(buf, REX_W, 0x8b, RAX, insn->a);
+            emit_mem(buf, REX_W, 0x89, RAX, insn->dst);
+            break;
+        case R11F_RI_movi:
+            if (insn->imm == (int32_t)insn->imm) {
+                /* mov qword [slot], simm32 */
+                emit_mem(buf, REX_W, 0xc7, 0, insn->dst);
+                emit_u32(buf, (uint32_t)insn->imm);
+            }
+            else {
+                emit_movabs(buf, RAX, (uint64_t)insn->imm);
+                emit_mem(buf, REX_W, 0x89, RAX, insn->dst);
+            }
+            break;
+
+        case R11F_RI_iadd: emit_alu(buf, 0, 0x03, insn); break;
+        case R11F_RI_isub: emit_alu(buf, 0, 0x2b, insn); break;
+        case R11F_RI_imul: emit_alu(buf, 0, 0x0faf, insn); break;
+        case R11F_RI_iand: emit_alu(buf, 0, 0x23, insn); break;
+        case R11F_RI_ior: emit_alu(buf, 0, 0x0b, insn); break;
+        case R11F_RI_ixor: emit_alu(buf, 0, 0x33, insn); break;
+        case R11F_RI_ladd: emit_alu(buf, REX_W, 0x03, insn); break;
+        case R11F_RI_lsub: emit_alu(buf, REX_W, 0x2b, insn); break;
+        case R11F_RI_lmul: emit_alu(buf, REX_W, 0x0faf, insn); break;
+        case R11F_RI_land: emit_alu(buf, REX_W, 0x23, insn); break;
+        case R11F_RI_lor: emit_alu(buf, REX_W, 0x0b, insn); break;
+        case R11F_RI_lxor: emit_alu(buf, REX_W, 0x33, insn); break;
+
+        case R11F_RI_iaddi: emit_alu_imm(buf, 0, 0, insn); break;
+        case R11F_RI_iori: emit_alu_imm(buf, 0, 1, insn); break;
+        case R11F_RI_iandi: emit_alu_imm(buf, 0, 4, insn); break;
+        case R11F_RI_ixori: emit_alu_imm(buf, 0, 6, insn); break;
+        case R11F_RI_imuli:
+            emit_mem(buf, 0, 0x8b, RAX, insn->a);
+            /* imul eax, eax, imm32 */
+            emit_bytes(buf, (uint8_t[]){ 0x69, 0xc0 }, 2);
+            emit_u32(buf, (uint32_t)insn->imm);
+            emit_mem(buf, 0, 0x89, RAX, insn->dst);
+            break;
+        case R11F_RI_laddi:
+            if (insn->imm == (int32_t)insn->imm) {
+                emit_alu_imm(buf, REX_W, 0, insn);
+            }
+            else {
+                emit_mem(buf, REX_W, 0x8b, RAX, insn->a);
+                emit_movabs(buf, RCX, (uint64_t)insn->imm);
+                /* add rax, rcx */
+                emit_bytes(buf, (uint8_t[]){ REX_W, 0x03, 0xc1 }, 3);
+                emit_mem(buf, REX_W, 0x89, RAX, insn->dst);
+            }
+            break;
+
+        case R11F_RI_ishl: emit_shift(buf, 0, 4, insn, false); break;
+        case R11F_RI_ishr: emit_shift(buf, 0, 7, insn, false); break;
+        case R11F_RI_iushr: emit_shift(buf, 0, 5, insn, false); break;
+        case R11F_RI_ishli: emit_shift(buf, 0, 4, insn, true); break;
+        case R11F_RI_ishri: emit_shift(buf, 0, 7, insn, true); break;
+        case R11F_RI_iushri: emit_shift(buf, 0, 5, insn, true); break;
+        case R11F_RI_lshl: emit_shift(buf, REX_W, 4, insn, false); break;
+        case R11F_RI_lshr: emit_shift(buf, REX_W, 7, insn, false); break;
+        case R11F_RI_lushr: emit_shift(buf, REX_W, 5, insn, false); break;
+
+        case R11F_RI_idiv: emit_div(buf, 0, insn, false); break;
+        case R11F_RI_irem: emit_div(buf, 0, insn, true); break;
+        case R11F_RI_ldiv: emit_div(buf, REX_W, insn, false); break;
+        case R11F_RI_lrem: emit_div(buf, REX_W, insn, true); break;
+
+        case R11F_RI_ineg:
+        case R11F_RI_lneg: {
+            uint8_t rex = insn->op == R11F_RI_lneg ? REX_W : 0;
+            emit_mem(buf, rex, 0x8b, RAX, insn->a);
+            /* neg eax */
+            if (rex) {
+                emit_u8(buf, rex);
+            }
+            emit_bytes(buf, (uint8_t[]){ 0xf7, 0xd8 }, 2);
+            emit_mem(buf, rex, 0x89, RAX, insn->dst);
+            break;
+        }
+
+        case R11F_RI_i2l:
+            /* movsxd rax, dword [slot] */
+            emit_mem(buf, REX_W, 0x63, RAX, insn->a);
+            emit_mem(buf, REX_W, 0x89, RAX, insn->dst);
+            break;
+        case R11F_RI_l2i:
+            emit_mem(buf, 0, 0x8b, RAX, insn->a);
+            emit_mem(buf, 0, 0x89, RAX, insn->dst);
+            break;
+        case R11F_RI_i2b:
+        case R11F_RI_i2c:
+        case R11F_RI_i2s: {
+            /* movsx eax, byte / movzx eax, word / movsx eax, word */
+            uint16_t opcode = insn->op == R11F_RI_i2b ? 0x0fbe :
+                insn->op == R11F_RI_i2c ? 0x0fb7 :
+                0x0fbf;
+            emit_mem(buf, 0, opcode, RAX, insn->a);
+            emit_mem(buf, 0, 0x89, RAX, insn->dst);
+            break;
+        }
+
+        case R11F_RI_lcmp:
+            emit_mem(buf, REX_W, 0x8b, RAX, insn->a);
+            emit_mem(buf, REX_W, 0x3b, RAX, insn->b);
+            /* setg al; setl cl; sub al, cl; movsx eax, al */
+            emit_bytes(buf, (uint8_t[]){ 0x0f, 0x9f, 0xc0, 0x0f, 0x9c, 0xc1,
+                                         0x28, 0xc8, 0x0f, 0xbe, 0xc0 }, 11);
+            emit_mem(buf, 0, 0x89, RAX, insn->dst);
+            break;
+
+        case R11F_RI_intrinsic:
+            /* mov edi, fn; lea rsi, [rbx + a * 8] */
+            emit_u8(buf, 0xb8 + RDI);
+            emit_u32(buf, (uint32_t)insn->imm);
+            emit_mem(buf, REX_W, 0x8d, RSI, insn->a);
+            emit_reloc(buf, RAX, R11F_JIT_RELOC_NATIVEFN, 0);
+            /* call rax */
+            emit_bytes(buf, (uint8_t[]){ 0xff, 0xd0 }, 2);
+            emit_mem(buf, REX_W, 0x89, RAX, insn->dst);
+            break;
+
+        case R11F_RI_newarray:
+            /* mov rdi, r12 */
+            emit_bytes(buf, (uint8_t[]){ 0x4c, 0x89, 0xe7 }, 3);
+            emit_mem(buf, 0, 0x8b, RSI, insn->a);
+            emit_mem(buf, REX_W, 0x8d, RDX, insn->dst);
+            emit_reloc(buf, RAX, R11F_JIT_RELOC_NEW_ARRAY, 0);
+            /* call rax; test eax, eax; jnz exit */
+            emit_bytes(buf, (uint8_t[]){ 0xff, 0xd0, 0x85, 0xc0, 0x0f, 0x85 },
+                       6);
+            emit_throw_rel32(buf, TARGET_EXIT);
+            break;
+        case R11F_RI_arraylength:
+            emit_mem(buf, REX_W, 0x8b, RAX, insn->a);
+            /* test rax, rax; jz null */
+            emit_bytes(buf, (uint8_t[]){ REX_W, 0x85, 0xc0, 0x0f, 0x84 }, 5);
+            emit_throw_rel32(buf, TARGET_NULL);
+            /* mov eax, [rax + length] */
+            emit_bytes(buf, (uint8_t[]){ 0x8b, 0x40,
+                                         offsetof(r11f_array_t, length) }, 3);
+            emit_mem(buf, 0, 0x89, RAX, insn->dst);
+            break;
+        case R11F_RI_iaload:
+            emit_element(buf, insn);
+            /* mov eax, [rax + rcx * 4 + data] */
+            emit_bytes(buf, (uint8_t[]){ 0x8b, 0x44, 0x88,
+                                         offsetof(r11f_array_t, data) }, 4);
+            emit_mem(buf, 0, 0x89, RAX, insn->dst);
+            break;
+        case R11F_RI_iastore:
+            emit_element(buf, insn);
+            emit_mem(buf, 0, 0x8b, RDX, insn->dst);
+            /* mov [rax + rcx * 4 + data], edx */
+            emit_bytes(buf, (uint8_t[]){ 0x89, 0x54, 0x88,
+                                         offsetof(r11f_array_t, data) }, 4);
+            break;
+
+        case R11F_RI_ifeq: case R11F_RI_ifne: case R11F_RI_iflt:
+        case R11F_RI_ifge: case R11F_RI_ifgt: case R11F_RI_ifle:
+            /* cmp dword [slot], 0 */
+            emit_mem(buf, 0, 0x83, 7, insn->a);
+            emit_u8(buf, 0);
+            emit_bytes(buf, (uint8_t[]){ 0x0f, g_jcc[insn->op - R11F_RI_ifeq] },
+                       2);
+            emit_rel32(buf, insn->dst);
+            break;
+
+        case R11F_RI_if_icmpeq: case R11F_RI_if_icmpne:
+        case R11F_RI_if_icmplt: case R11F_RI_if_icmpge:
+        case R11F_RI_if_icmpgt: case R11F_RI_if_icmple:
+            emit_mem(buf, 0, 0x8b, RAX, insn->a);
+            emit_mem(buf, 0, 0x3b, RAX, insn->b);
+            emit_bytes(
+                buf,
+                (uint8_t[]){ 0x0f, g_jcc[insn->op - R11F_RI_if_icmpeq] },
+                2
+            );
+            emit_rel32(buf, insn->dst);
+            break;
+
+        case R11F_RI_if_icmpeqi: case R11F_RI_if_icmpnei:
+        case R11F_RI_if_icmplti: case R11F_RI_if_icmpgei:
+        case R11F_RI_if_icmpgti: case R11F_RI_if_icmplei:
+            /* cmp dword [slot], imm32 */
+            emit_mem(buf, 0, 0x81, 7, insn->a);
+            emit_u32(buf, (uint32_t)insn->imm);
+            emit_bytes(
+                buf,
+                (uint8_t[]){ 0x0f, g_jcc[insn->op - R11F_RI_if_icmpeqi] },
+                2
+            );
+            emit_rel32(buf, insn->dst);
+            break;
+
+        case R11F_RI_goto:
+            emit_u8(buf, 0xe9);
+            emit_rel32(buf, insn->dst);
+            break;
+
+        case R11F_RI_switch: {
+            /* rax = r11f_switch_lookup(switches[i], key), a code offset */
+            emit_reloc(buf, RAX, R11F_JIT_RELOC_SWITCH, *switch_index);
+            /* mov rdi, [rax] */
+            emit_bytes(buf, (uint8_t[]){ REX_W, 0x8b, 0x38 }, 3);
+            emit_mem(buf, 0, 0x8b, RSI, insn->a);
+            emit_reloc(buf, RAX, R11F_JIT_RELOC_SWITCH_LOOKUP, 0);
+            /* call rax */
+            emit_bytes(buf, (uint8_t[]){ 0xff, 0xd0 }, 2);
+            /* lea rcx, [rip - (code offset after this lea)] */
+            emit_bytes(buf, (uint8_t[]){ REX_W, 0x8d, 0x0d }, 3);
+            emit_u32(buf, (uint32_t)-(int32_t)(buf->size + 4));
+            /* add rax, rcx; jmp rax */
+            emit_bytes(buf, (uint8_t[]){ REX_W, 0x01, 0xc8, 0xff, 0xe0 }, 5);
+            (*switch_index)++;
+            break;
+        }
+
+        case R11F_RI_ireturn:
+        case R11F_RI_lreturn:
+            emit_mem(buf, REX_W, 0x8b, RAX, insn->a);
+            /* mov [r14], rax */
+            emit_bytes(buf, (uint8_t[]){ 0x49, 0x89, 0x06 }, 3);
+            /* fall through */
+        case R11F_RI_return:
+            /* xor eax, eax; jmp exit */
+            emit_bytes(buf, (uint8_t[]){ 0x31, 0xc0, 0xe9 }, 3);
+            emit_rel32(buf, TARGET_EXIT);
+            break;
+
+        case R11F_RI_athrow:
+            /* mov rdi, r12 */
+            emit_bytes(buf, (uint8_t[]){ 0x4c, 0x89, 0xe7 }, 3);
+            emit_mem(buf, REX_W, 0x8b, RSI, insn->a);
+            emit_reloc(buf, RAX, R11F_JIT_RELOC_ATHROW, 0);
+            /* call rax; jmp exit */
+            emit_bytes(buf, (uint8_t[]){ 0xff, 0xd0, 0xe9 }, 3);
+            emit_throw_rel32(buf, TARGET_EXIT);
+            break;
+
+        case R11F_RI_invokestatic:
+        case R11F_RI_invokevirtual:
+            /* mov rdi, r12 */
+            emit_bytes(buf, (uint8_t[]){ 0x4c, 0x89, 0xe7 }, 3);
+            emit_reloc(buf, RSI, R11F_JIT_RELOC_CALLSITE, *callsite_index);
+            /* lea rdx, [rbx + a * 8]; lea rcx, [rbx + dst * 8] */
+            emit_mem(buf, REX_W, 0x8d, RDX, insn->a);
+            emit_mem(buf, REX_W, 0x8d, RCX, insn->dst);
+            emit_reloc(buf, RAX, R11F_JIT_RELOC_JIT_INVOKE, 0);
+            /* call rax; test eax, eax; jnz exit */
+            emit_bytes(buf, (uint8_t[]){ 0xff, 0xd0, 0x85, 0xc0, 0x0f, 0x85 },
+                       6);
+            emit_throw_rel32(buf, TARGET_EXIT);
+            (*callsite_index)++;
+            break;
+    }
+}
+
+static void emit_alu(jit_buf_t *buf,
+                     uint8_t rex,
+                     uint16_t opcode,
+                     r11f_regir_insn_t *insn) {
+    emit_mem(buf, rex, 0x8b, RAX, insn->a);
+    emit_mem(buf, rex, opcode, RAX, insn->b);
+    emit_mem(buf, rex, 0x89, RAX, insn->dst);
+}
+
+static void emit_alu_imm(jit_buf_t *buf,
+                         uint8_t rex,
+                         uint8_t digit,
+                         r11f_regir_insn_t *insn) {
+    emit_mem(buf, rex, 0x8b, RAX, insn->a);
+    /* op eax, imm32 */
+    if (rex) {
+        emit_u8(buf, rex);
+    }
+    emit_bytes(buf, (uint8_t[]){ 0x81, 0xc0 | (digit << 3) }, 2);
+    emit_u32(buf, (uint32_t)insn->imm);
+    emit_mem(buf, rex, 0x89, RAX, insn->dst);
+}
+
+static void emit_shift(jit_buf_t *buf,
+                       uint8_t rex,
+                       uint8_t digit,
+                       r11f_regir_insn_t *insn,
+                       bool immediate) {
+    /* the hardware masks shift counts exactly like the JVM does */
+    emit_mem(buf, rex, 0x8b, RAX, insn->a);
+    if (!immediate) {
+        emit_mem(buf, 0, 0x8b, RCX, insn->b);
+    }
+    if (rex) {
+        emit_u8(buf, rex);
+    }
+    if (immediate) {
+        emit_bytes(buf, (uint8_t[]){ 0xc1, 0xc0 | (digit << 3) }, 2);
+        emit_u8(buf, (uint8_t)(insn->imm & 31));
+    }
+    else {
+        emit_bytes(buf, (uint8_t[]){ 0xd3, 0xc0 | (digit << 3) }, 2);
+    }
+    emit_mem(buf, rex, 0x89, RAX, insn->dst);
+}
+
+static void emit_div(jit_buf_t *buf, uint8_t rex, r11f_regir_insn_t *insn,
+                     bool rem) {
+    emit_mem(buf, rex, 0x8b, RAX, insn->a);
+    emit_mem(buf, rex, 0x8b, RCX, insn->b);
+
+    /* test ecx, ecx; jz div0 */
+    if (rex) {
+        emit_u8(buf, rex);
+    }
+    emit_bytes(buf, (uint8_t[]){ 0x85, 0xc9, 0x0f, 0x84 }, 4);
+    emit_throw_rel32(buf, TARGET_DIV0);
+
+    /* cmp ecx, -1; jne divide */
+    if (rex) {
+        emit_u8(buf, rex);
+    }
+    emit_bytes(buf, (uint8_t[]){ 0x83, 0xf9, 0xff, 0x75, 0x00 }, 5);
+    size_t jne_at = buf->size - 1;
+
+    /* x / -1 is -x and x % -1 is 0, idiv would trap on MIN_VALUE */
+    if (rex) {
+        emit_u8(buf, rex);
+    }
+    if (rem) {
+        /* xor eax, eax */
+        emit_bytes(buf, (uint8_t[]){ 0x31, 0xc0 }, 2);
+    }
+    else {
+        /* neg eax */
+        emit_bytes(buf, (uint8_t[]){ 0xf7, 0xd8 }, 2);
+    }
+    /* jmp done */
+    emit_bytes(buf, (uint8_t[]){ 0xeb, 0x00 }, 2);
+    size_t jmp_at = buf->size - 1;
+
+    if (!buf->oom) {
+        buf->data[jne_at] = (uint8_t)(buf->size - (jne_at + 1));
+    }
+    /* cdq / cqo; idiv ecx */
+    if (rex) {
+        emit_u8(buf, rex);
+    }
+    emit_u8(buf, 0x99);
+    if (rex) {
+        emit_u8(buf, rex);
+    }
+    emit_bytes(buf, (uint8_t[]){ 0xf7, 0xf9 }, 2);
+    if (rem) {
+        /* mov eax, edx */
+        if (rex) {
+            emit_u8(buf, rex);
+        }
+        emit_bytes(buf, (uint8_t[]){ 0x89, 0xd0 }, 2);
+    }
+
+    if (!buf->oom) {
+        buf->data[jmp_at] = (uint8_t)(buf->size - (jmp_at + 1));
+    }
+    emit_mem(buf, rex, 0x89, RAX, insn->dst);
+}
+
+/* rax = the array in register a, rcx = the index in register b, both
+   checked */
+static void emit_element(jit_buf_t *buf, r11f_regir_insn_t *insn) {
+    emit_mem(buf, REX_W, 0x8b, RAX, insn->a);
+    /* test rax, rax; jz null */
+    emit_bytes(buf, (uint8_t[]){ REX_W, 0x85, 0xc0, 0x0f, 0x84 }, 5);
+    emit_throw_rel32(buf, TARGET_NULL);
+    emit_mem(buf, 0, 0x8b, RCX, insn->b);
+    /* cmp ecx, [rax + length]; jae bounds, negative indices included */
+    emit_bytes(buf, (uint8_t[]){ 0x3b, 0x48, offsetof(r11f_array_t, length),
+                                 0x0f, 0x83 }, 5);
+    emit_throw_rel32(buf, TARGET_BOUNDS);
+}
+
+static void emit_error(jit_buf_t *buf, r11f_error_t error) {
+    /* mov eax, error; jmp exit */
+    emit_u8(buf, 0xb8);
+    emit_u32(buf, error);
+    emit_u8(buf, 0xe9);
+    emit_rel32(buf, TARGET_EXIT);
+}
+
+static void emit_u8(jit_buf_t *buf, uint8_t value) {
+    emit_bytes(buf, &value, 1);
+}
+
+static void emit_u32(jit_buf_t *buf, uint32_t value) {
+    emit_bytes(buf, (uint8_t*)&value, 4);
+}
+
+static void emit_u64(jit_buf_t *buf, uint64_t value) {
+    emit_bytes(buf, (uint8_t*)&value, 8);
+}
+
+static void emit_bytes(jit_buf_t *buf, uint8_t const *bytes, size_t count) {
+    if (buf->oom) {
+        return;
+    }
+
+    if (buf->size + count > buf->capacity) {
+        size_t capacity = buf->capacity ? buf->capacity * 2 : 256;
+        while (capacity < buf->size + count) {
+            capacity *= 2;
+        }
+        uint8_t *data = r11f_alloc(capacity);
+        if (!data) {
+            buf->oom = true;
+            return;
+        }
+        if (buf->data) {
+            memcpy(data, buf->data, buf->size);
+            r11f_free(buf->data);
+        }
+        buf->data = data;
+        buf->capacity = capacity;
+    }
+
+    memcpy(buf->data + buf->size, bytes, count);
+    buf->size += count;
+}
+
+static void emit_mem(jit_buf_t *buf,
+                     uint8_t rex,
+                     uint16_t opcode,
+                     uint8_t reg,
+                     uint16_t slot) {
+    /* op reg, [rbx + disp32] */
+    if (rex) {
+        emit_u8(buf, rex);
+    }
+    if (opcode > 0xff) {
+        emit_u8(buf, (uint8_t)(opcode >> 8));
+    }
+    emit_u8(buf, (uint8_t)opcode);
+    emit_u8(buf, 0x80 | (reg << 3) | RBX);
+    emit_u32(buf, (uint32_t)slot * sizeof(r11f_value_t));
+}
+
+static void emit_rel32(jit_buf_t *buf, uint32_t target) {
+    if (buf->fixup_count == buf->fixup_capacity) {
+        uint32_t capacity = buf->fixup_capacity ? buf->fixup_capacity * 2 : 32;
+        jit_fixup_t *fixups = r11f_alloc(capacity * sizeof(jit_fixup_t));
+        if (!fixups) {
+            buf->oom = true;
+            return;
+        }
+        if (buf->fixups) {
+            memcpy(fixups,
+                   buf->fixups,
+                   buf->fixup_count * sizeof(jit_fixup_t));
+            r11f_free(buf->fixups);
+        }
+        buf->fixups = fixups;
+        buf->fixup_capacity = capacity;
+    }
+
+    buf->fixups[buf->fixup_count++] = (jit_fixup_t) {
+        .at = (uint32_t)buf->size,
+        .target = target
+    };
+    emit_u32(buf, 0);
+}
+
+/* rel32 to `target` through a new stub for the current instruction */
+static void emit_throw_rel32(jit_buf_t *buf, uint32_t target) {
+    if (buf->stub_count == buf->stub_capacity) {
+        uint32_t capacity = buf->stub_capacity ? buf->stub_capacity * 2 : 16;
+        jit_stub_t *stubs = r11f_alloc(capacity * sizeof(jit_stub_t));
+        if (!stubs) {
+            buf->oom = true;
+            return;
+        }
+        if (buf->stubs) {
+            memcpy(stubs, buf->stubs, buf->stub_count * sizeof(jit_stub_t));
+            r11f_free(buf->stubs);
+        }
+        buf->stubs = stubs;
+        buf->stub_capacity = capacity;
+    }
+
+    buf->stubs[buf->stub_count] = (jit_stub_t) {
+        .insn = buf->insn,
+        .target = target
+    };
+    emit_rel32(buf, TARGET_STUB + buf->stub_count++);
+}
+
+static void emit_movabs(jit_buf_t *buf, uint8_t reg, uint64_t value) {
+    /* mov r64, imm64 */
+    emit_bytes(buf, (uint8_t[]){ REX_W, 0xb8 + reg }, 2);
+    emit_u64(buf, value);
+}
+
+/* movabs of an address only known once the code is placed */
+static void emit_reloc(jit_buf_t *buf,
+                       uint8_t reg,
+                       uint32_t kind,
+                       uint32_t index) {
+    if (buf->reloc_count == buf->reloc_capacity) {
+        uint32_t capacity = buf->reloc_capacity ? buf->reloc_capacity * 2 : 16;
+        r11f_jit_reloc_t *relocs =
+            r11f_alloc(capacity * sizeof(r11f_jit_reloc_t));
+        if (!relocs) {
+            buf->oom = true;
+            return;
+        }
+        if (buf->relocs) {
+            memcpy(relocs,
+                   buf->relocs,
+                   buf->reloc_count * sizeof(r11f_jit_reloc_t));
+            r11f_free(buf->relocs);
+        }
+        buf->relocs = relocs;
+        buf->reloc_capacity = capacity;
+    }
+
+    buf->relocs[buf->reloc_count++] = (r11f_jit_reloc_t) {
+        .at = (uint32_t)buf->size + 2,
+        .kind = kind,
+        .index = index
+    };
+    emit_movabs(buf, reg, 0);
+}
+
+static void emit_prologue(jit_buf_t *buf) {
+    /* push rbx; push r12; push r13; push r14; push r15 */
+    emit_bytes(buf, (uint8_t[]){ 0x53, 0x41, 0x54, 0x41, 0x55,
+                                 0x41, 0x56, 0x41, 0x57 }, 9);
+    /* mov r12, rdi; mov r13, rsi; mov r14, rdx */
+    emit_bytes(buf, (uint8_t[]){ 0x49, 0x89, 0xfc, 0x49, 0x89, 0xf5,
+                                 0x49, 0x89, 0xd6 }, 9);
+    /* mov rbx, [r13 + offsetof(data)] */
+    emit_bytes(buf, (uint8_t[]){ 0x49, 0x8b, 0x9d }, 3);
+    emit_u32(buf, (uint32_t)offsetof(r11f_frame_t, data));
+}
+
+static void init_callsite(r11f_linked_method_t *method,
+                          r11f_regir_insn_t *insn,
+                          r11f_jit_callsite_t *callsite) {
+    uint16_t index = (uint16_t)insn->imm;
+    r11f_method_qual_name_t qual_name = r11f_class_get_method_name(
+        method->clazz,
+        method->clazz->constant_pool[index]
+    );
+    char const *return_type = qual_name.descriptor;
+    while (*return_type != ')') {
+        return_type++;
+    }
+
+    callsite->caller = method->clazz;
+    callsite->methodref_index = index;
+    callsite->has_result = return_type[1] != 'V';
+    callsite->is_virtual = insn->op == R11F_RI_invokevirtual;
+    callsite->args_in_frame = true;
+    callsite->clazz = NULL;
+    callsite->method_info = NULL;
+    callsite->receiver_class = NULL;
+}
+
+#else /* __x86_64__ && !WIN32 */
+
+R11F_EXPORT r11f_error_t r11f_jit_compile(r11f_linked_method_t *method,
+                                          r11f_jit_code_t **output) {
+    (void)method;
+    (void)output;
+    return R11F_ERR_not_implemented_instruction;
+}
+
+#endif /* __x86_64__ && !WIN32 */
+
+R11F_EXPORT void r11f_jit_free(r11f_jit_code_t *jit) {
+    if (!jit) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < jit->switch_count; i++) {
+        r11f_switch_free(jit->switches[i]);
+    }
+    r11f_free(jit->switches);
+    r11f_free(jit->callsites);
+    r11f_free(jit->osr);
+    r11f_free(jit->deopt_points);
+    r11f_free(jit->deopt_frames);
+    r11f_free(jit->deopt_objects);
+    r11f_codecache_free((void*)jit->entry, jit->code_size);
+    r11f_free(jit);
+}
+
+R11F_EXPORT r11f_jit_entry_t r11f_jit_find_osr(r11f_jit_code_t *jit,
+                                               uint32_t pc) {
+    uint32_t low = 0;
+    uint32_t high = jit->osr_count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        r11f_jit_osr_t *osr = &jit->osr[mid];
+        if (osr->pc == pc) {
+            return osr->entry;
+        } else if (osr->pc < pc) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return NULL;
+}
+
+R11F_EXPORT void r11f_jit_invalidate(r11f_jit_code_t *jit) {
+    /* compiled code polls the flag at its speculation points */
+    __atomic_store_n(&jit->invalidated, 1, __ATOMIC_RELEASE);
+}
+
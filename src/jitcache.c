@@ -0,0 +1,263 @@
+#include "jitcache.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "alloc.h"
+#include "class.h"
+#include "jit.h"
+#include "link.h"
+#include "regir.h"
+
+#if defined(__x86_64__) && !defined(WIN32)
+
+#include <unistd.h>
+#include "jitimage.h"
+
+#ifndef R11F_BUILD_ID
+#   define R11F_BUILD_ID 0
+#endif
+
+#define PAD8(size) (((size) + 7) & ~(size_t)7)
+
+static const char g_magic[8] = "R11FJIT1";
+static const uint8_t g_padding[8];
+
+static size_t g_hits;
+
+static uint8_t *read_file(char const *path, size_t *out_size);
+static void write_file(char const *path,
+                       r11f_jit_record_t const *key,
+                       r11f_jit_image_t const *image);
+static bool write_array(FILE *file, void const *data, size_t size);
+static bool check_image(r11f_linked_method_t *method,
+                        r11f_jit_image_t const *image);
+
+R11F_EXPORT r11f_error_t r11f_jitcache_compile(char const *dir,
+                                               r11f_linked_method_t *method,
+                                               r11f_jit_code_t **output) {
+    r11f_jit_record_t key;
+    if (!dir || !method->regir || !r11f_jit_record_key(method, &key)) {
+        return r11f_jit_compile(method, output);
+    }
+
+    // path = dir + '/' + content hash + '-' + build id + '-' + index + ".jit"
+    char path[strlen(dir) + 64];
+    snprintf(path, sizeof(path), "%s/%016" PRIx64 "-%016" PRIx64 "-%" PRIu32
+             ".jit", dir, key.content_hash, key.build_id, key.method_index);
+
+    r11f_jit_image_t image;
+    size_t size;
+    uint8_t *data = read_file(path, &size);
+    if (data) {
+        bool loaded = r11f_jit_record_read(data, size, &key, method, &image)
+            && r11f_jit_load_image(method, &image, output) == R11F_success;
+        r11f_free(data);
+        if (loaded) {
+            __atomic_fetch_add(&g_hits, 1, __ATOMIC_RELAXED);
+            return R11F_success;
+        }
+    }
+
+    r11f_error_t err = r11f_jit_compile_image(method, &image);
+    if (err != R11F_success) {
+        return err;
+    }
+    write_file(path, &key, &image);
+    err = r11f_jit_load_image(method, &image, output);
+    r11f_jit_image_free(&image);
+    return err;
+}
+
+R11F_EXPORT size_t r11f_jitcache_hits(void) {
+    return __atomic_load_n(&g_hits, __ATOMIC_RELAXED);
+}
+
+R11F_INTERNAL bool r11f_jit_record_key(r11f_linked_method_t *method,
+                                       r11f_jit_record_t *output) {
+    r11f_class_t *clazz = method->clazz;
+    if (!R11F_BUILD_ID || !clazz->content_hash) {
+        return false;
+    }
+
+    memset(output, 0, sizeof(r11f_jit_record_t));
+    memcpy(output->magic, g_magic, sizeof(g_magic));
+    output->content_hash = clazz->content_hash;
+    output->build_id = (uint64_t)R11F_BUILD_ID;
+    output->method_index = UINT32_MAX;
+    for (uint16_t i = 0; i < clazz->methods_count; i++) {
+        if (clazz->methods[i] == method->method_info) {
+            output->method_index = i;
+        }
+    }
+    return output->method_index != UINT32_MAX;
+}
+
+R11F_INTERNAL bool r11f_jit_record_write(FILE *file,
+                                         r11f_jit_record_t const *key,
+                                         r11f_jit_image_t const *image) {
+    r11f_jit_record_t header = *key;
+    header.code_size = image->code_size;
+    header.insn_count = image->insn_count;
+    header.reloc_count = image->reloc_count;
+    header.osr_count = image->osr_count;
+
+    return write_array(file, &header, sizeof(r11f_jit_record_t))
+        && write_array(file, image->code, image->code_size)
+        && write_array(file,
+                       image->offsets,
+                       image->insn_count * sizeof(uint32_t))
+        && write_array(file,
+                       image->relocs,
+                       image->reloc_count * sizeof(r11f_jit_reloc_t))
+        && write_array(file, image->osr, image->osr_count * sizeof(uint32_t));
+}
+
+R11F_INTERNAL bool r11f_jit_record_read(uint8_t const *data,
+                                        size_t size,
+                                        r11f_jit_record_t const *key,
+                                        r11f_linked_method_t *method,
+                                        r11f_jit_image_t *output) {
+    r11f_jit_record_t header;
+    if (size < sizeof(r11f_jit_record_t)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(r11f_jit_record_t));
+    if (memcmp(header.magic, key->magic, sizeof(g_magic)) != 0
+        || header.content_hash != key->content_hash
+        || header.build_id != key->build_id
+        || header.method_index != key->method_index) {
+        return false;
+    }
+
+    size_t at = sizeof(r11f_jit_record_t);
+    size_t code_at = at;
+    at += PAD8((size_t)header.code_size);
+    size_t offsets_at = at;
+    at += PAD8((size_t)header.insn_count * sizeof(uint32_t));
+    size_t relocs_at = at;
+    at += PAD8((size_t)header.reloc_count * sizeof(r11f_jit_reloc_t));
+    size_t osr_at = at;
+    at += PAD8((size_t)header.osr_count * sizeof(uint32_t));
+    if (at > size) {
+        return false;
+    }
+
+    memset(output, 0, sizeof(r11f_jit_image_t));
+    output->code = (uint8_t*)data + code_at;
+    output->code_size = header.code_size;
+    output->insn_count = header.insn_count;
+    output->offsets = (uint32_t*)(data + offsets_at);
+    output->reloc_count = header.reloc_count;
+    output->relocs = (r11f_jit_reloc_t*)(data + relocs_at);
+    output->osr_count = header.osr_count;
+    output->osr = (uint32_t*)(data + osr_at);
+    return check_image(method, output);
+}
+
+/* the whole file, NULL if it cannot be read */
+static uint8_t *read_file(char const *path, size_t *out_size) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+
+    uint8_t *data = NULL;
+    long size = -1;
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        size = ftell(fp);
+    }
+    if (size > 0 && fseek(fp, 0, SEEK_SET) == 0) {
+        data = r11f_alloc((size_t)size);
+    }
+    if (data && fread(data, 1, (size_t)size, fp) != (size_t)size) {
+        r11f_free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    *out_size = (size_t)size;
+    return data;
+}
+
+/* written under a temporary name first, so that concurrent runs never
+   see half a file */
+static void write_file(char const *path,
+                       r11f_jit_record_t const *key,
+                       r11f_jit_image_t const *image) {
+    char temp_path[strlen(path) + 24];
+    snprintf(temp_path, sizeof(temp_path), "%s.%ld", path, (long)getpid());
+
+    FILE *fp = fopen(temp_path, "wb");
+    if (!fp) {
+        return;
+    }
+
+    bool ok = r11f_jit_record_write(fp, key, image);
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(temp_path, path) != 0) {
+        remove(temp_path);
+    }
+}
+
+/* padded to 8 bytes; empty arrays of an image may be NULL */
+static bool write_array(FILE *file, void const *data, size_t size) {
+    return (!size || fwrite(data, 1, size, file) == size)
+        && fwrite(g_padding, 1, PAD8(size) - size, file) == PAD8(size) - size;
+}
+
+/* a record matching the key can still be truncated or damaged, nothing
+   it says may point outside the code */
+static bool check_image(r11f_linked_method_t *method,
+                        r11f_jit_image_t const *image) {
+    r11f_regir_t *regir = method->regir;
+    if (image->insn_count != regir->insn_count
+        || image->osr_count != regir->loop_count) {
+        return false;
+    }
+
+    uint32_t callsite_count = 0;
+    for (uint32_t i = 0; i < regir->insn_count; i++) {
+        if (regir->insns[i].op == R11F_RI_invokestatic
+            || regir->insns[i].op == R11F_RI_invokevirtual) {
+            callsite_count++;
+        }
+        if (image->offsets[i] >= image->code_size) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < image->osr_count; i++) {
+        if (image->osr[i] >= image->code_size) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < image->reloc_count; i++) {
+        r11f_jit_reloc_t *reloc = &image->relocs[i];
+        if (image->code_size < 8 || reloc->at > image->code_size - 8) {
+            return false;
+        }
+        if ((reloc->kind == R11F_JIT_RELOC_SWITCH
+             && reloc->index >= regir->switch_count)
+            || (reloc->kind == R11F_JIT_RELOC_CALLSITE
+                && reloc->index >= callsite_count)
+            || reloc->kind > R11F_JIT_RELOC_ATHROW) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#else /* __x86_64__ && !WIN32 */
+
+R11F_EXPORT r11f_error_t r11f_jitcache_compile(char const *dir,
+                                               r11f_linked_method_t *method,
+                                               r11f_jit_code_t **output) {
+    (void)dir;
+    return r11f_jit_compile(method, output);
+}
+
+R11F_EXPORT size_t r11f_jitcache_hits(void) {
+    return 0;
+}
+
+#endif /* __x86_64__ && !WIN32 */
@@ -0,0 +1,845 @@
+#include "link.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "bytecode.h"
+#include "byteutil.h"
+#include "class.h"
+#include "class/attrib.h"
+#include "class/cpool.h"
+#include "frame.h"
+#include "jit.h"
+#include "regir.h"
+
+/* the local an instruction accesses and how its index is encoded */
+typedef struct {
+    uint16_t index;
+    /* the <op>_0 opcode of the <op>_<n> forms, zero otherwise */
+    uint8_t base;
+    /* the index is one byte at pc + 1, or two at pc + 2 after wide */
+    bool u2;
+} local_operand_t;
+
+static r11f_error_t link_switches(r11f_linked_method_t *linked);
+static void unlink_switches(r11f_linked_method_t *linked);
+static bool link_loops(r11f_linked_method_t *linked);
+static bool link_handlers(r11f_linked_method_t *linked, uint8_t *table);
+static void unlink_handlers(r11f_linked_method_t *linked);
+static bool link_locals(r11f_linked_method_t *linked);
+static bool local_operand(uint8_t const *code,
+                          uint32_t pc,
+                          local_operand_t *operand);
+static void link_trivial(r11f_linked_method_t *linked);
+static int32_t trivial_int(r11f_trivial_t const *trivial,
+                           uint8_t operand,
+                           r11f_value_t const *args);
+static int64_t trivial_long(r11f_trivial_t const *trivial,
+                            uint8_t operand,
+                            bool widen,
+                            r11f_value_t const *args);
+
+R11F_EXPORT r11f_error_t r11f_method_link(r11f_class_t *clazz,
+                                          r11f_method_info_t *method_info,
+                                          r11f_linked_method_t **output) {
+    if (method_info->linked) {
+        *output = method_info->linked;
+        return R11F_success;
+    }
+
+    r11f_linked_method_t *linked =
+        r11f_alloc_zeroed(sizeof(r11f_linked_method_t));
+    if (!linked) {
+        return R11F_ERR_out_of_memory;
+    }
+
+    r11f_constant_utf8_info_t *name_info =
+        clazz->constant_pool[method_info->name_index];
+    r11f_constant_utf8_info_t *desc_info =
+        clazz->constant_pool[method_info->descriptor_index];
+
+    linked->clazz = clazz;
+    linked->method_info = method_info;
+    linked->name = (char const*)name_info->bytes;
+    linked->name_len = name_info->length;
+    linked->descriptor = (char const*)desc_info->bytes;
+    linked->descriptor_len = desc_info->length;
+
+    r11f_attribute_info_t *code_info =
+        r11f_method_find_attribute(clazz, method_info, "Code");
+    uint8_t *exception_table = NULL;
+    if (code_info) {
+        linked->max_stack = read_unaligned2(code_info->info);
+        linked->max_locals = read_unaligned2(code_info->info + 2);
+        linked->code_length = read_unaligned4(code_info->info + 4);
+        linked->code = code_info->info + 8;
+        exception_table = linked->code + linked->code_length;
+    }
+
+    linked->argc = r11f_descriptor_argc(linked->descriptor);
+    char const *return_type = linked->descriptor;
+    while (*return_type != ')') {
+        return_type++;
+    }
+    linked->return_type = return_type[1] == '[' ? 'L' : return_type[1];
+    for (char const *desc = linked->descriptor + 1; *desc != ')'; desc++) {
+        while (*desc == '[') {
+            desc++;
+        }
+        if (*desc == 'L') {
+            while (*desc != ';') {
+                desc++;
+            }
+        }
+        else if (desc[-1] != '[' && (*desc == 'J' || *desc == 'D')) {
+            linked->wide_args = true;
+        }
+    }
+
+    /* switches are the only operands checked here, the rest can only fail
+     * for want of memory */
+    r11f_error_t err = R11F_ERR_out_of_memory;
+    if (link_locals(linked)) {
+        err = link_switches(linked);
+        if (err == R11F_success
+            && (!link_loops(linked)
+                || (exception_table
+                    && !link_handlers(linked, exception_table)))) {
+            err = R11F_ERR_out_of_memory;
+        }
+    }
+    if (err != R11F_success) {
+        unlink_switches(linked);
+        unlink_handlers(linked);
+        r11f_free(linked->loops);
+        if (linked->compact_locals) {
+            r11f_free(linked->code);
+        }
+        r11f_free(linked);
+        return err;
+    }
+    if (linked->code) {
+        link_trivial(linked);
+    }
+
+    /* compile threads read this without holding the VM lock */
+    __atomic_store_n(&method_info->linked, linked, __ATOMIC_RELEASE);
+    *output = linked;
+    return R11F_success;
+}
+
+R11F_EXPORT void r11f_method_unlink(r11f_method_info_t *method_info) {
+    r11f_linked_method_t *linked = method_info->linked;
+    if (!linked) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < linked->loop_count; i++) {
+        r11f_jit_free(linked->loops[i].osr);
+    }
+    r11f_jit_free(linked->opt);
+    r11f_jit_free(linked->jit);
+    r11f_regir_free(linked->regir);
+    unlink_switches(linked);
+    unlink_handlers(linked);
+    r11f_free(linked->loops);
+    if (linked->compact_locals) {
+        r11f_free(linked->code);
+    }
+    r11f_free(linked);
+    method_info->linked = NULL;
+}
+
+R11F_EXPORT r11f_switch_t*
+r11f_method_find_switch(r11f_linked_method_t *linked, uint32_t pc) {
+    uint32_t low = 0;
+    uint32_t high = linked->switch_count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        r11f_switch_t *sw = linked->switches[mid];
+        if (sw->pc == pc) {
+            return sw;
+        } else if (sw->pc < pc) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return NULL;
+}
+
+R11F_EXPORT r11f_handler_range_t*
+r11f_method_find_handlers(r11f_linked_method_t *linked, uint32_t pc) {
+    uint32_t low = 0;
+    uint32_t high = linked->handler_range_count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        r11f_handler_range_t *range = &linked->handler_ranges[mid];
+        if (pc < range->start_pc) {
+            high = mid;
+        } else if (pc >= range->end_pc) {
+            low = mid + 1;
+        } else {
+            return range;
+        }
+    }
+    return NULL;
+}
+
+R11F_EXPORT r11f_loop_counter_t*
+r11f_method_find_loop(r11f_linked_method_t *linked, uint32_t header_pc) {
+    uint32_t low = 0;
+    uint32_t high = linked->loop_count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        r11f_loop_counter_t *loop = &linked->loops[mid];
+        if (loop->header_pc == header_pc) {
+            return loop;
+        } else if (loop->header_pc < header_pc) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return NULL;
+}
+
+R11F_EXPORT r11f_value_t
+r11f_method_run_trivial(r11f_linked_method_t const *linked,
+                        r11f_value_t const *args) {
+    r11f_trivial_t const *t = &linked->trivial;
+    if (t->kind == R11F_TRIVIAL_CONSTANT) {
+        return linked->return_type == 'J' || linked->return_type == 'L' ?
+            (r11f_value_t) { .i64 = t->imm } :
+            (r11f_value_t) { .i32 = (int32_t)t->imm };
+    }
+
+    int32_t a, b;
+    int64_t la, lb;
+    switch (t->op) {
+        case R11F_nop:
+            return t->widen_a ?
+                (r11f_value_t) { .i64 = args[t->a].i32 } :
+                args[t->a];
+
+#define INT_OP(CODE, EXPR) \
+        case R11F_##CODE: \
+            a = trivial_int(t, t->a, args); \
+            b = trivial_int(t, t->b, args); \
+            return (r11f_value_t) { .i32 = (int32_t)(EXPR) };
+        INT_OP(iadd, (uint32_t)a + (uint32_t)b)
+        INT_OP(isub, (uint32_t)a - (uint32_t)b)
+        INT_OP(imul, (uint32_t)a * (uint32_t)b)
+        INT_OP(iand, a & b)
+        INT_OP(ior, a | b)
+        INT_OP(ixor, a ^ b)
+        INT_OP(ishl, (uint32_t)a << (b & 31))
+        INT_OP(ishr, a >> (b & 31))
+        INT_OP(iushr, (uint32_t)a >> (b & 31))
+#undef INT_OP
+
+#define LONG_OP(CODE, EXPR) \
+        case R11F_##CODE: \
+            la = trivial_long(t, t->a, t->widen_a, args); \
+            lb = trivial_long(t, t->b, t->widen_b, args); \
+            return (r11f_value_t) { .i64 = (int64_t)(EXPR) };
+        LONG_OP(ladd, (uint64_t)la + (uint64_t)lb)
+        LONG_OP(lsub, (uint64_t)la - (uint64_t)lb)
+        LONG_OP(lmul, (uint64_t)la * (uint64_t)lb)
+        LONG_OP(land, la & lb)
+        LONG_OP(lor, la | lb)
+        LONG_OP(lxor, la ^ lb)
+#undef LONG_OP
+
+        /* the shift distance is an int */
+        case R11F_lshl:
+            la = trivial_long(t, t->a, t->widen_a, args);
+            b = trivial_int(t, t->b, args);
+            return (r11f_value_t) {
+                .i64 = (int64_t)((uint64_t)la << (b & 63))
+            };
+        case R11F_lshr:
+            la = trivial_long(t, t->a, t->widen_a, args);
+            b = trivial_int(t, t->b, args);
+            return (r11f_value_t) { .i64 = la >> (b & 63) };
+        case R11F_lushr:
+            la = trivial_long(t, t->a, t->widen_a, args);
+            b = trivial_int(t, t->b, args);
+            return (r11f_value_t) {
+                .i64 = (int64_t)((uint64_t)la >> (b & 63))
+            };
+    }
+
+    assert(false && "link_trivial accepted an unsupported bytecode");
+    return (r11f_value_t) { .i64 = 0 };
+}
+
+R11F_EXPORT uint16_t r11f_descriptor_argc(char const *descriptor) {
+    assert(*descriptor == '(');
+
+    uint16_t argc = 0;
+    descriptor += 1;
+    while (*descriptor != ')') {
+        while (*descriptor == '[') {
+            descriptor++;
+        }
+        if (*descriptor == 'L') {
+            while (*descriptor != ';') {
+                descriptor++;
+            }
+        }
+        argc++;
+        descriptor++;
+    }
+
+    return argc;
+}
+
+static r11f_error_t link_switches(r11f_linked_method_t *linked) {
+    uint32_t count = 0;
+    for (uint32_t pc = 0; pc < linked->code_length;
+         pc += r11f_bytecode_length(linked->code, linked->code_length, pc)) {
+        uint8_t opcode = linked->code[pc];
+        if (opcode == R11F_tableswitch || opcode == R11F_lookupswitch) {
+            count++;
+        }
+    }
+    if (!count) {
+        return R11F_success;
+    }
+
+    linked->switches = r11f_alloc_zeroed(sizeof(r11f_switch_t*) * count);
+    if (!linked->switches) {
+        return R11F_ERR_out_of_memory;
+    }
+
+    for (uint32_t pc = 0; pc < linked->code_length;
+         pc += r11f_bytecode_length(linked->code, linked->code_length, pc)) {
+        uint8_t opcode = linked->code[pc];
+        if (opcode != R11F_tableswitch && opcode != R11F_lookupswitch) {
+            continue;
+        }
+
+        r11f_switch_t *sw;
+        r11f_error_t err =
+            r11f_switch_compile(linked->code, linked->code_length, pc, &sw);
+        if (err != R11F_success) {
+            return err;
+        }
+        linked->switches[linked->switch_count++] = sw;
+    }
+    return R11F_success;
+}
+
+static void unlink_switches(r11f_linked_method_t *linked) {
+    for (uint32_t i = 0; i < linked->switch_count; i++) {
+        r11f_switch_free(linked->switches[i]);
+    }
+    r11f_free(linked->switches);
+}
+
+/* counts the targets of the branch or switch at pc that jump backwards,
+   or to itself, and stores them as loop headers unless `loops` is NULL */
+static uint32_t backward_targets(r11f_linked_method_t *linked, uint32_t pc,
+                                 r11f_loop_counter_t *loops) {
+    uint8_t *code = linked->code;
+    int32_t offset;
+    switch (code[pc]) {
+        case R11F_ifeq: case R11F_ifne: case R11F_iflt:
+        case R11F_ifge: case R11F_ifgt: case R11F_ifle:
+        case R11F_if_icmpeq: case R11F_if_icmpne: case R11F_if_icmplt:
+        case R11F_if_icmpge: case R11F_if_icmpgt: case R11F_if_icmple:
+        case R11F_if_acmpeq: case R11F_if_acmpne:
+        case R11F_ifnull: case R11F_ifnonnull:
+        case R11F_goto:
+            offset = (int16_t)read_unaligned_be2(code + pc + 1);
+            break;
+        case R11F_goto_w:
+            offset = (int32_t)read_unaligned_be4(code + pc + 1);
+            break;
+        case R11F_tableswitch:
+        case R11F_lookupswitch: {
+            /* javac never jumps back from a switch, other compilers may */
+            r11f_switch_t *sw = r11f_method_find_switch(linked, pc);
+            uint32_t count = 0;
+            for (uint32_t i = 0; i <= sw->count; i++) {
+                uint32_t target =
+                    i < sw->count ? sw->targets[i] : sw->default_target;
+                if (target <= pc) {
+                    if (loops) {
+                        loops[count].header_pc = target;
+                    }
+                    count++;
+                }
+            }
+            return count;
+        }
+        default:
+            return 0;
+    }
+    if (offset > 0) {
+        return 0;
+    }
+    if (loops) {
+        loops[0].header_pc = pc + offset;
+    }
+    return 1;
+}
+
+static int compare_loops(void const *lhs, void const *rhs) {
+    uint32_t a = ((r11f_loop_counter_t const*)lhs)->header_pc;
+    uint32_t b = ((r11f_loop_counter_t const*)rhs)->header_pc;
+    return (a > b) - (a < b);
+}
+
+static bool link_loops(r11f_linked_method_t *linked) {
+    uint32_t count = 0;
+    for (uint32_t pc = 0; pc < linked->code_length;
+         pc += r11f_bytecode_length(linked->code, linked->code_length, pc)) {
+        count += backward_targets(linked, pc, NULL);
+    }
+    if (!count) {
+        return true;
+    }
+
+    linked->loops = r11f_alloc_zeroed(sizeof(r11f_loop_counter_t) * count);
+    if (!linked->loops) {
+        return false;
+    }
+
+    for (uint32_t pc = 0; pc < linked->code_length;
+         pc += r11f_bytecode_length(linked->code, linked->code_length, pc)) {
+        linked->loop_count += backward_targets(
+            linked, pc, linked->loops + linked->loop_count
+        );
+    }
+
+    /* several back edges may share one header */
+    qsort(linked->loops, linked->loop_count, sizeof(r11f_loop_counter_t),
+          compare_loops);
+    uint32_t unique = 0;
+    for (uint32_t i = 0; i < linked->loop_count; i++) {
+        if (!unique
+            || linked->loops[unique - 1].header_pc
+               != linked->loops[i].header_pc) {
+            linked->loops[unique++] = linked->loops[i];
+        }
+    }
+    linked->loop_count = unique;
+    return true;
+}
+
+static int compare_pcs(void const *lhs, void const *rhs) {
+    uint32_t a = *(uint32_t const*)lhs;
+    uint32_t b = *(uint32_t const*)rhs;
+    return (a > b) - (a < b);
+}
+
+/* cuts the code at every start_pc and end_pc of the table, each piece
+   covered by some entry becomes a range */
+static bool link_handlers(r11f_linked_method_t *linked, uint8_t *table) {
+    uint16_t count = read_unaligned2(table);
+    if (!count) {
+        return true;
+    }
+
+    linked->handlers = r11f_alloc_zeroed(sizeof(r11f_handler_t) * count);
+    uint32_t *bounds = r11f_alloc(sizeof(uint32_t) * count * 2);
+    if (!linked->handlers || !bounds) {
+        r11f_free(bounds);
+        return false;
+    }
+
+    uint32_t bound_count = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        uint8_t *entry = table + 2 + i * 8;
+        r11f_handler_t *handler = &linked->handlers[i];
+        handler->start_pc = read_unaligned2(entry);
+        handler->end_pc = read_unaligned2(entry + 2);
+        handler->handler_pc = read_unaligned2(entry + 4);
+        handler->catch_type = read_unaligned2(entry + 6);
+        if (handler->start_pc < handler->end_pc
+            && handler->end_pc <= linked->code_length) {
+            bounds[bound_count++] = handler->start_pc;
+            bounds[bound_count++] = handler->end_pc;
+        }
+    }
+    linked->handler_count = count;
+
+    qsort(bounds, bound_count, sizeof(uint32_t), compare_pcs);
+    uint32_t unique = 0;
+    for (uint32_t i = 0; i < bound_count; i++) {
+        if (!unique || bounds[unique - 1] != bounds[i]) {
+            bounds[unique++] = bounds[i];
+        }
+    }
+
+    /* every piece lists each entry at most once */
+    size_t range_size = unique ? sizeof(r11f_handler_range_t) * (unique - 1)
+                               : 0;
+    linked->handler_ranges = range_size ? r11f_alloc(range_size) : NULL;
+    linked->handler_order =
+        r11f_alloc(sizeof(uint16_t) * count * (unique ? unique : 1));
+    if ((range_size && !linked->handler_ranges) || !linked->handler_order) {
+        r11f_free(bounds);
+        return false;
+    }
+
+    uint32_t order_count = 0;
+    for (uint32_t i = 0; i + 1 < unique; i++) {
+        uint32_t first = order_count;
+        for (uint16_t j = 0; j < count; j++) {
+            r11f_handler_t *handler = &linked->handlers[j];
+            if (handler->start_pc <= bounds[i]
+                && bounds[i + 1] <= handler->end_pc) {
+                linked->handler_order[order_count++] = j;
+            }
+        }
+        if (order_count > first) {
+            linked->handler_ranges[linked->handler_range_count++] =
+                (r11f_handler_range_t) {
+                    .start_pc = bounds[i],
+                    .end_pc = bounds[i + 1],
+                    .first = first,
+                    .count = order_count - first
+                };
+        }
+    }
+
+    r11f_free(bounds);
+    return true;
+}
+
+static void unlink_handlers(r11f_linked_method_t *linked) {
+    r11f_free(linked->handlers);
+    r11f_free(linked->handler_ranges);
+    r11f_free(linked->handler_order);
+}
+
+/* renumbers the locals to one per value: the second half of a long or
+   double goes unless the code uses it on its own, as does any local
+   past the arguments the code never touches. The renumbered code is a
+   copy of the class file's; indices only get smaller and keep their
+   encoding, so no pc moves */
+static bool link_locals(r11f_linked_method_t *linked) {
+    uint16_t max_locals = linked->max_locals;
+    if (!linked->code || !max_locals) {
+        return true;
+    }
+
+    bool *used = r11f_alloc_zeroed(max_locals * sizeof(bool));
+    uint16_t *renumber = r11f_alloc(max_locals * sizeof(uint16_t));
+    if (!used || !renumber) {
+        r11f_free(used);
+        r11f_free(renumber);
+        return false;
+    }
+
+    /* the arguments are there whether used or not */
+    uint16_t local = 0;
+    if (!(linked->method_info->access_flags & R11F_ACC_STATIC)) {
+        used[local++] = true;
+    }
+    for (char const *desc = linked->descriptor + 1;
+         *desc != ')' && local < max_locals;
+         desc++) {
+        used[local] = true;
+        local += *desc == 'J' || *desc == 'D' ? 2 : 1;
+        while (*desc == '[') {
+            desc++;
+        }
+        if (*desc == 'L') {
+            while (*desc != ';') {
+                desc++;
+            }
+        }
+    }
+
+    bool compact = true;
+    for (uint32_t pc = 0; pc < linked->code_length;
+         pc += r11f_bytecode_length(linked->code, linked->code_length, pc)) {
+        local_operand_t operand;
+        if (!local_operand(linked->code, pc, &operand)) {
+            continue;
+        }
+        if (operand.index >= max_locals) {
+            compact = false;
+            break;
+        }
+        used[operand.index] = true;
+    }
+
+    uint16_t count = 0;
+    for (uint16_t i = 0; i < max_locals; i++) {
+        renumber[i] = count;
+        count += used[i] ? 1 : 0;
+    }
+
+    /* the arguments have to stay one per value for the caller to pass
+       them in place, which a half of one used on its own prevents */
+    uint16_t argc = linked->argc
+        + !(linked->method_info->access_flags & R11F_ACC_STATIC);
+    if (local > max_locals
+        || (local < max_locals ? renumber[local] : count) != argc) {
+        compact = false;
+    }
+
+    bool ok = true;
+    uint8_t *code = NULL;
+    if (compact && count < max_locals) {
+        code = r11f_alloc(linked->code_length);
+        ok = code != NULL;
+    }
+    if (code) {
+        memcpy(code, linked->code, linked->code_length);
+        for (uint32_t pc = 0; pc < linked->code_length;
+             pc += r11f_bytecode_length(code, linked->code_length, pc)) {
+            local_operand_t operand;
+            if (!local_operand(code, pc, &operand)) {
+                continue;
+            }
+            uint16_t index = renumber[operand.index];
+            if (operand.base) {
+                code[pc] = (uint8_t)(operand.base + index);
+            }
+            else if (operand.u2) {
+                code[pc + 2] = (uint8_t)(index >> 8);
+                code[pc + 3] = (uint8_t)index;
+            }
+            else {
+                code[pc + 1] = (uint8_t)index;
+            }
+        }
+        linked->code = code;
+        linked->max_locals = count;
+        linked->compact_locals = true;
+        linked->wide_args = false;
+    }
+
+    r11f_free(used);
+    r11f_free(renumber);
+    return ok;
+}
+
+static bool local_operand(uint8_t const *code,
+                          uint32_t pc,
+                          local_operand_t *operand) {
+    uint8_t insc = code[pc];
+    switch (insc) {
+#define SHORT_FORM(OP) \
+        case R11F_##OP##_0: case R11F_##OP##_1: case R11F_##OP##_2: \
+        case R11F_##OP##_3: \
+            *operand = (local_operand_t) { \
+                .index = insc - R11F_##OP##_0, \
+                .base = R11F_##OP##_0 \
+            }; \
+            return true;
+        SHORT_FORM(iload)
+        SHORT_FORM(lload)
+        SHORT_FORM(fload)
+        SHORT_FORM(dload)
+        SHORT_FORM(aload)
+        SHORT_FORM(istore)
+        SHORT_FORM(lstore)
+        SHORT_FORM(fstore)
+        SHORT_FORM(dstore)
+        SHORT_FORM(astore)
+#undef SHORT_FORM
+
+        case R11F_iload: case R11F_lload: case R11F_fload: case R11F_dload:
+        case R11F_aload: case R11F_istore: case R11F_lstore:
+        case R11F_fstore: case R11F_dstore: case R11F_astore:
+        case R11F_iinc: case R11F_ret:
+            *operand = (local_operand_t) { .index = code[pc + 1] };
+            return true;
+
+        case R11F_wide:
+            *operand = (local_operand_t) {
+                .index = read_unaligned_be2((uint8_t*)code + pc + 2),
+                .u2 = true
+            };
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/* recognizes the straight line code r11f_method_run_trivial can stand
+   in for, see r11f_trivial_t */
+static void link_trivial(r11f_linked_method_t *linked) {
+    /* the argument each local holds, UINT8_MAX for the second half of a
+       long left by link_locals and anything past the arguments */
+    uint8_t arg_of_local[256];
+    memset(arg_of_local, UINT8_MAX, sizeof(arg_of_local));
+    uint16_t local = 0;
+    uint8_t arg = 0;
+    if (!(linked->method_info->access_flags & R11F_ACC_STATIC)) {
+        arg_of_local[local++] = arg++;
+    }
+    for (char const *desc = linked->descriptor + 1; *desc != ')'; desc++) {
+        if (local >= 255) {
+            return;
+        }
+        arg_of_local[local] = arg++;
+        bool wide = (*desc == 'J' || *desc == 'D') && linked->wide_args;
+        while (*desc == '[') {
+            desc++;
+        }
+        if (*desc == 'L') {
+            while (*desc != ';') {
+                desc++;
+            }
+        }
+        local += wide ? 2 : 1;
+    }
+
+    uint8_t *code = linked->code;
+    r11f_trivial_t t = { .kind = R11F_TRIVIAL_LEAF, .op = R11F_nop };
+    uint8_t *operands[2] = { &t.a, &t.b };
+    bool *widen[2] = { &t.widen_a, &t.widen_b };
+    uint8_t depth = 0;
+    bool have_imm = false;
+    bool computed = false;
+    uint32_t pc = 0;
+    while (pc < linked->code_length) {
+        uint8_t insc = code[pc];
+        int32_t load = -1;
+        bool is_imm = false;
+        int64_t imm = 0;
+        switch (insc) {
+            case R11F_iload_0: case R11F_iload_1: case R11F_iload_2:
+            case R11F_iload_3:
+                load = insc - R11F_iload_0;
+                break;
+            case R11F_lload_0: case R11F_lload_1: case R11F_lload_2:
+            case R11F_lload_3:
+                load = insc - R11F_lload_0;
+                break;
+            case R11F_aload_0: case R11F_aload_1: case R11F_aload_2:
+            case R11F_aload_3:
+                load = insc - R11F_aload_0;
+                break;
+            case R11F_iload:
+            case R11F_lload:
+            case R11F_aload:
+                load = code[pc + 1];
+                break;
+
+            case R11F_aconst_null:
+                is_imm = true;
+                break;
+            case R11F_iconst_m1: case R11F_iconst_0: case R11F_iconst_1:
+            case R11F_iconst_2: case R11F_iconst_3: case R11F_iconst_4:
+            case R11F_iconst_5:
+                is_imm = true;
+                imm = (int64_t)insc - R11F_iconst_0;
+                break;
+            case R11F_lconst_0:
+            case R11F_lconst_1:
+                is_imm = true;
+                imm = (int64_t)insc - R11F_lconst_0;
+                break;
+            case R11F_bipush:
+                is_imm = true;
+                imm = (int8_t)code[pc + 1];
+                break;
+            case R11F_sipush:
+                is_imm = true;
+                imm = (int16_t)read_unaligned_be2(code + pc + 1);
+                break;
+            case R11F_ldc: {
+                r11f_cpinfo_t *cpinfo =
+                    linked->clazz->constant_pool[code[pc + 1]];
+                if (cpinfo->tag != R11F_CONSTANT_Integer) {
+                    return;
+                }
+                r11f_constant_integer_info_t *integer_info =
+                    (r11f_constant_integer_info_t*)cpinfo;
+                is_imm = true;
+                imm = (int32_t)integer_info->bytes;
+                break;
+            }
+
+            case R11F_i2l:
+                /* constants are kept sign extended already */
+                if (depth == 0 || computed) {
+                    return;
+                }
+                if (*operands[depth - 1] != R11F_TRIVIAL_IMM) {
+                    *widen[depth - 1] = true;
+                }
+                break;
+
+            case R11F_iadd: case R11F_isub: case R11F_imul:
+            case R11F_iand: case R11F_ior: case R11F_ixor:
+            case R11F_ishl: case R11F_ishr: case R11F_iushr:
+            case R11F_ladd: case R11F_lsub: case R11F_lmul:
+            case R11F_land: case R11F_lor: case R11F_lxor:
+            case R11F_lshl: case R11F_lshr: case R11F_lushr:
+                if (depth != 2 || computed) {
+                    return;
+                }
+                t.op = insc;
+                computed = true;
+                depth = 1;
+                break;
+
+            case R11F_ireturn:
+            case R11F_lreturn:
+            case R11F_areturn:
+                if (depth != 1) {
+                    return;
+                }
+                if (!computed && t.a == R11F_TRIVIAL_IMM) {
+                    t.kind = R11F_TRIVIAL_CONSTANT;
+                }
+                linked->trivial = t;
+                return;
+
+            default:
+                return;
+        }
+
+        if (load >= 0 || is_imm) {
+            if (depth == 2 || computed) {
+                return;
+            }
+            if (is_imm) {
+                if (have_imm) {
+                    return;
+                }
+                have_imm = true;
+                t.imm = imm;
+                *operands[depth] = R11F_TRIVIAL_IMM;
+            }
+            else if (arg_of_local[load] == UINT8_MAX) {
+                return;
+            }
+            else {
+                *operands[depth] = arg_of_local[load];
+            }
+            depth++;
+        }
+        pc += r11f_bytecode_length(code, linked->code_length, pc);
+    }
+}
+
+static int32_t trivial_int(r11f_trivial_t const *trivial,
+                           uint8_t operand,
+                           r11f_value_t const *args) {
+    return operand == R11F_TRIVIAL_IMM ?
+        (int32_t)trivial->imm :
+        args[operand].i32;
+}
+
+static int64_t trivial_long(r11f_trivial_t const *trivial,
+                            uint8_t operand,
+                            bool widen,
+                            r11f_value_t const *args) {
+    if (operand == R11F_TRIVIAL_IMM) {
+        return trivial->imm;
+    }
+    return widen ? args[operand].i32 : args[operand].i64;
+}
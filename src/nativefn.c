@@ -0,0 +1,140 @@
+#include "nativefn.h"
+
+#include <string.h>
+#include "class.h"
+#include "link.h"
+
+typedef struct {
+    char const *class_name;
+    char const *name;
+    char const *descriptor;
+} nativefn_t;
+
+static nativefn_t const nativefns[] = {
+#define NATIVEFN(CODE,CLASS,NAME,DESCRIPTOR) { CLASS, NAME, DESCRIPTOR },
+#include "nativefninc.h"
+};
+
+static bool name_equals(char const *expected,
+                        char const *name,
+                        uint16_t name_len);
+
+R11F_EXPORT uint16_t r11f_nativefn_find(char const *class_name,
+                                        uint16_t class_name_len,
+                                        char const *name,
+                                        uint16_t name_len,
+                                        char const *descriptor,
+                                        uint16_t descriptor_len) {
+    for (uint16_t i = 0; i < R11F_NATIVEFN_COUNT; i++) {
+        if (name_equals(nativefns[i].class_name, class_name, class_name_len)
+            && name_equals(nativefns[i].name, name, name_len)
+            && name_equals(nativefns[i].descriptor,
+                           descriptor,
+                           descriptor_len)) {
+            return i;
+        }
+    }
+    return R11F_NATIVEFN_NONE;
+}
+
+R11F_EXPORT uint16_t r11f_nativefn_find_ref(r11f_class_t *clazz,
+                                            uint16_t index) {
+    r11f_constant_methodref_info_t *methodref_info =
+        clazz->constant_pool[index];
+    char const *class_name;
+    uint16_t class_name_len;
+    if (!r11f_class_get_class_name(clazz,
+                                   methodref_info->class_index,
+                                   &class_name,
+                                   &class_name_len)) {
+        return R11F_NATIVEFN_NONE;
+    }
+    r11f_method_qual_name_t qual_name =
+        r11f_class_get_method_name(clazz, methodref_info);
+    return r11f_nativefn_find(class_name,
+                              class_name_len,
+                              qual_name.name,
+                              qual_name.name_len,
+                              qual_name.descriptor,
+                              qual_name.descriptor_len);
+}
+
+R11F_EXPORT char const *r11f_nativefn_name(uint16_t fn) {
+    return nativefns[fn].name;
+}
+
+R11F_EXPORT uint16_t r11f_nativefn_argc(uint16_t fn) {
+    return r11f_descriptor_argc(nativefns[fn].descriptor);
+}
+
+R11F_EXPORT bool r11f_nativefn_wide(uint16_t fn) {
+    char const *descriptor = nativefns[fn].descriptor;
+    return descriptor[strlen(descriptor) - 1] == 'J';
+}
+
+R11F_EXPORT r11f_value_t r11f_nativefn_call(uint16_t fn,
+                                            r11f_value_t const *args) {
+    int32_t a = args[0].i32;
+    int64_t la = args[0].i64;
+    uint32_t ua = args[0].u32;
+    uint64_t ula = (uint64_t)la;
+    r11f_value_t result = { .i64 = 0 };
+    switch (fn) {
+        /* negated through unsigned, abs(MIN_VALUE) stays MIN_VALUE */
+        case R11F_NATIVEFN_iabs:
+            result.i32 = a < 0 ? (int32_t)(0u - ua) : a;
+            break;
+        case R11F_NATIVEFN_labs:
+            result.i64 = la < 0 ? (int64_t)(0u - ula) : la;
+            break;
+        case R11F_NATIVEFN_imin:
+            result.i32 = a < args[1].i32 ? a : args[1].i32;
+            break;
+        case R11F_NATIVEFN_lmin:
+            result.i64 = la < args[1].i64 ? la : args[1].i64;
+            break;
+        case R11F_NATIVEFN_imax:
+            result.i32 = a > args[1].i32 ? a : args[1].i32;
+            break;
+        case R11F_NATIVEFN_lmax:
+            result.i64 = la > args[1].i64 ? la : args[1].i64;
+            break;
+
+        case R11F_NATIVEFN_ibitcount:
+            result.i32 = __builtin_popcount(ua);
+            break;
+        case R11F_NATIVEFN_inlz:
+            result.i32 = ua ? __builtin_clz(ua) : 32;
+            break;
+        case R11F_NATIVEFN_intz:
+            result.i32 = ua ? __builtin_ctz(ua) : 32;
+            break;
+        case R11F_NATIVEFN_ibswap:
+            result.i32 = (int32_t)__builtin_bswap32(ua);
+            break;
+
+        case R11F_NATIVEFN_lbitcount:
+            result.i32 = __builtin_popcountll(ula);
+            break;
+        case R11F_NATIVEFN_lnlz:
+            result.i32 = ula ? __builtin_clzll(ula) : 64;
+            break;
+        case R11F_NATIVEFN_lntz:
+            result.i32 = ula ? __builtin_ctzll(ula) : 64;
+            break;
+        case R11F_NATIVEFN_lbswap:
+            result.i64 = (int64_t)__builtin_bswap64(ula);
+            break;
+
+        /* parking is up to the interpreters */
+        case R11F_NATIVEFN_yield:
+            break;
+    }
+    return result;
+}
+
+static bool name_equals(char const *expected,
+                        char const *name,
+                        uint16_t name_len) {
+    return strlen(expected) == name_len && !memcmp(expected, name, name_len);
+}
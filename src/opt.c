@@ -0,0 +1,3612 @@
+#include "opt.h"
+
+#include <assert.h>
+#include <string.h>
+#include "alloc.h"
+#include "class.h"
+#include "class/cpool.h"
+#include "jit.h"
+#include "link.h"
+#include "nativefn.h"
+#include "regir.h"
+#include "ssa.h"
+
+/* callees with at most this many register IR instructions get inlined */
+#define OPT_INLINE_MAX_INSNS 32
+#define OPT_INLINE_MAX_DEPTH 4
+/* give up on methods growing beyond this many SSA values */
+#define OPT_MAX_VALUES 20000
+
+/* checks at most one loop trades for guards ahead of it */
+#define OPT_MAX_LOOP_GUARDS 8
+
+/* give up on loops vectorizing to more than this */
+#define OPT_MAX_VEC_INSNS 64
+#define OPT_MAX_VEC_ARGS 32
+
+/* arrays of at most this many elements get broken into their values */
+#define OPT_MAX_SCALAR_LENGTH 8
+
+typedef struct st_arena_chunk {
+    struct st_arena_chunk *next;
+    size_t used;
+    size_t size;
+    /* r11f_alloc only guarantees 8 byte alignment */
+    uint64_t data[];
+} arena_chunk_t;
+
+/* per method state while translating register IR, one per inlining
+   level */
+typedef struct st_build_ctx {
+    r11f_vm_t *vm;
+    r11f_ssa_t *ssa;
+    struct st_build_ctx *parent;
+    uint32_t depth;
+
+    r11f_linked_method_t *method;
+    r11f_regir_t *regir;
+    uint32_t reg_count;
+
+    /* register IR blocks, rb for short */
+    uint32_t rb_count;
+    uint32_t *rb_start;
+    uint32_t *insn_rb;
+    uint32_t *rb_pred_count;
+    /* some predecessor of each block, the only one if there is one */
+    uint32_t *rb_pred;
+    uint32_t *rpo;
+    uint32_t rpo_count;
+    uint32_t *rpo_index;
+
+    uint32_t *head;
+    uint32_t *tail;
+    uint32_t **end_defs;
+    bool *has_phis;
+
+    uint32_t entry_block;
+    uint32_t *entry_defs;
+    /* register IR instruction entered first, and its block */
+    uint32_t entry_insn;
+    uint32_t entry_rb;
+
+    /* inlined methods return by jumping to exit_block */
+    uint32_t exit_block;
+    uint32_t *ret_values;
+    uint32_t ret_count;
+
+    /* the call being inlined and the registers before it */
+    r11f_regir_insn_t *call_insn;
+    uint32_t *call_defs;
+} build_ctx_t;
+
+/* give up on traces running through more instructions than this */
+#define TRACE_MAX_STEPS 4096
+
+/* one instruction on the path of a trace: `next` is where a branch went
+   on, `callee` what a call went into */
+typedef struct {
+    r11f_linked_method_t *method;
+    uint32_t pc;
+    uint32_t next;
+    r11f_linked_method_t *callee;
+} trace_step_t;
+
+/* a method on the path, waiting in the call at `pc` unless innermost */
+typedef struct {
+    r11f_linked_method_t *method;
+    uint32_t pc;
+    uint32_t *defs;
+} trace_frame_t;
+
+typedef struct {
+    uint8_t cond;
+    uint32_t args[2];
+    bool hoisted;
+} trace_guard_t;
+
+typedef struct {
+    r11f_ssa_t *ssa;
+
+    /* the entry block loads the registers, constants and everything
+       computed from values the loop never changes go there too */
+    uint32_t entry;
+    uint32_t *entry_defs;
+    uint32_t header;
+    uint32_t body;
+
+    trace_frame_t frames[R11F_TRACE_MAX_DEPTH + 1];
+    uint32_t depth;
+
+    /* guards with invariant operands get checked ahead of the loop */
+    trace_guard_t *guards;
+    uint32_t guard_count;
+} trace_ctx_t;
+
+/* dominator tree of the blocks there were when eliminate_checks
+   started, blocks it adds are not part of it */
+typedef struct {
+    r11f_ssa_t *ssa;
+    uint32_t block_count;
+    uint32_t *rpo;
+    uint32_t rpo_count;
+    /* R11F_SSA_NONE for unreachable blocks */
+    uint32_t *rpo_index;
+    uint32_t *idom;
+} dom_tree_t;
+
+/* `lhs` compared against `rhs`, a constant zero when R11F_SSA_NONE or
+   the length of `array` if that is set */
+typedef struct {
+    uint8_t cond;
+    bool wide;
+    uint32_t lhs;
+    uint32_t rhs;
+    uint32_t array;
+} loop_guard_t;
+
+/* the SIMD version of a loop while vectorize_loop builds it. Registers
+   and arguments are handed out on first use of a value and kept in
+   small maps, operands of the vloop value are args[] in order */
+typedef struct {
+    r11f_ssa_t *ssa;
+    uint32_t h;
+    uint32_t body;
+    uint32_t entry;
+    uint32_t iv;
+
+    uint32_t reg_values[R11F_VEC_REGS];
+    uint8_t reg_count;
+    uint8_t iv_reg;
+    uint8_t step_reg;
+
+    uint32_t args[OPT_MAX_VEC_ARGS];
+    uint32_t arg_count;
+    /* null checks of the header, repeated ahead of the vloop */
+    uint32_t null_checks[OPT_MAX_LOOP_GUARDS];
+    uint32_t null_check_count;
+
+    r11f_ssa_vinsn_t setup[R11F_VEC_REGS];
+    uint32_t setup_count;
+    r11f_ssa_vinsn_t insns[OPT_MAX_VEC_INSNS];
+    uint32_t insn_count;
+
+    /* phis summing up a value of the body, and the register doing it */
+    uint32_t reduce_phis[R11F_VEC_REGS];
+    uint8_t reduce_regs[R11F_VEC_REGS];
+    uint32_t reduce_count;
+} vec_ctx_t;
+
+/* an allocation replace_allocations breaks into its elements. Values an
+   element has at the entry of each block are made on first use */
+typedef struct {
+    r11f_ssa_t *ssa;
+    uint32_t array;
+    uint32_t length;
+    /* block_count * length of them, R11F_SSA_NONE until asked for */
+    uint32_t *entry_defs;
+} scalar_ctx_t;
+
+static void *arena_alloc(r11f_ssa_t *ssa, size_t size);
+static void *arena_grow(r11f_ssa_t *ssa,
+                        void *data,
+                        uint32_t count,
+                        uint32_t *capacity,
+                        size_t item_size);
+
+static bool build_method(build_ctx_t *ctx);
+static bool analyze_blocks(build_ctx_t *ctx);
+static bool translate_block(build_ctx_t *ctx, uint32_t rb);
+static bool falls_through(uint16_t op);
+static bool translate_op(r11f_ssa_t *ssa,
+                         uint32_t block,
+                         r11f_regir_insn_t *insn,
+                         uint32_t *defs,
+                         uint32_t reg_count);
+static void check_element(r11f_ssa_t *ssa,
+                          uint32_t block,
+                          uint32_t array,
+                          uint32_t index);
+static uint8_t translate_cond(r11f_ssa_t *ssa,
+                              uint32_t block,
+                              r11f_regir_insn_t *insn,
+                              uint32_t a,
+                              uint32_t b,
+                              uint32_t *args);
+static bool translate_invoke(build_ctx_t *ctx,
+                             r11f_regir_insn_t *insn,
+                             uint32_t *block,
+                             uint32_t *defs);
+static int try_inline(build_ctx_t *ctx,
+                      r11f_regir_insn_t *insn,
+                      uint32_t *block,
+                      uint32_t *defs);
+static void callee_entry_defs(r11f_ssa_t *ssa,
+                              uint32_t block,
+                              r11f_linked_method_t *callee,
+                              uint32_t const *args,
+                              bool is_virtual,
+                              uint32_t *entry_defs);
+static bool add_deopt_point(build_ctx_t *ctx,
+                            r11f_linked_method_t *callee,
+                            uint32_t block,
+                            uint32_t *entry_defs);
+static uint32_t new_point(r11f_ssa_t *ssa,
+                          uint32_t block,
+                          uint16_t op,
+                          uint32_t frame_count,
+                          uint32_t argc);
+static bool add_loop(build_ctx_t *ctx,
+                     uint32_t block,
+                     uint32_t pc,
+                     uint32_t const *defs);
+static r11f_ssa_loop_t *new_loop(r11f_ssa_t *ssa,
+                                 uint32_t block,
+                                 uint32_t frame_count,
+                                 uint32_t argc);
+static bool add_dependency(r11f_ssa_t *ssa,
+                           r11f_cha_dependency_t const *dependency);
+static void fill_phis(build_ctx_t *ctx);
+static uint32_t *defs_of_pred(build_ctx_t *ctx, uint32_t pred);
+
+static uint32_t trace_walk(r11f_linked_method_t *method,
+                           uint32_t header,
+                           r11f_trace_event_t const *events,
+                           uint32_t event_count,
+                           trace_step_t *steps,
+                           bool *written);
+static bool trace_translate(trace_ctx_t *ctx, trace_step_t const *step);
+static bool trace_guard(trace_ctx_t *ctx,
+                        uint8_t cond,
+                        uint32_t const *args,
+                        uint32_t exit_pc);
+static uint32_t trace_exit(trace_ctx_t *ctx,
+                           trace_frame_t const *frames,
+                           uint32_t frame_count,
+                           uint32_t exit_pc);
+static void trace_hoist(trace_ctx_t *ctx, uint32_t first);
+static bool trace_invariant(trace_ctx_t *ctx, uint32_t value);
+
+static uint32_t new_value(r11f_ssa_t *ssa,
+                          uint32_t block,
+                          uint16_t op,
+                          uint32_t argc,
+                          uint32_t a,
+                          uint32_t b,
+                          int64_t imm);
+static uint32_t new_const(r11f_ssa_t *ssa, uint32_t block, int64_t value);
+static bool is_const(r11f_ssa_t *ssa, uint32_t value);
+
+static bool remove_trivial_phis(r11f_ssa_t *ssa);
+static bool fold_values(r11f_ssa_t *ssa);
+static bool fold_branches(r11f_ssa_t *ssa);
+static bool remove_unreachable(r11f_ssa_t *ssa);
+static void remove_edge(r11f_ssa_t *ssa, uint32_t from, uint32_t to);
+static void eliminate_dead_code(r11f_ssa_t *ssa);
+static void simplify(r11f_ssa_t *ssa);
+static void eliminate_checks(r11f_ssa_t *ssa);
+static bool compute_dominators(dom_tree_t *dom);
+static bool dominates(dom_tree_t *dom, uint32_t a, uint32_t b);
+static void remove_redundant_checks(dom_tree_t *dom);
+static uint32_t find_dominating(dom_tree_t *dom,
+                                uint32_t const *seen,
+                                uint32_t seen_count,
+                                uint32_t v);
+static void optimize_loop(dom_tree_t *dom, r11f_ssa_loop_t *loop);
+static uint32_t induction_start(r11f_ssa_t *ssa,
+                                uint32_t h,
+                                uint32_t entry,
+                                uint32_t phi);
+static void remove_loop_checks(dom_tree_t *dom,
+                               bool const *in_loop,
+                               uint32_t block,
+                               uint32_t iv,
+                               uint32_t init,
+                               uint32_t limit,
+                               loop_guard_t *guards,
+                               uint32_t *guard_count);
+static bool has_guard(loop_guard_t const *guards,
+                      uint32_t count,
+                      loop_guard_t const *guard);
+static bool loop_invariant(r11f_ssa_t *ssa, bool const *in_loop, uint32_t v);
+static void remove_null_checks(r11f_ssa_t *ssa,
+                               bool const *in_loop,
+                               uint32_t block_count,
+                               uint32_t array);
+static void add_loop_guards(r11f_ssa_t *ssa,
+                            r11f_ssa_loop_t const *loop,
+                            uint32_t entry,
+                            loop_guard_t const *guards,
+                            uint32_t guard_count);
+static uint32_t split_loop_entry(r11f_ssa_t *ssa, uint32_t h, uint32_t entry);
+static void vectorize_loops(r11f_ssa_t *ssa);
+static bool vectorize_loop(vec_ctx_t *ctx);
+static bool vec_reduction(vec_ctx_t *ctx, uint32_t phi);
+static uint32_t vec_loop_uses(vec_ctx_t *ctx, uint32_t v);
+static bool vec_value(vec_ctx_t *ctx, uint32_t v);
+static int vec_operand(vec_ctx_t *ctx, uint32_t v);
+static int vec_new_reg(vec_ctx_t *ctx, uint32_t v);
+static int vec_arg(vec_ctx_t *ctx, uint32_t v);
+static bool vec_emit(vec_ctx_t *ctx,
+                     bool setup,
+                     uint8_t op,
+                     int dst,
+                     int a,
+                     int b,
+                     uint8_t imm);
+static void vec_transform(vec_ctx_t *ctx);
+static bool replace_allocations(r11f_ssa_t *ssa);
+static bool scalar_candidate(r11f_ssa_t *ssa, uint32_t array);
+static bool scalar_index(r11f_ssa_t *ssa, uint32_t array, uint32_t index);
+static void scalar_replace(scalar_ctx_t *ctx);
+static uint32_t scalar_before(scalar_ctx_t *ctx, uint32_t v, uint32_t element);
+static uint32_t scalar_read(scalar_ctx_t *ctx,
+                            uint32_t block,
+                            uint32_t end,
+                            uint32_t element);
+static uint32_t scalar_entry(scalar_ctx_t *ctx,
+                             uint32_t block,
+                             uint32_t element);
+static void scalar_point(scalar_ctx_t *ctx, uint32_t point);
+static bool eval_op(uint16_t op, int64_t a, int64_t b, int64_t *out);
+static bool eval_cond(uint8_t cond, int64_t a, int64_t b);
+
+static r11f_error_t opt_compile(r11f_vm_t *vm,
+                                r11f_linked_method_t *method,
+                                uint32_t osr_pc,
+                                r11f_jit_code_t **output);
+
+R11F_EXPORT r11f_error_t r11f_opt_compile(r11f_vm_t *vm,
+                                          r11f_linked_method_t *method,
+                                          r11f_jit_code_t **output) {
+    return opt_compile(vm, method, R11F_SSA_NONE, output);
+}
+
+R11F_EXPORT r11f_error_t r11f_opt_compile_osr(r11f_vm_t *vm,
+                                              r11f_linked_method_t *method,
+                                              uint32_t pc,
+                                              r11f_jit_code_t **output) {
+    return opt_compile(vm, method, pc, output);
+}
+
+static r11f_error_t opt_compile(r11f_vm_t *vm,
+                                r11f_linked_method_t *method,
+                                uint32_t osr_pc,
+                                r11f_jit_code_t **output) {
+    r11f_ssa_t ssa;
+    r11f_error_t err = r11f_ssa_build(vm, method, osr_pc, &ssa);
+    if (err == R11F_success) {
+        r11f_ssa_optimize(&ssa);
+        err = ssa.oom ?
+            R11F_ERR_out_of_memory :
+            r11f_ssa_codegen(&ssa, output);
+    }
+    if (err == R11F_success) {
+        /* a class loaded meanwhile invalidates the code right away */
+        err = r11f_vm_add_dependencies(vm,
+                                       *output,
+                                       ssa.dependencies,
+                                       ssa.dependency_count);
+        if (err != R11F_success) {
+            r11f_jit_free(*output);
+        }
+    }
+    r11f_ssa_cleanup(&ssa);
+    return err;
+}
+
+R11F_INTERNAL r11f_error_t r11f_ssa_build(r11f_vm_t *vm,
+                                          r11f_linked_method_t *method,
+                                          uint32_t osr_pc,
+                                          r11f_ssa_t *ssa) {
+    memset(ssa, 0, sizeof(r11f_ssa_t));
+    ssa->method = method;
+    ssa->deopt_stress = vm->deopt_stress;
+    ssa->simd = r11f_ssa_simd_level();
+    if (vm->simd_level != R11F_SIMD_DEFAULT && vm->simd_level < ssa->simd) {
+        ssa->simd = vm->simd_level;
+    }
+    /* exception handlers continue in the interpreter */
+    if (!method->regir || method->handler_count) {
+        return R11F_ERR_not_implemented_instruction;
+    }
+
+    r11f_regir_loop_t *osr = NULL;
+    if (osr_pc != R11F_SSA_NONE) {
+        osr = r11f_regir_find_loop(method->regir, osr_pc);
+        if (!osr) {
+            return R11F_ERR_not_implemented_instruction;
+        }
+    }
+
+    /* the entry block loads the parameters and enters the method body */
+    uint32_t entry = r11f_ssa_new_block(ssa);
+    uint32_t reg_count = method->max_stack + method->max_locals;
+    uint32_t *defs = arena_alloc(ssa, (reg_count + 1) * sizeof(uint32_t));
+    if (ssa->oom) {
+        return R11F_ERR_out_of_memory;
+    }
+
+    uint32_t undef = new_const(ssa, entry, 0);
+    for (uint32_t i = 0; i < reg_count; i++) {
+        defs[i] = undef;
+    }
+
+    if (osr) {
+        /* whatever the interpreter left in the frame */
+        for (uint32_t i = 0; i < reg_count; i++) {
+            defs[i] = new_value(ssa, entry, R11F_SSA_param, 0, 0, 0, i);
+        }
+    }
+    else {
+        char const *desc = method->descriptor + 1;
+        uint16_t slot = 0;
+        while (*desc != ')') {
+            uint32_t param =
+                new_value(ssa, entry, R11F_SSA_param, 0, 0, 0, slot);
+            defs[slot] = param;
+            bool wide = (*desc == 'J' || *desc == 'D') && method->wide_args;
+            while (*desc == '[') {
+                desc++;
+            }
+            if (*desc == 'L') {
+                while (*desc != ';') {
+                    desc++;
+                }
+            }
+            desc++;
+            slot += wide ? 2 : 1;
+        }
+    }
+
+    build_ctx_t ctx = {
+        .vm = vm,
+        .ssa = ssa,
+        .parent = NULL,
+        .depth = 0,
+        .method = method,
+        .regir = method->regir,
+        .reg_count = reg_count,
+        .entry_block = entry,
+        .entry_defs = defs,
+        .entry_insn = osr ? osr->insn : 0,
+        .exit_block = R11F_SSA_NONE
+    };
+    if (!build_method(&ctx)) {
+        return ssa->oom ?
+            R11F_ERR_out_of_memory :
+            R11F_ERR_not_implemented_instruction;
+    }
+    return R11F_success;
+}
+
+R11F_INTERNAL r11f_error_t
+r11f_ssa_build_trace(r11f_linked_method_t *method,
+                     uint32_t header,
+                     r11f_trace_event_t const *events,
+                     uint32_t event_count,
+                     r11f_ssa_t *ssa) {
+    memset(ssa, 0, sizeof(r11f_ssa_t));
+    ssa->method = method;
+    ssa->simd = r11f_ssa_simd_level();
+    if (!method->regir || header >= method->regir->insn_count) {
+        return R11F_ERR_not_implemented_instruction;
+    }
+
+    uint32_t reg_count = method->max_stack + method->max_locals;
+    trace_step_t *steps = arena_alloc(ssa,
+                                      TRACE_MAX_STEPS * sizeof(trace_step_t));
+    bool *written = arena_alloc(ssa, reg_count * sizeof(bool));
+    uint32_t *entry_defs = arena_alloc(ssa, reg_count * sizeof(uint32_t));
+    uint32_t *defs = arena_alloc(ssa, reg_count * sizeof(uint32_t));
+    uint32_t *phis = arena_alloc(ssa, reg_count * sizeof(uint32_t));
+    trace_guard_t *guards =
+        arena_alloc(ssa, (event_count + 1) * sizeof(trace_guard_t));
+    if (ssa->oom) {
+        return R11F_ERR_out_of_memory;
+    }
+
+    /* registers of the traced method nothing on the path writes keep
+       their values all along */
+    memset(written, 0, reg_count * sizeof(bool));
+    uint32_t step_count =
+        trace_walk(method, header, events, event_count, steps, written);
+    if (!step_count) {
+        return R11F_ERR_not_implemented_instruction;
+    }
+
+    trace_ctx_t ctx = {
+        .ssa = ssa,
+        .entry = r11f_ssa_new_block(ssa),
+        .entry_defs = entry_defs,
+        .header = r11f_ssa_new_block(ssa),
+        .depth = 0,
+        .guards = guards,
+        .guard_count = 0
+    };
+    for (uint32_t i = 0; i < reg_count; i++) {
+        entry_defs[i] = new_value(ssa, ctx.entry, R11F_SSA_param, 0, 0, 0, i);
+        phis[i] = written[i] ?
+            new_value(ssa, ctx.header, R11F_SSA_phi, 0, 0, 0, 0) :
+            R11F_SSA_NONE;
+        defs[i] = written[i] ? phis[i] : entry_defs[i];
+    }
+    ctx.body = ctx.header;
+    ctx.frames[0] = (trace_frame_t) {
+        .method = method,
+        .pc = header,
+        .defs = defs
+    };
+    r11f_ssa_loop_t *loop = new_loop(ssa, ctx.header, 1, reg_count);
+    if (!loop) {
+        return R11F_ERR_out_of_memory;
+    }
+    loop->frames[0] = (r11f_deopt_frame_t) {
+        .method = method,
+        .pc = header,
+        .sp = 0
+    };
+    memcpy(loop->args, defs, reg_count * sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < step_count; i++) {
+        if (!trace_translate(&ctx, &steps[i])) {
+            return ssa->oom ?
+                R11F_ERR_out_of_memory :
+                R11F_ERR_not_implemented_instruction;
+        }
+    }
+
+    /* the hoisted guards leave before the first iteration, the frame
+       still as the interpreter left it */
+    trace_frame_t entry_frame = {
+        .method = method,
+        .pc = header,
+        .defs = entry_defs
+    };
+    uint32_t pre = ctx.entry;
+    for (uint32_t g = 0; g < ctx.guard_count; g++) {
+        trace_guard_t *guard = &guards[g];
+        if (!guard->hoisted) {
+            continue;
+        }
+        uint32_t next = r11f_ssa_new_block(ssa);
+        uint32_t exit = trace_exit(&ctx, &entry_frame, 1, header);
+        if (exit == R11F_SSA_NONE) {
+            return R11F_ERR_out_of_memory;
+        }
+        r11f_ssa_block_t *block = &ssa->blocks[pre];
+        block->term = R11F_SSA_BRANCH;
+        block->cond = guard->cond;
+        block->term_args[0] = guard->args[0];
+        block->term_args[1] = guard->args[1];
+        block->succs[0] = next;
+        block->succs[1] = exit;
+        r11f_ssa_add_pred(ssa, next, pre);
+        r11f_ssa_add_pred(ssa, exit, pre);
+        pre = next;
+    }
+
+    ssa->blocks[pre].term = R11F_SSA_JUMP;
+    ssa->blocks[pre].succs[0] = ctx.header;
+    ssa->blocks[ctx.body].term = R11F_SSA_JUMP;
+    ssa->blocks[ctx.body].succs[0] = ctx.header;
+    r11f_ssa_add_pred(ssa, ctx.header, pre);
+    r11f_ssa_add_pred(ssa, ctx.header, ctx.body);
+    for (uint32_t i = 0; i < reg_count; i++) {
+        if (phis[i] == R11F_SSA_NONE) {
+            continue;
+        }
+        uint32_t *args = arena_alloc(ssa, 2 * sizeof(uint32_t));
+        if (ssa->oom) {
+            return R11F_ERR_out_of_memory;
+        }
+        args[0] = entry_defs[i];
+        args[1] = defs[i];
+        ssa->values[phis[i]].argc = 2;
+        ssa->values[phis[i]].args = args;
+    }
+    return ssa->oom ? R11F_ERR_out_of_memory : R11F_success;
+}
+
+R11F_INTERNAL void r11f_ssa_optimize(r11f_ssa_t *ssa) {
+    simplify(ssa);
+    if (!ssa->oom) {
+        eliminate_checks(ssa);
+        simplify(ssa);
+    }
+    /* unused phis would still hold on to allocations */
+    eliminate_dead_code(ssa);
+    if (!ssa->oom && replace_allocations(ssa)) {
+        simplify(ssa);
+        eliminate_dead_code(ssa);
+    }
+    if (!ssa->oom && ssa->simd >= R11F_SIMD_SSE41) {
+        vectorize_loops(ssa);
+    }
+}
+
+R11F_INTERNAL void r11f_ssa_cleanup(r11f_ssa_t *ssa) {
+    arena_chunk_t *chunk = ssa->arena;
+    while (chunk) {
+        arena_chunk_t *next = chunk->next;
+        r11f_free(chunk);
+        chunk = next;
+    }
+    ssa->arena = NULL;
+}
+
+R11F_INTERNAL uint32_t r11f_ssa_resolve(r11f_ssa_t *ssa, uint32_t value) {
+    while (ssa->values[value].forward != R11F_SSA_NONE) {
+        value = ssa->values[value].forward;
+    }
+    return value;
+}
+
+R11F_INTERNAL uint32_t r11f_ssa_succ_count(r11f_ssa_block_t *block) {
+    switch (block->term) {
+        case R11F_SSA_JUMP: return 1;
+        case R11F_SSA_BRANCH: return 2;
+        default: return 0;
+    }
+}
+
+R11F_INTERNAL uint32_t r11f_ssa_new_block(r11f_ssa_t *ssa) {
+    if (ssa->block_count == ssa->block_capacity) {
+        ssa->blocks = arena_grow(ssa,
+                                 ssa->blocks,
+                                 ssa->block_count,
+                                 &ssa->block_capacity,
+                                 sizeof(r11f_ssa_block_t));
+        if (ssa->oom) {
+            return 0;
+        }
+    }
+
+    uint32_t id = ssa->block_count++;
+    memset(&ssa->blocks[id], 0, sizeof(r11f_ssa_block_t));
+    ssa->blocks[id].term = R11F_SSA_RETURN;
+    ssa->blocks[id].term_args[0] = R11F_SSA_NONE;
+    ssa->blocks[id].term_args[1] = R11F_SSA_NONE;
+    return id;
+}
+
+R11F_INTERNAL void r11f_ssa_add_pred(r11f_ssa_t *ssa,
+                                     uint32_t block,
+                                     uint32_t pred) {
+    r11f_ssa_block_t *b = &ssa->blocks[block];
+    if (b->pred_count == b->pred_capacity) {
+        b->preds = arena_grow(ssa,
+                              b->preds,
+                              b->pred_count,
+                              &b->pred_capacity,
+                              sizeof(uint32_t));
+        if (ssa->oom) {
+            return;
+        }
+    }
+    b->preds[b->pred_count++] = pred;
+}
+
+static void *arena_alloc(r11f_ssa_t *ssa, size_t size) {
+    size = (size + 7) & ~(size_t)7;
+
+    arena_chunk_t *chunk = ssa->arena;
+    if (!chunk || chunk->size - chunk->used < size) {
+        size_t chunk_size = size > 65536 ? size : 65536;
+        chunk = r11f_alloc(sizeof(arena_chunk_t) + chunk_size);
+        if (!chunk) {
+            ssa->oom = true;
+            return NULL;
+        }
+        chunk->next = ssa->arena;
+        chunk->used = 0;
+        chunk->size = chunk_size;
+        ssa->arena = chunk;
+    }
+
+    void *ret = (uint8_t*)chunk->data + chunk->used;
+    chunk->used += size;
+    return ret;
+}
+
+static void *arena_grow(r11f_ssa_t *ssa,
+                        void *data,
+                        uint32_t count,
+                        uint32_t *capacity,
+                        size_t item_size) {
+    uint32_t new_capacity = *capacity ? *capacity * 2 : 4;
+    void *new_data = arena_alloc(ssa, new_capacity * item_size);
+    if (!new_data) {
+        return data;
+    }
+    if (count) {
+        memcpy(new_data, data, count * item_size);
+    }
+    *capacity = new_capacity;
+    return new_data;
+}
+
+static bool build_method(build_ctx_t *ctx) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    if (!analyze_blocks(ctx)) {
+        return false;
+    }
+
+    uint32_t rb_count = ctx->rb_count;
+    ctx->head = arena_alloc(ssa, rb_count * sizeof(uint32_t));
+    ctx->tail = arena_alloc(ssa, rb_count * sizeof(uint32_t));
+    ctx->end_defs = arena_alloc(ssa, rb_count * sizeof(uint32_t*));
+    ctx->has_phis = arena_alloc(ssa, rb_count * sizeof(bool));
+    ctx->ret_values = arena_alloc(ssa,
+                                  ctx->regir->insn_count * sizeof(uint32_t));
+    if (ssa->oom) {
+        return false;
+    }
+
+    for (uint32_t rb = 0; rb < rb_count; rb++) {
+        ctx->head[rb] = r11f_ssa_new_block(ssa);
+        ctx->tail[rb] = R11F_SSA_NONE;
+        ctx->end_defs[rb] = NULL;
+
+        /* a block entered only from one block translated before it just
+           continues with its definitions, anything else starts with a
+           phi per register, most of which get removed again later */
+        if (rb == ctx->entry_rb) {
+            ctx->has_phis[rb] = ctx->rb_pred_count[rb] != 0;
+        }
+        else {
+            ctx->has_phis[rb] = ctx->rb_pred_count[rb] != 1
+                || ctx->rpo_index[ctx->rb_pred[rb]] >= ctx->rpo_index[rb];
+        }
+    }
+
+    ssa->blocks[ctx->entry_block].term = R11F_SSA_JUMP;
+    ssa->blocks[ctx->entry_block].succs[0] = ctx->head[ctx->entry_rb];
+    r11f_ssa_add_pred(ssa, ctx->head[ctx->entry_rb], ctx->entry_block);
+
+    for (uint32_t i = 0; i < ctx->rpo_count; i++) {
+        if (!translate_block(ctx, ctx->rpo[i])) {
+            return false;
+        }
+        if (ssa->value_count > OPT_MAX_VALUES) {
+            return false;
+        }
+    }
+
+    fill_phis(ctx);
+    return !ssa->oom;
+}
+
+static bool analyze_blocks(build_ctx_t *ctx) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    r11f_regir_t *regir = ctx->regir;
+    uint32_t insn_count = regir->insn_count;
+
+    bool *leader = arena_alloc(ssa, (insn_count + 1) * sizeof(bool));
+    if (ssa->oom) {
+        return false;
+    }
+    memset(leader, 0, (insn_count + 1) * sizeof(bool));
+    leader[0] = true;
+
+    for (uint32_t i = 0; i < insn_count; i++) {
+        r11f_regir_insn_t *insn = &regir->insns[i];
+        if (insn->op == R11F_RI_switch) {
+            return false;
+        }
+        if (insn->op >= R11F_RI_ifeq && insn->op <= R11F_RI_goto) {
+            leader[insn->dst] = true;
+            leader[i + 1] = true;
+        }
+        else if (!falls_through(insn->op)) {
+            leader[i + 1] = true;
+        }
+    }
+
+    uint32_t rb_count = 0;
+    for (uint32_t i = 0; i < insn_count; i++) {
+        rb_count += leader[i];
+    }
+
+    ctx->rb_count = rb_count;
+    ctx->rb_start = arena_alloc(ssa, rb_count * sizeof(uint32_t));
+    ctx->insn_rb = arena_alloc(ssa, insn_count * sizeof(uint32_t));
+    ctx->rb_pred_count = arena_alloc(ssa, rb_count * sizeof(uint32_t));
+    ctx->rb_pred = arena_alloc(ssa, rb_count * sizeof(uint32_t));
+    ctx->rpo = arena_alloc(ssa, rb_count * sizeof(uint32_t));
+    ctx->rpo_index = arena_alloc(ssa, rb_count * sizeof(uint32_t));
+    uint32_t *stack = arena_alloc(ssa, (rb_count + 1) * sizeof(uint32_t));
+    uint8_t *state = arena_alloc(ssa, rb_count);
+    if (ssa->oom) {
+        return false;
+    }
+
+    uint32_t rb = 0;
+    for (uint32_t i = 0; i < insn_count; i++) {
+        if (leader[i]) {
+            ctx->rb_start[rb++] = i;
+        }
+        ctx->insn_rb[i] = rb - 1;
+    }
+    if (ctx->entry_insn >= insn_count || !leader[ctx->entry_insn]) {
+        return false;
+    }
+    ctx->entry_rb = ctx->insn_rb[ctx->entry_insn];
+
+    /* successors of a block, taken branch first */
+    #define RB_END(RB) \
+        ((RB) + 1 < rb_count ? ctx->rb_start[(RB) + 1] : insn_count)
+
+    memset(ctx->rb_pred_count, 0, rb_count * sizeof(uint32_t));
+    memset(state, 0, rb_count);
+    for (uint32_t i = 0; i < rb_count; i++) {
+        ctx->rpo_index[i] = UINT32_MAX;
+    }
+
+    /* iterative depth first search for the reverse postorder */
+    uint32_t *postorder = ctx->rpo;
+    uint32_t post_count = 0;
+    uint32_t sp = 0;
+    stack[sp++] = ctx->entry_rb;
+    state[ctx->entry_rb] = 1;
+    while (sp) {
+        uint32_t cur = stack[sp - 1];
+        r11f_regir_insn_t *last = &regir->insns[RB_END(cur) - 1];
+        uint32_t succs[2];
+        uint32_t succ_count = 0;
+        if (last->op >= R11F_RI_ifeq && last->op <= R11F_RI_goto) {
+            succs[succ_count++] = ctx->insn_rb[last->dst];
+        }
+        if (falls_through(last->op)) {
+            if (RB_END(cur) >= insn_count) {
+                return false;
+            }
+            succs[succ_count++] = ctx->insn_rb[RB_END(cur)];
+        }
+
+        bool pushed = false;
+        for (uint32_t i = 0; i < succ_count; i++) {
+            if (state[succs[i]] == 0) {
+                state[succs[i]] = 1;
+                stack[sp++] = succs[i];
+                pushed = true;
+                break;
+            }
+        }
+        if (!pushed) {
+            sp--;
+            postorder[post_count++] = cur;
+            /* count each edge once, when its source is finished */
+            for (uint32_t i = 0; i < succ_count; i++) {
+                ctx->rb_pred_count[succs[i]]++;
+                ctx->rb_pred[succs[i]] = cur;
+            }
+        }
+    }
+    #undef RB_END
+
+    for (uint32_t i = 0; i < post_count / 2; i++) {
+        uint32_t t = postorder[i];
+        postorder[i] = postorder[post_count - 1 - i];
+        postorder[post_count - 1 - i] = t;
+    }
+    ctx->rpo_count = post_count;
+    for (uint32_t i = 0; i < post_count; i++) {
+        ctx->rpo_index[ctx->rpo[i]] = i;
+    }
+    return true;
+}
+
+static bool translate_block(build_ctx_t *ctx, uint32_t rb) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    r11f_regir_t *regir = ctx->regir;
+    uint32_t block = ctx->head[rb];
+    uint32_t *defs = arena_alloc(ssa, ctx->reg_count * sizeof(uint32_t));
+    if (ssa->oom) {
+        return false;
+    }
+
+    if (ctx->has_phis[rb]) {
+        for (uint32_t r = 0; r < ctx->reg_count; r++) {
+            defs[r] = new_value(ssa, block, R11F_SSA_phi, 0, 0, 0, 0);
+        }
+        for (uint32_t i = 0; i < regir->loop_count; i++) {
+            if (regir->loops[i].insn == ctx->rb_start[rb]
+                && !add_loop(ctx, block, ctx->rb_start[rb], defs)) {
+                return false;
+            }
+        }
+    }
+    else if (rb == ctx->entry_rb) {
+        memcpy(defs, ctx->entry_defs, ctx->reg_count * sizeof(uint32_t));
+    }
+    else {
+        memcpy(defs,
+               ctx->end_defs[ctx->rb_pred[rb]],
+               ctx->reg_count * sizeof(uint32_t));
+    }
+
+    uint32_t end = rb + 1 < ctx->rb_count ?
+        ctx->rb_start[rb + 1] :
+        regir->insn_count;
+    for (uint32_t i = ctx->rb_start[rb]; i < end; i++) {
+        r11f_regir_insn_t *insn = &regir->insns[i];
+        uint32_t a = insn->a < ctx->reg_count ? defs[insn->a] : 0;
+        uint32_t b = insn->b < ctx->reg_count ? defs[insn->b] : 0;
+        r11f_ssa_block_t *cur = NULL;
+
+        switch (insn->op) {
+            case R11F_RI_ifeq: case R11F_RI_ifne: case R11F_RI_iflt:
+            case R11F_RI_ifge: case R11F_RI_ifgt: case R11F_RI_ifle:
+            case R11F_RI_if_icmpeq: case R11F_RI_if_icmpne:
+            case R11F_RI_if_icmplt: case R11F_RI_if_icmpge:
+            case R11F_RI_if_icmpgt: case R11F_RI_if_icmple:
+            case R11F_RI_if_icmpeqi: case R11F_RI_if_icmpnei:
+            case R11F_RI_if_icmplti: case R11F_RI_if_icmpgei:
+            case R11F_RI_if_icmpgti: case R11F_RI_if_icmplei: {
+                uint32_t args[2];
+                uint8_t cond = translate_cond(ssa, block, insn, a, b, args);
+                cur = &ssa->blocks[block];
+                cur->term = R11F_SSA_BRANCH;
+                cur->cond = cond;
+                cur->term_args[0] = args[0];
+                cur->term_args[1] = args[1];
+                cur->succs[0] = ctx->head[ctx->insn_rb[insn->dst]];
+                cur->succs[1] = ctx->head[ctx->insn_rb[i + 1]];
+                break;
+            }
+            case R11F_RI_goto:
+                cur = &ssa->blocks[block];
+                cur->term = R11F_SSA_JUMP;
+                cur->succs[0] = ctx->head[ctx->insn_rb[insn->dst]];
+                break;
+
+            case R11F_RI_return:
+            case R11F_RI_ireturn:
+            case R11F_RI_lreturn:
+                cur = &ssa->blocks[block];
+                if (ctx->exit_block == R11F_SSA_NONE) {
+                    cur->term = R11F_SSA_RETURN;
+                    cur->returns_value = insn->op != R11F_RI_return;
+                    cur->term_args[0] = a;
+                }
+                else {
+                    cur->term = R11F_SSA_JUMP;
+                    cur->succs[0] = ctx->exit_block;
+                    ctx->ret_values[ctx->ret_count++] = a;
+                }
+                break;
+
+            case R11F_RI_invokestatic:
+            case R11F_RI_invokevirtual:
+                if (!translate_invoke(ctx, insn, &block, defs)) {
+                    return false;
+                }
+                break;
+
+            default:
+                if (!translate_op(ssa, block, insn, defs, ctx->reg_count)) {
+                    return false;
+                }
+                break;
+        }
+        if (ssa->oom) {
+            return false;
+        }
+    }
+
+    r11f_ssa_block_t *last = &ssa->blocks[block];
+    uint32_t last_op = regir->insns[end - 1].op;
+    if (falls_through(last_op)
+        && !(last_op >= R11F_RI_ifeq && last_op <= R11F_RI_if_icmplei)) {
+        /* falls through into the next block */
+        last->term = R11F_SSA_JUMP;
+        last->succs[0] = ctx->head[ctx->insn_rb[end]];
+    }
+
+    ctx->tail[rb] = block;
+    ctx->end_defs[rb] = defs;
+    for (uint32_t s = 0; s < r11f_ssa_succ_count(last); s++) {
+        r11f_ssa_add_pred(ssa, ssa->blocks[block].succs[s], block);
+    }
+    return !ssa->oom;
+}
+
+static bool falls_through(uint16_t op) {
+    return op != R11F_RI_goto
+        && op != R11F_RI_switch
+        && op != R11F_RI_return
+        && op != R11F_RI_ireturn
+        && op != R11F_RI_lreturn;
+}
+
+/* the instructions that only compute a value, false for anything else */
+static bool translate_op(r11f_ssa_t *ssa,
+                         uint32_t block,
+                         r11f_regir_insn_t *insn,
+                         uint32_t *defs,
+                         uint32_t reg_count) {
+    uint32_t a = insn->a < reg_count ? defs[insn->a] : 0;
+    uint32_t b = insn->b < reg_count ? defs[insn->b] : 0;
+    switch (insn->op) {
+        case R11F_RI_nop:
+        /* compiled code never parks */
+        case R11F_RI_yield:
+            break;
+        case R11F_RI_mov:
+            defs[insn->dst] = a;
+            break;
+        case R11F_RI_movi:
+            defs[insn->dst] = new_const(ssa, block, insn->imm);
+            break;
+
+#define BINOP(CODE) \
+        case R11F_RI_##CODE: \
+            defs[insn->dst] = \
+                new_value(ssa, block, R11F_SSA_##CODE, 2, a, b, 0); \
+            break;
+#define BINOP_IMM(CODE, OP, IMM) \
+        case R11F_RI_##CODE: \
+            defs[insn->dst] = new_value( \
+                ssa, block, R11F_SSA_##OP, 2, \
+                a, new_const(ssa, block, (IMM)), 0 \
+            ); \
+            break;
+#define UNOP(CODE) \
+        case R11F_RI_##CODE: \
+            defs[insn->dst] = \
+                new_value(ssa, block, R11F_SSA_##CODE, 1, a, 0, 0); \
+            break;
+
+        BINOP(iadd) BINOP(isub) BINOP(imul) BINOP(idiv) BINOP(irem)
+        BINOP(ishl) BINOP(ishr) BINOP(iushr)
+        BINOP(iand) BINOP(ior) BINOP(ixor)
+        BINOP(ladd) BINOP(lsub) BINOP(lmul) BINOP(ldiv) BINOP(lrem)
+        BINOP(lshl) BINOP(lshr) BINOP(lushr)
+        BINOP(land) BINOP(lor) BINOP(lxor)
+        BINOP(lcmp)
+        BINOP_IMM(iaddi, iadd, (int32_t)insn->imm)
+        BINOP_IMM(imuli, imul, (int32_t)insn->imm)
+        BINOP_IMM(ishli, ishl, (int32_t)insn->imm)
+        BINOP_IMM(ishri, ishr, (int32_t)insn->imm)
+        BINOP_IMM(iushri, iushr, (int32_t)insn->imm)
+        BINOP_IMM(iandi, iand, (int32_t)insn->imm)
+        BINOP_IMM(iori, ior, (int32_t)insn->imm)
+        BINOP_IMM(ixori, ixor, (int32_t)insn->imm)
+        BINOP_IMM(laddi, ladd, insn->imm)
+        UNOP(ineg) UNOP(lneg)
+        UNOP(i2l) UNOP(l2i) UNOP(i2b) UNOP(i2c) UNOP(i2s)
+
+#undef BINOP
+#undef BINOP_IMM
+#undef UNOP
+
+        case R11F_RI_intrinsic: {
+            uint16_t argc = r11f_nativefn_argc((uint16_t)insn->imm);
+            b = argc > 1 ? defs[insn->a + 1] : 0;
+            defs[insn->dst] = new_value(ssa, block, R11F_SSA_intrinsic, argc,
+                                        a, b, insn->imm);
+            break;
+        }
+        case R11F_RI_newarray:
+            defs[insn->dst] =
+                new_value(ssa, block, R11F_SSA_newarray, 1, a, 0, 0);
+            break;
+        case R11F_RI_arraylength:
+            new_value(ssa, block, R11F_SSA_nullchk, 1, a, 0, 0);
+            defs[insn->dst] =
+                new_value(ssa, block, R11F_SSA_alength, 1, a, 0, 0);
+            break;
+        case R11F_RI_iaload:
+            check_element(ssa, block, a, b);
+            defs[insn->dst] =
+                new_value(ssa, block, R11F_SSA_iaload, 2, a, b, 0);
+            break;
+        case R11F_RI_iastore: {
+            check_element(ssa, block, a, b);
+            uint32_t store =
+                new_value(ssa, block, R11F_SSA_iastore, 3, a, b, 0);
+            if (!ssa->oom) {
+                ssa->values[store].args[2] = defs[insn->dst];
+            }
+            break;
+        }
+
+        default:
+            return false;
+    }
+    return true;
+}
+
+/* the checks ahead of an access to element `index` of `array` */
+static void check_element(r11f_ssa_t *ssa,
+                          uint32_t block,
+                          uint32_t array,
+                          uint32_t index) {
+    new_value(ssa, block, R11F_SSA_nullchk, 1, array, 0, 0);
+    uint32_t length = new_value(ssa, block, R11F_SSA_alength, 1, array, 0, 0);
+    new_value(ssa, block, R11F_SSA_boundschk, 2, index, length, 0);
+}
+
+/* condition and compared operands of a conditional branch, constants
+   get created in `block` */
+static uint8_t translate_cond(r11f_ssa_t *ssa,
+                              uint32_t block,
+                              r11f_regir_insn_t *insn,
+                              uint32_t a,
+                              uint32_t b,
+                              uint32_t *args) {
+    args[0] = a;
+    if (insn->op <= R11F_RI_ifle) {
+        args[1] = new_const(ssa, block, 0);
+        return (uint8_t)(insn->op - R11F_RI_ifeq);
+    }
+    if (insn->op <= R11F_RI_if_icmple) {
+        args[1] = b;
+        return (uint8_t)(insn->op - R11F_RI_if_icmpeq);
+    }
+    args[1] = new_const(ssa, block, (int32_t)insn->imm);
+    return (uint8_t)(insn->op - R11F_RI_if_icmpeqi);
+}
+
+static bool translate_invoke(build_ctx_t *ctx,
+                             r11f_regir_insn_t *insn,
+                             uint32_t *block,
+                             uint32_t *defs) {
+    int inlined = try_inline(ctx, insn, block, defs);
+    if (inlined != 0) {
+        return inlined > 0;
+    }
+
+    r11f_ssa_t *ssa = ctx->ssa;
+    uint16_t index = (uint16_t)insn->imm;
+    r11f_class_t *clazz = ctx->method->clazz;
+    r11f_method_qual_name_t qual_name =
+        r11f_class_get_method_name(clazz, clazz->constant_pool[index]);
+    char const *return_type = qual_name.descriptor;
+    while (*return_type != ')') {
+        return_type++;
+    }
+
+    bool is_virtual = insn->op == R11F_RI_invokevirtual;
+    uint32_t argc = r11f_descriptor_argc(qual_name.descriptor) + is_virtual;
+    uint32_t call = new_value(ssa, *block, R11F_SSA_call, 0, 0, 0, index);
+    uint32_t *args = arena_alloc(ssa, (argc + 1) * sizeof(uint32_t));
+    if (ssa->oom) {
+        return false;
+    }
+    for (uint32_t i = 0; i < argc; i++) {
+        args[i] = defs[insn->a + i];
+    }
+
+    r11f_ssa_value_t *value = &ssa->values[call];
+    value->argc = argc;
+    value->args = args;
+    value->caller = clazz;
+    value->has_result = return_type[1] != 'V';
+    value->is_virtual = is_virtual;
+    if (value->has_result) {
+        defs[insn->dst] = call;
+    }
+    return true;
+}
+
+/* 1 when inlined, 0 when a call is needed instead, -1 on failure */
+static int try_inline(build_ctx_t *ctx,
+                      r11f_regir_insn_t *insn,
+                      uint32_t *block,
+                      uint32_t *defs) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    if (ctx->depth >= OPT_INLINE_MAX_DEPTH) {
+        return 0;
+    }
+
+    /* resolving may load the class, a failure is left to the call. A
+       virtual call is inlined when class hierarchy analysis finds a
+       single target */
+    bool is_virtual = insn->op == R11F_RI_invokevirtual;
+    r11f_cha_dependency_t dependency;
+    r11f_linked_method_t *callee = is_virtual ?
+        r11f_vm_link_virtual(ctx->vm,
+                             ctx->method->clazz,
+                             (uint16_t)insn->imm,
+                             &dependency) :
+        r11f_vm_link_static(ctx->vm, ctx->method->clazz, (uint16_t)insn->imm);
+    if (!callee || !callee->code) {
+        return 0;
+    }
+    if (!callee->regir
+        || callee->regir->insn_count > OPT_INLINE_MAX_INSNS
+        || callee->regir->switch_count
+        || callee->handler_count
+        || callee->regir->throw_count) {
+        return 0;
+    }
+    for (build_ctx_t *c = ctx; c; c = c->parent) {
+        if (c->method == callee) {
+            return 0;
+        }
+    }
+
+    uint32_t reg_count = callee->max_stack + callee->max_locals;
+    uint32_t *entry_defs = arena_alloc(ssa, reg_count * sizeof(uint32_t));
+    if (ssa->oom) {
+        return -1;
+    }
+    callee_entry_defs(ssa, *block, callee, defs + insn->a, is_virtual,
+                      entry_defs);
+
+    /* the callee could be left before running any of it. Receivers of
+       classes loaded after compiling need the call dispatched again */
+    ctx->call_insn = insn;
+    ctx->call_defs = defs;
+    if (is_virtual) {
+        if (!add_deopt_point(ctx, NULL, *block, NULL)
+            || !add_dependency(ssa, &dependency)) {
+            return -1;
+        }
+        new_value(ssa, *block, R11F_SSA_nullchk, 1, defs[insn->a], 0, 0);
+    }
+    else if (!add_deopt_point(ctx, callee, *block, entry_defs)) {
+        return -1;
+    }
+
+    build_ctx_t inner = {
+        .vm = ctx->vm,
+        .ssa = ssa,
+        .parent = ctx,
+        .depth = ctx->depth + 1,
+        .method = callee,
+        .regir = callee->regir,
+        .reg_count = reg_count,
+        .entry_block = *block,
+        .entry_defs = entry_defs,
+        .exit_block = r11f_ssa_new_block(ssa)
+    };
+    bool built = build_method(&inner);
+    ctx->call_insn = NULL;
+    ctx->call_defs = NULL;
+    if (!built) {
+        return -1;
+    }
+
+    uint32_t exit = inner.exit_block;
+    if (callee->return_type != 'V') {
+        uint32_t result;
+        if (inner.ret_count == 1) {
+            result = inner.ret_values[0];
+        }
+        else {
+            result = new_value(ssa, exit, R11F_SSA_phi, 0, 0, 0, 0);
+            ssa->values[result].argc = inner.ret_count;
+            ssa->values[result].args = inner.ret_values;
+        }
+        defs[insn->dst] = result;
+    }
+
+    ssa->inlined_count++;
+    *block = exit;
+    return ssa->oom ? -1 : 1;
+}
+
+/* registers of a callee entered with `args`, the receiver of a virtual
+   call first; the ones not holding a parameter are zero */
+static void callee_entry_defs(r11f_ssa_t *ssa,
+                              uint32_t block,
+                              r11f_linked_method_t *callee,
+                              uint32_t const *args,
+                              bool is_virtual,
+                              uint32_t *entry_defs) {
+    uint32_t reg_count = callee->max_stack + callee->max_locals;
+    uint32_t undef = new_const(ssa, block, 0);
+    for (uint32_t i = 0; i < reg_count; i++) {
+        entry_defs[i] = undef;
+    }
+
+    /* the receiver goes to local 0 */
+    char const *desc = callee->descriptor + 1;
+    uint32_t arg = is_virtual;
+    uint16_t slot = is_virtual;
+    entry_defs[0] = args[0];
+    while (*desc != ')') {
+        entry_defs[slot] = args[arg];
+        bool wide = (*desc == 'J' || *desc == 'D') && callee->wide_args;
+        while (*desc == '[') {
+            desc++;
+        }
+        if (*desc == 'L') {
+            while (*desc != ';') {
+                desc++;
+            }
+        }
+        desc++;
+        arg++;
+        slot += wide ? 2 : 1;
+    }
+}
+
+/* a deopt value at the entry of an inlined callee: every enclosing
+   method waits in its call, the callee starts from scratch. Without a
+   callee ctx itself resumes at its call instead, making it again */
+static bool add_deopt_point(build_ctx_t *ctx,
+                            r11f_linked_method_t *callee,
+                            uint32_t block,
+                            uint32_t *entry_defs) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    uint32_t frame_count = ctx->depth + (callee ? 2 : 1);
+    uint32_t callee_regs = callee ? callee->max_stack + callee->max_locals : 0;
+    uint32_t argc = callee_regs;
+    for (build_ctx_t *c = ctx; c; c = c->parent) {
+        argc += c->reg_count;
+    }
+
+    uint32_t deopt = new_point(ssa, block, R11F_SSA_deopt, frame_count, argc);
+    if (deopt == R11F_SSA_NONE) {
+        return false;
+    }
+    r11f_deopt_frame_t *frames =
+        ssa->deopt_points[ssa->values[deopt].imm].frames;
+    uint32_t *args = ssa->values[deopt].args;
+
+    /* filled back to front, the callee's values come last */
+    uint32_t f = frame_count;
+    uint32_t at = argc - callee_regs;
+    if (callee) {
+        f--;
+        frames[f] = (r11f_deopt_frame_t) { .method = callee, .pc = 0, .sp = 0 };
+        memcpy(args + at, entry_defs, callee_regs * sizeof(uint32_t));
+    }
+    for (build_ctx_t *c = ctx; c; c = c->parent) {
+        f--;
+        at -= c->reg_count;
+        uint32_t call = (uint32_t)(c->call_insn - c->regir->insns);
+        bool waits = callee || c != ctx;
+        frames[f] = (r11f_deopt_frame_t) {
+            .method = c->method,
+            .pc = waits ? call + 1 : call,
+            .sp = waits ? c->call_insn->dst : 0
+        };
+        memcpy(args + at, c->call_defs, c->reg_count * sizeof(uint32_t));
+    }
+
+    return true;
+}
+
+/* the state a loop header at instruction `pc` is entered with, every
+   enclosing method waiting in its call */
+static bool add_loop(build_ctx_t *ctx,
+                     uint32_t block,
+                     uint32_t pc,
+                     uint32_t const *defs) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    uint32_t frame_count = ctx->depth + 1;
+    uint32_t argc = 0;
+    for (build_ctx_t *c = ctx; c; c = c->parent) {
+        argc += c->reg_count;
+    }
+
+    r11f_ssa_loop_t *loop = new_loop(ssa, block, frame_count, argc);
+    if (!loop) {
+        return false;
+    }
+
+    /* filled back to front like add_deopt_point does */
+    uint32_t f = frame_count - 1;
+    uint32_t at = argc - ctx->reg_count;
+    loop->frames[f] = (r11f_deopt_frame_t) {
+        .method = ctx->method,
+        .pc = pc,
+        .sp = 0
+    };
+    memcpy(loop->args + at, defs, ctx->reg_count * sizeof(uint32_t));
+    for (build_ctx_t *c = ctx->parent; c; c = c->parent) {
+        f--;
+        at -= c->reg_count;
+        uint32_t call = (uint32_t)(c->call_insn - c->regir->insns);
+        loop->frames[f] = (r11f_deopt_frame_t) {
+            .method = c->method,
+            .pc = call + 1,
+            .sp = c->call_insn->dst
+        };
+        memcpy(loop->args + at, c->call_defs, c->reg_count * sizeof(uint32_t));
+    }
+    return true;
+}
+
+static r11f_ssa_loop_t *new_loop(r11f_ssa_t *ssa,
+                                 uint32_t block,
+                                 uint32_t frame_count,
+                                 uint32_t argc) {
+    if (ssa->loop_count == ssa->loop_capacity) {
+        ssa->loops = arena_grow(ssa,
+                                ssa->loops,
+                                ssa->loop_count,
+                                &ssa->loop_capacity,
+                                sizeof(r11f_ssa_loop_t));
+    }
+    r11f_deopt_frame_t *frames =
+        arena_alloc(ssa, frame_count * sizeof(r11f_deopt_frame_t));
+    uint32_t *args = arena_alloc(ssa, argc * sizeof(uint32_t));
+    if (ssa->oom) {
+        return NULL;
+    }
+
+    r11f_ssa_loop_t *loop = &ssa->loops[ssa->loop_count++];
+    *loop = (r11f_ssa_loop_t) {
+        .block = block,
+        .frame_count = frame_count,
+        .frames = frames,
+        .argc = argc,
+        .args = args
+    };
+    return loop;
+}
+
+/* a deopt or exit value at the end of `block` with a new point of
+   `frame_count` frames and `argc` values, both left to fill */
+static uint32_t new_point(r11f_ssa_t *ssa,
+                          uint32_t block,
+                          uint16_t op,
+                          uint32_t frame_count,
+                          uint32_t argc) {
+    if (ssa->deopt_count == ssa->deopt_capacity) {
+        ssa->deopt_points = arena_grow(ssa,
+                                       ssa->deopt_points,
+                                       ssa->deopt_count,
+                                       &ssa->deopt_capacity,
+                                       sizeof(r11f_deopt_point_t));
+    }
+    r11f_deopt_frame_t *frames =
+        arena_alloc(ssa, frame_count * sizeof(r11f_deopt_frame_t));
+    uint32_t point = new_value(ssa, block, op, 0, 0, 0, ssa->deopt_count);
+    uint32_t *args = arena_alloc(ssa, argc * sizeof(uint32_t));
+    if (ssa->oom) {
+        return R11F_SSA_NONE;
+    }
+
+    ssa->deopt_points[ssa->deopt_count++] = (r11f_deopt_point_t) {
+        .frame_count = frame_count,
+        .frames = frames
+    };
+    ssa->values[point].argc = argc;
+    ssa->values[point].args = args;
+    return point;
+}
+
+static bool add_dependency(r11f_ssa_t *ssa,
+                           r11f_cha_dependency_t const *dependency) {
+    if (ssa->dependency_count == ssa->dependency_capacity) {
+        ssa->dependencies = arena_grow(ssa,
+                                       ssa->dependencies,
+                                       ssa->dependency_count,
+                                       &ssa->dependency_capacity,
+                                       sizeof(r11f_cha_dependency_t));
+        if (ssa->oom) {
+            return false;
+        }
+    }
+    ssa->dependencies[ssa->dependency_count++] = *dependency;
+    return true;
+}
+
+static void fill_phis(build_ctx_t *ctx) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    for (uint32_t rb = 0; rb < ctx->rb_count; rb++) {
+        if (!ctx->has_phis[rb] || ctx->tail[rb] == R11F_SSA_NONE) {
+            continue;
+        }
+
+        r11f_ssa_block_t *head = &ssa->blocks[ctx->head[rb]];
+        uint32_t pred_count = head->pred_count;
+        uint32_t **pred_defs =
+            arena_alloc(ssa, (pred_count + 1) * sizeof(uint32_t*));
+        if (ssa->oom) {
+            return;
+        }
+        for (uint32_t p = 0; p < pred_count; p++) {
+            pred_defs[p] = defs_of_pred(ctx, head->preds[p]);
+        }
+
+        for (uint32_t r = 0; r < ctx->reg_count; r++) {
+            uint32_t phi = head->values[r];
+            uint32_t *args =
+                arena_alloc(ssa, (pred_count + 1) * sizeof(uint32_t));
+            if (ssa->oom) {
+                return;
+            }
+            for (uint32_t p = 0; p < pred_count; p++) {
+                args[p] = pred_defs[p][r];
+            }
+            ssa->values[phi].argc = pred_count;
+            ssa->values[phi].args = args;
+        }
+    }
+}
+
+static uint32_t *defs_of_pred(build_ctx_t *ctx, uint32_t pred) {
+    if (pred == ctx->entry_block) {
+        return ctx->entry_defs;
+    }
+    for (uint32_t rb = 0; rb < ctx->rb_count; rb++) {
+        if (ctx->tail[rb] == pred) {
+            return ctx->end_defs[rb];
+        }
+    }
+    assert(false && "predecessor outside of the method");
+    return ctx->entry_defs;
+}
+
+/* follows the recorded events from the header back to it, one step per
+   instruction run; the number of steps, 0 when the events do not fit
+   the code or lead somewhere a trace cannot go */
+static uint32_t trace_walk(r11f_linked_method_t *method,
+                           uint32_t header,
+                           r11f_trace_event_t const *events,
+                           uint32_t event_count,
+                           trace_step_t *steps,
+                           bool *written) {
+    r11f_linked_method_t *callers[R11F_TRACE_MAX_DEPTH];
+    uint32_t call_pcs[R11F_TRACE_MAX_DEPTH];
+    uint32_t depth = 0;
+    uint32_t e = 0;
+    uint32_t count = 0;
+    r11f_linked_method_t *cur = method;
+    uint32_t pc = header;
+
+    for (;;) {
+        if (count == TRACE_MAX_STEPS || pc >= cur->regir->insn_count) {
+            return 0;
+        }
+        r11f_regir_insn_t *insn = &cur->regir->insns[pc];
+        steps[count++] = (trace_step_t) {
+            .method = cur,
+            .pc = pc,
+            .next = pc + 1,
+            .callee = NULL
+        };
+
+        uint16_t op = insn->op;
+        if (op >= R11F_RI_ifeq && op <= R11F_RI_goto) {
+            r11f_trace_event_t const *event = &events[e];
+            if (e++ == event_count
+                || event->method != cur
+                || event->pc != pc
+                || event->callee
+                || (event->target != insn->dst
+                    && (op == R11F_RI_goto || event->target != pc + 1))) {
+                return 0;
+            }
+            steps[count - 1].next = event->target;
+            if (depth == 0 && event->target == header) {
+                return e == event_count ? count : 0;
+            }
+            pc = event->target;
+        }
+        else if (op == R11F_RI_invokestatic) {
+            r11f_trace_event_t const *event = &events[e];
+            if (e++ == event_count
+                || event->method != cur
+                || event->pc != pc
+                || !event->callee
+                || !event->callee->regir
+                || depth == R11F_TRACE_MAX_DEPTH) {
+                return 0;
+            }
+            steps[count - 1].callee = event->callee;
+            if (depth == 0) {
+                written[insn->dst] = true;
+            }
+            callers[depth] = cur;
+            call_pcs[depth] = pc;
+            depth++;
+            cur = event->callee;
+            pc = 0;
+        }
+        else if (op == R11F_RI_return
+                 || op == R11F_RI_ireturn
+                 || op == R11F_RI_lreturn) {
+            if (depth == 0) {
+                return 0;
+            }
+            depth--;
+            cur = callers[depth];
+            pc = call_pcs[depth] + 1;
+        }
+        else if (op == R11F_RI_switch || op == R11F_RI_invokevirtual) {
+            return 0;
+        }
+        else {
+            /* iastore has its stored value in dst */
+            if (depth == 0
+                && op != R11F_RI_nop
+                && op != R11F_RI_yield
+                && op != R11F_RI_iastore) {
+                written[insn->dst] = true;
+            }
+            pc++;
+        }
+    }
+}
+
+static bool trace_translate(trace_ctx_t *ctx, trace_step_t const *step) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    trace_frame_t *frame = &ctx->frames[ctx->depth];
+    r11f_linked_method_t *method = step->method;
+    r11f_regir_insn_t *insn = &method->regir->insns[step->pc];
+    uint32_t reg_count = method->max_stack + method->max_locals;
+    uint32_t *defs = frame->defs;
+    frame->pc = step->pc;
+
+    switch (insn->op) {
+        case R11F_RI_ifeq: case R11F_RI_ifne: case R11F_RI_iflt:
+        case R11F_RI_ifge: case R11F_RI_ifgt: case R11F_RI_ifle:
+        case R11F_RI_if_icmpeq: case R11F_RI_if_icmpne:
+        case R11F_RI_if_icmplt: case R11F_RI_if_icmpge:
+        case R11F_RI_if_icmpgt: case R11F_RI_if_icmple:
+        case R11F_RI_if_icmpeqi: case R11F_RI_if_icmpnei:
+        case R11F_RI_if_icmplti: case R11F_RI_if_icmpgei:
+        case R11F_RI_if_icmpgti: case R11F_RI_if_icmplei: {
+            if (insn->dst == step->pc + 1) {
+                return true;
+            }
+            uint32_t a = insn->a < reg_count ? defs[insn->a] : 0;
+            uint32_t b = insn->b < reg_count ? defs[insn->b] : 0;
+            uint32_t args[2];
+            uint8_t cond = translate_cond(ssa, ctx->entry, insn, a, b, args);
+            /* the guard holds when the branch goes where it did while
+               recording */
+            bool taken = step->next == insn->dst;
+            return trace_guard(ctx,
+                               taken ? cond : cond ^ 1,
+                               args,
+                               taken ? step->pc + 1 : insn->dst);
+        }
+        case R11F_RI_goto:
+            return true;
+
+        case R11F_RI_invokestatic: {
+            r11f_linked_method_t *callee = step->callee;
+            uint32_t *entry_defs = arena_alloc(
+                ssa,
+                (callee->max_stack + callee->max_locals) * sizeof(uint32_t)
+            );
+            if (ssa->oom) {
+                return false;
+            }
+            callee_entry_defs(ssa, ctx->entry, callee, defs + insn->a, false,
+                              entry_defs);
+            ctx->depth++;
+            ctx->frames[ctx->depth] = (trace_frame_t) {
+                .method = callee,
+                .pc = 0,
+                .defs = entry_defs
+            };
+            ssa->inlined_count++;
+            return !ssa->oom;
+        }
+
+        case R11F_RI_return:
+        case R11F_RI_ireturn:
+        case R11F_RI_lreturn: {
+            ctx->depth--;
+            trace_frame_t *caller = &ctx->frames[ctx->depth];
+            r11f_regir_insn_t *call = &caller->method->regir->insns[caller->pc];
+            if (insn->op != R11F_RI_return) {
+                caller->defs[call->dst] = defs[insn->a];
+            }
+            return true;
+        }
+
+        default: {
+            uint32_t first = ssa->blocks[ctx->body].value_count;
+            if (!translate_op(ssa, ctx->body, insn, defs, reg_count)) {
+                return false;
+            }
+            trace_hoist(ctx, first);
+            return !ssa->oom;
+        }
+    }
+}
+
+/* repeats of an earlier guard are dropped, guards on invariant values
+   wait for the loop to be closed */
+static bool trace_guard(trace_ctx_t *ctx,
+                        uint8_t cond,
+                        uint32_t const *args,
+                        uint32_t exit_pc) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    for (uint32_t g = 0; g < ctx->guard_count; g++) {
+        trace_guard_t *guard = &ctx->guards[g];
+        if (guard->cond == cond
+            && guard->args[0] == args[0]
+            && guard->args[1] == args[1]) {
+            return true;
+        }
+    }
+
+    bool hoisted = trace_invariant(ctx, args[0])
+        && trace_invariant(ctx, args[1]);
+    ctx->guards[ctx->guard_count++] = (trace_guard_t) {
+        .cond = cond,
+        .args = { args[0], args[1] },
+        .hoisted = hoisted
+    };
+    if (hoisted) {
+        return true;
+    }
+
+    uint32_t next = r11f_ssa_new_block(ssa);
+    uint32_t exit = trace_exit(ctx, ctx->frames, ctx->depth + 1, exit_pc);
+    if (exit == R11F_SSA_NONE) {
+        return false;
+    }
+    r11f_ssa_block_t *block = &ssa->blocks[ctx->body];
+    block->term = R11F_SSA_BRANCH;
+    block->cond = cond;
+    block->term_args[0] = args[0];
+    block->term_args[1] = args[1];
+    block->succs[0] = next;
+    block->succs[1] = exit;
+    r11f_ssa_add_pred(ssa, next, ctx->body);
+    r11f_ssa_add_pred(ssa, exit, ctx->body);
+    ctx->body = next;
+    return !ssa->oom;
+}
+
+/* a block leaving to the interpreter: the innermost frame continues at
+   `exit_pc`, the others wait for their callees */
+static uint32_t trace_exit(trace_ctx_t *ctx,
+                           trace_frame_t const *frames,
+                           uint32_t frame_count,
+                           uint32_t exit_pc) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    uint32_t argc = 0;
+    for (uint32_t f = 0; f < frame_count; f++) {
+        argc += frames[f].method->max_stack + frames[f].method->max_locals;
+    }
+
+    uint32_t block = r11f_ssa_new_block(ssa);
+    uint32_t exit = new_point(ssa, block, R11F_SSA_exit, frame_count, argc);
+    if (exit == R11F_SSA_NONE) {
+        return R11F_SSA_NONE;
+    }
+    r11f_deopt_frame_t *states =
+        ssa->deopt_points[ssa->values[exit].imm].frames;
+    uint32_t *args = ssa->values[exit].args;
+
+    uint32_t at = 0;
+    for (uint32_t f = 0; f < frame_count; f++) {
+        r11f_linked_method_t *method = frames[f].method;
+        uint32_t count = method->max_stack + method->max_locals;
+        bool waits = f + 1 < frame_count;
+        states[f] = (r11f_deopt_frame_t) {
+            .method = method,
+            .pc = waits ? frames[f].pc + 1 : exit_pc,
+            .sp = waits ? method->regir->insns[frames[f].pc].dst : 0
+        };
+        memcpy(args + at, frames[f].defs, count * sizeof(uint32_t));
+        at += count;
+    }
+    ssa->blocks[block].term = R11F_SSA_EXIT;
+    return block;
+}
+
+/* values translated from `first` on move ahead of the loop when they
+   only depend on invariant values and cannot trap. Checks and array
+   accesses stay, eliminate_checks takes care of those */
+static void trace_hoist(trace_ctx_t *ctx, uint32_t first) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    r11f_ssa_block_t *body = &ssa->blocks[ctx->body];
+    r11f_ssa_block_t *entry = &ssa->blocks[ctx->entry];
+    uint32_t kept = first;
+    for (uint32_t i = first; i < body->value_count; i++) {
+        uint32_t v = body->values[i];
+        r11f_ssa_value_t *value = &ssa->values[v];
+        bool hoist = (value->op == R11F_SSA_const
+                      || value->op >= R11F_SSA_iadd)
+            && value->op != R11F_SSA_idiv
+            && value->op != R11F_SSA_irem
+            && value->op != R11F_SSA_ldiv
+            && value->op != R11F_SSA_lrem;
+        for (uint32_t j = 0; hoist && j < value->argc; j++) {
+            hoist = trace_invariant(ctx, value->args[j]);
+        }
+        if (!hoist) {
+            body->values[kept++] = v;
+            continue;
+        }
+
+        if (entry->value_count == entry->value_capacity) {
+            entry->values = arena_grow(ssa,
+                                       entry->values,
+                                       entry->value_count,
+                                       &entry->value_capacity,
+                                       sizeof(uint32_t));
+            if (ssa->oom) {
+                return;
+            }
+        }
+        entry->values[entry->value_count++] = v;
+        value->block = ctx->entry;
+    }
+    body->value_count = kept;
+}
+
+static bool trace_invariant(trace_ctx_t *ctx, uint32_t value) {
+    return ctx->ssa->values[value].block == ctx->entry;
+}
+
+static uint32_t new_value(r11f_ssa_t *ssa,
+                          uint32_t block,
+                          uint16_t op,
+                          uint32_t argc,
+                          uint32_t a,
+                          uint32_t b,
+                          int64_t imm) {
+    if (ssa->value_count == ssa->value_capacity) {
+        ssa->values = arena_grow(ssa,
+                                 ssa->values,
+                                 ssa->value_count,
+                                 &ssa->value_capacity,
+                                 sizeof(r11f_ssa_value_t));
+    }
+    r11f_ssa_block_t *bb = &ssa->blocks[block];
+    if (bb->value_count == bb->value_capacity) {
+        bb->values = arena_grow(ssa,
+                                bb->values,
+                                bb->value_count,
+                                &bb->value_capacity,
+                                sizeof(uint32_t));
+    }
+    uint32_t *args = argc ? arena_alloc(ssa, argc * sizeof(uint32_t)) : NULL;
+    if (ssa->oom) {
+        return 0;
+    }
+
+    uint32_t id = ssa->value_count++;
+    if (argc > 0) {
+        args[0] = a;
+    }
+    if (argc > 1) {
+        args[1] = b;
+    }
+    ssa->values[id] = (r11f_ssa_value_t) {
+        .op = op,
+        .dead = false,
+        .block = block,
+        .forward = R11F_SSA_NONE,
+        .argc = argc,
+        .args = args,
+        .imm = imm,
+        .caller = NULL,
+        .has_result = false
+    };
+    bb->values[bb->value_count++] = id;
+    return id;
+}
+
+static uint32_t new_const(r11f_ssa_t *ssa, uint32_t block, int64_t value) {
+    return new_value(ssa, block, R11F_SSA_const, 0, 0, 0, value);
+}
+
+static bool is_const(r11f_ssa_t *ssa, uint32_t value) {
+    return ssa->values[value].op == R11F_SSA_const;
+}
+
+static bool remove_trivial_phis(r11f_ssa_t *ssa) {
+    bool changed = false;
+    for (uint32_t v = 0; v < ssa->value_count; v++) {
+        r11f_ssa_value_t *value = &ssa->values[v];
+        if (value->op != R11F_SSA_phi
+            || value->dead
+            || value->forward != R11F_SSA_NONE) {
+            continue;
+        }
+
+        uint32_t unique = R11F_SSA_NONE;
+        bool trivial = true;
+        for (uint32_t i = 0; i < value->argc; i++) {
+            uint32_t arg = r11f_ssa_resolve(ssa, value->args[i]);
+            if (arg == v || arg == unique) {
+                continue;
+            }
+            if (unique != R11F_SSA_NONE) {
+                trivial = false;
+                break;
+            }
+            unique = arg;
+        }
+
+        if (trivial) {
+            if (unique == R11F_SSA_NONE) {
+                /* only reachable through itself, the value is unused */
+                value->op = R11F_SSA_const;
+                value->argc = 0;
+                value->imm = 0;
+            }
+            else {
+                value->forward = unique;
+                value->dead = true;
+            }
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+static bool fold_values(r11f_ssa_t *ssa) {
+    bool changed = false;
+    for (uint32_t v = 0; v < ssa->value_count; v++) {
+        r11f_ssa_value_t *value = &ssa->values[v];
+        if (value->dead
+            || value->forward != R11F_SSA_NONE
+            || value->op < R11F_SSA_iadd) {
+            continue;
+        }
+
+        for (uint32_t i = 0; i < value->argc; i++) {
+            value->args[i] = r11f_ssa_resolve(ssa, value->args[i]);
+        }
+        uint32_t a = value->args[0];
+        uint32_t b = value->argc > 1 ? value->args[1] : a;
+        bool a_const = is_const(ssa, a);
+        bool b_const = is_const(ssa, b);
+        int64_t a_imm = ssa->values[a].imm;
+        int64_t b_imm = ssa->values[b].imm;
+
+        int64_t result;
+        if (value->op == R11F_SSA_intrinsic) {
+            if (a_const && b_const) {
+                r11f_value_t args[2] = { { .i64 = a_imm }, { .i64 = b_imm } };
+                uint16_t fn = (uint16_t)value->imm;
+                r11f_value_t ret = r11f_nativefn_call(fn, args);
+                value->op = R11F_SSA_const;
+                value->argc = 0;
+                value->imm = r11f_nativefn_wide(fn) ? ret.i64 : ret.i32;
+                changed = true;
+            }
+            continue;
+        }
+        if (a_const && b_const && eval_op(value->op, a_imm, b_imm, &result)) {
+            value->op = R11F_SSA_const;
+            value->argc = 0;
+            value->imm = result;
+            changed = true;
+            continue;
+        }
+
+        uint32_t same = R11F_SSA_NONE;
+        switch (value->op) {
+            case R11F_SSA_iadd: case R11F_SSA_ladd:
+            case R11F_SSA_ior: case R11F_SSA_lor:
+            case R11F_SSA_ixor: case R11F_SSA_lxor:
+                if (b_const && b_imm == 0) {
+                    same = a;
+                }
+                else if (a_const && a_imm == 0) {
+                    same = b;
+                }
+                break;
+            case R11F_SSA_isub: case R11F_SSA_lsub:
+                if (b_const && b_imm == 0) {
+                    same = a;
+                }
+                break;
+            case R11F_SSA_imul: case R11F_SSA_lmul:
+                if (b_const && b_imm == 1) {
+                    same = a;
+                }
+                else if (a_const && a_imm == 1) {
+                    same = b;
+                }
+                break;
+            case R11F_SSA_idiv: case R11F_SSA_ldiv:
+                if (b_const && b_imm == 1) {
+                    same = a;
+                }
+                break;
+            case R11F_SSA_iand:
+                if (b_const && (int32_t)b_imm == -1) {
+                    same = a;
+                }
+                break;
+            case R11F_SSA_land:
+                if (b_const && b_imm == -1) {
+                    same = a;
+                }
+                break;
+            case R11F_SSA_ishl: case R11F_SSA_ishr: case R11F_SSA_iushr:
+                if (b_const && (b_imm & 31) == 0) {
+                    same = a;
+                }
+                break;
+            case R11F_SSA_lshl: case R11F_SSA_lshr: case R11F_SSA_lushr:
+                if (b_const && (b_imm & 63) == 0) {
+                    same = a;
+                }
+                break;
+            case R11F_SSA_l2i:
+                /* narrowing a widened int gives the int back */
+                if (ssa->values[a].op == R11F_SSA_i2l) {
+                    same = r11f_ssa_resolve(ssa, ssa->values[a].args[0]);
+                }
+                break;
+        }
+
+        if (same != R11F_SSA_NONE) {
+            value->forward = same;
+            value->dead = true;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+static bool fold_branches(r11f_ssa_t *ssa) {
+    bool changed = false;
+    for (uint32_t b = 0; b < ssa->block_count; b++) {
+        r11f_ssa_block_t *block = &ssa->blocks[b];
+        if (block->term != R11F_SSA_BRANCH) {
+            continue;
+        }
+
+        uint32_t x = r11f_ssa_resolve(ssa, block->term_args[0]);
+        uint32_t y = r11f_ssa_resolve(ssa, block->term_args[1]);
+        block->term_args[0] = x;
+        block->term_args[1] = y;
+
+        uint32_t taken;
+        if (block->succs[0] == block->succs[1]) {
+            taken = 0;
+        }
+        else if (is_const(ssa, x) && is_const(ssa, y)) {
+            int64_t a = ssa->values[x].imm;
+            int64_t b = ssa->values[y].imm;
+            if (!block->wide) {
+                a = (int32_t)a;
+                b = (int32_t)b;
+            }
+            taken = eval_cond(block->cond, a, b) ? 0 : 1;
+        }
+        else {
+            continue;
+        }
+
+        uint32_t keep = block->succs[taken];
+        uint32_t drop = block->succs[1 - taken];
+        block->term = R11F_SSA_JUMP;
+        block->succs[0] = keep;
+        remove_edge(ssa, b, drop);
+        changed = true;
+    }
+    return changed;
+}
+
+static bool remove_unreachable(r11f_ssa_t *ssa) {
+    uint32_t block_count = ssa->block_count;
+    bool *reachable = r11f_alloc_zeroed(block_count * sizeof(bool));
+    uint32_t *worklist = r11f_alloc((block_count + 1) * sizeof(uint32_t));
+    if (!reachable || !worklist) {
+        r11f_free(reachable);
+        r11f_free(worklist);
+        ssa->oom = true;
+        return false;
+    }
+
+    uint32_t count = 0;
+    worklist[count++] = 0;
+    reachable[0] = true;
+    while (count) {
+        r11f_ssa_block_t *block = &ssa->blocks[worklist[--count]];
+        for (uint32_t s = 0; s < r11f_ssa_succ_count(block); s++) {
+            if (!reachable[block->succs[s]]) {
+                reachable[block->succs[s]] = true;
+                worklist[count++] = block->succs[s];
+            }
+        }
+    }
+
+    bool changed = false;
+    for (uint32_t b = 0; b < block_count; b++) {
+        r11f_ssa_block_t *block = &ssa->blocks[b];
+        if (reachable[b]) {
+            continue;
+        }
+
+        while (r11f_ssa_succ_count(block)) {
+            uint32_t succ = block->succs[r11f_ssa_succ_count(block) - 1];
+            block->term = block->term == R11F_SSA_BRANCH ?
+                R11F_SSA_JUMP :
+                R11F_SSA_RETURN;
+            block->returns_value = false;
+            remove_edge(ssa, b, succ);
+            changed = true;
+        }
+        for (uint32_t i = 0; i < block->value_count; i++) {
+            ssa->values[block->values[i]].dead = true;
+        }
+        block->pred_count = 0;
+    }
+
+    r11f_free(reachable);
+    r11f_free(worklist);
+    return changed;
+}
+
+static void remove_edge(r11f_ssa_t *ssa, uint32_t from, uint32_t to) {
+    r11f_ssa_block_t *block = &ssa->blocks[to];
+    for (uint32_t i = 0; i < block->pred_count; i++) {
+        if (block->preds[i] != from) {
+            continue;
+        }
+
+        for (uint32_t j = i + 1; j < block->pred_count; j++) {
+            block->preds[j - 1] = block->preds[j];
+        }
+        block->pred_count--;
+
+        for (uint32_t k = 0; k < block->value_count; k++) {
+            r11f_ssa_value_t *phi = &ssa->values[block->values[k]];
+            if (phi->op != R11F_SSA_phi || phi->argc <= i) {
+                continue;
+            }
+            for (uint32_t j = i + 1; j < phi->argc; j++) {
+                phi->args[j - 1] = phi->args[j];
+            }
+            phi->argc--;
+        }
+        return;
+    }
+}
+
+static void eliminate_dead_code(r11f_ssa_t *ssa) {
+    uint32_t value_count = ssa->value_count;
+    bool *live = r11f_alloc_zeroed(value_count * sizeof(bool));
+    uint32_t *worklist = r11f_alloc((value_count + 1) * sizeof(uint32_t));
+    if (!live || !worklist) {
+        r11f_free(live);
+        r11f_free(worklist);
+        ssa->oom = true;
+        return;
+    }
+
+    uint32_t count = 0;
+    #define MARK(V) \
+        do { \
+            uint32_t v_ = r11f_ssa_resolve(ssa, (V)); \
+            if (!live[v_]) { \
+                live[v_] = true; \
+                worklist[count++] = v_; \
+            } \
+        } while (0)
+
+    for (uint32_t b = 0; b < ssa->block_count; b++) {
+        r11f_ssa_block_t *block = &ssa->blocks[b];
+        if (b != 0 && !block->pred_count) {
+            continue;
+        }
+
+        if (block->term == R11F_SSA_BRANCH) {
+            MARK(block->term_args[0]);
+            MARK(block->term_args[1]);
+        }
+        else if (block->term == R11F_SSA_RETURN && block->returns_value) {
+            MARK(block->term_args[0]);
+        }
+
+        for (uint32_t i = 0; i < block->value_count; i++) {
+            uint32_t v = block->values[i];
+            r11f_ssa_value_t *value = &ssa->values[v];
+            if (value->dead || value->forward != R11F_SSA_NONE) {
+                continue;
+            }
+
+            /* calls, deopts, exits, checks, array allocations and
+               stores, vector loops and possibly trapping divisions
+               must stay */
+            bool effect = value->op == R11F_SSA_call
+                || value->op == R11F_SSA_deopt
+                || value->op == R11F_SSA_exit
+                || value->op == R11F_SSA_nullchk
+                || value->op == R11F_SSA_boundschk
+                || value->op == R11F_SSA_newarray
+                || value->op == R11F_SSA_iastore
+                || value->op == R11F_SSA_vloop;
+            if (value->op == R11F_SSA_idiv || value->op == R11F_SSA_irem
+                || value->op == R11F_SSA_ldiv || value->op == R11F_SSA_lrem) {
+                uint32_t divisor = r11f_ssa_resolve(ssa, value->args[1]);
+                effect = !is_const(ssa, divisor)
+                    || ssa->values[divisor].imm == 0;
+            }
+            if (effect) {
+                MARK(v);
+            }
+        }
+    }
+
+    while (count) {
+        r11f_ssa_value_t *value = &ssa->values[worklist[--count]];
+        for (uint32_t i = 0; i < value->argc; i++) {
+            MARK(value->args[i]);
+        }
+    }
+    #undef MARK
+
+    for (uint32_t v = 0; v < value_count; v++) {
+        if (!live[v]) {
+            ssa->values[v].dead = true;
+        }
+    }
+
+    r11f_free(live);
+    r11f_free(worklist);
+}
+
+static void simplify(r11f_ssa_t *ssa) {
+    bool changed = true;
+    while (changed && !ssa->oom) {
+        changed = false;
+        changed |= remove_trivial_phis(ssa);
+        changed |= fold_values(ssa);
+        changed |= fold_branches(ssa);
+        changed |= remove_unreachable(ssa);
+    }
+}
+
+static void eliminate_checks(r11f_ssa_t *ssa) {
+    dom_tree_t dom = { .ssa = ssa, .block_count = ssa->block_count };
+    if (compute_dominators(&dom)) {
+        remove_redundant_checks(&dom);
+        for (uint32_t i = 0; i < ssa->loop_count && !ssa->oom; i++) {
+            optimize_loop(&dom, &ssa->loops[i]);
+        }
+    }
+    else {
+        ssa->oom = true;
+    }
+    r11f_free(dom.rpo);
+    r11f_free(dom.rpo_index);
+    r11f_free(dom.idom);
+}
+
+/* Cooper, Harvey and Kennedy's iteration over reverse postorder */
+static bool compute_dominators(dom_tree_t *dom) {
+    r11f_ssa_t *ssa = dom->ssa;
+    uint32_t block_count = dom->block_count;
+    dom->rpo = r11f_alloc(block_count * sizeof(uint32_t));
+    dom->rpo_index = r11f_alloc(block_count * sizeof(uint32_t));
+    dom->idom = r11f_alloc(block_count * sizeof(uint32_t));
+    uint32_t *stack = r11f_alloc(block_count * sizeof(uint32_t));
+    uint32_t *next = r11f_alloc_zeroed(block_count * sizeof(uint32_t));
+    if (!dom->rpo || !dom->rpo_index || !dom->idom || !stack || !next) {
+        r11f_free(stack);
+        r11f_free(next);
+        return false;
+    }
+
+    for (uint32_t b = 0; b < block_count; b++) {
+        dom->rpo_index[b] = R11F_SSA_NONE;
+        dom->idom[b] = R11F_SSA_NONE;
+    }
+
+    /* postorder first, rpo_index marks the blocks seen */
+    uint32_t order = block_count;
+    uint32_t depth = 0;
+    stack[depth++] = 0;
+    dom->rpo_index[0] = 0;
+    while (depth) {
+        uint32_t b = stack[depth - 1];
+        r11f_ssa_block_t *block = &ssa->blocks[b];
+        if (next[b] < r11f_ssa_succ_count(block)) {
+            uint32_t succ = block->succs[next[b]++];
+            if (dom->rpo_index[succ] == R11F_SSA_NONE) {
+                dom->rpo_index[succ] = 0;
+                stack[depth++] = succ;
+            }
+            continue;
+        }
+        dom->rpo[--order] = b;
+        depth--;
+    }
+    dom->rpo_count = block_count - order;
+    memmove(dom->rpo, dom->rpo + order, dom->rpo_count * sizeof(uint32_t));
+    for (uint32_t i = 0; i < dom->rpo_count; i++) {
+        dom->rpo_index[dom->rpo[i]] = i;
+    }
+    r11f_free(stack);
+    r11f_free(next);
+
+    dom->idom[0] = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t i = 1; i < dom->rpo_count; i++) {
+            uint32_t b = dom->rpo[i];
+            r11f_ssa_block_t *block = &ssa->blocks[b];
+            uint32_t idom = R11F_SSA_NONE;
+            for (uint32_t p = 0; p < block->pred_count; p++) {
+                uint32_t pred = block->preds[p];
+                if (dom->idom[pred] == R11F_SSA_NONE) {
+                    continue;
+                }
+                if (idom == R11F_SSA_NONE) {
+                    idom = pred;
+                    continue;
+                }
+                while (idom != pred) {
+                    while (dom->rpo_index[idom] > dom->rpo_index[pred]) {
+                        idom = dom->idom[idom];
+                    }
+                    while (dom->rpo_index[pred] > dom->rpo_index[idom]) {
+                        pred = dom->idom[pred];
+                    }
+                }
+            }
+            if (dom->idom[b] != idom) {
+                dom->idom[b] = idom;
+                changed = true;
+            }
+        }
+    }
+    return true;
+}
+
+/* blocks added since the tree was built dominate nothing */
+static bool dominates(dom_tree_t *dom, uint32_t a, uint32_t b) {
+    if (a >= dom->block_count || b >= dom->block_count
+        || dom->rpo_index[a] == R11F_SSA_NONE
+        || dom->rpo_index[b] == R11F_SSA_NONE) {
+        return false;
+    }
+    while (b != a && b != 0) {
+        b = dom->idom[b];
+    }
+    return b == a;
+}
+
+/* checks repeating a dominating one, null checks of fresh arrays,
+   bounds checks of constants and lengths of arrays allocated right
+   here go away */
+static void remove_redundant_checks(dom_tree_t *dom) {
+    r11f_ssa_t *ssa = dom->ssa;
+    uint32_t *seen = r11f_alloc((ssa->value_count + 1) * sizeof(uint32_t));
+    if (!seen) {
+        ssa->oom = true;
+        return;
+    }
+
+    uint32_t seen_count = 0;
+    for (uint32_t i = 0; i < dom->rpo_count; i++) {
+        r11f_ssa_block_t *block = &ssa->blocks[dom->rpo[i]];
+        for (uint32_t j = 0; j < block->value_count; j++) {
+            uint32_t v = block->values[j];
+            r11f_ssa_value_t *value = &ssa->values[v];
+            if (value->dead
+                || value->forward != R11F_SSA_NONE
+                || (value->op != R11F_SSA_nullchk
+                    && value->op != R11F_SSA_boundschk
+                    && value->op != R11F_SSA_alength)) {
+                continue;
+            }
+            for (uint32_t k = 0; k < value->argc; k++) {
+                value->args[k] = r11f_ssa_resolve(ssa, value->args[k]);
+            }
+
+            r11f_ssa_value_t *def = &ssa->values[value->args[0]];
+            if (def->op == R11F_SSA_newarray
+                && value->op == R11F_SSA_alength) {
+                value->forward = r11f_ssa_resolve(ssa, def->args[0]);
+                value->dead = true;
+                continue;
+            }
+            if (def->op == R11F_SSA_newarray
+                && value->op == R11F_SSA_nullchk) {
+                value->dead = true;
+                continue;
+            }
+            if (value->op == R11F_SSA_boundschk
+                && is_const(ssa, value->args[0])
+                && is_const(ssa, value->args[1])
+                && (uint32_t)def->imm
+                    < (uint32_t)ssa->values[value->args[1]].imm) {
+                value->dead = true;
+                continue;
+            }
+
+            uint32_t same = find_dominating(dom, seen, seen_count, v);
+            if (same == R11F_SSA_NONE) {
+                seen[seen_count++] = v;
+                continue;
+            }
+            if (value->op == R11F_SSA_alength) {
+                value->forward = same;
+            }
+            value->dead = true;
+        }
+    }
+    r11f_free(seen);
+}
+
+static uint32_t find_dominating(dom_tree_t *dom,
+                                uint32_t const *seen,
+                                uint32_t seen_count,
+                                uint32_t v) {
+    r11f_ssa_t *ssa = dom->ssa;
+    r11f_ssa_value_t *value = &ssa->values[v];
+    for (uint32_t i = 0; i < seen_count; i++) {
+        r11f_ssa_value_t *other = &ssa->values[seen[i]];
+        if (other->dead || other->op != value->op) {
+            continue;
+        }
+        bool same = true;
+        for (uint32_t k = 0; same && k < value->argc; k++) {
+            same = r11f_ssa_resolve(ssa, other->args[k]) == value->args[k];
+        }
+        if (same && dominates(dom, other->block, value->block)) {
+            return seen[i];
+        }
+    }
+    return R11F_SSA_NONE;
+}
+
+/* Bounds checks of an induction variable counting up from its start by
+   one, in blocks only reached while it is below some limit, hold for
+   every iteration once the start is not negative and the limit is not
+   above the array length. Where that is not known statically, guards
+   ahead of the loop make sure of it and leave to the interpreter at the
+   loop header otherwise */
+static void optimize_loop(dom_tree_t *dom, r11f_ssa_loop_t *loop) {
+    r11f_ssa_t *ssa = dom->ssa;
+    uint32_t h = loop->block;
+    if (!dominates(dom, h, h)) {
+        return;
+    }
+
+    uint32_t entry = R11F_SSA_NONE;
+    r11f_ssa_block_t *header = &ssa->blocks[h];
+    for (uint32_t p = 0; p < header->pred_count; p++) {
+        if (dominates(dom, h, header->preds[p])) {
+            continue;
+        }
+        if (entry != R11F_SSA_NONE) {
+            return;
+        }
+        entry = p;
+    }
+    if (entry == R11F_SSA_NONE || header->pred_count < 2) {
+        return;
+    }
+
+    /* the natural loop, walking back from the latches to the header */
+    uint32_t block_count = ssa->block_count;
+    bool *in_loop = r11f_alloc_zeroed(block_count * sizeof(bool));
+    uint32_t *worklist = r11f_alloc(block_count * sizeof(uint32_t));
+    if (!in_loop || !worklist) {
+        r11f_free(in_loop);
+        r11f_free(worklist);
+        ssa->oom = true;
+        return;
+    }
+    uint32_t count = 0;
+    in_loop[h] = true;
+    for (uint32_t p = 0; p < header->pred_count; p++) {
+        if (p != entry && !in_loop[header->preds[p]]) {
+            in_loop[header->preds[p]] = true;
+            worklist[count++] = header->preds[p];
+        }
+    }
+    while (count) {
+        r11f_ssa_block_t *block = &ssa->blocks[worklist[--count]];
+        for (uint32_t p = 0; p < block->pred_count; p++) {
+            if (!in_loop[block->preds[p]]) {
+                in_loop[block->preds[p]] = true;
+                worklist[count++] = block->preds[p];
+            }
+        }
+    }
+
+    loop_guard_t guards[OPT_MAX_LOOP_GUARDS];
+    uint32_t guard_count = 0;
+    for (uint32_t t = 0; t < dom->block_count; t++) {
+        r11f_ssa_block_t *test = &ssa->blocks[t];
+        if (!in_loop[t] || test->term != R11F_SSA_BRANCH || test->wide) {
+            continue;
+        }
+        for (uint32_t k = 0; k < 2; k++) {
+            uint32_t s = test->succs[k];
+            if (s >= dom->block_count
+                || !in_loop[s]
+                || ssa->blocks[s].pred_count != 1) {
+                continue;
+            }
+
+            /* the induction variable is below the limit within s */
+            uint8_t cond = k == 0 ? test->cond : test->cond ^ 1;
+            uint32_t iv = r11f_ssa_resolve(ssa, test->term_args[0]);
+            uint32_t limit = r11f_ssa_resolve(ssa, test->term_args[1]);
+            if (cond == R11F_SSA_GT) {
+                uint32_t swap = iv;
+                iv = limit;
+                limit = swap;
+                cond = R11F_SSA_LT;
+            }
+            uint32_t init = induction_start(ssa, h, entry, iv);
+            if (cond != R11F_SSA_LT || init == R11F_SSA_NONE) {
+                continue;
+            }
+            bool every_iteration = true;
+            for (uint32_t p = 0; every_iteration && p < header->pred_count;
+                 p++) {
+                every_iteration = p == entry
+                    || dominates(dom, s, header->preds[p]);
+            }
+            if (!every_iteration) {
+                continue;
+            }
+
+            for (uint32_t c = 0; c < dom->block_count; c++) {
+                if (in_loop[c] && dominates(dom, s, c)) {
+                    remove_loop_checks(dom, in_loop, c, iv, init, limit,
+                                       guards, &guard_count);
+                }
+            }
+        }
+    }
+
+    if (guard_count) {
+        add_loop_guards(ssa, loop, entry, guards, guard_count);
+    }
+    r11f_free(in_loop);
+    r11f_free(worklist);
+}
+
+/* the value `phi` of header `h` starts with when entered through
+   preds[entry], if every other edge steps it by one */
+static uint32_t induction_start(r11f_ssa_t *ssa,
+                                uint32_t h,
+                                uint32_t entry,
+                                uint32_t phi) {
+    r11f_ssa_value_t *value = &ssa->values[phi];
+    if (value->op != R11F_SSA_phi
+        || value->block != h
+        || value->dead
+        || value->argc != ssa->blocks[h].pred_count) {
+        return R11F_SSA_NONE;
+    }
+    for (uint32_t i = 0; i < value->argc; i++) {
+        if (i == entry) {
+            continue;
+        }
+        r11f_ssa_value_t *step =
+            &ssa->values[r11f_ssa_resolve(ssa, value->args[i])];
+        if (step->op != R11F_SSA_iadd) {
+            return R11F_SSA_NONE;
+        }
+        uint32_t a = r11f_ssa_resolve(ssa, step->args[0]);
+        uint32_t b = r11f_ssa_resolve(ssa, step->args[1]);
+        uint32_t other = a == phi ? b : b == phi ? a : R11F_SSA_NONE;
+        if (other == R11F_SSA_NONE
+            || !is_const(ssa, other)
+            || ssa->values[other].imm != 1) {
+            return R11F_SSA_NONE;
+        }
+    }
+    return r11f_ssa_resolve(ssa, value->args[entry]);
+}
+
+/* bounds checks of `iv` in `block`, known to be below `limit` there */
+static void remove_loop_checks(dom_tree_t *dom,
+                               bool const *in_loop,
+                               uint32_t block,
+                               uint32_t iv,
+                               uint32_t init,
+                               uint32_t limit,
+                               loop_guard_t *guards,
+                               uint32_t *guard_count) {
+    r11f_ssa_t *ssa = dom->ssa;
+    r11f_ssa_block_t *bb = &ssa->blocks[block];
+    for (uint32_t i = 0; i < bb->value_count; i++) {
+        r11f_ssa_value_t *check = &ssa->values[bb->values[i]];
+        if (check->op != R11F_SSA_boundschk
+            || check->dead
+            || r11f_ssa_resolve(ssa, check->args[0]) != iv) {
+            continue;
+        }
+
+        loop_guard_t needed[3];
+        uint32_t needed_count = 0;
+        if (!is_const(ssa, init) || (int32_t)ssa->values[init].imm < 0) {
+            needed[needed_count++] = (loop_guard_t) {
+                .cond = R11F_SSA_GE,
+                .lhs = init,
+                .rhs = R11F_SSA_NONE,
+                .array = R11F_SSA_NONE
+            };
+        }
+
+        uint32_t length = r11f_ssa_resolve(ssa, check->args[1]);
+        r11f_ssa_value_t *len = &ssa->values[length];
+        r11f_ssa_value_t *lim = &ssa->values[limit];
+        bool covered = length == limit
+            || (len->op == R11F_SSA_alength
+                && lim->op == R11F_SSA_alength
+                && r11f_ssa_resolve(ssa, len->args[0])
+                    == r11f_ssa_resolve(ssa, lim->args[0]));
+        uint32_t array = R11F_SSA_NONE;
+        if (!covered) {
+            /* the limit and the length must be known before the loop,
+               the length of an array the loop does not change is */
+            if (len->op == R11F_SSA_alength) {
+                array = r11f_ssa_resolve(ssa, len->args[0]);
+            }
+            if (!loop_invariant(ssa, in_loop, limit)
+                || (array == R11F_SSA_NONE
+                    && !loop_invariant(ssa, in_loop, length))
+                || (array != R11F_SSA_NONE
+                    && (is_const(ssa, array)
+                        || !loop_invariant(ssa, in_loop, array)))) {
+                continue;
+            }
+            if (array != R11F_SSA_NONE) {
+                needed[needed_count++] = (loop_guard_t) {
+                    .cond = R11F_SSA_NE,
+                    .wide = true,
+                    .lhs = array,
+                    .rhs = R11F_SSA_NONE,
+                    .array = R11F_SSA_NONE
+                };
+            }
+            needed[needed_count++] = (loop_guard_t) {
+                .cond = R11F_SSA_LE,
+                .lhs = limit,
+                .rhs = array == R11F_SSA_NONE ? length : R11F_SSA_NONE,
+                .array = array
+            };
+        }
+
+        uint32_t fresh = 0;
+        for (uint32_t n = 0; n < needed_count; n++) {
+            if (!has_guard(guards, *guard_count, &needed[n])) {
+                needed[fresh++] = needed[n];
+            }
+        }
+        if (*guard_count + fresh > OPT_MAX_LOOP_GUARDS) {
+            continue;
+        }
+        memcpy(guards + *guard_count, needed, fresh * sizeof(loop_guard_t));
+        *guard_count += fresh;
+        check->dead = true;
+
+        /* the guarded array is never null inside the loop either */
+        if (array != R11F_SSA_NONE) {
+            remove_null_checks(ssa, in_loop, dom->block_count, array);
+        }
+    }
+}
+
+static bool has_guard(loop_guard_t const *guards,
+                      uint32_t count,
+                      loop_guard_t const *guard) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (guards[i].cond == guard->cond
+            && guards[i].wide == guard->wide
+            && guards[i].lhs == guard->lhs
+            && guards[i].rhs == guard->rhs
+            && guards[i].array == guard->array) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool loop_invariant(r11f_ssa_t *ssa, bool const *in_loop, uint32_t v) {
+    return is_const(ssa, v) || !in_loop[ssa->values[v].block];
+}
+
+static void remove_null_checks(r11f_ssa_t *ssa,
+                               bool const *in_loop,
+                               uint32_t block_count,
+                               uint32_t array) {
+    for (uint32_t b = 0; b < block_count; b++) {
+        r11f_ssa_block_t *block = &ssa->blocks[b];
+        for (uint32_t i = 0; in_loop[b] && i < block->value_count; i++) {
+            r11f_ssa_value_t *value = &ssa->values[block->values[i]];
+            if (value->op == R11F_SSA_nullchk
+                && r11f_ssa_resolve(ssa, value->args[0]) == array) {
+                value->dead = true;
+            }
+        }
+    }
+}
+
+/* `guards` run in order between preds[entry] of the loop header and the
+   header itself. Failing any leaves with the state the loop would have
+   been entered with, the interpreter runs it with every check */
+static void add_loop_guards(r11f_ssa_t *ssa,
+                            r11f_ssa_loop_t const *loop,
+                            uint32_t entry,
+                            loop_guard_t const *guards,
+                            uint32_t guard_count) {
+    uint32_t h = loop->block;
+    uint32_t exit_block = r11f_ssa_new_block(ssa);
+    uint32_t exit = new_point(ssa, exit_block, R11F_SSA_exit,
+                              loop->frame_count, loop->argc);
+    if (ssa->oom) {
+        return;
+    }
+    r11f_deopt_point_t *point = &ssa->deopt_points[ssa->values[exit].imm];
+    memcpy(point->frames,
+           loop->frames,
+           loop->frame_count * sizeof(r11f_deopt_frame_t));
+    for (uint32_t i = 0; i < loop->argc; i++) {
+        uint32_t arg = r11f_ssa_resolve(ssa, loop->args[i]);
+        r11f_ssa_value_t *phi = &ssa->values[arg];
+        if (phi->op == R11F_SSA_phi && phi->block == h) {
+            arg = r11f_ssa_resolve(ssa, phi->args[entry]);
+        }
+        ssa->values[exit].args[i] = arg;
+    }
+    ssa->blocks[exit_block].term = R11F_SSA_EXIT;
+
+    for (uint32_t g = 0; g < guard_count; g++) {
+        loop_guard_t const *guard = &guards[g];
+        uint32_t block = split_loop_entry(ssa, h, entry);
+        uint32_t rhs = guard->rhs;
+        if (!ssa->oom && guard->array != R11F_SSA_NONE) {
+            rhs = new_value(ssa, block, R11F_SSA_alength, 1,
+                            guard->array, 0, 0);
+        }
+        else if (!ssa->oom && rhs == R11F_SSA_NONE) {
+            rhs = new_const(ssa, block, 0);
+        }
+        if (ssa->oom) {
+            return;
+        }
+
+        r11f_ssa_block_t *bb = &ssa->blocks[block];
+        bb->term = R11F_SSA_BRANCH;
+        bb->cond = guard->cond;
+        bb->wide = guard->wide;
+        bb->term_args[0] = guard->lhs;
+        bb->term_args[1] = rhs;
+        bb->succs[1] = exit_block;
+        r11f_ssa_add_pred(ssa, exit_block, block);
+    }
+}
+
+/* a new block jumping to header `h`, which takes the place of h among
+   the successors of preds[entry] */
+static uint32_t split_loop_entry(r11f_ssa_t *ssa, uint32_t h, uint32_t entry) {
+    uint32_t block = r11f_ssa_new_block(ssa);
+    if (ssa->oom) {
+        return R11F_SSA_NONE;
+    }
+    uint32_t pred = ssa->blocks[h].preds[entry];
+    r11f_ssa_block_t *from = &ssa->blocks[pred];
+    for (uint32_t s = 0; s < r11f_ssa_succ_count(from); s++) {
+        if (from->succs[s] == h) {
+            from->succs[s] = block;
+        }
+    }
+    r11f_ssa_add_pred(ssa, block, pred);
+    ssa->blocks[block].term = R11F_SSA_JUMP;
+    ssa->blocks[block].succs[0] = h;
+    ssa->blocks[h].preds[entry] = block;
+    return block;
+}
+
+/* Counted loops whose body is a single block of int arithmetic on
+   elements at the induction variable, stored back or summed up, run
+   whole vectors of iterations in a vloop ahead of the scalar loop,
+   which then does the remaining ones. Runs last, on dead code already
+   removed: every value left in the body is needed for something */
+static void vectorize_loops(r11f_ssa_t *ssa) {
+    for (uint32_t i = 0; i < ssa->loop_count && !ssa->oom; i++) {
+        uint32_t h = ssa->loops[i].block;
+        r11f_ssa_block_t *header = &ssa->blocks[h];
+        if (header->pred_count != 2 || header->term != R11F_SSA_BRANCH) {
+            continue;
+        }
+
+        /* the body is the latch, jumping back to the header alone */
+        vec_ctx_t ctx = {
+            .ssa = ssa,
+            .h = h,
+            .body = R11F_SSA_NONE,
+            .iv_reg = R11F_VEC_NO_REG,
+            .step_reg = R11F_VEC_NO_REG
+        };
+        for (uint32_t p = 0; p < 2; p++) {
+            r11f_ssa_block_t *pred = &ssa->blocks[header->preds[p]];
+            if (header->preds[p] != h
+                && pred->term == R11F_SSA_JUMP
+                && pred->pred_count == 1
+                && pred->preds[0] == h) {
+                ctx.body = header->preds[p];
+                ctx.entry = 1 - p;
+            }
+        }
+        if (ctx.body != R11F_SSA_NONE
+            && ssa->blocks[header->preds[ctx.entry]].pred_count
+            && vectorize_loop(&ctx)) {
+            vec_transform(&ctx);
+        }
+    }
+}
+
+static bool vectorize_loop(vec_ctx_t *ctx) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    r11f_ssa_block_t *header = &ssa->blocks[ctx->h];
+    if (header->wide) {
+        return false;
+    }
+
+    /* the header goes on into the body while iv < limit */
+    uint32_t k = header->succs[0] == ctx->body ? 0 : 1;
+    if (header->succs[k] != ctx->body || header->succs[1 - k] == ctx->body) {
+        return false;
+    }
+    uint8_t cond = k == 0 ? header->cond : header->cond ^ 1;
+    uint32_t iv = r11f_ssa_resolve(ssa, header->term_args[0]);
+    uint32_t limit = r11f_ssa_resolve(ssa, header->term_args[1]);
+    if (cond == R11F_SSA_GT) {
+        uint32_t swap = iv;
+        iv = limit;
+        limit = swap;
+        cond = R11F_SSA_LT;
+    }
+    uint32_t start = induction_start(ssa, ctx->h, ctx->entry, iv);
+    if (cond != R11F_SSA_LT
+        || start == R11F_SSA_NONE
+        || ssa->values[start].op == R11F_SSA_vloop) {
+        return false;
+    }
+    ctx->iv = iv;
+    if (vec_arg(ctx, start) != 0 || vec_arg(ctx, limit) != 1) {
+        return false;
+    }
+
+    /* the header has nothing but phis, null checks and lengths to
+       compute, the latter move ahead of the vloop with the arguments */
+    for (uint32_t i = 0; i < header->value_count; i++) {
+        uint32_t v = header->values[i];
+        r11f_ssa_value_t *value = &ssa->values[v];
+        if (value->dead
+            || value->forward != R11F_SSA_NONE
+            || value->op == R11F_SSA_const
+            || v == iv) {
+            continue;
+        }
+        if (value->op == R11F_SSA_phi) {
+            if (!vec_reduction(ctx, v)) {
+                return false;
+            }
+        }
+        else if (value->op == R11F_SSA_nullchk) {
+            uint32_t array = r11f_ssa_resolve(ssa, value->args[0]);
+            uint32_t block = ssa->values[array].block;
+            if (block == ctx->h
+                || block == ctx->body
+                || ctx->null_check_count == OPT_MAX_LOOP_GUARDS) {
+                return false;
+            }
+            ctx->null_checks[ctx->null_check_count++] = array;
+        }
+        else if (value->op != R11F_SSA_alength) {
+            return false;
+        }
+    }
+
+    /* stores are what the body is there for, the rest gets vectorized
+       as they or the reductions need it */
+    r11f_ssa_block_t *body = &ssa->blocks[ctx->body];
+    bool stores = false;
+    for (uint32_t i = 0; i < body->value_count; i++) {
+        uint32_t v = body->values[i];
+        r11f_ssa_value_t *value = &ssa->values[v];
+        if (value->dead || value->forward != R11F_SSA_NONE) {
+            continue;
+        }
+        switch (value->op) {
+            case R11F_SSA_iastore:
+                if (!vec_value(ctx, v)) {
+                    return false;
+                }
+                stores = true;
+                break;
+            case R11F_SSA_const: case R11F_SSA_iaload:
+            case R11F_SSA_iadd: case R11F_SSA_isub: case R11F_SSA_imul:
+            case R11F_SSA_iand: case R11F_SSA_ior: case R11F_SSA_ixor:
+            case R11F_SSA_ishl: case R11F_SSA_ishr: case R11F_SSA_iushr:
+                break;
+            default:
+                return false;
+        }
+    }
+
+    for (uint32_t r = 0; r < ctx->reduce_count; r++) {
+        r11f_ssa_value_t *step = &ssa->values[
+            r11f_ssa_resolve(ssa, ssa->values[ctx->reduce_phis[r]]
+                                      .args[1 - ctx->entry])];
+        uint32_t a = r11f_ssa_resolve(ssa, step->args[0]);
+        uint32_t x = a == ctx->reduce_phis[r] ?
+            r11f_ssa_resolve(ssa, step->args[1]) :
+            a;
+        int reg = vec_operand(ctx, x);
+        if (reg < 0
+            || !vec_emit(ctx, false, R11F_VEC_ADD, ctx->reduce_regs[r],
+                         ctx->reduce_regs[r], reg, 0)) {
+            return false;
+        }
+    }
+    return stores || ctx->reduce_count;
+}
+
+/* `phi` sums up a value of the body and nothing else in the loop reads
+   the sum or the steps to it */
+static bool vec_reduction(vec_ctx_t *ctx, uint32_t phi) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    if (ssa->values[phi].argc != 2
+        || ctx->reduce_count == R11F_VEC_REGS) {
+        return false;
+    }
+    uint32_t s = r11f_ssa_resolve(ssa, ssa->values[phi].args[1 - ctx->entry]);
+    r11f_ssa_value_t *step = &ssa->values[s];
+    if (step->op != R11F_SSA_iadd || step->block != ctx->body) {
+        return false;
+    }
+    uint32_t a = r11f_ssa_resolve(ssa, step->args[0]);
+    uint32_t b = r11f_ssa_resolve(ssa, step->args[1]);
+    if ((a == phi) == (b == phi)
+        || vec_loop_uses(ctx, phi) != 1
+        || vec_loop_uses(ctx, s) != 1) {
+        return false;
+    }
+
+    uint32_t init = r11f_ssa_resolve(ssa, ssa->values[phi].args[ctx->entry]);
+    int reg = vec_new_reg(ctx, phi);
+    if (reg < 0
+        || vec_arg(ctx, init) < 0
+        || !vec_emit(ctx, true, R11F_VEC_ZERO, reg, 0, 0, 0)) {
+        return false;
+    }
+    ctx->reduce_phis[ctx->reduce_count] = phi;
+    ctx->reduce_regs[ctx->reduce_count++] = (uint8_t)reg;
+    return true;
+}
+
+/* reads of `v` by the header and the body */
+static uint32_t vec_loop_uses(vec_ctx_t *ctx, uint32_t v) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    uint32_t uses = 0;
+    uint32_t blocks[2] = { ctx->h, ctx->body };
+    for (uint32_t b = 0; b < 2; b++) {
+        r11f_ssa_block_t *block = &ssa->blocks[blocks[b]];
+        for (uint32_t i = 0; i < block->value_count; i++) {
+            r11f_ssa_value_t *value = &ssa->values[block->values[i]];
+            if (value->dead || value->forward != R11F_SSA_NONE) {
+                continue;
+            }
+            for (uint32_t j = 0; j < value->argc; j++) {
+                uses += r11f_ssa_resolve(ssa, value->args[j]) == v;
+            }
+        }
+    }
+    r11f_ssa_block_t *header = &ssa->blocks[ctx->h];
+    uses += r11f_ssa_resolve(ssa, header->term_args[0]) == v;
+    uses += r11f_ssa_resolve(ssa, header->term_args[1]) == v;
+    return uses;
+}
+
+/* vectorizes the body value `v`, its operands first */
+static bool vec_value(vec_ctx_t *ctx, uint32_t v) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    r11f_ssa_value_t *value = &ssa->values[v];
+    uint32_t argc = value->argc;
+    uint32_t args[3] = { R11F_SSA_NONE, R11F_SSA_NONE, R11F_SSA_NONE };
+    for (uint32_t i = 0; i < argc && i < 3; i++) {
+        args[i] = r11f_ssa_resolve(ssa, value->args[i]);
+    }
+
+    static const struct {
+        uint16_t op;
+        uint8_t vec;
+    } ops[] = {
+        { R11F_SSA_iadd, R11F_VEC_ADD }, { R11F_SSA_isub, R11F_VEC_SUB },
+        { R11F_SSA_imul, R11F_VEC_MUL }, { R11F_SSA_iand, R11F_VEC_AND },
+        { R11F_SSA_ior, R11F_VEC_OR }, { R11F_SSA_ixor, R11F_VEC_XOR },
+        { R11F_SSA_ishl, R11F_VEC_SHL }, { R11F_SSA_ishr, R11F_VEC_SHR },
+        { R11F_SSA_iushr, R11F_VEC_USHR },
+    };
+    uint16_t op = value->op;
+
+    if (op == R11F_SSA_iaload || op == R11F_SSA_iastore) {
+        /* elements at the induction variable of an array the loop
+           never changes */
+        if (args[1] != ctx->iv
+            || is_const(ssa, args[0])
+            || ssa->values[args[0]].block == ctx->h
+            || ssa->values[args[0]].block == ctx->body) {
+            return false;
+        }
+        int array = vec_arg(ctx, args[0]);
+        if (op == R11F_SSA_iastore) {
+            int reg = vec_operand(ctx, args[2]);
+            return array >= 0
+                && reg >= 0
+                && vec_emit(ctx, false, R11F_VEC_STORE, 0, array, reg, 0);
+        }
+        int dst = vec_new_reg(ctx, v);
+        return array >= 0
+            && dst >= 0
+            && vec_emit(ctx, false, R11F_VEC_LOAD, dst, array, 0, 0);
+    }
+
+    for (uint32_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        if (ops[i].op != op) {
+            continue;
+        }
+        bool shift = ops[i].vec >= R11F_VEC_SHL;
+        if (shift && !is_const(ssa, args[1])) {
+            return false;
+        }
+        int a = vec_operand(ctx, args[0]);
+        int b = shift ? 0 : vec_operand(ctx, args[1]);
+        if (a < 0 || b < 0) {
+            return false;
+        }
+        uint8_t imm = shift ? (uint8_t)(ssa->values[args[1]].imm & 31) : 0;
+        int dst = vec_new_reg(ctx, v);
+        return dst >= 0 && vec_emit(ctx, false, ops[i].vec, dst, a, b, imm);
+    }
+    return false;
+}
+
+/* the register holding the lanes of `v`, -1 if it has none */
+static int vec_operand(vec_ctx_t *ctx, uint32_t v) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    for (uint32_t r = 0; r < ctx->reg_count; r++) {
+        if (ctx->reg_values[r] == v) {
+            return (int)r;
+        }
+    }
+
+    r11f_ssa_value_t *value = &ssa->values[v];
+    if (v == ctx->iv) {
+        /* the index counts up in each lane, by a vector a step */
+        int reg = vec_new_reg(ctx, v);
+        int step = vec_new_reg(ctx, R11F_SSA_NONE);
+        if (reg < 0
+            || step < 0
+            || !vec_emit(ctx, true, R11F_VEC_IOTA, reg, 0, 0, 0)) {
+            return -1;
+        }
+        ctx->iv_reg = (uint8_t)reg;
+        ctx->step_reg = (uint8_t)step;
+        return reg;
+    }
+    if (value->block == ctx->body && value->op != R11F_SSA_const) {
+        return vec_value(ctx, v) ? vec_operand(ctx, v) : -1;
+    }
+    if (value->block == ctx->h
+        && value->op != R11F_SSA_const
+        && value->op != R11F_SSA_alength) {
+        /* reductions only ever get read by their steps */
+        return -1;
+    }
+
+    int arg = vec_arg(ctx, v);
+    int reg = arg < 0 ? -1 : vec_new_reg(ctx, v);
+    if (reg < 0 || !vec_emit(ctx, true, R11F_VEC_BCAST, reg, arg, 0, 0)) {
+        return -1;
+    }
+    return reg;
+}
+
+static int vec_new_reg(vec_ctx_t *ctx, uint32_t v) {
+    if (ctx->reg_count == R11F_VEC_REGS) {
+        return -1;
+    }
+    ctx->reg_values[ctx->reg_count] = v;
+    return ctx->reg_count++;
+}
+
+/* the operand of the vloop value `v` becomes, -1 when out of them */
+static int vec_arg(vec_ctx_t *ctx, uint32_t v) {
+    r11f_ssa_value_t *value = &ctx->ssa->values[v];
+    if (value->block == ctx->h && value->op == R11F_SSA_alength) {
+        uint32_t array = r11f_ssa_resolve(ctx->ssa, value->args[0]);
+        uint32_t block = ctx->ssa->values[array].block;
+        if (block == ctx->h || block == ctx->body) {
+            return -1;
+        }
+    }
+    else if (value->op != R11F_SSA_const
+             && (value->block == ctx->h || value->block == ctx->body)) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < ctx->arg_count; i++) {
+        if (ctx->args[i] == v) {
+            return (int)i;
+        }
+    }
+    if (ctx->arg_count == OPT_MAX_VEC_ARGS) {
+        return -1;
+    }
+    ctx->args[ctx->arg_count] = v;
+    return (int)ctx->arg_count++;
+}
+
+static bool vec_emit(vec_ctx_t *ctx,
+                     bool setup,
+                     uint8_t op,
+                     int dst,
+                     int a,
+                     int b,
+                     uint8_t imm) {
+    r11f_ssa_vinsn_t insn = {
+        .op = op,
+        .dst = (uint8_t)dst,
+        .a = (uint8_t)a,
+        .b = (uint8_t)b,
+        .imm = imm
+    };
+    if (setup) {
+        /* one instruction per register at most */
+        ctx->setup[ctx->setup_count++] = insn;
+        return true;
+    }
+    if (ctx->insn_count == OPT_MAX_VEC_INSNS) {
+        return false;
+    }
+    ctx->insns[ctx->insn_count++] = insn;
+    return true;
+}
+
+/* a block between the loop and its entry runs the vloop and passes
+   what it stopped at to the header phis */
+static void vec_transform(vec_ctx_t *ctx) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    if (ssa->vloop_count == ssa->vloop_capacity) {
+        ssa->vloops = arena_grow(ssa,
+                                 ssa->vloops,
+                                 ssa->vloop_count,
+                                 &ssa->vloop_capacity,
+                                 sizeof(r11f_ssa_vloop_t));
+    }
+    uint32_t insn_count = ctx->setup_count + ctx->insn_count;
+    r11f_ssa_vinsn_t *insns =
+        arena_alloc(ssa, insn_count * sizeof(r11f_ssa_vinsn_t));
+    r11f_ssa_reduce_t *reduces = ctx->reduce_count ?
+        arena_alloc(ssa, ctx->reduce_count * sizeof(r11f_ssa_reduce_t)) :
+        NULL;
+    uint32_t block = split_loop_entry(ssa, ctx->h, ctx->entry);
+    if (ssa->oom) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < ctx->null_check_count; i++) {
+        new_value(ssa, block, R11F_SSA_nullchk, 1, ctx->null_checks[i], 0, 0);
+    }
+    for (uint32_t i = 0; i < ctx->arg_count; i++) {
+        r11f_ssa_value_t *value = &ssa->values[ctx->args[i]];
+        if (value->block == ctx->h && value->op != R11F_SSA_const) {
+            ctx->args[i] = new_value(ssa, block, R11F_SSA_alength, 1,
+                                     value->args[0], 0, 0);
+        }
+    }
+    uint32_t index = ssa->vloop_count++;
+    uint32_t vloop = new_value(ssa, block, R11F_SSA_vloop, ctx->arg_count,
+                               0, 0, index);
+    if (ssa->oom) {
+        return;
+    }
+    memcpy(ssa->values[vloop].args,
+           ctx->args,
+           ctx->arg_count * sizeof(uint32_t));
+    r11f_ssa_value_t *iv = &ssa->values[ctx->iv];
+    iv->args[ctx->entry] = vloop;
+
+    for (uint32_t r = 0; r < ctx->reduce_count; r++) {
+        uint32_t phi = ctx->reduce_phis[r];
+        uint32_t init = r11f_ssa_resolve(ssa, ssa->values[phi].args[ctx->entry]);
+        uint32_t sum = new_value(ssa, block, R11F_SSA_vreduce, 0, 0, 0, index);
+        if (ssa->oom) {
+            return;
+        }
+        ssa->values[phi].args[ctx->entry] = sum;
+        reduces[r] = (r11f_ssa_reduce_t) {
+            .value = sum,
+            .reg = ctx->reduce_regs[r],
+            .init = (uint8_t)vec_arg(ctx, init)
+        };
+    }
+
+    memcpy(insns, ctx->setup, ctx->setup_count * sizeof(r11f_ssa_vinsn_t));
+    memcpy(insns + ctx->setup_count,
+           ctx->insns,
+           ctx->insn_count * sizeof(r11f_ssa_vinsn_t));
+    ssa->vloops[index] = (r11f_ssa_vloop_t) {
+        .insns = insns,
+        .insn_count = insn_count,
+        .setup_count = ctx->setup_count,
+        .iv_reg = ctx->iv_reg,
+        .step_reg = ctx->step_reg,
+        .reduces = reduces,
+        .reduce_count = ctx->reduce_count
+    };
+}
+
+/* Scalar replacement: int[] allocations of a small constant length that
+   only get read and written at constant indices never exist as objects,
+   each element becomes a value of its own with phis where paths join.
+   Deopts and exits the array is live at allocate it again, see
+   r11f_deopt_object_t; anything else it flows into keeps it */
+static bool replace_allocations(r11f_ssa_t *ssa) {
+    bool changed = false;
+    uint32_t value_count = ssa->value_count;
+    for (uint32_t v = 0; v < value_count && !ssa->oom; v++) {
+        if (!scalar_candidate(ssa, v)) {
+            continue;
+        }
+        uint32_t length = (uint32_t)ssa->values[
+            r11f_ssa_resolve(ssa, ssa->values[v].args[0])
+        ].imm;
+        scalar_ctx_t ctx = {
+            .ssa = ssa,
+            .array = v,
+            .length = length,
+            .entry_defs = arena_alloc(ssa,
+                                      (ssa->block_count * length + 1)
+                                          * sizeof(uint32_t))
+        };
+        if (ssa->oom) {
+            break;
+        }
+        for (uint32_t i = 0; i < ssa->block_count * length; i++) {
+            ctx.entry_defs[i] = R11F_SSA_NONE;
+        }
+        scalar_replace(&ctx);
+        ssa->replaced_count++;
+        changed = true;
+    }
+    return changed;
+}
+
+static bool scalar_candidate(r11f_ssa_t *ssa, uint32_t array) {
+    r11f_ssa_value_t *value = &ssa->values[array];
+    if (value->op != R11F_SSA_newarray
+        || value->dead
+        || value->forward != R11F_SSA_NONE) {
+        return false;
+    }
+    uint32_t length = r11f_ssa_resolve(ssa, value->args[0]);
+    if (!is_const(ssa, length)
+        || ssa->values[length].imm < 0
+        || ssa->values[length].imm > OPT_MAX_SCALAR_LENGTH) {
+        return false;
+    }
+
+    for (uint32_t b = 0; b < ssa->block_count; b++) {
+        r11f_ssa_block_t *block = &ssa->blocks[b];
+        if (b != 0 && !block->pred_count) {
+            continue;
+        }
+        if ((block->term == R11F_SSA_BRANCH
+             && (r11f_ssa_resolve(ssa, block->term_args[0]) == array
+                 || r11f_ssa_resolve(ssa, block->term_args[1]) == array))
+            || (block->term == R11F_SSA_RETURN
+                && block->returns_value
+                && r11f_ssa_resolve(ssa, block->term_args[0]) == array)) {
+            return false;
+        }
+
+        for (uint32_t i = 0; i < block->value_count; i++) {
+            r11f_ssa_value_t *use = &ssa->values[block->values[i]];
+            if (use->dead || use->forward != R11F_SSA_NONE) {
+                continue;
+            }
+            for (uint32_t k = 0; k < use->argc; k++) {
+                if (r11f_ssa_resolve(ssa, use->args[k]) != array) {
+                    continue;
+                }
+                bool fine;
+                switch (use->op) {
+                    case R11F_SSA_deopt: case R11F_SSA_exit:
+                    case R11F_SSA_nullchk: case R11F_SSA_alength:
+                        fine = true;
+                        break;
+                    case R11F_SSA_iaload: case R11F_SSA_iastore:
+                        fine = k == 0 && scalar_index(ssa, array, use->args[1]);
+                        break;
+                    default:
+                        fine = false;
+                        break;
+                }
+                if (!fine) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/* out of range indices stay with the array, whose access throws */
+static bool scalar_index(r11f_ssa_t *ssa, uint32_t array, uint32_t index) {
+    index = r11f_ssa_resolve(ssa, index);
+    uint32_t length = r11f_ssa_resolve(ssa, ssa->values[array].args[0]);
+    return is_const(ssa, index)
+        && ssa->values[index].imm >= 0
+        && ssa->values[index].imm < ssa->values[length].imm;
+}
+
+/* loads read the element values first, while the stores are still
+   there to find them; the allocation becomes the zero elements start
+   out with */
+static void scalar_replace(scalar_ctx_t *ctx) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    uint32_t array = ctx->array;
+    uint32_t value_count = ssa->value_count;
+    for (uint32_t v = 0; v < value_count && !ssa->oom; v++) {
+        r11f_ssa_value_t *value = &ssa->values[v];
+        if (value->dead
+            || value->forward != R11F_SSA_NONE
+            || value->argc == 0
+            || r11f_ssa_resolve(ssa, value->args[0]) != array) {
+            continue;
+        }
+        if (value->op == R11F_SSA_iaload) {
+            uint32_t index = r11f_ssa_resolve(ssa, value->args[1]);
+            uint32_t element =
+                scalar_before(ctx, v, (uint32_t)ssa->values[index].imm);
+            ssa->values[v].forward = element;
+            ssa->values[v].dead = true;
+        }
+    }
+    for (uint32_t v = 0; v < value_count && !ssa->oom; v++) {
+        r11f_ssa_value_t *value = &ssa->values[v];
+        if ((value->op == R11F_SSA_deopt || value->op == R11F_SSA_exit)
+            && !value->dead) {
+            scalar_point(ctx, v);
+        }
+    }
+    if (ssa->oom) {
+        return;
+    }
+
+    for (uint32_t v = 0; v < value_count; v++) {
+        r11f_ssa_value_t *value = &ssa->values[v];
+        if (value->dead
+            || value->forward != R11F_SSA_NONE
+            || value->argc == 0
+            || value->op == R11F_SSA_deopt
+            || value->op == R11F_SSA_exit
+            || r11f_ssa_resolve(ssa, value->args[0]) != array) {
+            continue;
+        }
+        if (value->op == R11F_SSA_alength) {
+            value->op = R11F_SSA_const;
+            value->argc = 0;
+            value->imm = ctx->length;
+        }
+        else {
+            value->dead = true;
+        }
+    }
+    r11f_ssa_value_t *alloc = &ssa->values[array];
+    alloc->op = R11F_SSA_const;
+    alloc->argc = 0;
+    alloc->imm = 0;
+}
+
+/* the value of `element` right ahead of value `v` */
+static uint32_t scalar_before(scalar_ctx_t *ctx, uint32_t v, uint32_t element) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    uint32_t block = ssa->values[v].block;
+    r11f_ssa_block_t *bb = &ssa->blocks[block];
+    uint32_t end = 0;
+    while (bb->values[end] != v) {
+        end++;
+    }
+    return scalar_read(ctx, block, end, element);
+}
+
+/* the value of `element` ahead of the `end`th value of `block` */
+static uint32_t scalar_read(scalar_ctx_t *ctx,
+                            uint32_t block,
+                            uint32_t end,
+                            uint32_t element) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    r11f_ssa_block_t *bb = &ssa->blocks[block];
+    for (uint32_t i = end; i > 0; i--) {
+        uint32_t v = bb->values[i - 1];
+        r11f_ssa_value_t *value = &ssa->values[v];
+        if (v == ctx->array) {
+            return v;
+        }
+        if (value->op == R11F_SSA_iastore
+            && !value->dead
+            && r11f_ssa_resolve(ssa, value->args[0]) == ctx->array
+            && ssa->values[r11f_ssa_resolve(ssa, value->args[1])].imm
+                == element) {
+            return r11f_ssa_resolve(ssa, value->args[2]);
+        }
+    }
+    return scalar_entry(ctx, block, element);
+}
+
+static uint32_t scalar_entry(scalar_ctx_t *ctx,
+                             uint32_t block,
+                             uint32_t element) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    uint32_t *def = &ctx->entry_defs[block * ctx->length + element];
+    if (*def != R11F_SSA_NONE) {
+        return *def;
+    }
+    uint32_t pred_count = ssa->blocks[block].pred_count;
+    if (pred_count == 0) {
+        /* not reached from the allocation, which dominates its uses */
+        return ctx->array;
+    }
+    if (pred_count == 1) {
+        uint32_t pred = ssa->blocks[block].preds[0];
+        *def = scalar_read(ctx,
+                           pred,
+                           ssa->blocks[pred].value_count,
+                           element);
+        return *def;
+    }
+
+    /* recorded before its arguments, loops come back to it */
+    uint32_t phi = new_value(ssa, block, R11F_SSA_phi, 0, 0, 0, 0);
+    uint32_t *args = arena_alloc(ssa, pred_count * sizeof(uint32_t));
+    if (ssa->oom) {
+        return ctx->array;
+    }
+    r11f_ssa_block_t *bb = &ssa->blocks[block];
+    memmove(bb->values + 1,
+            bb->values,
+            (bb->value_count - 1) * sizeof(uint32_t));
+    bb->values[0] = phi;
+    ctx->entry_defs[block * ctx->length + element] = phi;
+
+    for (uint32_t p = 0; p < pred_count; p++) {
+        uint32_t pred = ssa->blocks[block].preds[p];
+        args[p] = scalar_read(ctx,
+                              pred,
+                              ssa->blocks[pred].value_count,
+                              element);
+    }
+    ssa->values[phi].argc = pred_count;
+    ssa->values[phi].args = args;
+    return phi;
+}
+
+/* the interpreter gets the array back from the elements, which go
+   after the values of the frames */
+static void scalar_point(scalar_ctx_t *ctx, uint32_t point) {
+    r11f_ssa_t *ssa = ctx->ssa;
+    uint32_t argc = ssa->values[point].argc;
+    uint32_t elements = R11F_SSA_NONE;
+    for (uint32_t i = 0; i < argc && !ssa->oom; i++) {
+        if (r11f_ssa_resolve(ssa, ssa->values[point].args[i]) != ctx->array) {
+            continue;
+        }
+
+        if (elements == R11F_SSA_NONE) {
+            uint32_t *args =
+                arena_alloc(ssa, (argc + ctx->length) * sizeof(uint32_t));
+            if (ssa->oom) {
+                return;
+            }
+            memcpy(args, ssa->values[point].args, argc * sizeof(uint32_t));
+            for (uint32_t e = 0; e < ctx->length; e++) {
+                args[argc + e] = scalar_before(ctx, point, e);
+            }
+            ssa->values[point].args = args;
+            ssa->values[point].argc = argc + ctx->length;
+            elements = argc;
+        }
+
+        r11f_deopt_point_t *deopt =
+            &ssa->deopt_points[ssa->values[point].imm];
+        r11f_deopt_object_t *objects = arena_alloc(
+            ssa,
+            (deopt->object_count + 1) * sizeof(r11f_deopt_object_t)
+        );
+        if (ssa->oom) {
+            return;
+        }
+        if (deopt->object_count) {
+            memcpy(objects,
+                   deopt->objects,
+                   deopt->object_count * sizeof(r11f_deopt_object_t));
+        }
+        objects[deopt->object_count] = (r11f_deopt_object_t) {
+            .slot = i,
+            .length = ctx->length,
+            .elements = elements
+        };
+        deopt->objects = objects;
+        deopt->object_count++;
+    }
+}
+
+static bool eval_op(uint16_t op, int64_t a, int64_t b, int64_t *out) {
+    int32_t ia = (int32_t)a;
+    int32_t ib = (int32_t)b;
+    uint32_t ua = (uint32_t)ia;
+    uint32_t ub = (uint32_t)ib;
+    uint64_t la = (uint64_t)a;
+    uint64_t lb = (uint64_t)b;
+
+    switch (op) {
+        case R11F_SSA_iadd: *out = (int32_t)(ua + ub); return true;
+        case R11F_SSA_isub: *out = (int32_t)(ua - ub); return true;
+        case R11F_SSA_imul: *out = (int32_t)(ua * ub); return true;
+        case R11F_SSA_ineg: *out = (int32_t)(0u - ua); return true;
+        case R11F_SSA_ishl: *out = (int32_t)(ua << (ib & 31)); return true;
+        case R11F_SSA_ishr: *out = ia >> (ib & 31); return true;
+        case R11F_SSA_iushr: *out = (int32_t)(ua >> (ib & 31)); return true;
+        case R11F_SSA_iand: *out = ia & ib; return true;
+        case R11F_SSA_ior: *out = ia | ib; return true;
+        case R11F_SSA_ixor: *out = ia ^ ib; return true;
+        case R11F_SSA_idiv:
+        case R11F_SSA_irem:
+            if (ib == 0) {
+                return false;
+            }
+            if (ib == -1) {
+                *out = op == R11F_SSA_idiv ? (int32_t)(0u - ua) : 0;
+            }
+            else {
+                *out = op == R11F_SSA_idiv ? ia / ib : ia % ib;
+            }
+            return true;
+
+        case R11F_SSA_ladd: *out = (int64_t)(la + lb); return true;
+        case R11F_SSA_lsub: *out = (int64_t)(la - lb); return true;
+        case R11F_SSA_lmul: *out = (int64_t)(la * lb); return true;
+        case R11F_SSA_lneg: *out = (int64_t)(0ull - la); return true;
+        case R11F_SSA_lshl: *out = (int64_t)(la << (ib & 63)); return true;
+        case R11F_SSA_lshr: *out = a >> (ib & 63); return true;
+        case R11F_SSA_lushr: *out = (int64_t)(la >> (ib & 63)); return true;
+        case R11F_SSA_land: *out = a & b; return true;
+        case R11F_SSA_lor: *out = a | b; return true;
+        case R11F_SSA_lxor: *out = a ^ b; return true;
+        case R11F_SSA_ldiv:
+        case R11F_SSA_lrem:
+            if (b == 0) {
+                return false;
+            }
+            if (b == -1) {
+                *out = op == R11F_SSA_ldiv ? (int64_t)(0ull - la) : 0;
+            }
+            else {
+                *out = op == R11F_SSA_ldiv ? a / b : a % b;
+            }
+            return true;
+
+        case R11F_SSA_i2l: *out = ia; return true;
+        case R11F_SSA_l2i: *out = (int32_t)a; return true;
+        case R11F_SSA_i2b: *out = (int8_t)ia; return true;
+        case R11F_SSA_i2c: *out = (uint16_t)ia; return true;
+        case R11F_SSA_i2s: *out = (int16_t)ia; return true;
+        case R11F_SSA_lcmp: *out = (a > b) - (a < b); return true;
+
+        default:
+            return false;
+    }
+}
+
+static bool eval_cond(uint8_t cond, int64_t a, int64_t b) {
+    switch (cond) {
+        case R11F_SSA_EQ: return a == b;
+        case R11F_SSA_NE: return a != b;
+        case R11F_SSA_LT: return a < b;
+        case R11F_SSA_GE: return a >= b;
+        case R11F_SSA_GT: return a > b;
+        default: return a <= b;
+    }
+}
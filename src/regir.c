@@ -0,0 +1,1102 @@
+#include "regir.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+#include "alloc.h"
+#include "bytecode.h"
+#include "byteutil.h"
+#include "class.h"
+#include "class/cpool.h"
+#include "nativefn.h"
+
+enum {
+    SYM_REG = 0,
+    SYM_CONST = 1
+};
+
+/* symbolic operand stack entry, the value has not necessarily been
+   written to its stack slot yet */
+typedef struct {
+    uint8_t kind;
+    uint16_t reg;
+    int64_t value;
+} sym_t;
+
+typedef struct {
+    r11f_linked_method_t *method;
+
+    r11f_regir_insn_t *insns;
+    uint32_t insn_count;
+    uint32_t block_start;
+
+    sym_t *sym;
+    uint16_t depth;
+} translator_t;
+
+enum {
+    FLOW_NEXT = 0,
+    FLOW_BRANCH = 1,
+    FLOW_GOTO = 2,
+    FLOW_RETURN = 3,
+    /* like FLOW_GOTO, but to every target of the switch at pc */
+    FLOW_SWITCH = 4
+};
+
+static bool analyze_insn(r11f_linked_method_t *method,
+                         uint32_t pc,
+                         uint32_t *out_length,
+                         uint16_t *out_pop,
+                         uint16_t *out_push,
+                         uint8_t *out_flow,
+                         uint32_t *out_target);
+static bool analyze_depth(r11f_linked_method_t *method,
+                          int32_t *depth_at,
+                          bool *leader);
+static bool analyze_target(r11f_linked_method_t *method,
+                           uint32_t target,
+                           int32_t depth,
+                           int32_t *depth_at,
+                           bool *leader,
+                           uint32_t *worklist,
+                           uint32_t *worklist_size);
+static r11f_error_t remap_switches(r11f_linked_method_t *method,
+                                   r11f_regir_insn_t *insns,
+                                   uint32_t insn_count,
+                                   uint32_t const *pc_to_insn,
+                                   r11f_regir_t *regir);
+static bool translate_insn(translator_t *t, uint32_t pc);
+
+static uint32_t emit(translator_t *t,
+                     uint16_t op,
+                     uint16_t dst,
+                     uint16_t a,
+                     uint16_t b,
+                     int64_t imm);
+static uint16_t local_reg(translator_t *t, uint16_t index);
+static uint16_t slot_reg(translator_t *t, uint16_t slot);
+static void materialize(translator_t *t, uint16_t slot);
+static void materialize_all(translator_t *t);
+static void materialize_local_refs(translator_t *t, uint16_t reg);
+static uint16_t operand(translator_t *t, uint16_t slot);
+static void push_reg(translator_t *t, uint16_t reg);
+static void push_const(translator_t *t, int64_t value);
+static void store_local(translator_t *t, uint16_t index);
+static void binop(translator_t *t, uint16_t op, uint16_t opi, bool commute);
+static void unop(translator_t *t, uint16_t op);
+static void branch1(translator_t *t, uint16_t op, uint32_t target);
+static void branch2(translator_t *t, uint16_t op, uint32_t target);
+
+R11F_EXPORT r11f_error_t r11f_regir_compile(r11f_linked_method_t *method,
+                                            r11f_regir_t **output) {
+    if (!method->code) {
+        return R11F_ERR_not_implemented_instruction;
+    }
+
+    uint32_t code_length = method->code_length;
+    int32_t *depth_at = r11f_alloc(code_length * sizeof(int32_t));
+    bool *leader = r11f_alloc_zeroed(code_length * sizeof(bool));
+    uint32_t *pc_to_insn = r11f_alloc(code_length * sizeof(uint32_t));
+    sym_t *sym = r11f_alloc((method->max_stack + 1) * sizeof(sym_t));
+    /* every bytecode emits at most one instruction of its own, plus one
+       move per stack slot when the symbolic stack gets flushed */
+    size_t capacity = (size_t)code_length * (method->max_stack + 2) + 1;
+    r11f_regir_insn_t *insns = r11f_alloc(
+        capacity * sizeof(r11f_regir_insn_t)
+    );
+    uint32_t *pcs = r11f_alloc(capacity * sizeof(uint32_t));
+
+    r11f_error_t err = R11F_success;
+    if (!depth_at || !leader || !pc_to_insn || !sym || !insns || !pcs) {
+        err = R11F_ERR_out_of_memory;
+        goto cleanup;
+    }
+
+    for (uint32_t i = 0; i < code_length; i++) {
+        depth_at[i] = -1;
+    }
+    if (!analyze_depth(method, depth_at, leader)) {
+        err = R11F_ERR_not_implemented_instruction;
+        goto cleanup;
+    }
+
+    translator_t t = {
+        .method = method,
+        .insns = insns,
+        .insn_count = 0,
+        .block_start = 0,
+        .sym = sym,
+        .depth = 0
+    };
+
+    uint32_t bytecode_count = 0;
+    uint32_t switch_count = 0;
+    uint32_t pcs_filled = 0;
+    bool fallthrough = false;
+    uint32_t pc = 0;
+    while (pc < code_length) {
+        uint32_t length;
+        uint16_t pop, push;
+        uint8_t flow;
+        uint32_t target;
+        analyze_insn(method, pc, &length, &pop, &push, &flow, &target);
+
+        if (depth_at[pc] < 0) {
+            /* unreachable code */
+            fallthrough = false;
+            pc += length;
+            continue;
+        }
+
+        if (leader[pc]) {
+            if (fallthrough) {
+                materialize_all(&t);
+            }
+            t.block_start = t.insn_count;
+            t.depth = (uint16_t)depth_at[pc];
+            for (uint16_t i = 0; i < t.depth; i++) {
+                t.sym[i] = (sym_t){ .kind = SYM_REG, .reg = slot_reg(&t, i) };
+            }
+        }
+
+        pc_to_insn[pc] = t.insn_count;
+        if (!translate_insn(&t, pc)) {
+            err = R11F_ERR_not_implemented_instruction;
+            goto cleanup;
+        }
+        /* moves flushing the stack ahead of a leader, which cannot
+           throw, go with it */
+        for (; pcs_filled < t.insn_count; pcs_filled++) {
+            pcs[pcs_filled] = pc;
+        }
+        bytecode_count++;
+
+        fallthrough = flow == FLOW_NEXT || flow == FLOW_BRANCH;
+        if (flow == FLOW_SWITCH) {
+            switch_count++;
+        }
+        pc += length;
+    }
+
+    if (t.insn_count > UINT16_MAX) {
+        /* branch targets would not fit into the dst field */
+        err = R11F_ERR_not_implemented_instruction;
+        goto cleanup;
+    }
+
+    for (uint32_t i = 0; i < t.insn_count; i++) {
+        r11f_regir_insn_t *insn = &t.insns[i];
+        if ((insn->op >= R11F_RI_ifeq && insn->op <= R11F_RI_if_icmplei)
+            || insn->op == R11F_RI_goto) {
+            insn->dst = (uint16_t)pc_to_insn[insn->dst];
+        }
+    }
+
+    r11f_regir_t *regir = r11f_alloc(
+        sizeof(r11f_regir_t) + t.insn_count * sizeof(r11f_regir_insn_t)
+    );
+    if (!regir) {
+        err = R11F_ERR_out_of_memory;
+        goto cleanup;
+    }
+
+    regir->insn_count = t.insn_count;
+    regir->bytecode_count = bytecode_count;
+    regir->switch_count = 0;
+    regir->switches = NULL;
+    regir->loop_count = 0;
+    regir->loops = NULL;
+    regir->pcs = NULL;
+    regir->handler_insns = NULL;
+    regir->throw_count = 0;
+    memcpy(regir->insns, t.insns, t.insn_count * sizeof(r11f_regir_insn_t));
+    for (uint32_t i = 0; i < t.insn_count; i++) {
+        regir->throw_count += t.insns[i].op == R11F_RI_athrow;
+    }
+
+    regir->pcs = r11f_alloc((t.insn_count + 1) * sizeof(uint32_t));
+    if (method->handler_count) {
+        regir->handler_insns =
+            r11f_alloc(method->handler_count * sizeof(uint32_t));
+    }
+    if (!regir->pcs || (method->handler_count && !regir->handler_insns)) {
+        err = R11F_ERR_out_of_memory;
+        r11f_regir_free(regir);
+        goto cleanup;
+    }
+    memcpy(regir->pcs, pcs, t.insn_count * sizeof(uint32_t));
+    for (uint16_t i = 0; i < method->handler_count; i++) {
+        uint32_t handler_pc = method->handlers[i].handler_pc;
+        regir->handler_insns[i] =
+            handler_pc < code_length && depth_at[handler_pc] >= 0 ?
+                pc_to_insn[handler_pc] :
+                UINT32_MAX;
+    }
+
+    if (method->loop_count) {
+        regir->loops =
+            r11f_alloc(method->loop_count * sizeof(r11f_regir_loop_t));
+        if (!regir->loops) {
+            err = R11F_ERR_out_of_memory;
+            r11f_regir_free(regir);
+            goto cleanup;
+        }
+        for (uint32_t i = 0; i < method->loop_count; i++) {
+            uint32_t header = method->loops[i].header_pc;
+            if (depth_at[header] >= 0) {
+                regir->loops[regir->loop_count++] = (r11f_regir_loop_t) {
+                    .pc = header,
+                    .insn = pc_to_insn[header]
+                };
+            }
+        }
+    }
+
+    if (switch_count) {
+        regir->switches =
+            r11f_alloc_zeroed(switch_count * sizeof(r11f_switch_t*));
+        err = regir->switches ?
+            remap_switches(method, regir->insns, t.insn_count, pc_to_insn,
+                           regir) :
+            R11F_ERR_out_of_memory;
+        if (err != R11F_success) {
+            r11f_regir_free(regir);
+            goto cleanup;
+        }
+    }
+    *output = regir;
+
+cleanup:
+    r11f_free(depth_at);
+    r11f_free(leader);
+    r11f_free(pc_to_insn);
+    r11f_free(sym);
+    r11f_free(insns);
+    r11f_free(pcs);
+    return err;
+}
+
+R11F_EXPORT void r11f_regir_free(r11f_regir_t *regir) {
+    if (!regir) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < regir->switch_count; i++) {
+        r11f_switch_free(regir->switches[i]);
+    }
+    r11f_free(regir->switches);
+    r11f_free(regir->loops);
+    r11f_free(regir->pcs);
+    r11f_free(regir->handler_insns);
+    r11f_free(regir);
+}
+
+R11F_EXPORT r11f_regir_loop_t *r11f_regir_find_loop(r11f_regir_t *regir,
+                                                    uint32_t pc) {
+    uint32_t low = 0;
+    uint32_t high = regir->loop_count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        r11f_regir_loop_t *loop = &regir->loops[mid];
+        if (loop->pc == pc) {
+            return loop;
+        } else if (loop->pc < pc) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return NULL;
+}
+
+R11F_EXPORT char const* r11f_regir_explain_op(uint16_t op) {
+    switch (op) {
+#define REGIR_OP(CODE) case R11F_RI_##CODE: return #CODE;
+#include "regirinc.h"
+
+    default:
+        assert(false && "unknown register IR op");
+        return "unknown";
+    }
+}
+
+R11F_EXPORT void r11f_regir_dump(FILE *fp, r11f_regir_t *regir) {
+    for (uint32_t i = 0; i < regir->insn_count; i++) {
+        r11f_regir_insn_t *insn = &regir->insns[i];
+        fprintf(
+            fp,
+            "[%u]\t%s d=%u a=%u b=%u imm=%lld\n",
+            i,
+            r11f_regir_explain_op(insn->op),
+            insn->dst,
+            insn->a,
+            insn->b,
+            (long long)insn->imm
+        );
+    }
+}
+
+static bool analyze_insn(r11f_linked_method_t *method,
+                         uint32_t pc,
+                         uint32_t *out_length,
+                         uint16_t *out_pop,
+                         uint16_t *out_push,
+                         uint8_t *out_flow,
+                         uint32_t *out_target) {
+    uint8_t *code = method->code;
+    uint8_t insc = code[pc];
+
+    *out_length = 1;
+    *out_pop = 0;
+    *out_push = 0;
+    *out_flow = FLOW_NEXT;
+    *out_target = 0;
+
+    switch (insc) {
+        case R11F_nop:
+            return true;
+
+        case R11F_iconst_m1: case R11F_iconst_0: case R11F_iconst_1:
+        case R11F_iconst_2: case R11F_iconst_3: case R11F_iconst_4:
+        case R11F_iconst_5: case R11F_lconst_0: case R11F_lconst_1:
+        case R11F_iload_0: case R11F_iload_1: case R11F_iload_2:
+        case R11F_iload_3: case R11F_lload_0: case R11F_lload_1:
+        case R11F_lload_2: case R11F_lload_3: case R11F_aload_0:
+        case R11F_aload_1: case R11F_aload_2: case R11F_aload_3:
+        case R11F_aconst_null:
+            *out_push = 1;
+            return true;
+
+        case R11F_bipush:
+        case R11F_ldc:
+        case R11F_iload:
+        case R11F_lload:
+        case R11F_aload:
+            *out_length = 2;
+            *out_push = 1;
+            return true;
+
+        case R11F_sipush:
+        case R11F_ldc_w:
+        case R11F_ldc2_w:
+            *out_length = 3;
+            *out_push = 1;
+            return true;
+
+        case R11F_istore_0: case R11F_istore_1: case R11F_istore_2:
+        case R11F_istore_3: case R11F_lstore_0: case R11F_lstore_1:
+        case R11F_lstore_2: case R11F_lstore_3: case R11F_astore_0:
+        case R11F_astore_1: case R11F_astore_2: case R11F_astore_3:
+        case R11F_pop:
+            *out_pop = 1;
+            return true;
+
+        case R11F_istore:
+        case R11F_lstore:
+        case R11F_astore:
+            *out_length = 2;
+            *out_pop = 1;
+            return true;
+
+        case R11F_iinc:
+            *out_length = 3;
+            return true;
+
+        case R11F_dup:
+            *out_pop = 1;
+            *out_push = 2;
+            return true;
+
+        case R11F_iadd: case R11F_isub: case R11F_imul: case R11F_idiv:
+        case R11F_irem: case R11F_ishl: case R11F_ishr: case R11F_iushr:
+        case R11F_iand: case R11F_ior: case R11F_ixor:
+        case R11F_ladd: case R11F_lsub: case R11F_lmul: case R11F_ldiv:
+        case R11F_lrem: case R11F_lshl: case R11F_lshr: case R11F_lushr:
+        case R11F_land: case R11F_lor: case R11F_lxor:
+        case R11F_lcmp:
+            *out_pop = 2;
+            *out_push = 1;
+            return true;
+
+        case R11F_ineg: case R11F_lneg:
+        case R11F_i2l: case R11F_l2i:
+        case R11F_i2b: case R11F_i2c: case R11F_i2s:
+        case R11F_arraylength:
+            *out_pop = 1;
+            *out_push = 1;
+            return true;
+
+        case R11F_newarray:
+            /* int[] only */
+            if (code[pc + 1] != 10) {
+                return false;
+            }
+            *out_length = 2;
+            *out_pop = 1;
+            *out_push = 1;
+            return true;
+
+        case R11F_iaload:
+            *out_pop = 2;
+            *out_push = 1;
+            return true;
+        case R11F_iastore:
+            *out_pop = 3;
+            return true;
+
+        case R11F_ifeq: case R11F_ifne: case R11F_iflt:
+        case R11F_ifge: case R11F_ifgt: case R11F_ifle:
+            *out_length = 3;
+            *out_pop = 1;
+            *out_flow = FLOW_BRANCH;
+            *out_target = pc + (int16_t)read_unaligned_be2(code + pc + 1);
+            return true;
+
+        case R11F_if_icmpeq: case R11F_if_icmpne: case R11F_if_icmplt:
+        case R11F_if_icmpge: case R11F_if_icmpgt: case R11F_if_icmple:
+            *out_length = 3;
+            *out_pop = 2;
+            *out_flow = FLOW_BRANCH;
+            *out_target = pc + (int16_t)read_unaligned_be2(code + pc + 1);
+            return true;
+
+        case R11F_goto:
+            *out_length = 3;
+            *out_flow = FLOW_GOTO;
+            *out_target = pc + (int16_t)read_unaligned_be2(code + pc + 1);
+            return true;
+
+        case R11F_tableswitch:
+        case R11F_lookupswitch:
+            *out_length = r11f_bytecode_length(code, method->code_length, pc);
+            *out_pop = 1;
+            *out_flow = FLOW_SWITCH;
+            return true;
+
+        case R11F_ireturn:
+        case R11F_lreturn:
+        case R11F_areturn:
+            *out_pop = 1;
+            *out_flow = FLOW_RETURN;
+            return true;
+
+        case R11F_return:
+            *out_flow = FLOW_RETURN;
+            return true;
+
+        case R11F_athrow:
+            *out_pop = 1;
+            *out_flow = FLOW_RETURN;
+            return true;
+
+        case R11F_invokestatic:
+        case R11F_invokevirtual: {
+            uint16_t index = read_unaligned_be2(code + pc + 1);
+            r11f_method_qual_name_t qual_name = r11f_class_get_method_name(
+                method->clazz,
+                method->clazz->constant_pool[index]
+            );
+            char const *return_type = qual_name.descriptor;
+            while (*return_type != ')') {
+                return_type++;
+            }
+
+            *out_length = 3;
+            *out_pop = r11f_descriptor_argc(qual_name.descriptor)
+                       + (insc == R11F_invokevirtual);
+            *out_push = return_type[1] == 'V' ? 0 : 1;
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+static bool analyze_depth(r11f_linked_method_t *method,
+                          int32_t *depth_at,
+                          bool *leader) {
+    uint32_t code_length = method->code_length;
+    uint32_t *worklist = r11f_alloc((code_length + 1) * sizeof(uint32_t));
+    if (!worklist) {
+        return false;
+    }
+
+    bool ok = true;
+    uint32_t worklist_size = 0;
+    worklist[worklist_size++] = 0;
+    depth_at[0] = 0;
+    leader[0] = true;
+
+    /* handlers start with nothing but the exception on the stack */
+    for (uint16_t i = 0; ok && i < method->handler_count; i++) {
+        ok = method->max_stack >= 1
+             && analyze_target(method, method->handlers[i].handler_pc, 1,
+                               depth_at, leader, worklist, &worklist_size);
+    }
+
+    while (ok && worklist_size) {
+        uint32_t pc = worklist[--worklist_size];
+        while (true) {
+            uint32_t length;
+            uint16_t pop, push;
+            uint8_t flow;
+            uint32_t target;
+            if (!analyze_insn(method, pc, &length, &pop, &push, &flow, &target)
+                || depth_at[pc] < pop) {
+                ok = false;
+                break;
+            }
+
+            int32_t depth = depth_at[pc] - pop + push;
+            if (depth > method->max_stack) {
+                ok = false;
+                break;
+            }
+
+            if (flow == FLOW_BRANCH || flow == FLOW_GOTO) {
+                if (!analyze_target(method, target, depth, depth_at, leader,
+                                    worklist, &worklist_size)) {
+                    ok = false;
+                    break;
+                }
+            }
+            else if (flow == FLOW_SWITCH) {
+                r11f_switch_t *sw = r11f_method_find_switch(method, pc);
+                ok = analyze_target(method, sw->default_target, depth,
+                                    depth_at, leader, worklist,
+                                    &worklist_size);
+                for (uint32_t i = 0; ok && i < sw->count; i++) {
+                    ok = analyze_target(method, sw->targets[i], depth,
+                                        depth_at, leader, worklist,
+                                        &worklist_size);
+                }
+                if (!ok) {
+                    break;
+                }
+            }
+
+            if (flow == FLOW_GOTO
+                || flow == FLOW_RETURN
+                || flow == FLOW_SWITCH) {
+                if (pc + length < code_length) {
+                    leader[pc + length] = true;
+                }
+                break;
+            }
+
+            pc += length;
+            if (pc >= code_length) {
+                ok = false;
+                break;
+            }
+            if (flow == FLOW_BRANCH) {
+                leader[pc] = true;
+            }
+            if (depth_at[pc] >= 0) {
+                ok = depth_at[pc] == depth;
+                break;
+            }
+            depth_at[pc] = depth;
+        }
+    }
+
+    r11f_free(worklist);
+    return ok;
+}
+
+static bool analyze_target(r11f_linked_method_t *method,
+                           uint32_t target,
+                           int32_t depth,
+                           int32_t *depth_at,
+                           bool *leader,
+                           uint32_t *worklist,
+                           uint32_t *worklist_size) {
+    if (target >= method->code_length) {
+        return false;
+    }
+
+    leader[target] = true;
+    if (depth_at[target] < 0) {
+        depth_at[target] = depth;
+        worklist[(*worklist_size)++] = target;
+        return true;
+    }
+    return depth_at[target] == depth;
+}
+
+static r11f_error_t remap_switches(r11f_linked_method_t *method,
+                                   r11f_regir_insn_t *insns,
+                                   uint32_t insn_count,
+                                   uint32_t const *pc_to_insn,
+                                   r11f_regir_t *regir) {
+    for (uint32_t i = 0; i < insn_count; i++) {
+        r11f_regir_insn_t *insn = &insns[i];
+        if (insn->op != R11F_RI_switch) {
+            continue;
+        }
+
+        /* imm still holds the bytecode pc of the switch */
+        r11f_switch_t *sw =
+            r11f_method_find_switch(method, (uint32_t)insn->imm);
+        r11f_error_t err = r11f_switch_remap(
+            sw,
+            pc_to_insn,
+            &regir->switches[regir->switch_count]
+        );
+        if (err != R11F_success) {
+            return err;
+        }
+        insn->imm = regir->switch_count++;
+    }
+    return R11F_success;
+}
+
+static bool translate_insn(translator_t *t, uint32_t pc) {
+    uint8_t *code = t->method->code;
+    r11f_class_t *clazz = t->method->clazz;
+    uint8_t insc = code[pc];
+
+    switch (insc) {
+        case R11F_nop:
+            break;
+
+        case R11F_aconst_null:
+            push_const(t, 0);
+            break;
+        case R11F_iconst_m1: case R11F_iconst_0: case R11F_iconst_1:
+        case R11F_iconst_2: case R11F_iconst_3: case R11F_iconst_4:
+        case R11F_iconst_5:
+            push_const(t, (int64_t)insc - R11F_iconst_0);
+            break;
+        case R11F_lconst_0:
+        case R11F_lconst_1:
+            push_const(t, (int64_t)insc - R11F_lconst_0);
+            break;
+        case R11F_bipush:
+            push_const(t, (int8_t)code[pc + 1]);
+            break;
+        case R11F_sipush:
+            push_const(t, (int16_t)read_unaligned_be2(code + pc + 1));
+            break;
+        case R11F_ldc:
+        case R11F_ldc_w: {
+            uint16_t index = insc == R11F_ldc ?
+                code[pc + 1] :
+                read_unaligned_be2(code + pc + 1);
+            r11f_cpinfo_t *cpinfo = clazz->constant_pool[index];
+            if (cpinfo->tag != R11F_CONSTANT_Integer) {
+                return false;
+            }
+            r11f_constant_integer_info_t *integer_info =
+                clazz->constant_pool[index];
+            push_const(t, (int32_t)integer_info->bytes);
+            break;
+        }
+        case R11F_ldc2_w: {
+            uint16_t index = read_unaligned_be2(code + pc + 1);
+            r11f_cpinfo_t *cpinfo = clazz->constant_pool[index];
+            if (cpinfo->tag != R11F_CONSTANT_Long) {
+                return false;
+            }
+            r11f_constant_long_info_t *long_info =
+                clazz->constant_pool[index];
+            push_const(
+                t,
+                (int64_t)(((uint64_t)long_info->high_bytes << 32)
+                          | long_info->low_bytes)
+            );
+            break;
+        }
+
+        case R11F_iload_0: case R11F_iload_1: case R11F_iload_2:
+        case R11F_iload_3:
+            push_reg(t, local_reg(t, insc - R11F_iload_0));
+            break;
+        case R11F_lload_0: case R11F_lload_1: case R11F_lload_2:
+        case R11F_lload_3:
+            push_reg(t, local_reg(t, insc - R11F_lload_0));
+            break;
+        case R11F_aload_0: case R11F_aload_1: case R11F_aload_2:
+        case R11F_aload_3:
+            push_reg(t, local_reg(t, insc - R11F_aload_0));
+            break;
+        case R11F_iload:
+        case R11F_lload:
+        case R11F_aload:
+            push_reg(t, local_reg(t, code[pc + 1]));
+            break;
+
+        case R11F_istore_0: case R11F_istore_1: case R11F_istore_2:
+        case R11F_istore_3:
+            store_local(t, insc - R11F_istore_0);
+            break;
+        case R11F_lstore_0: case R11F_lstore_1: case R11F_lstore_2:
+        case R11F_lstore_3:
+            store_local(t, insc - R11F_lstore_0);
+            break;
+        case R11F_astore_0: case R11F_astore_1: case R11F_astore_2:
+        case R11F_astore_3:
+            store_local(t, insc - R11F_astore_0);
+            break;
+        case R11F_istore:
+        case R11F_lstore:
+        case R11F_astore:
+            store_local(t, code[pc + 1]);
+            break;
+
+        case R11F_iinc: {
+            uint16_t reg = local_reg(t, code[pc + 1]);
+            materialize_local_refs(t, reg);
+            emit(t, R11F_RI_iaddi, reg, reg, 0, (int8_t)code[pc + 2]);
+            break;
+        }
+
+        case R11F_pop:
+            t->depth--;
+            break;
+        case R11F_dup:
+            t->sym[t->depth] = t->sym[t->depth - 1];
+            t->depth++;
+            break;
+
+        case R11F_iadd: binop(t, R11F_RI_iadd, R11F_RI_iaddi, true); break;
+        case R11F_isub: binop(t, R11F_RI_isub, 0, false); break;
+        case R11F_imul: binop(t, R11F_RI_imul, R11F_RI_imuli, true); break;
+        case R11F_idiv: binop(t, R11F_RI_idiv, 0, false); break;
+        case R11F_irem: binop(t, R11F_RI_irem, 0, false); break;
+        case R11F_ishl: binop(t, R11F_RI_ishl, R11F_RI_ishli, false); break;
+        case R11F_ishr: binop(t, R11F_RI_ishr, R11F_RI_ishri, false); break;
+        case R11F_iushr: binop(t, R11F_RI_iushr, R11F_RI_iushri, false); break;
+        case R11F_iand: binop(t, R11F_RI_iand, R11F_RI_iandi, true); break;
+        case R11F_ior: binop(t, R11F_RI_ior, R11F_RI_iori, true); break;
+        case R11F_ixor: binop(t, R11F_RI_ixor, R11F_RI_ixori, true); break;
+        case R11F_ladd: binop(t, R11F_RI_ladd, R11F_RI_laddi, true); break;
+        case R11F_lsub: binop(t, R11F_RI_lsub, 0, false); break;
+        case R11F_lmul: binop(t, R11F_RI_lmul, 0, false); break;
+        case R11F_ldiv: binop(t, R11F_RI_ldiv, 0, false); break;
+        case R11F_lrem: binop(t, R11F_RI_lrem, 0, false); break;
+        case R11F_lshl: binop(t, R11F_RI_lshl, 0, false); break;
+        case R11F_lshr: binop(t, R11F_RI_lshr, 0, false); break;
+        case R11F_lushr: binop(t, R11F_RI_lushr, 0, false); break;
+        case R11F_land: binop(t, R11F_RI_land, 0, false); break;
+        case R11F_lor: binop(t, R11F_RI_lor, 0, false); break;
+        case R11F_lxor: binop(t, R11F_RI_lxor, 0, false); break;
+        case R11F_lcmp: binop(t, R11F_RI_lcmp, 0, false); break;
+
+        case R11F_ineg: unop(t, R11F_RI_ineg); break;
+        case R11F_lneg: unop(t, R11F_RI_lneg); break;
+        case R11F_i2l: unop(t, R11F_RI_i2l); break;
+        case R11F_l2i: unop(t, R11F_RI_l2i); break;
+        case R11F_i2b: unop(t, R11F_RI_i2b); break;
+        case R11F_i2c: unop(t, R11F_RI_i2c); break;
+        case R11F_i2s: unop(t, R11F_RI_i2s); break;
+
+        case R11F_newarray: unop(t, R11F_RI_newarray); break;
+        case R11F_arraylength: unop(t, R11F_RI_arraylength); break;
+        case R11F_iaload: binop(t, R11F_RI_iaload, 0, false); break;
+        case R11F_iastore: {
+            uint16_t ra = operand(t, t->depth - 3);
+            uint16_t rb = operand(t, t->depth - 2);
+            uint16_t rv = operand(t, t->depth - 1);
+            t->depth -= 3;
+            emit(t, R11F_RI_iastore, rv, ra, rb, 0);
+            break;
+        }
+
+        case R11F_ifeq: case R11F_ifne: case R11F_iflt:
+        case R11F_ifge: case R11F_ifgt: case R11F_ifle:
+            branch1(
+                t,
+                R11F_RI_ifeq + (insc - R11F_ifeq),
+                pc + (int16_t)read_unaligned_be2(code + pc + 1)
+            );
+            break;
+
+        case R11F_if_icmpeq: case R11F_if_icmpne: case R11F_if_icmplt:
+        case R11F_if_icmpge: case R11F_if_icmpgt: case R11F_if_icmple:
+            branch2(
+                t,
+                R11F_RI_if_icmpeq + (insc - R11F_if_icmpeq),
+                pc + (int16_t)read_unaligned_be2(code + pc + 1)
+            );
+            break;
+
+        case R11F_goto:
+            materialize_all(t);
+            emit(
+                t,
+                R11F_RI_goto,
+                (uint16_t)(pc + (int16_t)read_unaligned_be2(code + pc + 1)),
+                0,
+                0,
+                0
+            );
+            break;
+
+        case R11F_tableswitch:
+        case R11F_lookupswitch: {
+            uint16_t reg = operand(t, t->depth - 1);
+            t->depth--;
+            materialize_all(t);
+            emit(t, R11F_RI_switch, 0, reg, 0, pc);
+            break;
+        }
+
+        case R11F_ireturn:
+        case R11F_lreturn:
+        case R11F_areturn: {
+            uint16_t reg = operand(t, t->depth - 1);
+            t->depth--;
+            emit(
+                t,
+                insc == R11F_ireturn ? R11F_RI_ireturn : R11F_RI_lreturn,
+                0,
+                reg,
+                0,
+                0
+            );
+            break;
+        }
+        case R11F_return:
+            emit(t, R11F_RI_return, 0, 0, 0, 0);
+            break;
+
+        case R11F_athrow: {
+            uint16_t reg = operand(t, t->depth - 1);
+            t->depth--;
+            emit(t, R11F_RI_athrow, 0, reg, 0, 0);
+            break;
+        }
+
+        case R11F_invokestatic:
+        case R11F_invokevirtual: {
+            uint16_t index = read_unaligned_be2(code + pc + 1);
+            r11f_method_qual_name_t qual_name = r11f_class_get_method_name(
+                clazz,
+                clazz->constant_pool[index]
+            );
+            char const *return_type = qual_name.descriptor;
+            while (*return_type != ')') {
+                return_type++;
+            }
+            uint16_t argc = r11f_descriptor_argc(qual_name.descriptor)
+                            + (insc == R11F_invokevirtual);
+            uint16_t base = t->depth - argc;
+            for (uint16_t i = base; i < t->depth; i++) {
+                materialize(t, i);
+            }
+
+            uint16_t fn = insc == R11F_invokestatic ?
+                r11f_nativefn_find_ref(clazz, index) :
+                R11F_NATIVEFN_NONE;
+            uint16_t reg = slot_reg(t, base);
+            if (fn == R11F_NATIVEFN_yield) {
+                emit(t, R11F_RI_yield, 0, 0, 0, 0);
+            }
+            else if (fn != R11F_NATIVEFN_NONE) {
+                emit(t, R11F_RI_intrinsic, reg, reg, 0, fn);
+            }
+            else {
+                emit(
+                    t,
+                    insc == R11F_invokestatic ?
+                        R11F_RI_invokestatic :
+                        R11F_RI_invokevirtual,
+                    reg,
+                    reg,
+                    0,
+                    index
+                );
+            }
+            t->depth = base;
+            if (return_type[1] != 'V') {
+                push_reg(t, reg);
+            }
+            break;
+        }
+
+        default:
+            assert(false && "analyze_insn accepted an unsupported bytecode");
+            return false;
+    }
+
+    return true;
+}
+
+static uint32_t emit(translator_t *t,
+                     uint16_t op,
+                     uint16_t dst,
+                     uint16_t a,
+                     uint16_t b,
+                     int64_t imm) {
+    t->insns[t->insn_count] = (r11f_regir_insn_t) {
+        .op = op,
+        .dst = dst,
+        .a = a,
+        .b = b,
+        .imm = imm
+    };
+    return t->insn_count++;
+}
+
+static uint16_t local_reg(translator_t *t, uint16_t index) {
+    (void)t;
+    return index;
+}
+
+static uint16_t slot_reg(translator_t *t, uint16_t slot) {
+    return t->method->max_locals + slot;
+}
+
+static void materialize(translator_t *t, uint16_t slot) {
+    sym_t *sym = &t->sym[slot];
+    uint16_t reg = slot_reg(t, slot);
+    if (sym->kind == SYM_CONST) {
+        emit(t, R11F_RI_movi, reg, 0, 0, sym->value);
+    }
+    else if (sym->reg != reg) {
+        emit(t, R11F_RI_mov, reg, sym->reg, 0, 0);
+    }
+    *sym = (sym_t){ .kind = SYM_REG, .reg = reg };
+}
+
+static void materialize_all(translator_t *t) {
+    for (uint16_t i = 0; i < t->depth; i++) {
+        materialize(t, i);
+    }
+}
+
+static void materialize_local_refs(translator_t *t, uint16_t reg) {
+    for (uint16_t i = 0; i < t->depth; i++) {
+        if (t->sym[i].kind == SYM_REG && t->sym[i].reg == reg) {
+            materialize(t, i);
+        }
+    }
+}
+
+static uint16_t operand(translator_t *t, uint16_t slot) {
+    if (t->sym[slot].kind == SYM_CONST) {
+        materialize(t, slot);
+    }
+    return t->sym[slot].reg;
+}
+
+static void push_reg(translator_t *t, uint16_t reg) {
+    t->sym[t->depth] = (sym_t){ .kind = SYM_REG, .reg = reg };
+    t->depth++;
+}
+
+static void push_const(translator_t *t, int64_t value) {
+    t->sym[t->depth] = (sym_t){ .kind = SYM_CONST, .value = value };
+    t->depth++;
+}
+
+static void store_local(translator_t *t, uint16_t index) {
+    uint16_t reg = local_reg(t, index);
+    uint16_t slot = slot_reg(t, t->depth - 1);
+    sym_t top = t->sym[t->depth - 1];
+    t->depth--;
+
+    bool referenced = false;
+    for (uint16_t i = 0; i < t->depth; i++) {
+        if (t->sym[i].kind == SYM_REG && t->sym[i].reg == reg) {
+            referenced = true;
+            break;
+        }
+    }
+
+    /* the value was just computed into its stack slot by the previous
+       instruction of this block, let that instruction write the local
+       directly instead of emitting a move */
+    if (!referenced
+        && top.kind == SYM_REG
+        && top.reg == slot
+        && t->insn_count > t->block_start
+        && t->insns[t->insn_count - 1].dst == slot
+        && (t->insns[t->insn_count - 1].op < R11F_RI_ifeq
+            || t->insns[t->insn_count - 1].op == R11F_RI_invokestatic
+            || t->insns[t->insn_count - 1].op == R11F_RI_invokevirtual)) {
+        t->insns[t->insn_count - 1].dst = reg;
+        return;
+    }
+
+    materialize_local_refs(t, reg);
+    if (top.kind == SYM_CONST) {
+        emit(t, R11F_RI_movi, reg, 0, 0, top.value);
+    }
+    else if (top.reg != reg) {
+        emit(t, R11F_RI_mov, reg, top.reg, 0, 0);
+    }
+}
+
+static void binop(translator_t *t, uint16_t op, uint16_t opi, bool commute) {
+    uint16_t slot = t->depth - 2;
+    uint16_t dst = slot_reg(t, slot);
+    sym_t *a = &t->sym[slot];
+    sym_t *b = &t->sym[slot + 1];
+
+    if (opi && b->kind == SYM_CONST) {
+        emit(t, opi, dst, operand(t, slot), 0, b->value);
+    }
+    else if (opi && commute && a->kind == SYM_CONST) {
+        emit(t, opi, dst, operand(t, slot + 1), 0, a->value);
+    }
+    else {
+        uint16_t ra = operand(t, slot);
+        uint16_t rb = operand(t, slot + 1);
+        emit(t, op, dst, ra, rb, 0);
+    }
+
+    t->depth--;
+    t->sym[slot] = (sym_t){ .kind = SYM_REG, .reg = dst };
+}
+
+static void unop(translator_t *t, uint16_t op) {
+    uint16_t slot = t->depth - 1;
+    uint16_t dst = slot_reg(t, slot);
+    emit(t, op, dst, operand(t, slot), 0, 0);
+    t->sym[slot] = (sym_t){ .kind = SYM_REG, .reg = dst };
+}
+
+static void branch1(translator_t *t, uint16_t op, uint32_t target) {
+    uint16_t reg = operand(t, t->depth - 1);
+    t->depth--;
+    materialize_all(t);
+    emit(t, op, (uint16_t)target, reg, 0, 0);
+}
+
+static void branch2(translator_t *t, uint16_t op, uint32_t target) {
+    sym_t a = t->sym[t->depth - 2];
+    sym_t b = t->sym[t->depth - 1];
+    uint16_t offset = op - R11F_RI_if_icmpeq;
+
+    if (b.kind == SYM_CONST) {
+        uint16_t ra = operand(t, t->depth - 2);
+        t->depth -= 2;
+        materialize_all(t);
+        emit(t, R11F_RI_if_icmpeqi + offset, (uint16_t)target, ra, 0, b.value);
+    }
+    else if (a.kind == SYM_CONST) {
+        /* c < x is x > c and so on, eq and ne are symmetric */
+        static const uint16_t swapped[] = { 0, 1, 4, 5, 2, 3 };
+        uint16_t rb = operand(t, t->depth - 1);
+        t->depth -= 2;
+        materialize_all(t);
+        emit(
+            t,
+            R11F_RI_if_icmpeqi + swapped[offset],
+            (uint16_t)target,
+            rb,
+            0,
+            a.value
+        );
+    }
+    else {
+        uint16_t ra = operand(t, t->depth - 2);
+        uint16_t rb = operand(t, t->depth - 1);
+        t->depth -= 2;
+        materialize_all(t);
+        emit(t, op, (uint16_t)target, ra, rb, 0);
+    }
+}
@@ -0,0 +1,1983 @@
+#include "ssa.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "class.h"
+#include "class/cpool.h"
+#include "codecache.h"
+#include "frame.h"
+#include "jit.h"
+#include "link.h"
+#include "nativefn.h"
+#include "object.h"
+
+#if defined(__x86_64__) && !defined(WIN32)
+
+/*
+ * Machine code generation for the optimizing tier. Values get machine
+ * registers through linear scan allocation over single live ranges, the
+ * rest lives in stack slots below rbp:
+ *
+ *   [rbp - 40, rbp)   saved rbx, r12 - r15
+ *   [rbp - 48]        vm
+ *   [rbp - 56]        frame
+ *   [rbp - 64]        result pointer
+ *   [rbp - 72 - 8k]   spill slot k
+ *   [rsp, ...)        outgoing call arguments, followed by the result
+ *
+ * rax, rcx and rdx are scratch registers and never hold values.
+ * Constants are not allocated at all, every use materializes them.
+ *
+ * Vectorized loops use xmm0 - xmm14 (ymm with AVX2) as their kernel
+ * says, xmm15 as scratch; nothing lives in them beyond the loop.
+ */
+
+enum {
+    RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+    R8 = 8, R9 = 9, R10 = 10, R11 = 11, R12 = 12, R13 = 13, R14 = 14, R15 = 15
+};
+
+enum {
+    SLOT_VM = -48,
+    SLOT_FRAME = -56,
+    SLOT_RESULT = -64,
+    SLOT_SPILL = -72
+};
+
+/* values living across calls may only use callee saved registers */
+static const uint8_t g_callee_saved[] = { RBX, R12, R13, R14, R15 };
+static const uint8_t g_caller_saved[] = { RSI, RDI, R8, R9, R10, R11 };
+
+/* jcc opcodes (second byte after 0x0f) for eq, ne, lt, ge, gt, le */
+static const uint8_t g_jcc[] = { 0x84, 0x85, 0x8c, 0x8d, 0x8f, 0x8e };
+
+enum {
+    TARGET_EXIT = UINT32_MAX,
+    TARGET_DIV0 = UINT32_MAX - 1,
+    TARGET_NULL = UINT32_MAX - 2,
+    TARGET_BOUNDS = UINT32_MAX - 3
+};
+
+/* index register of a SIMD memory operand that has none */
+#define NO_INDEX RSP
+
+enum {
+    LOC_NONE = 0,
+    LOC_REG = 1,
+    LOC_STACK = 2,
+    LOC_CONST = 3
+};
+
+typedef struct {
+    uint8_t kind;
+    uint8_t reg;
+    int32_t disp;
+    int64_t imm;
+} loc_t;
+
+typedef struct {
+    uint32_t at;
+    uint32_t target;
+} fixup_t;
+
+typedef struct {
+    r11f_ssa_t *ssa;
+
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    fixup_t *fixups;
+    uint32_t fixup_count;
+    uint32_t fixup_capacity;
+    bool oom;
+
+    /* reachable blocks in emission order */
+    uint32_t *order;
+    uint32_t order_count;
+    uint32_t *block_offset;
+
+    /* instruction positions for live ranges */
+    uint32_t *value_pos;
+    uint32_t *block_start;
+    uint32_t *block_end;
+    uint32_t *range_start;
+    uint32_t *range_end;
+    bool *allocatable;
+
+    loc_t *locs;
+    uint32_t spill_count;
+    uint32_t out_slots;
+
+    r11f_jit_callsite_t *callsites;
+    uint32_t callsite_count;
+
+    /* vector loops run on ymm registers with VEX encoded instructions,
+       otherwise on xmm registers with SSE4.1 */
+    bool avx;
+    /* bit count intrinsics use popcnt, lzcnt and tzcnt, otherwise bsr,
+       bsf and a multiply */
+    bool popcnt;
+    bool lzcnt;
+    bool tzcnt;
+
+    r11f_jit_code_t *jit;
+} gen_t;
+
+typedef struct {
+    loc_t dst;
+    loc_t src;
+} move_t;
+
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    uint32_t value;
+} range_t;
+
+static void split_critical_edges(r11f_ssa_t *ssa);
+static bool compute_order(gen_t *gen);
+static bool compute_ranges(gen_t *gen);
+static bool allocate_registers(gen_t *gen);
+static int compare_ranges(void const *lhs, void const *rhs);
+static bool is_live_value(r11f_ssa_t *ssa, uint32_t v);
+
+static void gen_block(gen_t *gen, uint32_t index);
+static void gen_value(gen_t *gen, uint32_t v);
+static void gen_binop(gen_t *gen, uint32_t v, r11f_ssa_value_t *value);
+static void gen_shift(gen_t *gen, uint32_t v, r11f_ssa_value_t *value);
+static void gen_div(gen_t *gen, uint32_t v, r11f_ssa_value_t *value);
+static void gen_call(gen_t *gen, uint32_t v, r11f_ssa_value_t *value);
+static void gen_intrinsic(gen_t *gen, uint32_t v, r11f_ssa_value_t *value);
+static void gen_bit_count(gen_t *gen, bool wide);
+static void gen_new_array(gen_t *gen, uint32_t v, r11f_ssa_value_t *value);
+static uint8_t gen_element(gen_t *gen, r11f_ssa_value_t *value);
+static void gen_vloop(gen_t *gen, uint32_t v, r11f_ssa_value_t *value);
+static void gen_vec_alu(gen_t *gen, r11f_ssa_vinsn_t const *insn, bool wide);
+static void gen_vec_element(gen_t *gen,
+                            uint8_t opcode,
+                            uint8_t reg,
+                            loc_t array);
+static void gen_broadcast(gen_t *gen, uint8_t reg, uint8_t gpr);
+static void gen_horizontal_sum(gen_t *gen, uint8_t reg);
+static void gen_deopt(gen_t *gen, r11f_ssa_value_t *value);
+static bool copy_deopt_points(gen_t *gen);
+static void gen_phi_moves(gen_t *gen, uint32_t from, uint32_t to);
+static void gen_move(gen_t *gen, loc_t dst, loc_t src);
+
+static loc_t value_loc(gen_t *gen, uint32_t v);
+static bool loc_equal(loc_t lhs, loc_t rhs);
+static uint8_t target_reg(gen_t *gen, uint32_t v, uint32_t avoid);
+static void emit_load(gen_t *gen, uint8_t reg, loc_t loc);
+static void emit_store(gen_t *gen, loc_t loc, uint8_t reg);
+static void emit_alu(gen_t *gen,
+                     bool wide,
+                     uint16_t opcode,
+                     uint8_t digit,
+                     uint8_t reg,
+                     loc_t operand);
+static void emit_rr(gen_t *gen, bool wide, uint16_t opcode,
+                    uint8_t reg, uint8_t rm);
+static void emit_rm(gen_t *gen, bool wide, uint16_t opcode,
+                    uint8_t reg, uint8_t base, int32_t disp);
+static void emit_element(gen_t *gen, uint16_t opcode,
+                         uint8_t reg, uint8_t base, uint8_t index);
+static void emit_simd(gen_t *gen, uint8_t pp, uint8_t map, uint8_t opcode,
+                      bool wide, uint8_t reg, uint8_t vvvv, uint8_t rm);
+static void emit_simd_mem(gen_t *gen, uint8_t pp, uint8_t map,
+                          uint8_t opcode, bool wide, uint8_t reg,
+                          uint8_t base, uint8_t index, int32_t disp);
+static void emit_simd_prefix(gen_t *gen, uint8_t pp, uint8_t map, bool wide,
+                             uint8_t reg, uint8_t vvvv, uint8_t index,
+                             uint8_t rm);
+static void emit_mov_imm(gen_t *gen, uint8_t reg, int64_t imm);
+static void emit_jump(gen_t *gen, uint8_t jcc, uint32_t target);
+static void emit_u8(gen_t *gen, uint8_t value);
+static void emit_u32(gen_t *gen, uint32_t value);
+static void emit_u64(gen_t *gen, uint64_t value);
+static void emit_bytes(gen_t *gen, uint8_t const *bytes, size_t count);
+
+R11F_INTERNAL r11f_error_t r11f_ssa_codegen(r11f_ssa_t *ssa,
+                                            r11f_jit_code_t **output) {
+    split_critical_edges(ssa);
+    if (ssa->oom) {
+        return R11F_ERR_out_of_memory;
+    }
+
+    gen_t gen;
+    memset(&gen, 0, sizeof(gen_t));
+    gen.ssa = ssa;
+    gen.avx = ssa->simd >= R11F_SIMD_AVX2;
+    /* they came with SSE4.2 and AVX2 respectively, the SIMD level caps
+       them as well */
+    __builtin_cpu_init();
+    gen.popcnt = ssa->simd >= R11F_SIMD_SSE41
+        && __builtin_cpu_supports("popcnt");
+    gen.lzcnt = ssa->simd >= R11F_SIMD_AVX2
+        && __builtin_cpu_supports("lzcnt");
+    gen.tzcnt = ssa->simd >= R11F_SIMD_AVX2
+        && __builtin_cpu_supports("bmi");
+
+    r11f_jit_code_t *jit = r11f_alloc_zeroed(sizeof(r11f_jit_code_t));
+    gen.jit = jit;
+    r11f_error_t err = R11F_success;
+    if (!jit
+        || !copy_deopt_points(&gen)
+        || !compute_order(&gen)
+        || !compute_ranges(&gen)
+        || !allocate_registers(&gen)) {
+        err = R11F_ERR_out_of_memory;
+        goto cleanup;
+    }
+
+    if (gen.callsite_count) {
+        gen.callsites =
+            r11f_alloc_zeroed(gen.callsite_count * sizeof(r11f_jit_callsite_t));
+        if (!gen.callsites) {
+            err = R11F_ERR_out_of_memory;
+            goto cleanup;
+        }
+    }
+    gen.callsite_count = 0;
+
+    uint32_t frame_size = 24 + 8 * (gen.spill_count + gen.out_slots);
+    if ((40 + frame_size) % 16 != 0) {
+        frame_size += 8;
+    }
+
+    /* push rbp; mov rbp, rsp; push rbx; push r12; push r13; push r14;
+       push r15; sub rsp, frame_size */
+    emit_bytes(&gen, (uint8_t[]){ 0x55, 0x48, 0x89, 0xe5, 0x53, 0x41, 0x54,
+                                  0x41, 0x55, 0x41, 0x56, 0x41, 0x57,
+                                  0x48, 0x81, 0xec }, 16);
+    emit_u32(&gen, frame_size);
+    emit_rm(&gen, true, 0x89, RDI, RBP, SLOT_VM);
+    emit_rm(&gen, true, 0x89, RSI, RBP, SLOT_FRAME);
+    emit_rm(&gen, true, 0x89, RDX, RBP, SLOT_RESULT);
+
+    for (uint32_t i = 0; i < gen.order_count; i++) {
+        gen_block(&gen, i);
+    }
+
+    uint32_t exit_offset = (uint32_t)gen.size;
+    /* lea rsp, [rbp - 40]; pop r15; pop r14; pop r13; pop r12; pop rbx;
+       pop rbp; ret */
+    emit_bytes(&gen, (uint8_t[]){ 0x48, 0x8d, 0x65, 0xd8, 0x41, 0x5f,
+                                  0x41, 0x5e, 0x41, 0x5d, 0x41, 0x5c,
+                                  0x5b, 0x5d, 0xc3 }, 15);
+
+    uint32_t div0_offset = (uint32_t)gen.size;
+    /* mov eax, R11F_ERR_division_by_zero; jmp exit */
+    emit_u8(&gen, 0xb8);
+    emit_u32(&gen, R11F_ERR_division_by_zero);
+    emit_jump(&gen, 0, TARGET_EXIT);
+
+    uint32_t null_offset = (uint32_t)gen.size;
+    /* mov eax, R11F_ERR_null_pointer; jmp exit */
+    emit_u8(&gen, 0xb8);
+    emit_u32(&gen, R11F_ERR_null_pointer);
+    emit_jump(&gen, 0, TARGET_EXIT);
+
+    uint32_t bounds_offset = (uint32_t)gen.size;
+    /* mov eax, R11F_ERR_array_index_out_of_bounds; jmp exit */
+    emit_u8(&gen, 0xb8);
+    emit_u32(&gen, R11F_ERR_array_index_out_of_bounds);
+    emit_jump(&gen, 0, TARGET_EXIT);
+
+    if (gen.oom) {
+        err = R11F_ERR_out_of_memory;
+        goto cleanup;
+    }
+
+    for (uint32_t i = 0; i < gen.fixup_count; i++) {
+        fixup_t *fixup = &gen.fixups[i];
+        uint32_t target = fixup->target == TARGET_EXIT ? exit_offset :
+            fixup->target == TARGET_DIV0 ? div0_offset :
+            fixup->target == TARGET_NULL ? null_offset :
+            fixup->target == TARGET_BOUNDS ? bounds_offset :
+            gen.block_offset[fixup->target];
+        uint32_t rel = target - (fixup->at + 4);
+        memcpy(gen.data + fixup->at, &rel, 4);
+    }
+
+    void *writable;
+    void *code = r11f_codecache_alloc(gen.size, &writable);
+    if (!code) {
+        err = R11F_ERR_out_of_memory;
+        goto cleanup;
+    }
+    memcpy(writable, gen.data, gen.size);
+    jit->entry = (r11f_jit_entry_t)code;
+    jit->code_size = gen.size;
+    jit->callsite_count = gen.callsite_count;
+    jit->callsites = gen.callsites;
+    jit->inlined_count = ssa->inlined_count;
+    jit->replaced_count = ssa->replaced_count;
+    gen.callsites = NULL;
+
+    *output = jit;
+    jit = NULL;
+
+cleanup:
+    r11f_jit_free(jit);
+    r11f_free(gen.callsites);
+    r11f_free(gen.data);
+    r11f_free(gen.fixups);
+    r11f_free(gen.order);
+    r11f_free(gen.block_offset);
+    r11f_free(gen.value_pos);
+    r11f_free(gen.block_start);
+    r11f_free(gen.block_end);
+    r11f_free(gen.range_start);
+    r11f_free(gen.range_end);
+    r11f_free(gen.allocatable);
+    r11f_free(gen.locs);
+    return err;
+}
+
+/* phi moves need a block of their own on edges from a branch into a
+   block with several predecessors */
+static void split_critical_edges(r11f_ssa_t *ssa) {
+    uint32_t block_count = ssa->block_count;
+    for (uint32_t b = 0; b < block_count; b++) {
+        if (b != 0 && !ssa->blocks[b].pred_count) {
+            continue;
+        }
+        if (ssa->blocks[b].term != R11F_SSA_BRANCH) {
+            continue;
+        }
+
+        for (uint32_t k = 0; k < 2; k++) {
+            uint32_t succ = ssa->blocks[b].succs[k];
+            if (ssa->blocks[succ].pred_count < 2) {
+                continue;
+            }
+
+            uint32_t split = r11f_ssa_new_block(ssa);
+            if (ssa->oom) {
+                return;
+            }
+            ssa->blocks[split].term = R11F_SSA_JUMP;
+            ssa->blocks[split].succs[0] = succ;
+            r11f_ssa_add_pred(ssa, split, b);
+
+            r11f_ssa_block_t *target = &ssa->blocks[succ];
+            for (uint32_t i = 0; i < target->pred_count; i++) {
+                if (target->preds[i] == b) {
+                    target->preds[i] = split;
+                    break;
+                }
+            }
+            ssa->blocks[b].succs[k] = split;
+        }
+    }
+}
+
+/* reverse postorder of the reachable blocks */
+static bool compute_order(gen_t *gen) {
+    r11f_ssa_t *ssa = gen->ssa;
+    uint32_t block_count = ssa->block_count;
+    gen->order = r11f_alloc(block_count * sizeof(uint32_t));
+    gen->block_offset = r11f_alloc_zeroed(block_count * sizeof(uint32_t));
+    uint32_t *stack = r11f_alloc((block_count + 1) * sizeof(uint32_t));
+    uint8_t *state = r11f_alloc_zeroed(block_count);
+    if (!gen->order || !gen->block_offset || !stack || !state) {
+        r11f_free(stack);
+        r11f_free(state);
+        return false;
+    }
+
+    uint32_t sp = 0;
+    uint32_t count = 0;
+    stack[sp++] = 0;
+    state[0] = 1;
+    while (sp) {
+        r11f_ssa_block_t *block = &ssa->blocks[stack[sp - 1]];
+        bool pushed = false;
+        /* the successor visited last follows the block, for a branch
+           that is the one taken when the condition fails */
+        for (uint32_t s = 0; s < r11f_ssa_succ_count(block); s++) {
+            uint32_t succ = block->succs[s];
+            if (!state[succ]) {
+                state[succ] = 1;
+                stack[sp++] = succ;
+                pushed = true;
+                break;
+            }
+        }
+        if (!pushed) {
+            gen->order[count++] = stack[--sp];
+        }
+    }
+
+    for (uint32_t i = 0; i < count / 2; i++) {
+        uint32_t t = gen->order[i];
+        gen->order[i] = gen->order[count - 1 - i];
+        gen->order[count - 1 - i] = t;
+    }
+    gen->order_count = count;
+
+    r11f_free(stack);
+    r11f_free(state);
+    return true;
+}
+
+static bool is_live_value(r11f_ssa_t *ssa, uint32_t v) {
+    r11f_ssa_value_t *value = &ssa->values[v];
+    return !value->dead
+        && value->forward == R11F_SSA_NONE
+        && value->op != R11F_SSA_const;
+}
+
+static bool compute_ranges(gen_t *gen) {
+    r11f_ssa_t *ssa = gen->ssa;
+    uint32_t value_count = ssa->value_count;
+    uint32_t block_count = ssa->block_count;
+    uint32_t words = (value_count + 63) / 64;
+
+    gen->value_pos = r11f_alloc_zeroed(value_count * sizeof(uint32_t));
+    gen->range_start = r11f_alloc(value_count * sizeof(uint32_t));
+    gen->range_end = r11f_alloc(value_count * sizeof(uint32_t));
+    gen->allocatable = r11f_alloc_zeroed(value_count * sizeof(bool));
+    gen->block_start = r11f_alloc_zeroed(block_count * sizeof(uint32_t));
+    gen->block_end = r11f_alloc_zeroed(block_count * sizeof(uint32_t));
+    uint64_t *live_in =
+        r11f_alloc_zeroed((size_t)block_count * words * sizeof(uint64_t));
+    uint64_t *live_out =
+        r11f_alloc_zeroed((size_t)block_count * words * sizeof(uint64_t));
+    uint64_t *live = r11f_alloc((words + 1) * sizeof(uint64_t));
+    bool ok = gen->value_pos && gen->range_start && gen->range_end
+        && gen->allocatable && gen->block_start && gen->block_end
+        && live_in && live_out && live;
+    if (!ok) {
+        goto cleanup;
+    }
+
+    #define SET(BITS, V) ((BITS)[(V) / 64] |= (uint64_t)1 << ((V) % 64))
+    #define CLEAR(BITS, V) ((BITS)[(V) / 64] &= ~((uint64_t)1 << ((V) % 64)))
+    #define TEST(BITS, V) (((BITS)[(V) / 64] >> ((V) % 64)) & 1)
+    #define USE(V) \
+        do { \
+            uint32_t u_ = r11f_ssa_resolve(ssa, (V)); \
+            if (gen->allocatable[u_]) { \
+                SET(live, u_); \
+            } \
+        } while (0)
+
+    /* number instructions and find the values needing a location */
+    uint32_t pos = 0;
+    for (uint32_t i = 0; i < gen->order_count; i++) {
+        uint32_t b = gen->order[i];
+        r11f_ssa_block_t *block = &ssa->blocks[b];
+        gen->block_start[b] = pos++;
+        for (uint32_t j = 0; j < block->value_count; j++) {
+            uint32_t v = block->values[j];
+            r11f_ssa_value_t *value = &ssa->values[v];
+            if (!is_live_value(ssa, v)) {
+                continue;
+            }
+            if (value->op == R11F_SSA_phi) {
+                gen->value_pos[v] = gen->block_start[b];
+            }
+            else {
+                gen->value_pos[v] = pos++;
+            }
+            if (value->op == R11F_SSA_call) {
+                gen->callsite_count++;
+                if (value->argc + 1 > gen->out_slots) {
+                    gen->out_slots = value->argc + 1;
+                }
+            }
+            if ((value->op == R11F_SSA_deopt || value->op == R11F_SSA_exit)
+                && value->argc > gen->out_slots) {
+                gen->out_slots = value->argc;
+            }
+            if (value->op == R11F_SSA_newarray && !gen->out_slots) {
+                gen->out_slots = 1;
+            }
+            /* the lane numbers of a vector index */
+            if (value->op == R11F_SSA_vloop && gen->out_slots < 4) {
+                gen->out_slots = 4;
+            }
+            gen->allocatable[v] = value->op == R11F_SSA_call ?
+                value->has_result :
+                value->op != R11F_SSA_deopt
+                    && value->op != R11F_SSA_exit
+                    && value->op != R11F_SSA_nullchk
+                    && value->op != R11F_SSA_boundschk
+                    && value->op != R11F_SSA_iastore;
+        }
+        gen->block_end[b] = pos++;
+    }
+
+    /* backward liveness until nothing changes */
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t i = gen->order_count; i > 0; i--) {
+            uint32_t b = gen->order[i - 1];
+            r11f_ssa_block_t *block = &ssa->blocks[b];
+            memset(live, 0, words * sizeof(uint64_t));
+
+            for (uint32_t s = 0; s < r11f_ssa_succ_count(block); s++) {
+                r11f_ssa_block_t *succ = &ssa->blocks[block->succs[s]];
+                uint64_t *succ_in = live_in + (size_t)block->succs[s] * words;
+                for (uint32_t w = 0; w < words; w++) {
+                    live[w] |= succ_in[w];
+                }
+
+                uint32_t pred_index = 0;
+                while (succ->preds[pred_index] != b) {
+                    pred_index++;
+                }
+                for (uint32_t j = 0; j < succ->value_count; j++) {
+                    uint32_t v = succ->values[j];
+                    r11f_ssa_value_t *phi = &ssa->values[v];
+                    if (phi->op != R11F_SSA_phi || !is_live_value(ssa, v)) {
+                        continue;
+                    }
+                    CLEAR(live, v);
+                }
+                for (uint32_t j = 0; j < succ->value_count; j++) {
+                    uint32_t v = succ->values[j];
+                    r11f_ssa_value_t *phi = &ssa->values[v];
+                    if (phi->op != R11F_SSA_phi || !is_live_value(ssa, v)) {
+                        continue;
+                    }
+                    USE(phi->args[pred_index]);
+                }
+            }
+            memcpy(live_out + (size_t)b * words, live, words * sizeof(uint64_t));
+
+            if (block->term == R11F_SSA_BRANCH) {
+                USE(block->term_args[0]);
+                USE(block->term_args[1]);
+            }
+            else if (block->term == R11F_SSA_RETURN && block->returns_value) {
+                USE(block->term_args[0]);
+            }
+            for (uint32_t j = block->value_count; j > 0; j--) {
+                uint32_t v = block->values[j - 1];
+                r11f_ssa_value_t *value = &ssa->values[v];
+                if (!is_live_value(ssa, v)) {
+                    continue;
+                }
+                CLEAR(live, v);
+                if (value->op != R11F_SSA_phi) {
+                    for (uint32_t k = 0; k < value->argc; k++) {
+                        USE(value->args[k]);
+                    }
+                }
+            }
+
+            uint64_t *block_in = live_in + (size_t)b * words;
+            if (memcmp(block_in, live, words * sizeof(uint64_t)) != 0) {
+                memcpy(block_in, live, words * sizeof(uint64_t));
+                changed = true;
+            }
+        }
+    }
+
+    /* a single range from the first to the last position a value is
+       live at, holes are not tracked */
+    for (uint32_t v = 0; v < value_count; v++) {
+        gen->range_start[v] = gen->value_pos[v];
+        gen->range_end[v] = gen->value_pos[v];
+    }
+    #define EXTEND(V, P) \
+        do { \
+            uint32_t e_ = r11f_ssa_resolve(ssa, (V)); \
+            if (gen->allocatable[e_]) { \
+                if ((P) < gen->range_start[e_]) { \
+                    gen->range_start[e_] = (P); \
+                } \
+                if ((P) > gen->range_end[e_]) { \
+                    gen->range_end[e_] = (P); \
+                } \
+            } \
+        } while (0)
+
+    for (uint32_t i = 0; i < gen->order_count; i++) {
+        uint32_t b = gen->order[i];
+        r11f_ssa_block_t *block = &ssa->blocks[b];
+        uint64_t *block_in = live_in + (size_t)b * words;
+        uint64_t *block_out = live_out + (size_t)b * words;
+        for (uint32_t v = 0; v < value_count; v++) {
+            if (TEST(block_in, v)) {
+                EXTEND(v, gen->block_start[b]);
+            }
+            if (TEST(block_out, v)) {
+                EXTEND(v, gen->block_end[b]);
+            }
+        }
+
+        for (uint32_t j = 0; j < block->value_count; j++) {
+            uint32_t v = block->values[j];
+            r11f_ssa_value_t *value = &ssa->values[v];
+            if (!is_live_value(ssa, v) || value->op == R11F_SSA_phi) {
+                continue;
+            }
+            for (uint32_t k = 0; k < value->argc; k++) {
+                EXTEND(value->args[k], gen->value_pos[v]);
+            }
+        }
+        if (block->term == R11F_SSA_BRANCH) {
+            EXTEND(block->term_args[0], gen->block_end[b]);
+            EXTEND(block->term_args[1], gen->block_end[b]);
+        }
+        else if (block->term == R11F_SSA_RETURN && block->returns_value) {
+            EXTEND(block->term_args[0], gen->block_end[b]);
+        }
+    }
+
+    #undef SET
+    #undef CLEAR
+    #undef TEST
+    #undef USE
+    #undef EXTEND
+
+cleanup:
+    r11f_free(live_in);
+    r11f_free(live_out);
+    r11f_free(live);
+    return ok;
+}
+
+static bool allocate_registers(gen_t *gen) {
+    r11f_ssa_t *ssa = gen->ssa;
+    uint32_t value_count = ssa->value_count;
+    gen->locs = r11f_alloc_zeroed(value_count * sizeof(loc_t));
+    range_t *ranges = r11f_alloc((value_count + 1) * sizeof(range_t));
+    uint32_t *calls = r11f_alloc((value_count + 1) * sizeof(uint32_t));
+    if (!gen->locs || !ranges || !calls) {
+        r11f_free(ranges);
+        r11f_free(calls);
+        return false;
+    }
+
+    uint32_t range_count = 0;
+    uint32_t call_count = 0;
+    for (uint32_t v = 0; v < value_count; v++) {
+        r11f_ssa_value_t *value = &ssa->values[v];
+        if (value->op == R11F_SSA_const) {
+            gen->locs[v].kind = LOC_CONST;
+            gen->locs[v].imm = value->imm;
+            continue;
+        }
+        if (is_live_value(ssa, v)
+            && (value->op == R11F_SSA_call
+                || value->op == R11F_SSA_newarray)) {
+            calls[call_count++] = gen->value_pos[v];
+        }
+        if (gen->allocatable[v]) {
+            ranges[range_count++] = (range_t) {
+                .start = gen->range_start[v],
+                .end = gen->range_end[v],
+                .value = v
+            };
+        }
+    }
+    qsort(ranges, range_count, sizeof(range_t), compare_ranges);
+
+    uint32_t owner[16];
+    for (uint32_t r = 0; r < 16; r++) {
+        owner[r] = R11F_SSA_NONE;
+    }
+
+    for (uint32_t i = 0; i < range_count; i++) {
+        range_t *range = &ranges[i];
+        bool crosses_call = false;
+        for (uint32_t c = 0; c < call_count; c++) {
+            if (calls[c] > range->start && calls[c] < range->end) {
+                crosses_call = true;
+                break;
+            }
+        }
+
+        /* caller saved registers first, callee saved ones are scarcer */
+        uint8_t pool[11];
+        uint32_t pool_size = 0;
+        if (!crosses_call) {
+            memcpy(pool, g_caller_saved, sizeof(g_caller_saved));
+            pool_size = sizeof(g_caller_saved);
+        }
+        memcpy(pool + pool_size, g_callee_saved, sizeof(g_callee_saved));
+        pool_size += sizeof(g_callee_saved);
+
+        int reg = -1;
+        for (uint32_t p = 0; p < pool_size && reg < 0; p++) {
+            uint32_t cur = owner[pool[p]];
+            if (cur == R11F_SSA_NONE || gen->range_end[cur] <= range->start) {
+                reg = pool[p];
+            }
+        }
+
+        if (reg < 0) {
+            /* evict whichever range ends last, possibly this one */
+            uint8_t victim_reg = pool[0];
+            for (uint32_t p = 1; p < pool_size; p++) {
+                if (gen->range_end[owner[pool[p]]]
+                    > gen->range_end[owner[victim_reg]]) {
+                    victim_reg = pool[p];
+                }
+            }
+
+            uint32_t victim = owner[victim_reg];
+            uint32_t spilled = range->value;
+            if (gen->range_end[victim] > range->end) {
+                spilled = victim;
+                reg = victim_reg;
+            }
+            gen->locs[spilled].kind = LOC_STACK;
+            gen->locs[spilled].disp =
+                SLOT_SPILL - 8 * (int32_t)gen->spill_count++;
+        }
+
+        if (reg >= 0) {
+            owner[reg] = range->value;
+            gen->locs[range->value].kind = LOC_REG;
+            gen->locs[range->value].reg = (uint8_t)reg;
+        }
+    }
+
+    r11f_free(ranges);
+    r11f_free(calls);
+    return true;
+}
+
+static int compare_ranges(void const *lhs, void const *rhs) {
+    range_t const *a = lhs;
+    range_t const *b = rhs;
+    if (a->start != b->start) {
+        return a->start < b->start ? -1 : 1;
+    }
+    return a->value < b->value ? -1 : a->value > b->value;
+}
+
+static void gen_block(gen_t *gen, uint32_t index) {
+    r11f_ssa_t *ssa = gen->ssa;
+    uint32_t b = gen->order[index];
+    r11f_ssa_block_t *block = &ssa->blocks[b];
+    uint32_t next = index + 1 < gen->order_count ?
+        gen->order[index + 1] :
+        R11F_SSA_NONE;
+    gen->block_offset[b] = (uint32_t)gen->size;
+
+    for (uint32_t i = 0; i < block->value_count; i++) {
+        uint32_t v = block->values[i];
+        if (is_live_value(ssa, v) && ssa->values[v].op != R11F_SSA_phi) {
+            gen_value(gen, v);
+        }
+    }
+
+    switch (block->term) {
+        case R11F_SSA_JUMP:
+            gen_phi_moves(gen, b, block->succs[0]);
+            if (block->succs[0] != next) {
+                emit_jump(gen, 0, block->succs[0]);
+            }
+            break;
+
+        case R11F_SSA_BRANCH: {
+            loc_t lhs = value_loc(gen, block->term_args[0]);
+            loc_t rhs = value_loc(gen, block->term_args[1]);
+            uint8_t reg = RAX;
+            if (lhs.kind == LOC_REG) {
+                reg = lhs.reg;
+            }
+            else {
+                emit_load(gen, RAX, lhs);
+            }
+            /* cmp r32, operand */
+            emit_alu(gen, block->wide, 0x3b, 7, reg, rhs);
+
+            if (block->succs[0] == next) {
+                emit_jump(gen, g_jcc[block->cond ^ 1], block->succs[1]);
+            }
+            else {
+                emit_jump(gen, g_jcc[block->cond], block->succs[0]);
+                if (block->succs[1] != next) {
+                    emit_jump(gen, 0, block->succs[1]);
+                }
+            }
+            break;
+        }
+
+        case R11F_SSA_RETURN:
+            if (block->returns_value) {
+                emit_load(gen, RAX, value_loc(gen, block->term_args[0]));
+                /* mov rcx, [result]; mov [rcx], rax */
+                emit_rm(gen, true, 0x8b, RCX, RBP, SLOT_RESULT);
+                emit_bytes(gen, (uint8_t[]){ 0x48, 0x89, 0x01 }, 3);
+            }
+            /* xor eax, eax */
+            emit_bytes(gen, (uint8_t[]){ 0x31, 0xc0 }, 2);
+            if (next != R11F_SSA_NONE) {
+                emit_jump(gen, 0, TARGET_EXIT);
+            }
+            break;
+
+        case R11F_SSA_EXIT:
+            /* its exit value has jumped away already */
+            break;
+    }
+}
+
+static void gen_value(gen_t *gen, uint32_t v) {
+    r11f_ssa_value_t *value = &gen->ssa->values[v];
+    loc_t dst = gen->locs[v];
+
+    switch (value->op) {
+        case R11F_SSA_param: {
+            uint8_t reg = target_reg(gen, v, R11F_SSA_NONE);
+            /* mov rcx, [frame]; mov rcx, [rcx + locals]; mov reg, [rcx] */
+            emit_rm(gen, true, 0x8b, RCX, RBP, SLOT_FRAME);
+            emit_rm(gen, true, 0x8b, RCX, RCX,
+                    (int32_t)offsetof(r11f_frame_t, locals));
+            emit_rm(gen, true, 0x8b, reg, RCX, (int32_t)(value->imm * 8));
+            emit_store(gen, dst, reg);
+            break;
+        }
+
+        case R11F_SSA_call:
+            gen_call(gen, v, value);
+            break;
+        case R11F_SSA_deopt:
+        case R11F_SSA_exit:
+            gen_deopt(gen, value);
+            break;
+        case R11F_SSA_nullchk: {
+            loc_t arg = value_loc(gen, value->args[0]);
+            uint8_t reg = arg.kind == LOC_REG ? arg.reg : RAX;
+            emit_load(gen, reg, arg);
+            /* test reg, reg; jz null */
+            emit_rr(gen, true, 0x85, reg, reg);
+            emit_jump(gen, 0x84, TARGET_NULL);
+            gen->jit->check_count++;
+            break;
+        }
+        case R11F_SSA_boundschk: {
+            loc_t index = value_loc(gen, value->args[0]);
+            uint8_t reg = index.kind == LOC_REG ? index.reg : RAX;
+            emit_load(gen, reg, index);
+            /* cmp r32, length; jae bounds, negative indices included */
+            emit_alu(gen, false, 0x3b, 7, reg, value_loc(gen, value->args[1]));
+            emit_jump(gen, 0x83, TARGET_BOUNDS);
+            gen->jit->check_count++;
+            break;
+        }
+
+        case R11F_SSA_newarray:
+            gen_new_array(gen, v, value);
+            break;
+        case R11F_SSA_alength: {
+            loc_t array = value_loc(gen, value->args[0]);
+            uint8_t base = array.kind == LOC_REG ? array.reg : RAX;
+            uint8_t reg = target_reg(gen, v, R11F_SSA_NONE);
+            emit_load(gen, base, array);
+            emit_rm(gen, false, 0x8b, reg, base,
+                    (int32_t)offsetof(r11f_array_t, length));
+            emit_store(gen, dst, reg);
+            break;
+        }
+        case R11F_SSA_iaload: {
+            uint8_t base = gen_element(gen, value);
+            uint8_t reg = target_reg(gen, v, R11F_SSA_NONE);
+            emit_element(gen, 0x8b, reg, base, RCX);
+            emit_store(gen, dst, reg);
+            break;
+        }
+        case R11F_SSA_iastore: {
+            uint8_t base = gen_element(gen, value);
+            emit_load(gen, RDX, value_loc(gen, value->args[2]));
+            emit_element(gen, 0x89, RDX, base, RCX);
+            break;
+        }
+        case R11F_SSA_vloop:
+            gen_vloop(gen, v, value);
+            break;
+        case R11F_SSA_vreduce:
+            /* written by its vloop already */
+            break;
+
+        case R11F_SSA_iadd: case R11F_SSA_isub: case R11F_SSA_imul:
+        case R11F_SSA_iand: case R11F_SSA_ior: case R11F_SSA_ixor:
+        case R11F_SSA_ladd: case R11F_SSA_lsub: case R11F_SSA_lmul:
+        case R11F_SSA_land: case R11F_SSA_lor: case R11F_SSA_lxor:
+            gen_binop(gen, v, value);
+            break;
+
+        case R11F_SSA_ishl: case R11F_SSA_ishr: case R11F_SSA_iushr:
+        case R11F_SSA_lshl: case R11F_SSA_lshr: case R11F_SSA_lushr:
+            gen_shift(gen, v, value);
+            break;
+
+        case R11F_SSA_idiv: case R11F_SSA_irem:
+        case R11F_SSA_ldiv: case R11F_SSA_lrem:
+            gen_div(gen, v, value);
+            break;
+
+        case R11F_SSA_ineg:
+        case R11F_SSA_lneg: {
+            bool wide = value->op == R11F_SSA_lneg;
+            uint8_t reg = target_reg(gen, v, R11F_SSA_NONE);
+            emit_load(gen, reg, value_loc(gen, value->args[0]));
+            /* neg reg */
+            emit_rr(gen, wide, 0xf7, 3, reg);
+            emit_store(gen, dst, reg);
+            break;
+        }
+
+        case R11F_SSA_i2l: {
+            uint8_t reg = target_reg(gen, v, R11F_SSA_NONE);
+            loc_t src = value_loc(gen, value->args[0]);
+            if (src.kind == LOC_CONST) {
+                emit_mov_imm(gen, reg, (int32_t)src.imm);
+            }
+            else {
+                emit_load(gen, reg, src);
+                /* movsxd reg, reg32 */
+                emit_rr(gen, true, 0x63, reg, reg);
+            }
+            emit_store(gen, dst, reg);
+            break;
+        }
+        case R11F_SSA_l2i: {
+            uint8_t reg = target_reg(gen, v, R11F_SSA_NONE);
+            emit_load(gen, reg, value_loc(gen, value->args[0]));
+            emit_store(gen, dst, reg);
+            break;
+        }
+        case R11F_SSA_i2b:
+        case R11F_SSA_i2c:
+        case R11F_SSA_i2s: {
+            /* movsx eax, al / movzx eax, ax / movsx eax, ax */
+            uint16_t opcode = value->op == R11F_SSA_i2b ? 0x0fbe :
+                value->op == R11F_SSA_i2c ? 0x0fb7 :
+                0x0fbf;
+            emit_load(gen, RAX, value_loc(gen, value->args[0]));
+            emit_rr(gen, false, opcode, RAX, RAX);
+            emit_store(gen, dst, RAX);
+            break;
+        }
+
+        case R11F_SSA_lcmp:
+            emit_load(gen, RAX, value_loc(gen, value->args[0]));
+            emit_alu(gen, true, 0x3b, 7, RAX, value_loc(gen, value->args[1]));
+            /* setg al; setl cl; sub al, cl; movsx eax, al */
+            emit_bytes(gen, (uint8_t[]){ 0x0f, 0x9f, 0xc0, 0x0f, 0x9c, 0xc1,
+                                         0x28, 0xc8, 0x0f, 0xbe, 0xc0 }, 11);
+            emit_store(gen, dst, RAX);
+            break;
+
+        case R11F_SSA_intrinsic:
+            gen_intrinsic(gen, v, value);
+            break;
+    }
+}
+
+static void gen_binop(gen_t *gen, uint32_t v, r11f_ssa_value_t *value) {
+    static const struct {
+        uint16_t op;
+        uint16_t opcode;
+        uint8_t digit;
+    } ops[] = {
+        { R11F_SSA_iadd, 0x03, 0 }, { R11F_SSA_ladd, 0x03, 0 },
+        { R11F_SSA_isub, 0x2b, 5 }, { R11F_SSA_lsub, 0x2b, 5 },
+        { R11F_SSA_iand, 0x23, 4 }, { R11F_SSA_land, 0x23, 4 },
+        { R11F_SSA_ior, 0x0b, 1 }, { R11F_SSA_lor, 0x0b, 1 },
+        { R11F_SSA_ixor, 0x33, 6 }, { R11F_SSA_lxor, 0x33, 6 },
+    };
+
+    bool wide = value->op >= R11F_SSA_ladd;
+    uint32_t rhs_value = r11f_ssa_resolve(gen->ssa, value->args[1]);
+    loc_t lhs = value_loc(gen, value->args[0]);
+    loc_t rhs = value_loc(gen, rhs_value);
+    uint8_t reg = target_reg(gen, v, rhs_value);
+
+    emit_load(gen, reg, lhs);
+    if (value->op == R11F_SSA_imul || value->op == R11F_SSA_lmul) {
+        if (rhs.kind == LOC_CONST && rhs.imm == (int32_t)rhs.imm) {
+            /* imul reg, reg, imm32 */
+            emit_rr(gen, wide, 0x69, reg, reg);
+            emit_u32(gen, (uint32_t)rhs.imm);
+        }
+        else {
+            emit_alu(gen, wide, 0x0faf, 0xff, reg, rhs);
+        }
+    }
+    else {
+        for (uint32_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+            if (ops[i].op == value->op) {
+                emit_alu(gen, wide, ops[i].opcode, ops[i].digit, reg, rhs);
+            }
+        }
+    }
+    emit_store(gen, gen->locs[v], reg);
+}
+
+static void gen_shift(gen_t *gen, uint32_t v, r11f_ssa_value_t *value) {
+    bool wide = value->op >= R11F_SSA_ladd;
+    uint8_t digit = (value->op == R11F_SSA_ishl
+                     || value->op == R11F_SSA_lshl) ? 4 :
+        (value->op == R11F_SSA_ishr || value->op == R11F_SSA_lshr) ? 7 :
+        5;
+    loc_t count = value_loc(gen, value->args[1]);
+    uint8_t reg = target_reg(gen, v, R11F_SSA_NONE);
+
+    if (count.kind == LOC_CONST) {
+        emit_load(gen, reg, value_loc(gen, value->args[0]));
+        /* shift reg, imm8 */
+        emit_rr(gen, wide, 0xc1, digit, reg);
+        emit_u8(gen, (uint8_t)(count.imm & (wide ? 63 : 31)));
+    }
+    else {
+        /* the count goes to cl first, reg may be where it lived */
+        emit_load(gen, RCX, count);
+        emit_load(gen, reg, value_loc(gen, value->args[0]));
+        emit_rr(gen, wide, 0xd3, digit, reg);
+    }
+    emit_store(gen, gen->locs[v], reg);
+}
+
+static void gen_div(gen_t *gen, uint32_t v, r11f_ssa_value_t *value) {
+    bool wide = value->op == R11F_SSA_ldiv || value->op == R11F_SSA_lrem;
+    bool rem = value->op == R11F_SSA_irem || value->op == R11F_SSA_lrem;
+    uint8_t rex = wide ? 0x48 : 0;
+
+    emit_load(gen, RAX, value_loc(gen, value->args[0]));
+    emit_load(gen, RCX, value_loc(gen, value->args[1]));
+
+    /* test ecx, ecx; jz div0 */
+    emit_rr(gen, wide, 0x85, RCX, RCX);
+    emit_jump(gen, 0x84, TARGET_DIV0);
+
+    /* cmp ecx, -1; jne divide */
+    if (rex) {
+        emit_u8(gen, rex);
+    }
+    emit_bytes(gen, (uint8_t[]){ 0x83, 0xf9, 0xff, 0x75, 0x00 }, 5);
+    size_t jne_at = gen->size - 1;
+
+    /* x / -1 is -x and x % -1 is 0, idiv would trap on MIN_VALUE */
+    if (rex) {
+        emit_u8(gen, rex);
+    }
+    if (rem) {
+        /* xor eax, eax */
+        emit_bytes(gen, (uint8_t[]){ 0x31, 0xc0 }, 2);
+    }
+    else {
+        /* neg eax */
+        emit_bytes(gen, (uint8_t[]){ 0xf7, 0xd8 }, 2);
+    }
+    /* jmp done */
+    emit_bytes(gen, (uint8_t[]){ 0xeb, 0x00 }, 2);
+    size_t jmp_at = gen->size - 1;
+
+    if (!gen->oom) {
+        gen->data[jne_at] = (uint8_t)(gen->size - (jne_at + 1));
+    }
+    /* cdq / cqo; idiv ecx */
+    if (rex) {
+        emit_u8(gen, rex);
+    }
+    emit_u8(gen, 0x99);
+    emit_rr(gen, wide, 0xf7, 7, RCX);
+    if (rem) {
+        /* mov eax, edx */
+        emit_rr(gen, wide, 0x8b, RAX, RDX);
+    }
+
+    if (!gen->oom) {
+        gen->data[jmp_at] = (uint8_t)(gen->size - (jmp_at + 1));
+    }
+    emit_store(gen, gen->locs[v], RAX);
+}
+
+static void gen_call(gen_t *gen, uint32_t v, r11f_ssa_value_t *value) {
+    r11f_jit_callsite_t *callsite = &gen->callsites[gen->callsite_count++];
+    callsite->caller = value->caller;
+    callsite->methodref_index = (uint16_t)value->imm;
+    callsite->has_result = value->has_result;
+    callsite->is_virtual = value->is_virtual;
+    callsite->args_in_frame = false;
+    callsite->clazz = NULL;
+    callsite->method_info = NULL;
+    callsite->receiver_class = NULL;
+
+    /* one value per argument at [rsp + 8 * i] */
+    for (uint32_t i = 0; i < value->argc; i++) {
+        loc_t arg = value_loc(gen, value->args[i]);
+        uint8_t reg = arg.kind == LOC_REG ? arg.reg : RAX;
+        emit_load(gen, reg, arg);
+        emit_rm(gen, true, 0x89, reg, RSP, (int32_t)(8 * i));
+    }
+
+    int32_t result_disp = (int32_t)(8 * (gen->out_slots - 1));
+    emit_rm(gen, true, 0x8b, RDI, RBP, SLOT_VM);
+    emit_mov_imm(gen, RSI, (int64_t)(uintptr_t)callsite);
+    /* mov rdx, rsp; lea rcx, [rsp + result] */
+    emit_bytes(gen, (uint8_t[]){ 0x48, 0x89, 0xe2 }, 3);
+    emit_rm(gen, true, 0x8d, RCX, RSP, result_disp);
+    emit_mov_imm(gen, RAX, (int64_t)(uintptr_t)r11f_vm_jit_invoke);
+    /* call rax; test eax, eax; jnz exit */
+    emit_bytes(gen, (uint8_t[]){ 0xff, 0xd0, 0x85, 0xc0 }, 4);
+    emit_jump(gen, 0x85, TARGET_EXIT);
+
+    if (gen->allocatable[v]) {
+        emit_rm(gen, true, 0x8b, RAX, RSP, result_disp);
+        emit_store(gen, gen->locs[v], RAX);
+    }
+}
+
+/* works on rax, the second argument in rcx */
+static void gen_intrinsic(gen_t *gen, uint32_t v, r11f_ssa_value_t *value) {
+    uint16_t fn = (uint16_t)value->imm;
+    bool wide = fn == R11F_NATIVEFN_labs
+        || fn == R11F_NATIVEFN_lmin
+        || fn == R11F_NATIVEFN_lmax
+        || fn == R11F_NATIVEFN_lbitcount
+        || fn == R11F_NATIVEFN_lnlz
+        || fn == R11F_NATIVEFN_lntz
+        || fn == R11F_NATIVEFN_lbswap;
+    emit_load(gen, RAX, value_loc(gen, value->args[0]));
+    if (value->argc > 1) {
+        emit_load(gen, RCX, value_loc(gen, value->args[1]));
+    }
+
+    switch (fn) {
+        case R11F_NATIVEFN_iabs:
+        case R11F_NATIVEFN_labs:
+            /* mov rdx, rax; neg rdx; cmovns rax, rdx */
+            emit_rr(gen, wide, 0x8b, RDX, RAX);
+            emit_rr(gen, wide, 0xf7, 3, RDX);
+            emit_rr(gen, wide, 0x0f49, RAX, RDX);
+            break;
+        case R11F_NATIVEFN_imin:
+        case R11F_NATIVEFN_lmin:
+        case R11F_NATIVEFN_imax:
+        case R11F_NATIVEFN_lmax: {
+            bool min = fn == R11F_NATIVEFN_imin || fn == R11F_NATIVEFN_lmin;
+            /* cmp rax, rcx; cmovg / cmovl rax, rcx */
+            emit_rr(gen, wide, 0x3b, RAX, RCX);
+            emit_rr(gen, wide, min ? 0x0f4f : 0x0f4c, RAX, RCX);
+            break;
+        }
+
+        case R11F_NATIVEFN_ibitcount:
+        case R11F_NATIVEFN_lbitcount:
+            if (gen->popcnt) {
+                emit_u8(gen, 0xf3);
+                emit_rr(gen, wide, 0x0fb8, RAX, RAX);
+            }
+            else {
+                gen_bit_count(gen, wide);
+            }
+            break;
+        case R11F_NATIVEFN_inlz:
+        case R11F_NATIVEFN_lnlz:
+            if (gen->lzcnt) {
+                emit_u8(gen, 0xf3);
+                emit_rr(gen, wide, 0x0fbd, RAX, RAX);
+            }
+            else {
+                /* mov ecx, -1; bsr rax, rax; cmovz eax, ecx; neg eax;
+                   add eax, 31 / 63 */
+                emit_mov_imm(gen, RCX, UINT32_MAX);
+                emit_rr(gen, wide, 0x0fbd, RAX, RAX);
+                emit_rr(gen, false, 0x0f44, RAX, RCX);
+                emit_rr(gen, false, 0xf7, 3, RAX);
+                emit_rr(gen, false, 0x83, 0, RAX);
+                emit_u8(gen, wide ? 63 : 31);
+            }
+            break;
+        case R11F_NATIVEFN_intz:
+        case R11F_NATIVEFN_lntz:
+            if (gen->tzcnt) {
+                emit_u8(gen, 0xf3);
+                emit_rr(gen, wide, 0x0fbc, RAX, RAX);
+            }
+            else {
+                /* mov ecx, 32 / 64; bsf rax, rax; cmovz eax, ecx */
+                emit_mov_imm(gen, RCX, wide ? 64 : 32);
+                emit_rr(gen, wide, 0x0fbc, RAX, RAX);
+                emit_rr(gen, false, 0x0f44, RAX, RCX);
+            }
+            break;
+        case R11F_NATIVEFN_ibswap:
+        case R11F_NATIVEFN_lbswap:
+            /* bswap rax */
+            if (wide) {
+                emit_u8(gen, 0x48);
+            }
+            emit_bytes(gen, (uint8_t[]){ 0x0f, 0xc8 }, 2);
+            break;
+    }
+    emit_store(gen, gen->locs[v], RAX);
+}
+
+/* population count of rax without popcnt, on rdx and rcx */
+static void gen_bit_count(gen_t *gen, bool wide) {
+    static const int64_t masks[] = {
+        0x5555555555555555, 0x3333333333333333,
+        0x0f0f0f0f0f0f0f0f, 0x0101010101010101
+    };
+    loc_t mask[4];
+    for (uint32_t i = 0; i < 4; i++) {
+        mask[i] = (loc_t) {
+            .kind = LOC_CONST,
+            .imm = wide ? masks[i] : (int32_t)masks[i]
+        };
+    }
+
+    /* rax -= (rax >> 1) & m1 */
+    emit_rr(gen, wide, 0x8b, RDX, RAX);
+    emit_rr(gen, wide, 0xc1, 5, RDX);
+    emit_u8(gen, 1);
+    emit_alu(gen, wide, 0x23, 4, RDX, mask[0]);
+    emit_rr(gen, wide, 0x2b, RAX, RDX);
+    /* rax = (rax & m2) + ((rax >> 2) & m2) */
+    emit_rr(gen, wide, 0x8b, RDX, RAX);
+    emit_rr(gen, wide, 0xc1, 5, RDX);
+    emit_u8(gen, 2);
+    emit_alu(gen, wide, 0x23, 4, RDX, mask[1]);
+    emit_alu(gen, wide, 0x23, 4, RAX, mask[1]);
+    emit_rr(gen, wide, 0x03, RAX, RDX);
+    /* rax = (rax + (rax >> 4)) & m4 */
+    emit_rr(gen, wide, 0x8b, RDX, RAX);
+    emit_rr(gen, wide, 0xc1, 5, RDX);
+    emit_u8(gen, 4);
+    emit_rr(gen, wide, 0x03, RAX, RDX);
+    emit_alu(gen, wide, 0x23, 4, RAX, mask[2]);
+    /* the byte sums add up in the top byte */
+    emit_alu(gen, wide, 0x0faf, 0xff, RAX, mask[3]);
+    emit_rr(gen, wide, 0xc1, 5, RAX);
+    emit_u8(gen, wide ? 56 : 24);
+}
+
+static void gen_new_array(gen_t *gen, uint32_t v, r11f_ssa_value_t *value) {
+    int32_t result_disp = (int32_t)(8 * (gen->out_slots - 1));
+    /* the length first, it may live in rdi */
+    emit_load(gen, RSI, value_loc(gen, value->args[0]));
+    emit_rm(gen, true, 0x8b, RDI, RBP, SLOT_VM);
+    emit_rm(gen, true, 0x8d, RDX, RSP, result_disp);
+    emit_mov_imm(gen, RAX, (int64_t)(uintptr_t)r11f_vm_new_array);
+    /* call rax; test eax, eax; jnz exit */
+    emit_bytes(gen, (uint8_t[]){ 0xff, 0xd0, 0x85, 0xc0 }, 4);
+    emit_jump(gen, 0x85, TARGET_EXIT);
+
+    if (gen->allocatable[v]) {
+        emit_rm(gen, true, 0x8b, RAX, RSP, result_disp);
+        emit_store(gen, gen->locs[v], RAX);
+    }
+}
+
+/* the array of an access in its register or rax, the index zero
+   extended into rcx; checks before it made sure both are fine */
+static uint8_t gen_element(gen_t *gen, r11f_ssa_value_t *value) {
+    loc_t array = value_loc(gen, value->args[0]);
+    uint8_t base = array.kind == LOC_REG ? array.reg : RAX;
+    emit_load(gen, base, array);
+    emit_load(gen, RCX, value_loc(gen, value->args[1]));
+    /* mov ecx, ecx */
+    emit_rr(gen, false, 0x8b, RCX, RCX);
+    return base;
+}
+
+/* see r11f_ssa_vloop_t. rax steps the index by whole vectors while rcx
+   = rax + lanes stays within rdx, the limit; both are sign extended so
+   that neither overflows */
+static void gen_vloop(gen_t *gen, uint32_t v, r11f_ssa_value_t *value) {
+    r11f_ssa_vloop_t const *vloop = &gen->ssa->vloops[value->imm];
+    uint8_t lanes = gen->avx ? 8 : 4;
+
+    /* movsxd rax, eax; movsxd rdx, edx */
+    emit_load(gen, RAX, value_loc(gen, value->args[0]));
+    emit_rr(gen, true, 0x63, RAX, RAX);
+    emit_load(gen, RDX, value_loc(gen, value->args[1]));
+    emit_rr(gen, true, 0x63, RDX, RDX);
+
+    for (uint32_t i = 0; i < vloop->setup_count; i++) {
+        r11f_ssa_vinsn_t const *insn = &vloop->insns[i];
+        switch (insn->op) {
+            case R11F_VEC_BCAST:
+                emit_load(gen, RCX, value_loc(gen, value->args[insn->a]));
+                gen_broadcast(gen, insn->dst, RCX);
+                break;
+            case R11F_VEC_IOTA: {
+                /* mov dword [rsp + 4k], k; movdqu reg, [rsp]; then the
+                   start index added to each lane */
+                for (uint8_t k = 0; k < lanes; k++) {
+                    emit_rm(gen, false, 0xc7, 0, RSP, 4 * k);
+                    emit_u32(gen, k);
+                }
+                emit_simd_mem(gen, 0xf3, 1, 0x6f, gen->avx, insn->dst,
+                              RSP, NO_INDEX, 0);
+                gen_broadcast(gen, 15, RAX);
+                gen_vec_alu(gen, &(r11f_ssa_vinsn_t) {
+                    .op = R11F_VEC_ADD,
+                    .dst = insn->dst,
+                    .a = insn->dst,
+                    .b = 15
+                }, gen->avx);
+                emit_mov_imm(gen, RCX, lanes);
+                gen_broadcast(gen, vloop->step_reg, RCX);
+                break;
+            }
+            case R11F_VEC_ZERO:
+                gen_vec_alu(gen, &(r11f_ssa_vinsn_t) {
+                    .op = R11F_VEC_XOR,
+                    .dst = insn->dst,
+                    .a = insn->dst,
+                    .b = insn->dst
+                }, gen->avx);
+                break;
+        }
+    }
+
+    /* top: lea rcx, [rax + lanes]; cmp rcx, rdx; jg done */
+    size_t top = gen->size;
+    emit_bytes(gen, (uint8_t[]){ 0x48, 0x8d, 0x48, lanes, 0x48, 0x39, 0xd1,
+                                 0x0f, 0x8f }, 9);
+    size_t done_at = gen->size;
+    emit_u32(gen, 0);
+
+    for (uint32_t i = vloop->setup_count; i < vloop->insn_count; i++) {
+        r11f_ssa_vinsn_t const *insn = &vloop->insns[i];
+        switch (insn->op) {
+            case R11F_VEC_LOAD:
+                /* movdqu reg, [array elements] */
+                gen_vec_element(gen, 0x6f, insn->dst,
+                                value_loc(gen, value->args[insn->a]));
+                break;
+            case R11F_VEC_STORE:
+                /* movdqu [array elements], reg */
+                gen_vec_element(gen, 0x7f, insn->b,
+                                value_loc(gen, value->args[insn->a]));
+                break;
+            default:
+                gen_vec_alu(gen, insn, gen->avx);
+                break;
+        }
+    }
+    if (vloop->iv_reg != R11F_VEC_NO_REG) {
+        gen_vec_alu(gen, &(r11f_ssa_vinsn_t) {
+            .op = R11F_VEC_ADD,
+            .dst = vloop->iv_reg,
+            .a = vloop->iv_reg,
+            .b = vloop->step_reg
+        }, gen->avx);
+    }
+    /* add rax, lanes; jmp top */
+    emit_bytes(gen, (uint8_t[]){ 0x48, 0x83, 0xc0, lanes, 0xe9 }, 5);
+    emit_u32(gen, (uint32_t)(top - (gen->size + 4)));
+    if (!gen->oom) {
+        uint32_t rel = (uint32_t)(gen->size - (done_at + 4));
+        memcpy(gen->data + done_at, &rel, 4);
+    }
+
+    /* the sums are complete before any result goes where an argument
+       may have been */
+    for (uint32_t r = 0; r < vloop->reduce_count; r++) {
+        r11f_ssa_reduce_t const *reduce = &vloop->reduces[r];
+        gen_horizontal_sum(gen, reduce->reg);
+        emit_load(gen, RCX, value_loc(gen, value->args[reduce->init]));
+        /* movd xmm15, ecx */
+        emit_simd(gen, 0x66, 1, 0x6e, false, 15, 0, RCX);
+        gen_vec_alu(gen, &(r11f_ssa_vinsn_t) {
+            .op = R11F_VEC_ADD,
+            .dst = reduce->reg,
+            .a = reduce->reg,
+            .b = 15
+        }, false);
+    }
+    emit_store(gen, gen->locs[v], RAX);
+    for (uint32_t r = 0; r < vloop->reduce_count; r++) {
+        r11f_ssa_reduce_t const *reduce = &vloop->reduces[r];
+        if (gen->allocatable[reduce->value]) {
+            /* movd ecx, xmm */
+            emit_simd(gen, 0x66, 1, 0x7e, false, reduce->reg, 0, RCX);
+            emit_store(gen, gen->locs[reduce->value], RCX);
+        }
+    }
+    if (gen->avx) {
+        /* vzeroupper */
+        emit_bytes(gen, (uint8_t[]){ 0xc5, 0xf8, 0x77 }, 3);
+    }
+    gen->jit->vector_count++;
+}
+
+/* `dst = a op b` on every lane, `wide` for ymm registers. SSE only has
+   `dst op= b`, xmm15 helps out when dst is b already */
+static void gen_vec_alu(gen_t *gen, r11f_ssa_vinsn_t const *insn, bool wide) {
+    static const struct {
+        uint8_t map;
+        uint8_t opcode;
+        /* digit of the shift group, 0xff for register operands */
+        uint8_t digit;
+    } ops[] = {
+        [R11F_VEC_ADD] = { 1, 0xfe, 0xff }, [R11F_VEC_SUB] = { 1, 0xfa, 0xff },
+        [R11F_VEC_MUL] = { 2, 0x40, 0xff }, [R11F_VEC_AND] = { 1, 0xdb, 0xff },
+        [R11F_VEC_OR] = { 1, 0xeb, 0xff }, [R11F_VEC_XOR] = { 1, 0xef, 0xff },
+        [R11F_VEC_SHL] = { 1, 0x72, 6 }, [R11F_VEC_SHR] = { 1, 0x72, 4 },
+        [R11F_VEC_USHR] = { 1, 0x72, 2 },
+    };
+    uint8_t map = ops[insn->op].map;
+    uint8_t opcode = ops[insn->op].opcode;
+    uint8_t digit = ops[insn->op].digit;
+
+    if (digit != 0xff) {
+        /* psxxd dst, a, imm8 */
+        if (gen->avx) {
+            emit_simd(gen, 0x66, map, opcode, wide, digit, insn->dst, insn->a);
+        }
+        else {
+            if (insn->dst != insn->a) {
+                /* movdqa dst, a */
+                emit_simd(gen, 0x66, 1, 0x6f, false, insn->dst, 0, insn->a);
+            }
+            emit_simd(gen, 0x66, map, opcode, false, digit, 0, insn->dst);
+        }
+        emit_u8(gen, insn->imm);
+        return;
+    }
+
+    if (gen->avx) {
+        emit_simd(gen, 0x66, map, opcode, wide, insn->dst, insn->a, insn->b);
+    }
+    else if (insn->dst == insn->a) {
+        emit_simd(gen, 0x66, map, opcode, false, insn->dst, 0, insn->b);
+    }
+    else if (insn->dst != insn->b) {
+        emit_simd(gen, 0x66, 1, 0x6f, false, insn->dst, 0, insn->a);
+        emit_simd(gen, 0x66, map, opcode, false, insn->dst, 0, insn->b);
+    }
+    else {
+        emit_simd(gen, 0x66, 1, 0x6f, false, 15, 0, insn->a);
+        emit_simd(gen, 0x66, map, opcode, false, 15, 0, insn->b);
+        emit_simd(gen, 0x66, 1, 0x6f, false, insn->dst, 0, 15);
+    }
+}
+
+/* movdqu to or from the elements at index rax of `array` */
+static void gen_vec_element(gen_t *gen,
+                            uint8_t opcode,
+                            uint8_t reg,
+                            loc_t array) {
+    uint8_t base = array.kind == LOC_REG ? array.reg : RCX;
+    emit_load(gen, base, array);
+    emit_simd_mem(gen, 0xf3, 1, opcode, gen->avx, reg, base, RAX,
+                  (int32_t)offsetof(r11f_array_t, data));
+}
+
+/* the low dword of `gpr` to every lane of `reg` */
+static void gen_broadcast(gen_t *gen, uint8_t reg, uint8_t gpr) {
+    /* movd reg, gpr */
+    emit_simd(gen, 0x66, 1, 0x6e, false, reg, 0, gpr);
+    if (gen->avx) {
+        /* vpbroadcastd ymm, xmm */
+        emit_simd(gen, 0x66, 2, 0x58, true, reg, 0, reg);
+    }
+    else {
+        /* pshufd reg, reg, 0 */
+        emit_simd(gen, 0x66, 1, 0x70, false, reg, 0, reg);
+        emit_u8(gen, 0);
+    }
+}
+
+/* the sum of all lanes of `reg` to its lowest one */
+static void gen_horizontal_sum(gen_t *gen, uint8_t reg) {
+    r11f_ssa_vinsn_t add = {
+        .op = R11F_VEC_ADD,
+        .dst = reg,
+        .a = reg,
+        .b = 15
+    };
+    if (gen->avx) {
+        /* vextracti128 xmm15, ymm, 1 */
+        emit_simd(gen, 0x66, 3, 0x39, true, reg, 0, 15);
+        emit_u8(gen, 1);
+        gen_vec_alu(gen, &add, false);
+    }
+    /* pshufd xmm15, reg, swap halves, then neighbours */
+    emit_simd(gen, 0x66, 1, 0x70, false, 15, 0, reg);
+    emit_u8(gen, 0x4e);
+    gen_vec_alu(gen, &add, false);
+    emit_simd(gen, 0x66, 1, 0x70, false, 15, 0, reg);
+    emit_u8(gen, 0xb1);
+    gen_vec_alu(gen, &add, false);
+}
+
+/* the values of all frames go to [rsp + 8 * i] for r11f_vm_deoptimize,
+   which a deopt skips while the code is valid and an exit never does */
+static void gen_deopt(gen_t *gen, r11f_ssa_value_t *value) {
+    r11f_deopt_point_t *point = &gen->jit->deopt_points[value->imm];
+    size_t skip_at = 0;
+    if (value->op == R11F_SSA_deopt) {
+        uint8_t *flag = gen->ssa->deopt_stress ?
+            &point->armed :
+            &gen->jit->invalidated;
+        emit_mov_imm(gen, RAX, (int64_t)(uintptr_t)flag);
+        /* cmp byte [rax], 0; je skip */
+        emit_bytes(gen, (uint8_t[]){ 0x80, 0x38, 0x00, 0x0f, 0x84 }, 5);
+        skip_at = gen->size;
+        emit_u32(gen, 0);
+    }
+
+    for (uint32_t i = 0; i < value->argc; i++) {
+        loc_t arg = value_loc(gen, value->args[i]);
+        uint8_t reg = arg.kind == LOC_REG ? arg.reg : RAX;
+        emit_load(gen, reg, arg);
+        emit_rm(gen, true, 0x89, reg, RSP, (int32_t)(8 * i));
+    }
+
+    emit_rm(gen, true, 0x8b, RDI, RBP, SLOT_VM);
+    emit_rm(gen, true, 0x8b, RSI, RBP, SLOT_FRAME);
+    emit_mov_imm(gen, RDX, (int64_t)(uintptr_t)point);
+    /* mov rcx, rsp */
+    emit_bytes(gen, (uint8_t[]){ 0x48, 0x89, 0xe1 }, 3);
+    emit_mov_imm(gen, RAX, (int64_t)(uintptr_t)r11f_vm_deoptimize);
+    /* call rax; jmp exit, eax holds the status */
+    emit_bytes(gen, (uint8_t[]){ 0xff, 0xd0 }, 2);
+    emit_jump(gen, 0, TARGET_EXIT);
+
+    if (skip_at && !gen->oom) {
+        uint32_t rel = (uint32_t)(gen->size - (skip_at + 4));
+        memcpy(gen->data + skip_at, &rel, 4);
+    }
+}
+
+/* deopt values refer to their points by address, which therefore move
+   to the code object before anything is generated */
+static bool copy_deopt_points(gen_t *gen) {
+    r11f_ssa_t *ssa = gen->ssa;
+    r11f_jit_code_t *jit = gen->jit;
+    if (!ssa->deopt_count) {
+        return true;
+    }
+
+    uint32_t frame_count = 0;
+    uint32_t object_count = 0;
+    for (uint32_t i = 0; i < ssa->deopt_count; i++) {
+        frame_count += ssa->deopt_points[i].frame_count;
+        object_count += ssa->deopt_points[i].object_count;
+    }
+    jit->deopt_points =
+        r11f_alloc(ssa->deopt_count * sizeof(r11f_deopt_point_t));
+    jit->deopt_frames = r11f_alloc(frame_count * sizeof(r11f_deopt_frame_t));
+    if (!jit->deopt_points || !jit->deopt_frames) {
+        return false;
+    }
+    if (object_count) {
+        jit->deopt_objects =
+            r11f_alloc(object_count * sizeof(r11f_deopt_object_t));
+        if (!jit->deopt_objects) {
+            return false;
+        }
+    }
+
+    r11f_deopt_frame_t *frames = jit->deopt_frames;
+    r11f_deopt_object_t *objects = jit->deopt_objects;
+    for (uint32_t i = 0; i < ssa->deopt_count; i++) {
+        r11f_deopt_point_t *point = &ssa->deopt_points[i];
+        memcpy(frames,
+               point->frames,
+               point->frame_count * sizeof(r11f_deopt_frame_t));
+        jit->deopt_points[i] = (r11f_deopt_point_t) {
+            .frame_count = point->frame_count,
+            .frames = frames,
+            .armed = ssa->deopt_stress
+        };
+        frames += point->frame_count;
+        if (point->object_count) {
+            memcpy(objects,
+                   point->objects,
+                   point->object_count * sizeof(r11f_deopt_object_t));
+            jit->deopt_points[i].object_count = point->object_count;
+            jit->deopt_points[i].objects = objects;
+            objects += point->object_count;
+        }
+    }
+    jit->deopt_count = ssa->deopt_count;
+    return true;
+}
+
+/* phis of `to` take their values all at once; rax breaks cycles */
+static void gen_phi_moves(gen_t *gen, uint32_t from, uint32_t to) {
+    r11f_ssa_t *ssa = gen->ssa;
+    r11f_ssa_block_t *succ = &ssa->blocks[to];
+    uint32_t pred_index = 0;
+    while (succ->preds[pred_index] != from) {
+        pred_index++;
+    }
+
+    move_t moves[64];
+    move_t *pending = moves;
+    uint32_t count = 0;
+    uint32_t phi_count = 0;
+    for (uint32_t i = 0; i < succ->value_count; i++) {
+        phi_count += ssa->values[succ->values[i]].op == R11F_SSA_phi;
+    }
+    if (phi_count > sizeof(moves) / sizeof(moves[0])) {
+        pending = r11f_alloc(phi_count * sizeof(move_t));
+        if (!pending) {
+            gen->oom = true;
+            return;
+        }
+    }
+
+    for (uint32_t i = 0; i < succ->value_count; i++) {
+        uint32_t v = succ->values[i];
+        r11f_ssa_value_t *phi = &ssa->values[v];
+        if (phi->op != R11F_SSA_phi || !gen->allocatable[v]) {
+            continue;
+        }
+        loc_t dst = gen->locs[v];
+        loc_t src = value_loc(gen, phi->args[pred_index]);
+        if (!loc_equal(dst, src)) {
+            pending[count++] = (move_t) { .dst = dst, .src = src };
+        }
+    }
+
+    while (count) {
+        bool progress = false;
+        for (uint32_t i = 0; i < count; i++) {
+            bool blocked = false;
+            for (uint32_t j = 0; j < count && !blocked; j++) {
+                blocked = j != i && loc_equal(pending[j].src, pending[i].dst);
+            }
+            if (!blocked) {
+                gen_move(gen, pending[i].dst, pending[i].src);
+                pending[i] = pending[--count];
+                progress = true;
+                break;
+            }
+        }
+
+        if (!progress) {
+            /* every destination is still read elsewhere: a cycle */
+            loc_t saved = pending[0].dst;
+            loc_t temp = { .kind = LOC_REG, .reg = RAX };
+            emit_load(gen, RAX, saved);
+            for (uint32_t j = 0; j < count; j++) {
+                if (loc_equal(pending[j].src, saved)) {
+                    pending[j].src = temp;
+                }
+            }
+        }
+    }
+
+    if (pending != moves) {
+        r11f_free(pending);
+    }
+}
+
+static void gen_move(gen_t *gen, loc_t dst, loc_t src) {
+    if (dst.kind == LOC_REG) {
+        emit_load(gen, dst.reg, src);
+    }
+    else if (src.kind == LOC_REG) {
+        emit_store(gen, dst, src.reg);
+    }
+    else {
+        emit_load(gen, RCX, src);
+        emit_store(gen, dst, RCX);
+    }
+}
+
+static loc_t value_loc(gen_t *gen, uint32_t v) {
+    return gen->locs[r11f_ssa_resolve(gen->ssa, v)];
+}
+
+static bool loc_equal(loc_t lhs, loc_t rhs) {
+    if (lhs.kind != rhs.kind) {
+        return false;
+    }
+    switch (lhs.kind) {
+        case LOC_REG: return lhs.reg == rhs.reg;
+        case LOC_STACK: return lhs.disp == rhs.disp;
+        case LOC_CONST: return lhs.imm == rhs.imm;
+        default: return true;
+    }
+}
+
+/* computes straight into the value's register unless that is where
+   the not yet read operand `avoid` lives */
+static uint8_t target_reg(gen_t *gen, uint32_t v, uint32_t avoid) {
+    loc_t dst = gen->locs[v];
+    if (dst.kind != LOC_REG) {
+        return RAX;
+    }
+    if (avoid != R11F_SSA_NONE) {
+        loc_t operand = value_loc(gen, avoid);
+        if (operand.kind == LOC_REG && operand.reg == dst.reg) {
+            return RAX;
+        }
+    }
+    return dst.reg;
+}
+
+static void emit_load(gen_t *gen, uint8_t reg, loc_t loc) {
+    switch (loc.kind) {
+        case LOC_REG:
+            if (loc.reg != reg) {
+                emit_rr(gen, true, 0x8b, reg, loc.reg);
+            }
+            break;
+        case LOC_STACK:
+            emit_rm(gen, true, 0x8b, reg, RBP, loc.disp);
+            break;
+        case LOC_CONST:
+            emit_mov_imm(gen, reg, loc.imm);
+            break;
+    }
+}
+
+static void emit_store(gen_t *gen, loc_t loc, uint8_t reg) {
+    if (loc.kind == LOC_REG && loc.reg != reg) {
+        emit_rr(gen, true, 0x8b, loc.reg, reg);
+    }
+    else if (loc.kind == LOC_STACK) {
+        emit_rm(gen, true, 0x89, reg, RBP, loc.disp);
+    }
+}
+
+/* `op reg, operand`, with the imm32 group form when digit is not 0xff */
+static void emit_alu(gen_t *gen,
+                     bool wide,
+                     uint16_t opcode,
+                     uint8_t digit,
+                     uint8_t reg,
+                     loc_t operand) {
+    switch (operand.kind) {
+        case LOC_CONST:
+            if (digit != 0xff && operand.imm == (int32_t)operand.imm) {
+                emit_rr(gen, wide, 0x81, digit, reg);
+                emit_u32(gen, (uint32_t)operand.imm);
+            }
+            else {
+                emit_mov_imm(gen, RCX, operand.imm);
+                emit_rr(gen, wide, opcode, reg, RCX);
+            }
+            break;
+        case LOC_REG:
+            emit_rr(gen, wide, opcode, reg, operand.reg);
+            break;
+        case LOC_STACK:
+            emit_rm(gen, wide, opcode, reg, RBP, operand.disp);
+            break;
+    }
+}
+
+static void emit_rr(gen_t *gen, bool wide, uint16_t opcode,
+                    uint8_t reg, uint8_t rm) {
+    uint8_t rex = 0x40 | (wide ? 8 : 0) | ((reg >> 3) << 2) | (rm >> 3);
+    if (rex != 0x40) {
+        emit_u8(gen, rex);
+    }
+    if (opcode > 0xff) {
+        emit_u8(gen, (uint8_t)(opcode >> 8));
+    }
+    emit_u8(gen, (uint8_t)opcode);
+    emit_u8(gen, (uint8_t)(0xc0 | ((reg & 7) << 3) | (rm & 7)));
+}
+
+static void emit_rm(gen_t *gen, bool wide, uint16_t opcode,
+                    uint8_t reg, uint8_t base, int32_t disp) {
+    uint8_t rex = 0x40 | (wide ? 8 : 0) | ((reg >> 3) << 2) | (base >> 3);
+    if (rex != 0x40) {
+        emit_u8(gen, rex);
+    }
+    if (opcode > 0xff) {
+        emit_u8(gen, (uint8_t)(opcode >> 8));
+    }
+    emit_u8(gen, (uint8_t)opcode);
+    /* [base + disp32], rsp as base needs a SIB byte */
+    emit_u8(gen, (uint8_t)(0x80 | ((reg & 7) << 3) | (base & 7)));
+    if ((base & 7) == RSP) {
+        emit_u8(gen, 0x24);
+    }
+    emit_u32(gen, (uint32_t)disp);
+}
+
+/* `op r32, [base + index * 4 + data]` on an int[] element */
+static void emit_element(gen_t *gen, uint16_t opcode,
+                         uint8_t reg, uint8_t base, uint8_t index) {
+    uint8_t rex = 0x40 | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3);
+    if (rex != 0x40) {
+        emit_u8(gen, rex);
+    }
+    emit_u8(gen, (uint8_t)opcode);
+    emit_u8(gen, (uint8_t)(0x84 | ((reg & 7) << 3)));
+    emit_u8(gen, (uint8_t)(0x80 | ((index & 7) << 3) | (base & 7)));
+    emit_u32(gen, (uint32_t)offsetof(r11f_array_t, data));
+}
+
+/* `op reg, rm` of SSE with mandatory prefix `pp`, or with gen->avx its
+   VEX form `op reg, vvvv, rm`, on ymm registers when `wide`. Maps 1 - 3
+   are the 0f, 0f38 and 0f3a opcode tables */
+static void emit_simd(gen_t *gen, uint8_t pp, uint8_t map, uint8_t opcode,
+                      bool wide, uint8_t reg, uint8_t vvvv, uint8_t rm) {
+    emit_simd_prefix(gen, pp, map, wide, reg, vvvv, 0, rm);
+    emit_u8(gen, opcode);
+    emit_u8(gen, (uint8_t)(0xc0 | ((reg & 7) << 3) | (rm & 7)));
+}
+
+/* the same on memory at [base + index * 4 + disp] */
+static void emit_simd_mem(gen_t *gen, uint8_t pp, uint8_t map,
+                          uint8_t opcode, bool wide, uint8_t reg,
+                          uint8_t base, uint8_t index, int32_t disp) {
+    emit_simd_prefix(gen, pp, map, wide, reg, 0, index, base);
+    emit_u8(gen, opcode);
+    emit_u8(gen, (uint8_t)(0x84 | ((reg & 7) << 3)));
+    emit_u8(gen, (uint8_t)(0x80 | ((index & 7) << 3) | (base & 7)));
+    emit_u32(gen, (uint32_t)disp);
+}
+
+static void emit_simd_prefix(gen_t *gen, uint8_t pp, uint8_t map, bool wide,
+                             uint8_t reg, uint8_t vvvv, uint8_t index,
+                             uint8_t rm) {
+    uint8_t r = reg >> 3;
+    uint8_t x = index >> 3;
+    uint8_t b = rm >> 3;
+    if (gen->avx) {
+        /* three byte VEX, W0 */
+        uint8_t pp_bits = pp == 0x66 ? 1 : pp == 0xf3 ? 2 : pp == 0xf2 ? 3 : 0;
+        emit_u8(gen, 0xc4);
+        emit_u8(gen, (uint8_t)((!r << 7) | (!x << 6) | (!b << 5) | map));
+        emit_u8(gen, (uint8_t)((~vvvv & 15) << 3 | (wide ? 4 : 0) | pp_bits));
+        return;
+    }
+
+    if (pp) {
+        emit_u8(gen, pp);
+    }
+    if (r || x || b) {
+        emit_u8(gen, (uint8_t)(0x40 | (r << 2) | (x << 1) | b));
+    }
+    emit_u8(gen, 0x0f);
+    if (map == 2) {
+        emit_u8(gen, 0x38);
+    }
+    else if (map == 3) {
+        emit_u8(gen, 0x3a);
+    }
+}
+
+static void emit_mov_imm(gen_t *gen, uint8_t reg, int64_t imm) {
+    if (imm >= 0 && imm <= UINT32_MAX) {
+        /* mov r32, imm32 zero extends */
+        if (reg >= 8) {
+            emit_u8(gen, 0x41);
+        }
+        emit_u8(gen, (uint8_t)(0xb8 + (reg & 7)));
+        emit_u32(gen, (uint32_t)imm);
+    }
+    else if (imm == (int32_t)imm) {
+        /* mov r64, simm32 */
+        emit_rr(gen, true, 0xc7, 0, reg);
+        emit_u32(gen, (uint32_t)imm);
+    }
+    else {
+        emit_u8(gen, (uint8_t)(0x48 | (reg >> 3)));
+        emit_u8(gen, (uint8_t)(0xb8 + (reg & 7)));
+        emit_u64(gen, (uint64_t)imm);
+    }
+}
+
+/* jmp rel32 when jcc is 0, the conditional jump otherwise */
+static void emit_jump(gen_t *gen, uint8_t jcc, uint32_t target) {
+    if (jcc) {
+        emit_u8(gen, 0x0f);
+        emit_u8(gen, jcc);
+    }
+    else {
+        emit_u8(gen, 0xe9);
+    }
+
+    if (gen->fixup_count == gen->fixup_capacity) {
+        uint32_t capacity = gen->fixup_capacity ? gen->fixup_capacity * 2 : 32;
+        fixup_t *fixups = r11f_alloc(capacity * sizeof(fixup_t));
+        if (!fixups) {
+            gen->oom = true;
+            return;
+        }
+        if (gen->fixups) {
+            memcpy(fixups, gen->fixups, gen->fixup_count * sizeof(fixup_t));
+            r11f_free(gen->fixups);
+        }
+        gen->fixups = fixups;
+        gen->fixup_capacity = capacity;
+    }
+    gen->fixups[gen->fixup_count++] = (fixup_t) {
+        .at = (uint32_t)gen->size,
+        .target = target
+    };
+    emit_u32(gen, 0);
+}
+
+static void emit_u8(gen_t *gen, uint8_t value) {
+    emit_bytes(gen, &value, 1);
+}
+
+static void emit_u32(gen_t *gen, uint32_t value) {
+    emit_bytes(gen, (uint8_t*)&value, 4);
+}
+
+static void emit_u64(gen_t *gen, uint64_t value) {
+    emit_bytes(gen, (uint8_t*)&value, 8);
+}
+
+static void emit_bytes(gen_t *gen, uint8_t const *bytes, size_t count) {
+    if (gen->oom) {
+        return;
+    }
+
+    if (gen->size + count > gen->capacity) {
+        size_t capacity = gen->capacity ? gen->capacity * 2 : 256;
+        while (capacity < gen->size + count) {
+            capacity *= 2;
+        }
+        uint8_t *data = r11f_alloc(capacity);
+        if (!data) {
+            gen->oom = true;
+            return;
+        }
+        if (gen->data) {
+            memcpy(data, gen->data, gen->size);
+            r11f_free(gen->data);
+        }
+        gen->data = data;
+        gen->capacity = capacity;
+    }
+    memcpy(gen->data + gen->size, bytes, count);
+    gen->size += count;
+}
+
+R11F_INTERNAL uint8_t r11f_ssa_simd_level(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return R11F_SIMD_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return R11F_SIMD_SSE41;
+    }
+    return R11F_SIMD_SCALAR;
+}
+
+#else /* __x86_64__ && !WIN32 */
+
+R11F_INTERNAL r11f_error_t r11f_ssa_codegen(r11f_ssa_t *ssa,
+                                            r11f_jit_code_t **output) {
+    (void)ssa;
+    (void)output;
+    return R11F_ERR_not_implemented_instruction;
+}
+
+R11F_INTERNAL uint8_t r11f_ssa_simd_level(void) {
+    return R11F_SIMD_SCALAR;
+}
+
+#endif /* __x86_64__ && !WIN32 */
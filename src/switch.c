@@ -0,0 +1,291 @@
+#include "switch.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include "alloc.h"
+#include "bytecode.h"
+#include "byteutil.h"
+
+static r11f_switch_t *switch_alloc(uint32_t key_count,
+                                   uint32_t target_count);
+static r11f_error_t compile_lookup(int32_t const *keys,
+                                   uint32_t const *targets,
+                                   uint32_t npairs,
+                                   uint32_t pc,
+                                   uint32_t default_target,
+                                   r11f_switch_t **output);
+static bool try_perfect_hash(r11f_switch_t *sw,
+                             int32_t const *keys,
+                             uint32_t const *targets,
+                             uint32_t npairs,
+                             uint8_t log2_size);
+
+R11F_EXPORT r11f_error_t r11f_switch_compile(uint8_t *code,
+                                             uint32_t code_length,
+                                             uint32_t pc,
+                                             r11f_switch_t **output) {
+    /* operands start at the next multiple of four */
+    uint32_t offset = (pc + 4) & ~(uint32_t)3;
+    uint8_t *operands = code + offset;
+    uint64_t room = code_length > offset ? code_length - offset : 0;
+    if (room < (code[pc] == R11F_tableswitch ? 12 : 8)) {
+        return R11F_ERR_malformed_classfile;
+    }
+    uint32_t default_target =
+        pc + (int32_t)read_unaligned_be4(operands);
+
+    if (code[pc] == R11F_tableswitch) {
+        int32_t low = (int32_t)read_unaligned_be4(operands + 4);
+        int32_t high = (int32_t)read_unaligned_be4(operands + 8);
+        if (high < low || 12 + 4 * ((uint64_t)high - low + 1) > room) {
+            return R11F_ERR_malformed_classfile;
+        }
+
+        uint32_t count = (uint32_t)high - (uint32_t)low + 1;
+        r11f_switch_t *sw = switch_alloc(0, count);
+        if (!sw) {
+            return R11F_ERR_out_of_memory;
+        }
+
+        sw->pc = pc;
+        sw->kind = R11F_SWITCH_TABLE;
+        sw->low = low;
+        sw->count = count;
+        sw->default_target = default_target;
+        for (uint32_t i = 0; i < count; i++) {
+            sw->targets[i] =
+                pc + (int32_t)read_unaligned_be4(operands + 12 + i * 4);
+        }
+
+        *output = sw;
+        return R11F_success;
+    }
+
+    uint32_t npairs = read_unaligned_be4(operands + 4);
+    if (8 + 8 * (uint64_t)npairs > room) {
+        return R11F_ERR_malformed_classfile;
+    }
+
+    /* npairs comes from the class file, so the pairs go on the heap */
+    int32_t *keys = r11f_alloc(sizeof(int32_t) * (npairs ? npairs : 1));
+    uint32_t *targets = r11f_alloc(sizeof(uint32_t) * (npairs ? npairs : 1));
+    r11f_error_t err = R11F_ERR_out_of_memory;
+    if (keys && targets) {
+        err = R11F_success;
+        for (uint32_t i = 0; i < npairs; i++) {
+            keys[i] = (int32_t)read_unaligned_be4(operands + 8 + i * 8);
+            targets[i] =
+                pc + (int32_t)read_unaligned_be4(operands + 12 + i * 8);
+            if (i > 0 && keys[i] <= keys[i - 1]) {
+                err = R11F_ERR_malformed_classfile;
+                break;
+            }
+        }
+    }
+    if (err == R11F_success) {
+        err = compile_lookup(keys, targets, npairs, pc, default_target,
+                             output);
+    }
+    r11f_free(keys);
+    r11f_free(targets);
+    return err;
+}
+
+static r11f_error_t compile_lookup(int32_t const *keys,
+                                   uint32_t const *targets,
+                                   uint32_t npairs,
+                                   uint32_t pc,
+                                   uint32_t default_target,
+                                   r11f_switch_t **output) {
+    /* nearly contiguous keys: a jump table with the holes sent to default */
+    int64_t range = npairs ? (int64_t)keys[npairs - 1] - keys[0] + 1 : 0;
+    if (npairs > 0 && range <= 2 * (int64_t)npairs) {
+        r11f_switch_t *sw = switch_alloc(0, (uint32_t)range);
+        if (!sw) {
+            return R11F_ERR_out_of_memory;
+        }
+
+        sw->pc = pc;
+        sw->kind = R11F_SWITCH_TABLE;
+        sw->low = keys[0];
+        sw->count = (uint32_t)range;
+        sw->default_target = default_target;
+        for (uint32_t i = 0; i < sw->count; i++) {
+            sw->targets[i] = default_target;
+        }
+        for (uint32_t i = 0; i < npairs; i++) {
+            sw->targets[(uint32_t)keys[i] - (uint32_t)keys[0]] = targets[i];
+        }
+
+        *output = sw;
+        return R11F_success;
+    }
+
+    /* sparse keys (typically hash codes of strings): look for a
+       multiplicative perfect hash, allowing up to four slots per key */
+    if (npairs > 4) {
+        uint8_t log2_size = 0;
+        while ((1u << log2_size) < npairs) {
+            log2_size++;
+        }
+
+        for (uint8_t extra = 0; extra <= 2 && log2_size + extra < 16; extra++) {
+            r11f_switch_t *sw = switch_alloc(1u << (log2_size + extra),
+                                             1u << (log2_size + extra));
+            if (!sw) {
+                return R11F_ERR_out_of_memory;
+            }
+
+            sw->pc = pc;
+            sw->default_target = default_target;
+            if (try_perfect_hash(sw, keys, targets, npairs, log2_size + extra)) {
+                *output = sw;
+                return R11F_success;
+            }
+            r11f_free(sw);
+        }
+    }
+
+    r11f_switch_t *sw = switch_alloc(npairs, npairs);
+    if (!sw) {
+        return R11F_ERR_out_of_memory;
+    }
+
+    sw->pc = pc;
+    sw->kind = R11F_SWITCH_BSEARCH;
+    sw->count = npairs;
+    sw->default_target = default_target;
+    memcpy(sw->keys, keys, npairs * sizeof(int32_t));
+    memcpy(sw->targets, targets, npairs * sizeof(uint32_t));
+
+    *output = sw;
+    return R11F_success;
+}
+
+R11F_EXPORT r11f_error_t r11f_switch_remap(r11f_switch_t *sw,
+                                           uint32_t const *target_map,
+                                           r11f_switch_t **output) {
+    uint32_t key_count = sw->kind == R11F_SWITCH_TABLE ? 0 : sw->count;
+    r11f_switch_t *remapped = switch_alloc(key_count, sw->count);
+    if (!remapped) {
+        return R11F_ERR_out_of_memory;
+    }
+
+    int32_t *keys = remapped->keys;
+    uint32_t *targets = remapped->targets;
+    *remapped = *sw;
+    remapped->keys = keys;
+    remapped->targets = targets;
+
+    if (key_count) {
+        memcpy(keys, sw->keys, key_count * sizeof(int32_t));
+    }
+    for (uint32_t i = 0; i < sw->count; i++) {
+        targets[i] = target_map[sw->targets[i]];
+    }
+    remapped->default_target = target_map[sw->default_target];
+
+    *output = remapped;
+    return R11F_success;
+}
+
+R11F_EXPORT uint32_t r11f_switch_lookup(r11f_switch_t *sw, int32_t key) {
+    switch (sw->kind) {
+        case R11F_SWITCH_TABLE: {
+            uint32_t index = (uint32_t)key - (uint32_t)sw->low;
+            return index < sw->count ?
+                sw->targets[index] :
+                sw->default_target;
+        }
+        case R11F_SWITCH_HASH: {
+            /* empty slots point to default, so no need to tell them apart */
+            uint32_t index = ((uint32_t)key * sw->hash_mul) >> sw->hash_shift;
+            return sw->keys[index] == key ?
+                sw->targets[index] :
+                sw->default_target;
+        }
+        default: {
+            if (!sw->count) {
+                return sw->default_target;
+            }
+
+            int32_t const *base = sw->keys;
+            uint32_t n = sw->count;
+            while (n > 1) {
+                uint32_t half = n / 2;
+                base = base[half] <= key ? base + half : base;
+                n -= half;
+            }
+            return *base == key ?
+                sw->targets[base - sw->keys] :
+                sw->default_target;
+        }
+    }
+}
+
+R11F_EXPORT void r11f_switch_free(r11f_switch_t *sw) {
+    r11f_free(sw);
+}
+
+static r11f_switch_t *switch_alloc(uint32_t key_count,
+                                   uint32_t target_count) {
+    r11f_switch_t *sw = r11f_alloc_zeroed(
+        sizeof(r11f_switch_t)
+        + key_count * sizeof(int32_t)
+        + target_count * sizeof(uint32_t)
+    );
+    if (!sw) {
+        return NULL;
+    }
+
+    sw->targets = (uint32_t*)(sw + 1);
+    sw->keys = key_count ? (int32_t*)(sw->targets + target_count) : NULL;
+    return sw;
+}
+
+static bool try_perfect_hash(r11f_switch_t *sw,
+                             int32_t const *keys,
+                             uint32_t const *targets,
+                             uint32_t npairs,
+                             uint8_t log2_size) {
+    uint32_t size = 1u << log2_size;
+    uint8_t shift = 32 - log2_size;
+    bool used[size];
+
+    /* odd multipliers from a fixed LCG so compilation is deterministic */
+    uint32_t mul = 0x9E3779B1u;
+    for (uint32_t attempt = 0; attempt < 64; attempt++) {
+        memset(used, 0, sizeof(used));
+
+        bool collision = false;
+        for (uint32_t i = 0; i < npairs; i++) {
+            uint32_t index = ((uint32_t)keys[i] * mul) >> shift;
+            if (used[index]) {
+                collision = true;
+                break;
+            }
+            used[index] = true;
+        }
+
+        if (!collision) {
+            sw->kind = R11F_SWITCH_HASH;
+            sw->hash_mul = mul;
+            sw->hash_shift = shift;
+            sw->count = size;
+            for (uint32_t i = 0; i < size; i++) {
+                sw->keys[i] = 0;
+                sw->targets[i] = sw->default_target;
+            }
+            for (uint32_t i = 0; i < npairs; i++) {
+                uint32_t index = ((uint32_t)keys[i] * mul) >> shift;
+                sw->keys[index] = keys[i];
+                sw->targets[index] = targets[i];
+            }
+            return true;
+        }
+
+        mul = (mul * 1664525u + 1013904223u) | 1u;
+    }
+
+    return false;
+}
@@ -0,0 +1,433 @@
+#include "tier.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include "alloc.h"
+#include "jit.h"
+#include "jitcache.h"
+#include "link.h"
+#include "opt.h"
+#include "regir.h"
+#include "vthread.h"
+
+#ifndef WIN32
+#   include <pthread.h>
+#endif
+
+typedef struct st_compile_task {
+    struct st_compile_task *next;
+    r11f_linked_method_t *method;
+    /* OSR compilations only */
+    r11f_loop_counter_t *loop;
+    uint8_t tier;
+    uint32_t invoke_count;
+    uint32_t backedge_count;
+} compile_task_t;
+
+struct st_r11f_compiler {
+    r11f_vm_t *vm;
+    /* set before the first thread starts, locks are skipped otherwise */
+    bool threaded;
+    uint8_t thread_count;
+#ifndef WIN32
+    pthread_t threads[R11F_MAX_COMPILE_THREADS];
+    /* guards the queue and the event log */
+    pthread_mutex_t queue_lock;
+    pthread_cond_t queue_cond;
+    /* signalled when the queue runs empty with no task in flight */
+    pthread_cond_t idle_cond;
+    /* recursive, guards class loading and linking */
+    pthread_mutex_t vm_lock;
+#endif
+    compile_task_t *head;
+    compile_task_t *tail;
+    uint32_t running;
+    bool stopping;
+
+    r11f_compile_event_t *events;
+    uint32_t event_count;
+    uint32_t event_capacity;
+};
+
+static void tier_check(r11f_vm_t *vm, r11f_linked_method_t *method);
+static r11f_compiler_t *compiler_get(r11f_vm_t *vm);
+static void compiler_request(r11f_vm_t *vm,
+                             r11f_linked_method_t *method,
+                             r11f_loop_counter_t *loop,
+                             uint8_t tier);
+static void compiler_run(r11f_compiler_t *compiler, compile_task_t *task);
+static void compiler_record(r11f_compiler_t *compiler,
+                            compile_task_t *task,
+                            r11f_error_t result);
+#ifndef WIN32
+static void *compiler_thread(void *arg);
+#endif
+
+R11F_INTERNAL void r11f_tier_invoke(r11f_vm_t *vm,
+                                    r11f_linked_method_t *method) {
+    method->invoke_count++;
+    tier_check(vm, method);
+}
+
+R11F_INTERNAL r11f_jit_entry_t r11f_tier_backedge(r11f_vm_t *vm,
+                                                  r11f_linked_method_t *method,
+                                                  uint32_t header_pc) {
+    method->backedge_count++;
+    tier_check(vm, method);
+
+    r11f_loop_counter_t *loop = r11f_method_find_loop(method, header_pc);
+    if (!loop) {
+        return NULL;
+    }
+    loop->count++;
+    uint32_t tier2 = vm->tier2_threshold ? vm->tier2_threshold
+                                         : R11F_TIER2_DEFAULT_THRESHOLD;
+    if (loop->count >= tier2 && !loop->osr_requested) {
+        loop->osr_requested = true;
+        compiler_request(vm, method, loop, R11F_TIER_OPT);
+    }
+
+    r11f_jit_code_t *osr = __atomic_load_n(&loop->osr, __ATOMIC_ACQUIRE);
+    if (osr && !__atomic_load_n(&osr->invalidated, __ATOMIC_ACQUIRE)) {
+        return osr->entry;
+    }
+    r11f_jit_code_t *jit = __atomic_load_n(&method->jit, __ATOMIC_ACQUIRE);
+    return jit ? r11f_jit_find_osr(jit, header_pc) : NULL;
+}
+
+static void tier_check(r11f_vm_t *vm, r11f_linked_method_t *method) {
+    uint32_t hotness = method->invoke_count + method->backedge_count;
+    uint32_t tier1 = vm->tier1_threshold ? vm->tier1_threshold
+                                         : R11F_TIER1_DEFAULT_THRESHOLD;
+    uint32_t tier2 = vm->tier2_threshold ? vm->tier2_threshold
+                                         : R11F_TIER2_DEFAULT_THRESHOLD;
+
+    if (hotness >= tier2 && method->tier_requested < R11F_TIER_OPT) {
+        compiler_request(vm, method, NULL, R11F_TIER_OPT);
+    }
+    else if (hotness >= tier1
+             && method->tier_requested < R11F_TIER_BASELINE) {
+        compiler_request(vm, method, NULL, R11F_TIER_BASELINE);
+    }
+}
+
+R11F_INTERNAL void r11f_tier_lock(r11f_vm_t *vm) {
+    /* carriers of a scheduler share the classes too */
+    if (vm->sched) {
+        r11f_sched_lock(vm->sched);
+    }
+#ifndef WIN32
+    if (vm->compiler && vm->compiler->threaded) {
+        pthread_mutex_lock(&vm->compiler->vm_lock);
+    }
+#endif
+}
+
+R11F_INTERNAL void r11f_tier_unlock(r11f_vm_t *vm) {
+#ifndef WIN32
+    if (vm->compiler && vm->compiler->threaded) {
+        pthread_mutex_unlock(&vm->compiler->vm_lock);
+    }
+#endif
+    if (vm->sched) {
+        r11f_sched_unlock(vm->sched);
+    }
+}
+
+R11F_INTERNAL void r11f_tier_shutdown(r11f_vm_t *vm) {
+    r11f_compiler_t *compiler = vm->compiler;
+    if (!compiler) {
+        return;
+    }
+
+#ifndef WIN32
+    if (compiler->threaded) {
+        /* workers finish whatever is still queued before leaving */
+        pthread_mutex_lock(&compiler->queue_lock);
+        compiler->stopping = true;
+        pthread_cond_broadcast(&compiler->queue_cond);
+        pthread_mutex_unlock(&compiler->queue_lock);
+
+        for (uint8_t i = 0; i < compiler->thread_count; i++) {
+            pthread_join(compiler->threads[i], NULL);
+        }
+        pthread_mutex_destroy(&compiler->vm_lock);
+        pthread_cond_destroy(&compiler->idle_cond);
+        pthread_cond_destroy(&compiler->queue_cond);
+        pthread_mutex_destroy(&compiler->queue_lock);
+    }
+#endif
+
+    r11f_free(compiler->events);
+    r11f_free(compiler);
+    vm->compiler = NULL;
+}
+
+R11F_EXPORT void r11f_vm_compile_wait(r11f_vm_t *vm) {
+#ifndef WIN32
+    r11f_compiler_t *compiler = vm->compiler;
+    if (!compiler || !compiler->threaded) {
+        return;
+    }
+
+    pthread_mutex_lock(&compiler->queue_lock);
+    while (compiler->head || compiler->running) {
+        pthread_cond_wait(&compiler->idle_cond, &compiler->queue_lock);
+    }
+    pthread_mutex_unlock(&compiler->queue_lock);
+#else
+    (void)vm;
+#endif
+}
+
+R11F_EXPORT uint32_t r11f_vm_compile_events(r11f_vm_t *vm,
+                                            r11f_compile_event_t *output,
+                                            uint32_t max) {
+    r11f_compiler_t *compiler = vm->compiler;
+    if (!compiler) {
+        return 0;
+    }
+
+#ifndef WIN32
+    if (compiler->threaded) {
+        pthread_mutex_lock(&compiler->queue_lock);
+    }
+#endif
+    uint32_t count = compiler->event_count;
+    if (count) {
+        memcpy(output,
+               compiler->events,
+               sizeof(r11f_compile_event_t) * (count < max ? count : max));
+    }
+#ifndef WIN32
+    if (compiler->threaded) {
+        pthread_mutex_unlock(&compiler->queue_lock);
+    }
+#endif
+    return count;
+}
+
+static r11f_compiler_t *compiler_get(r11f_vm_t *vm) {
+    if (vm->compiler) {
+        return vm->compiler;
+    }
+
+    r11f_compiler_t *compiler = r11f_alloc_zeroed(sizeof(r11f_compiler_t));
+    if (!compiler) {
+        return NULL;
+    }
+    compiler->vm = vm;
+
+#ifndef WIN32
+    uint8_t thread_count = vm->compile_threads;
+    if (thread_count > R11F_MAX_COMPILE_THREADS) {
+        thread_count = R11F_MAX_COMPILE_THREADS;
+    }
+    if (thread_count) {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init(&compiler->vm_lock, &attr);
+        pthread_mutexattr_destroy(&attr);
+        pthread_mutex_init(&compiler->queue_lock, NULL);
+        pthread_cond_init(&compiler->queue_cond, NULL);
+        pthread_cond_init(&compiler->idle_cond, NULL);
+        compiler->threaded = true;
+    }
+
+    /* published before any thread starts, the lock must be seen by all */
+    vm->compiler = compiler;
+    for (uint8_t i = 0; i < thread_count; i++) {
+        if (pthread_create(&compiler->threads[i],
+                           NULL,
+                           compiler_thread,
+                           compiler) != 0) {
+            break;
+        }
+        compiler->thread_count++;
+    }
+    if (thread_count && !compiler->thread_count) {
+        /* no thread could be started, compile synchronously instead */
+        pthread_cond_destroy(&compiler->idle_cond);
+        pthread_cond_destroy(&compiler->queue_cond);
+        pthread_mutex_destroy(&compiler->queue_lock);
+        pthread_mutex_destroy(&compiler->vm_lock);
+        compiler->threaded = false;
+    }
+#else
+    vm->compiler = compiler;
+#endif
+    return compiler;
+}
+
+static void compiler_request(r11f_vm_t *vm,
+                             r11f_linked_method_t *method,
+                             r11f_loop_counter_t *loop,
+                             uint8_t tier) {
+    if (!loop) {
+        method->tier_requested = tier;
+    }
+
+    r11f_compiler_t *compiler = compiler_get(vm);
+    if (!compiler) {
+        return;
+    }
+
+    compile_task_t task = {
+        .next = NULL,
+        .method = method,
+        .loop = loop,
+        .tier = tier,
+        .invoke_count = method->invoke_count,
+        .backedge_count = method->backedge_count,
+    };
+    if (!compiler->threaded) {
+        compiler_run(compiler, &task);
+        return;
+    }
+
+#ifndef WIN32
+    compile_task_t *queued = r11f_alloc(sizeof(compile_task_t));
+    if (!queued) {
+        return;
+    }
+    *queued = task;
+
+    pthread_mutex_lock(&compiler->queue_lock);
+    if (compiler->tail) {
+        compiler->tail->next = queued;
+    }
+    else {
+        compiler->head = queued;
+    }
+    compiler->tail = queued;
+    pthread_cond_signal(&compiler->queue_cond);
+    pthread_mutex_unlock(&compiler->queue_lock);
+#endif
+}
+
+static void compiler_run(r11f_compiler_t *compiler, compile_task_t *task) {
+    r11f_vm_t *vm = compiler->vm;
+    r11f_linked_method_t *method = task->method;
+
+    /* the optimizer translates callees too, keep out of its way */
+    r11f_tier_lock(vm);
+    if (!method->regir && !method->regir_failed) {
+        if (r11f_regir_compile(method, &method->regir) != R11F_success) {
+            method->regir = NULL;
+            method->regir_failed = true;
+        }
+    }
+    r11f_tier_unlock(vm);
+
+    if (!method->regir) {
+        compiler_record(compiler, task, R11F_ERR_not_implemented_instruction);
+        return;
+    }
+
+    r11f_jit_code_t *code;
+    r11f_error_t err;
+    if (task->loop) {
+        err = r11f_opt_compile_osr(vm, method, task->loop->header_pc, &code);
+        if (err == R11F_success) {
+            __atomic_store_n(&task->loop->osr, code, __ATOMIC_RELEASE);
+        }
+        else {
+            task->loop->osr_failed = true;
+        }
+    }
+    else if (task->tier == R11F_TIER_BASELINE) {
+        err = r11f_jitcache_compile(vm->jit_cache_dir, method, &code);
+        if (err == R11F_success) {
+            __atomic_store_n(&method->jit, code, __ATOMIC_RELEASE);
+        }
+        else {
+            method->jit_failed = true;
+        }
+    }
+    else {
+        err = r11f_opt_compile(vm, method, &code);
+        if (err == R11F_success) {
+            __atomic_store_n(&method->opt, code, __ATOMIC_RELEASE);
+        }
+        else {
+            method->opt_failed = true;
+        }
+    }
+    compiler_record(compiler, task, err);
+}
+
+static void compiler_record(r11f_compiler_t *compiler,
+                            compile_task_t *task,
+                            r11f_error_t result) {
+#ifndef WIN32
+    if (compiler->threaded) {
+        pthread_mutex_lock(&compiler->queue_lock);
+    }
+#endif
+    if (compiler->event_count == compiler->event_capacity) {
+        uint32_t capacity =
+            compiler->event_capacity ? compiler->event_capacity * 2 : 16;
+        r11f_compile_event_t *events =
+            r11f_alloc(sizeof(r11f_compile_event_t) * capacity);
+        if (events) {
+            if (compiler->event_count) {
+                memcpy(events,
+                       compiler->events,
+                       sizeof(r11f_compile_event_t) * compiler->event_count);
+            }
+            r11f_free(compiler->events);
+            compiler->events = events;
+            compiler->event_capacity = capacity;
+        }
+    }
+    if (compiler->event_count < compiler->event_capacity) {
+        compiler->events[compiler->event_count++] = (r11f_compile_event_t) {
+            .method = task->method,
+            .tier = task->tier,
+            .osr = task->loop != NULL,
+            .osr_pc = task->loop ? task->loop->header_pc : 0,
+            .invoke_count = task->invoke_count,
+            .backedge_count = task->backedge_count,
+            .result = result,
+        };
+    }
+#ifndef WIN32
+    if (compiler->threaded) {
+        pthread_mutex_unlock(&compiler->queue_lock);
+    }
+#endif
+}
+
+#ifndef WIN32
+static void *compiler_thread(void *arg) {
+    r11f_compiler_t *compiler = arg;
+    for (;;) {
+        pthread_mutex_lock(&compiler->queue_lock);
+        while (!compiler->head && !compiler->stopping) {
+            pthread_cond_wait(&compiler->queue_cond, &compiler->queue_lock);
+        }
+        compile_task_t *task = compiler->head;
+        if (!task) {
+            pthread_mutex_unlock(&compiler->queue_lock);
+            return NULL;
+        }
+        compiler->head = task->next;
+        if (!compiler->head) {
+            compiler->tail = NULL;
+        }
+        compiler->running++;
+        pthread_mutex_unlock(&compiler->queue_lock);
+
+        compiler_run(compiler, task);
+        r11f_free(task);
+
+        pthread_mutex_lock(&compiler->queue_lock);
+        compiler->running--;
+        if (!compiler->head && !compiler->running) {
+            pthread_cond_broadcast(&compiler->idle_cond);
+        }
+        pthread_mutex_unlock(&compiler->queue_lock);
+    }
+}
+#endif
@@ -0,0 +1,376 @@
+#include "tos.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "byteutil.h"
+#include "bytecode.h"
+#include "class/cpool.h"
+#include "class.h"
+#include "frame.h"
+#include "link.h"
+#include "object.h"
+#include "switch.h"
+
+/*
+ * Stack caching interpreter. Up to two topmost operand stack values live
+ * in the C locals t0 (top) and t1 (second), the rest stays in
+ * frame->stack below `sp`. The cache state is encoded by which of the
+ * three dispatch loops is running:
+ *
+ *   state0: nothing cached
+ *   state1: t0 cached
+ *   state2: t1 and t0 cached
+ *
+ * Handlers for every state are generated from the stack effects listed in
+ * tosinc.h. Upon hitting an instruction not listed there (calls, returns,
+ * division by zero, a null array or an index outside it...) the cache
+ * gets flushed back to the operand stack and control returns to
+ * vm_execute, which runs that one instruction.
+ */
+
+static r11f_value_t tos_ldc2_w(r11f_frame_t *frame, uint8_t *operand) {
+    /* verified to be a CONSTANT_Long, as in vm_execute */
+    r11f_constant_long_info_t *long_info =
+        frame->clazz->constant_pool[read_unaligned_be2(operand)];
+    return (r11f_value_t) {
+        .i64 = (int64_t)(((uint64_t)long_info->high_bytes << 32)
+                         | long_info->low_bytes)
+    };
+}
+
+/* what vm_execute throws for: no array, or an index outside it */
+static bool tos_bad_index(r11f_value_t array, r11f_value_t index) {
+    r11f_array_t *a = array.ptr;
+    return !a || (uint32_t)index.i32 >= (uint32_t)a->length;
+}
+
+static uint32_t tos_branch(uint8_t *code, uint32_t pc, int cond) {
+    return cond ? pc + (int16_t)read_unaligned_be2(code + pc + 1) : pc + 3;
+}
+
+static uint32_t tos_switch(r11f_frame_t *frame, uint32_t pc, int32_t key) {
+    r11f_switch_t *sw =
+        r11f_method_find_switch(frame->method_info->linked, pc);
+    return r11f_switch_lookup(sw, key);
+}
+
+R11F_INTERNAL void r11f_tos_execute(r11f_frame_t *frame) {
+    r11f_value_t *stack = frame->stack;
+    r11f_value_t *locals = frame->locals;
+    uint8_t *code = frame->code;
+    uint32_t pc = frame->pc;
+    uint16_t sp = frame->sp;
+    r11f_value_t t0, t1;
+
+state0:
+    switch (code[pc]) {
+#define TOS_PUSH(CODE, LENGTH, VALUE) \
+        case R11F_##CODE: \
+            t0 = (VALUE); \
+            pc += LENGTH; \
+            goto state1;
+#define TOS_POP(CODE, LENGTH, STMT) \
+        case R11F_##CODE: { \
+            r11f_value_t v = stack[--sp]; \
+            STMT; \
+            pc += LENGTH; \
+            goto state0; \
+        }
+#define TOS_DUP(CODE) \
+        case R11F_##CODE: \
+            t0 = stack[--sp]; \
+            t1 = t0; \
+            pc += 1; \
+            goto state2;
+#define TOS_UNOP(CODE, EXPR) \
+        case R11F_##CODE: { \
+            r11f_value_t a = stack[--sp]; \
+            t0 = (EXPR); \
+            pc += 1; \
+            goto state1; \
+        }
+#define TOS_BINOP(CODE, EXPR) \
+        case R11F_##CODE: { \
+            r11f_value_t b = stack[sp - 1]; \
+            r11f_value_t a = stack[sp - 2]; \
+            sp -= 2; \
+            t0 = (EXPR); \
+            pc += 1; \
+            goto state1; \
+        }
+#define TOS_CHKUNOP(CODE, FAIL, EXPR) \
+        case R11F_##CODE: { \
+            r11f_value_t a = stack[sp - 1]; \
+            if (FAIL) { \
+                goto flush0; \
+            } \
+            sp--; \
+            t0 = (EXPR); \
+            pc += 1; \
+            goto state1; \
+        }
+#define TOS_CHKBINOP(CODE, FAIL, EXPR) \
+        case R11F_##CODE: { \
+            r11f_value_t b = stack[sp - 1]; \
+            r11f_value_t a = stack[sp - 2]; \
+            if (FAIL) { \
+                goto flush0; \
+            } \
+            sp -= 2; \
+            t0 = (EXPR); \
+            pc += 1; \
+            goto state1; \
+        }
+#define TOS_POP3(CODE, FAIL, STMT) \
+        case R11F_##CODE: { \
+            r11f_value_t c = stack[sp - 1]; \
+            r11f_value_t b = stack[sp - 2]; \
+            r11f_value_t a = stack[sp - 3]; \
+            if (FAIL) { \
+                goto flush0; \
+            } \
+            sp -= 3; \
+            STMT; \
+            pc += 1; \
+            goto state0; \
+        }
+#define TOS_IF1(CODE, COND) \
+        case R11F_##CODE: { \
+            r11f_value_t a = stack[--sp]; \
+            pc = tos_branch(code, pc, (COND)); \
+            goto state0; \
+        }
+#define TOS_IF2(CODE, COND) \
+        case R11F_##CODE: { \
+            r11f_value_t b = stack[sp - 1]; \
+            r11f_value_t a = stack[sp - 2]; \
+            sp -= 2; \
+            pc = tos_branch(code, pc, (COND)); \
+            goto state0; \
+        }
+#define TOS_JUMP1(CODE, TARGET) \
+        case R11F_##CODE: { \
+            r11f_value_t a = stack[--sp]; \
+            pc = (TARGET); \
+            goto state0; \
+        }
+#define TOS_NOSTACK(CODE, STMT) \
+        case R11F_##CODE: \
+            STMT; \
+            goto state0;
+#include "tosinc.h"
+
+        default:
+            goto flush0;
+    }
+
+state1:
+    switch (code[pc]) {
+#define TOS_PUSH(CODE, LENGTH, VALUE) \
+        case R11F_##CODE: \
+            t1 = t0; \
+            t0 = (VALUE); \
+            pc += LENGTH; \
+            goto state2;
+#define TOS_POP(CODE, LENGTH, STMT) \
+        case R11F_##CODE: { \
+            r11f_value_t v = t0; \
+            STMT; \
+            pc += LENGTH; \
+            goto state0; \
+        }
+#define TOS_DUP(CODE) \
+        case R11F_##CODE: \
+            t1 = t0; \
+            pc += 1; \
+            goto state2;
+#define TOS_UNOP(CODE, EXPR) \
+        case R11F_##CODE: { \
+            r11f_value_t a = t0; \
+            t0 = (EXPR); \
+            pc += 1; \
+            goto state1; \
+        }
+#define TOS_BINOP(CODE, EXPR) \
+        case R11F_##CODE: { \
+            r11f_value_t b = t0; \
+            r11f_value_t a = stack[--sp]; \
+            t0 = (EXPR); \
+            pc += 1; \
+            goto state1; \
+        }
+#define TOS_CHKUNOP(CODE, FAIL, EXPR) \
+        case R11F_##CODE: { \
+            r11f_value_t a = t0; \
+            if (FAIL) { \
+                goto flush1; \
+            } \
+            t0 = (EXPR); \
+            pc += 1; \
+            goto state1; \
+        }
+#define TOS_CHKBINOP(CODE, FAIL, EXPR) \
+        case R11F_##CODE: { \
+            r11f_value_t b = t0; \
+            r11f_value_t a = stack[sp - 1]; \
+            if (FAIL) { \
+                goto flush1; \
+            } \
+            sp--; \
+            t0 = (EXPR); \
+            pc += 1; \
+            goto state1; \
+        }
+#define TOS_POP3(CODE, FAIL, STMT) \
+        case R11F_##CODE: { \
+            r11f_value_t c = t0; \
+            r11f_value_t b = stack[sp - 1]; \
+            r11f_value_t a = stack[sp - 2]; \
+            if (FAIL) { \
+                goto flush1; \
+            } \
+            sp -= 2; \
+            STMT; \
+            pc += 1; \
+            goto state0; \
+        }
+#define TOS_IF1(CODE, COND) \
+        case R11F_##CODE: { \
+            r11f_value_t a = t0; \
+            pc = tos_branch(code, pc, (COND)); \
+            goto state0; \
+        }
+#define TOS_IF2(CODE, COND) \
+        case R11F_##CODE: { \
+            r11f_value_t b = t0; \
+            r11f_value_t a = stack[--sp]; \
+            pc = tos_branch(code, pc, (COND)); \
+            goto state0; \
+        }
+#define TOS_JUMP1(CODE, TARGET) \
+        case R11F_##CODE: { \
+            r11f_value_t a = t0; \
+            pc = (TARGET); \
+            goto state0; \
+        }
+#define TOS_NOSTACK(CODE, STMT) \
+        case R11F_##CODE: \
+            STMT; \
+            goto state1;
+#include "tosinc.h"
+
+        default:
+            goto flush1;
+    }
+
+state2:
+    switch (code[pc]) {
+#define TOS_PUSH(CODE, LENGTH, VALUE) \
+        case R11F_##CODE: \
+            stack[sp++] = t1; \
+            t1 = t0; \
+            t0 = (VALUE); \
+            pc += LENGTH; \
+            goto state2;
+#define TOS_POP(CODE, LENGTH, STMT) \
+        case R11F_##CODE: { \
+            r11f_value_t v = t0; \
+            STMT; \
+            t0 = t1; \
+            pc += LENGTH; \
+            goto state1; \
+        }
+#define TOS_DUP(CODE) \
+        case R11F_##CODE: \
+            stack[sp++] = t1; \
+            t1 = t0; \
+            pc += 1; \
+            goto state2;
+#define TOS_UNOP(CODE, EXPR) \
+        case R11F_##CODE: { \
+            r11f_value_t a = t0; \
+            t0 = (EXPR); \
+            pc += 1; \
+            goto state2; \
+        }
+#define TOS_BINOP(CODE, EXPR) \
+        case R11F_##CODE: { \
+            r11f_value_t b = t0; \
+            r11f_value_t a = t1; \
+            t0 = (EXPR); \
+            pc += 1; \
+            goto state1; \
+        }
+#define TOS_CHKUNOP(CODE, FAIL, EXPR) \
+        case R11F_##CODE: { \
+            r11f_value_t a = t0; \
+            if (FAIL) { \
+                goto flush2; \
+            } \
+            t0 = (EXPR); \
+            pc += 1; \
+            goto state2; \
+        }
+#define TOS_CHKBINOP(CODE, FAIL, EXPR) \
+        case R11F_##CODE: { \
+            r11f_value_t b = t0; \
+            r11f_value_t a = t1; \
+            if (FAIL) { \
+                goto flush2; \
+            } \
+            t0 = (EXPR); \
+            pc += 1; \
+            goto state1; \
+        }
+#define TOS_POP3(CODE, FAIL, STMT) \
+        case R11F_##CODE: { \
+            r11f_value_t c = t0; \
+            r11f_value_t b = t1; \
+            r11f_value_t a = stack[sp - 1]; \
+            if (FAIL) { \
+                goto flush2; \
+            } \
+            sp--; \
+            STMT; \
+            pc += 1; \
+            goto state0; \
+        }
+#define TOS_IF1(CODE, COND) \
+        case R11F_##CODE: { \
+            r11f_value_t a = t0; \
+            t0 = t1; \
+            pc = tos_branch(code, pc, (COND)); \
+            goto state1; \
+        }
+#define TOS_IF2(CODE, COND) \
+        case R11F_##CODE: { \
+            r11f_value_t b = t0; \
+            r11f_value_t a = t1; \
+            pc = tos_branch(code, pc, (COND)); \
+            goto state0; \
+        }
+#define TOS_JUMP1(CODE, TARGET) \
+        case R11F_##CODE: { \
+            r11f_value_t a = t0; \
+            t0 = t1; \
+            pc = (TARGET); \
+            goto state1; \
+        }
+#define TOS_NOSTACK(CODE, STMT) \
+        case R11F_##CODE: \
+            STMT; \
+            goto state2;
+#include "tosinc.h"
+
+        default:
+            goto flush2;
+    }
+
+flush2:
+    stack[sp++] = t1;
+flush1:
+    stack[sp++] = t0;
+flush0:
+    frame->pc = pc;
+    frame->sp = sp;
+}
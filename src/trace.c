@@ -0,0 +1,209 @@
+#include "trace.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include "alloc.h"
+#include "class.h"
+#include "frame.h"
+#include "jit.h"
+#include "link.h"
+#include "regir.h"
+#include "ssa.h"
+
+struct st_r11f_tracer {
+    bool recording;
+    /* the frame recording started in, and the loop header it started at */
+    r11f_frame_t *root;
+    r11f_loop_counter_t *loop;
+    uint32_t header;
+    /* frames entered from the root frame and still running */
+    uint32_t depth;
+
+    uint32_t event_count;
+    r11f_trace_event_t events[R11F_TRACE_MAX_EVENTS];
+};
+
+static r11f_loop_counter_t *trace_find_loop(r11f_linked_method_t *method,
+                                            uint32_t header);
+static bool trace_record(r11f_vm_t *vm,
+                         r11f_linked_method_t *method,
+                         r11f_linked_method_t *callee,
+                         uint32_t pc,
+                         uint32_t target);
+static r11f_jit_entry_t trace_finish(r11f_tracer_t *tracer);
+
+R11F_EXPORT r11f_error_t r11f_trace_compile(r11f_linked_method_t *method,
+                                            uint32_t header,
+                                            r11f_trace_event_t const *events,
+                                            uint32_t event_count,
+                                            r11f_jit_code_t **output) {
+    r11f_ssa_t ssa;
+    r11f_error_t err =
+        r11f_ssa_build_trace(method, header, events, event_count, &ssa);
+    if (err == R11F_success) {
+        r11f_ssa_optimize(&ssa);
+        err = ssa.oom ?
+            R11F_ERR_out_of_memory :
+            r11f_ssa_codegen(&ssa, output);
+    }
+    r11f_ssa_cleanup(&ssa);
+    return err;
+}
+
+R11F_INTERNAL r11f_jit_entry_t r11f_trace_jump(r11f_vm_t *vm,
+                                               r11f_frame_t *frame,
+                                               uint32_t pc,
+                                               uint32_t target) {
+    r11f_linked_method_t *method = frame->method_info->linked;
+    r11f_tracer_t *tracer = vm->tracer;
+    if (tracer && tracer->recording) {
+        if (!trace_record(vm, method, NULL, pc, target)) {
+            return NULL;
+        }
+        if (target > pc) {
+            return NULL;
+        }
+        if (frame == tracer->root && target == tracer->header) {
+            return trace_finish(tracer);
+        }
+        /* the path runs into another loop */
+        r11f_trace_abort(vm);
+        return NULL;
+    }
+    if (target > pc) {
+        return NULL;
+    }
+
+    /* exception handlers continue in the interpreter */
+    r11f_loop_counter_t *loop = trace_find_loop(method, target);
+    if (!loop || loop->osr_failed || method->handler_count) {
+        return NULL;
+    }
+    if (loop->osr) {
+        return loop->osr->entry;
+    }
+    uint32_t threshold = vm->trace_threshold ?
+        vm->trace_threshold :
+        R11F_TRACE_DEFAULT_THRESHOLD;
+    if (++loop->count < threshold) {
+        return NULL;
+    }
+
+    if (!tracer) {
+        tracer = r11f_alloc(sizeof(r11f_tracer_t));
+        if (!tracer) {
+            loop->osr_failed = true;
+            return NULL;
+        }
+        vm->tracer = tracer;
+    }
+    tracer->recording = true;
+    tracer->root = frame;
+    tracer->loop = loop;
+    tracer->header = target;
+    tracer->depth = 0;
+    tracer->event_count = 0;
+    return NULL;
+}
+
+R11F_INTERNAL void r11f_trace_invoke(r11f_vm_t *vm,
+                                     r11f_frame_t *frame,
+                                     uint32_t pc,
+                                     r11f_linked_method_t *callee) {
+    r11f_tracer_t *tracer = vm->tracer;
+    if (!tracer || !tracer->recording) {
+        return;
+    }
+    if (!callee
+        || !callee->regir
+        || callee->handler_count
+        || tracer->depth == R11F_TRACE_MAX_DEPTH) {
+        r11f_trace_abort(vm);
+        return;
+    }
+    if (trace_record(vm, frame->method_info->linked, callee, pc, 0)) {
+        tracer->depth++;
+    }
+}
+
+R11F_INTERNAL void r11f_trace_return(r11f_vm_t *vm, r11f_frame_t *frame) {
+    r11f_tracer_t *tracer = vm->tracer;
+    if (!tracer || !tracer->recording) {
+        return;
+    }
+    if (frame == tracer->root || tracer->depth == 0) {
+        r11f_trace_abort(vm);
+        return;
+    }
+    tracer->depth--;
+}
+
+/* the loop stays interpreted, other loops still get their chance */
+R11F_INTERNAL void r11f_trace_abort(r11f_vm_t *vm) {
+    r11f_tracer_t *tracer = vm->tracer;
+    if (!tracer || !tracer->recording) {
+        return;
+    }
+    tracer->recording = false;
+    tracer->root = NULL;
+    tracer->loop->osr_failed = true;
+}
+
+R11F_INTERNAL void r11f_trace_cleanup(r11f_vm_t *vm) {
+    r11f_free(vm->tracer);
+    vm->tracer = NULL;
+}
+
+/* loop counters are kept by bytecode pc, register IR loops map the
+   header instruction back to it */
+static r11f_loop_counter_t *trace_find_loop(r11f_linked_method_t *method,
+                                            uint32_t header) {
+    r11f_regir_t *regir = method->regir;
+    for (uint32_t i = 0; i < regir->loop_count; i++) {
+        if (regir->loops[i].insn == header) {
+            return r11f_method_find_loop(method, regir->loops[i].pc);
+        }
+    }
+    return NULL;
+}
+
+/* false once the path got too long, which aborts recording */
+static bool trace_record(r11f_vm_t *vm,
+                         r11f_linked_method_t *method,
+                         r11f_linked_method_t *callee,
+                         uint32_t pc,
+                         uint32_t target) {
+    r11f_tracer_t *tracer = vm->tracer;
+    if (tracer->event_count == R11F_TRACE_MAX_EVENTS) {
+        r11f_trace_abort(vm);
+        return false;
+    }
+    tracer->events[tracer->event_count++] = (r11f_trace_event_t) {
+        .method = method,
+        .callee = callee,
+        .pc = pc,
+        .target = target
+    };
+    return true;
+}
+
+/* the root frame is back at the header, its path gets compiled and
+   entered right away */
+static r11f_jit_entry_t trace_finish(r11f_tracer_t *tracer) {
+    r11f_loop_counter_t *loop = tracer->loop;
+    r11f_linked_method_t *method = tracer->root->method_info->linked;
+    tracer->recording = false;
+    tracer->root = NULL;
+
+    r11f_jit_code_t *code;
+    if (r11f_trace_compile(method,
+                           tracer->header,
+                           tracer->events,
+                           tracer->event_count,
+                           &code) != R11F_success) {
+        loop->osr_failed = true;
+        return NULL;
+    }
+    loop->osr = code;
+    return code->entry;
+}
@@ -0,0 +1,1366 @@
+#include "verify.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "alloc.h"
+#include "bytecode.h"
+#include "byteutil.h"
+#include "class.h"
+#include "class/attrib.h"
+#include "class/cpool.h"
+
+#define CHKVERIFY(expr) \
+    if (!(expr)) { \
+        return R11F_ERR_verify_failed; \
+    }
+
+/* verification types; a long or double takes two slots, the second of
+   them VT_HALF */
+enum {
+    VT_TOP,
+    VT_INT,
+    VT_FLOAT,
+    VT_LONG,
+    VT_DOUBLE,
+    VT_HALF,
+    VT_NULL,
+    VT_UNINIT_THIS,
+    VT_UNINIT,
+    VT_OBJECT
+};
+
+typedef struct {
+    uint8_t kind;
+    uint16_t name_len;
+    /* VT_UNINIT: pc of the `new` that created the object */
+    uint32_t pc;
+    /* VT_OBJECT: class name, or the descriptor of an array type */
+    char const *name;
+} vtype_t;
+
+typedef struct {
+    uint32_t pc;
+    uint16_t sp;
+    vtype_t *locals;
+    vtype_t *stack;
+} vframe_t;
+
+typedef struct {
+    r11f_class_t *clazz;
+    uint8_t *code;
+    uint32_t code_length;
+    uint16_t max_stack;
+    uint16_t max_locals;
+
+    char const *descriptor;
+    uint16_t descriptor_len;
+    bool is_init;
+    vtype_t this_type;
+
+    /* the exception table, already little-endian (clsfile.c) */
+    uint8_t *handlers;
+    uint16_t handler_count;
+
+    /* 1 at the first byte of every instruction */
+    uint8_t *starts;
+    /* frames of the StackMapTable, sorted by pc */
+    vframe_t *frames;
+    uint32_t frame_count;
+
+    /* the frame before the instruction being verified */
+    vframe_t cur;
+    uint32_t pc;
+} verifier_t;
+
+static vtype_t const vt_top = { .kind = VT_TOP };
+static vtype_t const vt_int = { .kind = VT_INT };
+static vtype_t const vt_long = { .kind = VT_LONG };
+static vtype_t const vt_half = { .kind = VT_HALF };
+static vtype_t const vt_null = { .kind = VT_NULL };
+static vtype_t const vt_int_array = {
+    .kind = VT_OBJECT,
+    .name_len = 2,
+    .name = "[I"
+};
+
+static r11f_error_t verify_method(verifier_t *v,
+                                  r11f_method_info_t *method_info);
+static r11f_error_t read_code(verifier_t *v,
+                              r11f_attribute_info_t *code_attr,
+                              uint8_t **out_stack_map,
+                              uint32_t *out_stack_map_length);
+static bool mark_starts(verifier_t *v);
+static bool init_frame(verifier_t *v,
+                       r11f_method_info_t *method_info,
+                       vframe_t *frame,
+                       uint16_t *out_nlocals);
+static r11f_error_t read_stack_map(verifier_t *v,
+                                   uint8_t *data,
+                                   uint32_t length,
+                                   uint32_t count,
+                                   uint16_t nlocals,
+                                   vtype_t *types);
+static bool read_vtype(verifier_t *v,
+                       uint8_t **p,
+                       uint8_t *end,
+                       vtype_t *out);
+static bool append_local(verifier_t *v,
+                         vframe_t *frame,
+                         uint16_t *nlocals,
+                         vtype_t type);
+static bool check_handlers(verifier_t *v);
+static r11f_error_t verify_code(verifier_t *v);
+static r11f_error_t verify_insn(verifier_t *v, bool *out_falls_through);
+static r11f_error_t verify_invoke(verifier_t *v, uint8_t insc);
+static r11f_error_t verify_switch(verifier_t *v, uint8_t insc);
+static bool branch(verifier_t *v, int32_t offset);
+static vframe_t *find_frame(verifier_t *v, uint32_t pc);
+static bool frame_assignable(verifier_t *v, vframe_t const *frame);
+static bool handlers_assignable(verifier_t *v);
+static void copy_frame(verifier_t *v, vframe_t *dst, vframe_t const *src);
+static bool push(verifier_t *v, vtype_t type);
+static bool pop(verifier_t *v, vtype_t type);
+static bool pop_reference(verifier_t *v, vtype_t *out);
+static bool load(verifier_t *v, uint32_t index, vtype_t type);
+static bool store(verifier_t *v, uint32_t index, vtype_t type);
+static void initialize(verifier_t *v, vtype_t const *uninit, vtype_t type);
+static bool assignable(vtype_t const *from, vtype_t const *to);
+static bool is_wide(vtype_t const *type);
+static bool is_reference(vtype_t const *type);
+static bool parse_type(char const **p, char const *end, vtype_t *out);
+static void *cp_entry(r11f_class_t *clazz, uint16_t index, uint8_t tag);
+static bool class_name_at(r11f_class_t *clazz,
+                          uint16_t index,
+                          char const **out_name,
+                          uint16_t *out_name_len);
+static bool utf8_equals(r11f_constant_utf8_info_t const *utf8_info,
+                        char const *str);
+
+R11F_EXPORT r11f_error_t r11f_class_verify(r11f_class_t *clazz) {
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    /* the VM loads the superclass by this name before anything else */
+    char const *super_name;
+    uint16_t super_name_len;
+    uint16_t verified = 0;
+    r11f_error_t err = R11F_success;
+    if (clazz->super_class
+        && !class_name_at(clazz,
+                          clazz->super_class,
+                          &super_name,
+                          &super_name_len)) {
+        err = R11F_ERR_verify_failed;
+    }
+    for (uint16_t i = 0;
+         err == R11F_success && i < clazz->methods_count;
+         i++) {
+        /* code exactly where the VM may invoke the method */
+        r11f_method_info_t *method_info = clazz->methods[i];
+        bool has_code =
+            r11f_method_find_attribute(clazz, method_info, "Code") != NULL;
+        if (has_code
+            == !!(method_info->access_flags
+                  & (R11F_ACC_ABSTRACT | R11F_ACC_NATIVE))) {
+            err = R11F_ERR_verify_failed;
+            break;
+        }
+        if (!has_code) {
+            continue;
+        }
+
+        err = r11f_method_verify(clazz, method_info, NULL);
+        if (err == R11F_ERR_not_implemented_instruction) {
+            method_info->verify_error = err;
+            err = R11F_success;
+        } else if (err != R11F_success) {
+            break;
+        }
+        verified++;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    clazz->verified_methods = verified;
+    clazz->verify_nanos =
+        (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000u
+        + (uint64_t)end.tv_nsec - (uint64_t)start.tv_nsec;
+    return err;
+}
+
+R11F_EXPORT r11f_error_t r11f_method_verify(r11f_class_t *clazz,
+                                            r11f_method_info_t *method_info,
+                                            uint32_t *out_pc) {
+    verifier_t v;
+    memset(&v, 0, sizeof(verifier_t));
+    v.clazz = clazz;
+
+    r11f_error_t err = verify_method(&v, method_info);
+    if (out_pc) {
+        *out_pc = v.pc;
+    }
+    r11f_free(v.starts);
+    r11f_free(v.frames);
+    r11f_free(v.cur.locals);
+    return err;
+}
+
+static r11f_error_t verify_method(verifier_t *v,
+                                  r11f_method_info_t *method_info) {
+    r11f_attribute_info_t *code_attr =
+        r11f_method_find_attribute(v->clazz, method_info, "Code");
+    if (!code_attr) {
+        return R11F_success;
+    }
+
+    r11f_constant_utf8_info_t *name_info =
+        cp_entry(v->clazz, method_info->name_index, R11F_CONSTANT_Utf8);
+    r11f_constant_utf8_info_t *desc_info =
+        cp_entry(v->clazz, method_info->descriptor_index, R11F_CONSTANT_Utf8);
+    CHKVERIFY(name_info && desc_info)
+    v->descriptor = (char const*)desc_info->bytes;
+    v->descriptor_len = desc_info->length;
+    v->is_init = utf8_equals(name_info, "<init>");
+    CHKVERIFY(class_name_at(v->clazz,
+                            v->clazz->this_class,
+                            &v->this_type.name,
+                            &v->this_type.name_len))
+    v->this_type.kind = VT_OBJECT;
+
+    uint8_t *stack_map;
+    uint32_t stack_map_length;
+    r11f_error_t err = read_code(v, code_attr, &stack_map, &stack_map_length);
+    if (err != R11F_success) {
+        return err;
+    }
+
+    v->starts = r11f_alloc_zeroed(v->code_length);
+    if (!v->starts) {
+        return R11F_ERR_out_of_memory;
+    }
+    CHKVERIFY(mark_starts(v))
+
+    uint32_t frame_count = 0;
+    if (stack_map) {
+        CHKVERIFY(stack_map_length >= 2)
+        frame_count = read_unaligned_be2(stack_map);
+        /* at least a byte each, at distinct pcs */
+        CHKVERIFY(frame_count <= stack_map_length - 2
+                  && frame_count <= v->code_length)
+    }
+
+    /* cur first, then one frame per StackMapTable entry */
+    uint32_t frame_slots = (uint32_t)v->max_locals + v->max_stack;
+    vtype_t *types = r11f_alloc(
+        sizeof(vtype_t) * ((frame_count + 1) * frame_slots + 1)
+    );
+    v->cur.locals = types;
+    if (!types) {
+        return R11F_ERR_out_of_memory;
+    }
+    v->cur.stack = types + v->max_locals;
+
+    uint16_t nlocals;
+    CHKVERIFY(init_frame(v, method_info, &v->cur, &nlocals))
+    if (frame_count) {
+        v->frames = r11f_alloc(sizeof(vframe_t) * frame_count);
+        if (!v->frames) {
+            return R11F_ERR_out_of_memory;
+        }
+        err = read_stack_map(v,
+                             stack_map + 2,
+                             stack_map_length - 2,
+                             frame_count,
+                             nlocals,
+                             types + frame_slots);
+        if (err != R11F_success) {
+            return err;
+        }
+    }
+    CHKVERIFY(check_handlers(v))
+
+    return verify_code(v);
+}
+
+/* finds the code and the StackMapTable in the Code attribute, whose own
+   attributes are still big-endian (clsfile.c) */
+static r11f_error_t read_code(verifier_t *v,
+                              r11f_attribute_info_t *code_attr,
+                              uint8_t **out_stack_map,
+                              uint32_t *out_stack_map_length) {
+    uint8_t *info = code_attr->info;
+    uint32_t length = code_attr->attribute_length;
+    CHKVERIFY(length >= 12)
+    v->max_stack = read_unaligned2(info);
+    v->max_locals = read_unaligned2(info + 2);
+    v->code_length = read_unaligned4(info + 4);
+    v->code = info + 8;
+    CHKVERIFY(v->code_length > 0
+              && v->code_length < 65536
+              && v->code_length <= length - 12)
+
+    uint32_t offset = 8 + v->code_length;
+    uint16_t exception_table_length = read_unaligned2(info + offset);
+    v->handlers = info + offset + 2;
+    v->handler_count = exception_table_length;
+    offset += 2 + 8 * (uint32_t)exception_table_length;
+    CHKVERIFY(offset + 2 <= length)
+
+    *out_stack_map = NULL;
+    *out_stack_map_length = 0;
+    uint16_t attributes_count = read_unaligned_be2(info + offset);
+    offset += 2;
+    for (uint16_t i = 0; i < attributes_count; i++) {
+        CHKVERIFY(length - offset >= 6)
+        uint16_t name_index = read_unaligned_be2(info + offset);
+        uint32_t attr_length = read_unaligned_be4(info + offset + 2);
+        offset += 6;
+        CHKVERIFY(attr_length <= length - offset)
+
+        r11f_constant_utf8_info_t *name_info =
+            cp_entry(v->clazz, name_index, R11F_CONSTANT_Utf8);
+        CHKVERIFY(name_info)
+        if (utf8_equals(name_info, "StackMapTable")) {
+            CHKVERIFY(!*out_stack_map)
+            *out_stack_map = info + offset;
+            *out_stack_map_length = attr_length;
+        }
+        offset += attr_length;
+    }
+    return R11F_success;
+}
+
+static bool mark_starts(verifier_t *v) {
+    uint32_t pc = 0;
+    while (pc < v->code_length) {
+        v->starts[pc] = 1;
+
+        uint8_t insc = v->code[pc];
+        uint32_t insn_length;
+        if (insc == R11F_tableswitch || insc == R11F_lookupswitch) {
+            /* the header must be there before its counts are read */
+            uint32_t operands = (pc + 4) & ~(uint32_t)3;
+            if (operands + 12 > v->code_length) {
+                return false;
+            }
+            if (insc == R11F_tableswitch) {
+                int32_t low = (int32_t)read_unaligned_be4(
+                    v->code + operands + 4
+                );
+                int32_t high = (int32_t)read_unaligned_be4(
+                    v->code + operands + 8
+                );
+                if (low > high || (int64_t)high - low >= 65536) {
+                    return false;
+                }
+            } else if (read_unaligned_be4(v->code + operands + 4)
+                       >= 65536) {
+                return false;
+            }
+        } else if (insc == R11F_wide && pc + 1 >= v->code_length) {
+            return false;
+        }
+        insn_length = r11f_bytecode_length(v->code, v->code_length, pc);
+
+        if (insn_length > v->code_length - pc) {
+            return false;
+        }
+        pc += insn_length;
+    }
+    return true;
+}
+
+/* the frame at pc 0: the receiver and the arguments, top elsewhere */
+static bool init_frame(verifier_t *v,
+                       r11f_method_info_t *method_info,
+                       vframe_t *frame,
+                       uint16_t *out_nlocals) {
+    for (uint16_t i = 0; i < v->max_locals; i++) {
+        frame->locals[i] = vt_top;
+    }
+    frame->pc = 0;
+    frame->sp = 0;
+
+    uint16_t nlocals = 0;
+    if (!(method_info->access_flags & R11F_ACC_STATIC)) {
+        vtype_t this_type = v->this_type;
+        if (v->is_init) {
+            this_type = (vtype_t) { .kind = VT_UNINIT_THIS };
+        }
+        if (!append_local(v, frame, &nlocals, this_type)) {
+            return false;
+        }
+    }
+
+    char const *p = v->descriptor;
+    char const *end = v->descriptor + v->descriptor_len;
+    if (p == end || *p != '(') {
+        return false;
+    }
+    p++;
+    while (p < end && *p != ')') {
+        vtype_t type;
+        if (!parse_type(&p, end, &type)
+            || !append_local(v, frame, &nlocals, type)) {
+            return false;
+        }
+    }
+    if (p == end) {
+        return false;
+    }
+
+    /* the return type is checked by the return instructions */
+    p++;
+    if (p < end && *p == 'V') {
+        p++;
+    } else {
+        vtype_t type;
+        if (!parse_type(&p, end, &type)) {
+            return false;
+        }
+    }
+    *out_nlocals = nlocals;
+    return p == end && (!v->is_init || end[-1] == 'V');
+}
+
+static r11f_error_t read_stack_map(verifier_t *v,
+                                   uint8_t *data,
+                                   uint32_t length,
+                                   uint32_t count,
+                                   uint16_t nlocals,
+                                   vtype_t *types) {
+    uint8_t *p = data;
+    uint8_t *end = data + length;
+
+    /* frames are deltas of the one before, the first of the frame of the
+       method entry */
+    vframe_t prev = v->cur;
+
+    uint32_t frame_slots = (uint32_t)v->max_locals + v->max_stack;
+    for (uint32_t i = 0; i < count; i++) {
+        vframe_t *frame = &v->frames[i];
+        frame->locals = types + i * frame_slots;
+        frame->stack = frame->locals + v->max_locals;
+        memcpy(frame->locals, prev.locals, sizeof(vtype_t) * v->max_locals);
+        frame->sp = 0;
+
+        CHKVERIFY(p < end)
+        uint8_t frame_type = *p++;
+        uint32_t delta;
+        if (frame_type < 64) {
+            delta = frame_type;
+        } else if (frame_type < 128) {
+            delta = frame_type - 64;
+            vtype_t type;
+            CHKVERIFY(read_vtype(v, &p, end, &type))
+            CHKVERIFY(is_wide(&type) ? v->max_stack >= 2 : v->max_stack >= 1)
+            frame->stack[frame->sp++] = type;
+            if (is_wide(&type)) {
+                frame->stack[frame->sp++] = vt_half;
+            }
+        } else {
+            CHKVERIFY(frame_type >= 247 && end - p >= 2)
+            delta = read_unaligned_be2(p);
+            p += 2;
+            if (frame_type == 247) {
+                vtype_t type;
+                CHKVERIFY(read_vtype(v, &p, end, &type))
+                CHKVERIFY(is_wide(&type) ?
+                          v->max_stack >= 2 :
+                          v->max_stack >= 1)
+                frame->stack[frame->sp++] = type;
+                if (is_wide(&type)) {
+                    frame->stack[frame->sp++] = vt_half;
+                }
+            } else if (frame_type < 251) {
+                /* chop, a long or double goes with its second slot */
+                for (uint8_t k = 251 - frame_type; k > 0; k--) {
+                    CHKVERIFY(nlocals > 0)
+                    nlocals--;
+                    if (frame->locals[nlocals].kind == VT_HALF) {
+                        frame->locals[nlocals] = vt_top;
+                        CHKVERIFY(nlocals > 0)
+                        nlocals--;
+                    }
+                    frame->locals[nlocals] = vt_top;
+                }
+            } else if (frame_type < 255) {
+                /* append */
+                for (uint8_t k = frame_type - 251; k > 0; k--) {
+                    vtype_t type;
+                    CHKVERIFY(read_vtype(v, &p, end, &type))
+                    CHKVERIFY(append_local(v, frame, &nlocals, type))
+                }
+            } else {
+                /* full_frame */
+                for (uint16_t k = 0; k < v->max_locals; k++) {
+                    frame->locals[k] = vt_top;
+                }
+                nlocals = 0;
+                CHKVERIFY(end - p >= 2)
+                uint16_t count = read_unaligned_be2(p);
+                p += 2;
+                for (uint16_t k = 0; k < count; k++) {
+                    vtype_t type;
+                    CHKVERIFY(read_vtype(v, &p, end, &type))
+                    CHKVERIFY(append_local(v, frame, &nlocals, type))
+                }
+                CHKVERIFY(end - p >= 2)
+                count = read_unaligned_be2(p);
+                p += 2;
+                for (uint16_t k = 0; k < count; k++) {
+                    vtype_t type;
+                    CHKVERIFY(read_vtype(v, &p, end, &type))
+                    uint16_t words = is_wide(&type) ? 2 : 1;
+                    CHKVERIFY(frame->sp + words <= v->max_stack)
+                    frame->stack[frame->sp++] = type;
+                    if (words == 2) {
+                        frame->stack[frame->sp++] = vt_half;
+                    }
+                }
+            }
+        }
+
+        frame->pc = i == 0 ? delta : prev.pc + delta + 1;
+        CHKVERIFY(frame->pc < v->code_length && v->starts[frame->pc])
+        v->frame_count = i + 1;
+        prev = *frame;
+    }
+
+    CHKVERIFY(p == end)
+    return R11F_success;
+}
+
+static bool read_vtype(verifier_t *v,
+                       uint8_t **p,
+                       uint8_t *end,
+                       vtype_t *out) {
+    if (*p >= end) {
+        return false;
+    }
+    uint8_t tag = *(*p)++;
+    switch (tag) {
+        case 0:
+            *out = vt_top;
+            return true;
+        case 1:
+            *out = vt_int;
+            return true;
+        case 2:
+            *out = (vtype_t) { .kind = VT_FLOAT };
+            return true;
+        case 3:
+            *out = (vtype_t) { .kind = VT_DOUBLE };
+            return true;
+        case 4:
+            *out = vt_long;
+            return true;
+        case 5:
+            *out = vt_null;
+            return true;
+        case 6:
+            *out = (vtype_t) { .kind = VT_UNINIT_THIS };
+            return true;
+        case 7:
+        case 8: {
+            if (end - *p < 2) {
+                return false;
+            }
+            uint16_t operand = read_unaligned_be2(*p);
+            *p += 2;
+            if (tag == 8) {
+                *out = (vtype_t) { .kind = VT_UNINIT, .pc = operand };
+                return operand < v->code_length
+                       && v->starts[operand]
+                       && v->code[operand] == R11F_new;
+            }
+            *out = (vtype_t) { .kind = VT_OBJECT };
+            return class_name_at(v->clazz, operand, &out->name, &out->name_len);
+        }
+        default:
+            return false;
+    }
+}
+
+static bool append_local(verifier_t *v,
+                         vframe_t *frame,
+                         uint16_t *nlocals,
+                         vtype_t type) {
+    uint16_t words = is_wide(&type) ? 2 : 1;
+    if ((uint32_t)*nlocals + words > v->max_locals) {
+        return false;
+    }
+    frame->locals[(*nlocals)++] = type;
+    if (words == 2) {
+        frame->locals[(*nlocals)++] = vt_half;
+    }
+    return true;
+}
+
+/* one pass in code order; the frame after an instruction that does not
+   fall through comes from the StackMapTable */
+/* ranges on instruction boundaries, and handlers starting with a frame
+   that holds just the exception */
+static bool check_handlers(verifier_t *v) {
+    for (uint16_t i = 0; i < v->handler_count; i++) {
+        uint8_t *entry = v->handlers + 8 * (uint32_t)i;
+        uint16_t start_pc = read_unaligned2(entry);
+        uint16_t end_pc = read_unaligned2(entry + 2);
+        uint16_t handler_pc = read_unaligned2(entry + 4);
+        uint16_t catch_type = read_unaligned2(entry + 6);
+        if (start_pc >= end_pc
+            || end_pc > v->code_length
+            || !v->starts[start_pc]
+            || (end_pc < v->code_length && !v->starts[end_pc])
+            || handler_pc >= v->code_length) {
+            return false;
+        }
+
+        if (catch_type) {
+            char const *name;
+            uint16_t name_len;
+            if (!class_name_at(v->clazz, catch_type, &name, &name_len)
+                || name[0] == '[') {
+                return false;
+            }
+        }
+        vframe_t *frame = find_frame(v, handler_pc);
+        if (!frame
+            || frame->sp != 1
+            || frame->stack[0].kind != VT_OBJECT
+            || frame->stack[0].name[0] == '[') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static r11f_error_t verify_code(verifier_t *v) {
+    uint32_t next_frame = 0;
+    bool reachable = true;
+    for (v->pc = 0;
+         v->pc < v->code_length;
+         v->pc += r11f_bytecode_length(v->code, v->code_length, v->pc)) {
+        if (next_frame < v->frame_count
+            && v->frames[next_frame].pc == v->pc) {
+            CHKVERIFY(!reachable || frame_assignable(v, &v->frames[next_frame]))
+            copy_frame(v, &v->cur, &v->frames[next_frame]);
+            next_frame++;
+            reachable = true;
+        }
+        CHKVERIFY(reachable)
+        CHKVERIFY(!v->handler_count || handlers_assignable(v))
+
+        r11f_error_t err = verify_insn(v, &reachable);
+        if (err != R11F_success) {
+            return err;
+        }
+    }
+
+    /* running off the end of the code */
+    CHKVERIFY(!reachable)
+    return R11F_success;
+}
+
+static r11f_error_t verify_insn(verifier_t *v, bool *out_falls_through) {
+    uint8_t *code = v->code;
+    uint32_t pc = v->pc;
+    uint8_t insc = code[pc];
+    vtype_t *locals = v->cur.locals;
+    *out_falls_through = true;
+
+    switch (insc) {
+        case R11F_nop:
+            return R11F_success;
+
+        case R11F_aconst_null:
+            CHKVERIFY(push(v, vt_null))
+            return R11F_success;
+        case R11F_iconst_m1:
+        case R11F_iconst_0:
+        case R11F_iconst_1:
+        case R11F_iconst_2:
+        case R11F_iconst_3:
+        case R11F_iconst_4:
+        case R11F_iconst_5:
+        case R11F_bipush:
+        case R11F_sipush:
+            CHKVERIFY(push(v, vt_int))
+            return R11F_success;
+        case R11F_lconst_0:
+        case R11F_lconst_1:
+            CHKVERIFY(push(v, vt_long))
+            return R11F_success;
+        case R11F_ldc:
+        case R11F_ldc_w: {
+            uint16_t index = insc == R11F_ldc ?
+                code[pc + 1] :
+                read_unaligned_be2(code + pc + 1);
+            r11f_cpinfo_t *cpinfo = cp_entry(v->clazz, index, 0);
+            CHKVERIFY(cpinfo)
+            if (cpinfo->tag == R11F_CONSTANT_Float
+                || cpinfo->tag == R11F_CONSTANT_String
+                || cpinfo->tag == R11F_CONSTANT_Class) {
+                return R11F_ERR_not_implemented_instruction;
+            }
+            CHKVERIFY(cpinfo->tag == R11F_CONSTANT_Integer)
+            CHKVERIFY(push(v, vt_int))
+            return R11F_success;
+        }
+        case R11F_ldc2_w: {
+            r11f_cpinfo_t *cpinfo =
+                cp_entry(v->clazz, read_unaligned_be2(code + pc + 1), 0);
+            CHKVERIFY(cpinfo)
+            if (cpinfo->tag == R11F_CONSTANT_Double) {
+                return R11F_ERR_not_implemented_instruction;
+            }
+            CHKVERIFY(cpinfo->tag == R11F_CONSTANT_Long)
+            CHKVERIFY(push(v, vt_long))
+            return R11F_success;
+        }
+
+        case R11F_iload_0:
+        case R11F_iload_1:
+        case R11F_iload_2:
+        case R11F_iload_3:
+            CHKVERIFY(load(v, insc - R11F_iload_0, vt_int))
+            return R11F_success;
+        case R11F_lload_0:
+        case R11F_lload_1:
+        case R11F_lload_2:
+        case R11F_lload_3:
+            CHKVERIFY(load(v, insc - R11F_lload_0, vt_long))
+            return R11F_success;
+        case R11F_aload_0:
+        case R11F_aload_1:
+        case R11F_aload_2:
+        case R11F_aload_3:
+        case R11F_aload: {
+            uint32_t index = insc == R11F_aload ?
+                code[pc + 1] :
+                (uint32_t)insc - R11F_aload_0;
+            CHKVERIFY(index < v->max_locals && is_reference(&locals[index]))
+            CHKVERIFY(push(v, locals[index]))
+            return R11F_success;
+        }
+        case R11F_iload:
+            CHKVERIFY(load(v, code[pc + 1], vt_int))
+            return R11F_success;
+        case R11F_lload:
+            CHKVERIFY(load(v, code[pc + 1], vt_long))
+            return R11F_success;
+
+        case R11F_istore_0:
+        case R11F_istore_1:
+        case R11F_istore_2:
+        case R11F_istore_3:
+            CHKVERIFY(pop(v, vt_int) && store(v, insc - R11F_istore_0, vt_int))
+            return R11F_success;
+        case R11F_lstore_0:
+        case R11F_lstore_1:
+        case R11F_lstore_2:
+        case R11F_lstore_3:
+            CHKVERIFY(pop(v, vt_long)
+                      && store(v, insc - R11F_lstore_0, vt_long))
+            return R11F_success;
+        case R11F_astore_0:
+        case R11F_astore_1:
+        case R11F_astore_2:
+        case R11F_astore_3:
+        case R11F_astore: {
+            uint32_t index = insc == R11F_astore ?
+                code[pc + 1] :
+                (uint32_t)insc - R11F_astore_0;
+            vtype_t type;
+            CHKVERIFY(pop_reference(v, &type) && store(v, index, type))
+            return R11F_success;
+        }
+        case R11F_istore:
+            CHKVERIFY(pop(v, vt_int) && store(v, code[pc + 1], vt_int))
+            return R11F_success;
+        case R11F_lstore:
+            CHKVERIFY(pop(v, vt_long) && store(v, code[pc + 1], vt_long))
+            return R11F_success;
+        case R11F_iinc: {
+            uint8_t index = code[pc + 1];
+            CHKVERIFY(index < v->max_locals && locals[index].kind == VT_INT)
+            return R11F_success;
+        }
+
+        /* category 1 only, the interpreters keep a long in one slot */
+        case R11F_pop:
+            CHKVERIFY(v->cur.sp >= 1
+                      && v->cur.stack[v->cur.sp - 1].kind != VT_HALF)
+            v->cur.sp--;
+            return R11F_success;
+        case R11F_dup:
+            CHKVERIFY(v->cur.sp >= 1
+                      && v->cur.stack[v->cur.sp - 1].kind != VT_HALF)
+            CHKVERIFY(push(v, v->cur.stack[v->cur.sp - 1]))
+            return R11F_success;
+
+        case R11F_iadd:
+        case R11F_isub:
+        case R11F_imul:
+        case R11F_idiv:
+        case R11F_irem:
+        case R11F_ishl:
+        case R11F_ishr:
+        case R11F_iushr:
+        case R11F_iand:
+        case R11F_ior:
+        case R11F_ixor:
+            CHKVERIFY(pop(v, vt_int) && pop(v, vt_int) && push(v, vt_int))
+            return R11F_success;
+        case R11F_ladd:
+        case R11F_lsub:
+        case R11F_lmul:
+        case R11F_ldiv:
+        case R11F_lrem:
+        case R11F_land:
+        case R11F_lor:
+        case R11F_lxor:
+            CHKVERIFY(pop(v, vt_long) && pop(v, vt_long) && push(v, vt_long))
+            return R11F_success;
+        case R11F_lshl:
+        case R11F_lshr:
+        case R11F_lushr:
+            CHKVERIFY(pop(v, vt_int) && pop(v, vt_long) && push(v, vt_long))
+            return R11F_success;
+        case R11F_lcmp:
+            CHKVERIFY(pop(v, vt_long) && pop(v, vt_long) && push(v, vt_int))
+            return R11F_success;
+        case R11F_ineg:
+        case R11F_i2b:
+        case R11F_i2c:
+        case R11F_i2s:
+            CHKVERIFY(pop(v, vt_int) && push(v, vt_int))
+            return R11F_success;
+        case R11F_lneg:
+            CHKVERIFY(pop(v, vt_long) && push(v, vt_long))
+            return R11F_success;
+        case R11F_i2l:
+            CHKVERIFY(pop(v, vt_int) && push(v, vt_long))
+            return R11F_success;
+        case R11F_l2i:
+            CHKVERIFY(pop(v, vt_long) && push(v, vt_int))
+            return R11F_success;
+
+        case R11F_ifeq:
+        case R11F_ifne:
+        case R11F_iflt:
+        case R11F_ifge:
+        case R11F_ifgt:
+        case R11F_ifle:
+            CHKVERIFY(pop(v, vt_int))
+            CHKVERIFY(branch(v, (int16_t)read_unaligned_be2(code + pc + 1)))
+            return R11F_success;
+        case R11F_if_icmpeq:
+        case R11F_if_icmpne:
+        case R11F_if_icmplt:
+        case R11F_if_icmpge:
+        case R11F_if_icmpgt:
+        case R11F_if_icmple:
+            CHKVERIFY(pop(v, vt_int) && pop(v, vt_int))
+            CHKVERIFY(branch(v, (int16_t)read_unaligned_be2(code + pc + 1)))
+            return R11F_success;
+        case R11F_goto:
+            CHKVERIFY(branch(v, (int16_t)read_unaligned_be2(code + pc + 1)))
+            *out_falls_through = false;
+            return R11F_success;
+        case R11F_tableswitch:
+        case R11F_lookupswitch:
+            *out_falls_through = false;
+            return verify_switch(v, insc);
+
+        case R11F_ireturn:
+        case R11F_lreturn:
+        case R11F_areturn:
+        case R11F_return: {
+            char const *ret = memchr(v->descriptor, ')', v->descriptor_len);
+            char const *end = v->descriptor + v->descriptor_len;
+            ret++;
+            if (insc == R11F_return) {
+                CHKVERIFY(*ret == 'V')
+                if (v->is_init) {
+                    /* the superclass constructor has been called */
+                    for (uint16_t i = 0; i < v->max_locals; i++) {
+                        CHKVERIFY(locals[i].kind != VT_UNINIT_THIS)
+                    }
+                }
+            } else {
+                vtype_t type;
+                CHKVERIFY(*ret != 'V' && parse_type(&ret, end, &type))
+                CHKVERIFY(insc != R11F_ireturn || type.kind == VT_INT)
+                CHKVERIFY(insc != R11F_lreturn || type.kind == VT_LONG)
+                CHKVERIFY(insc != R11F_areturn || type.kind == VT_OBJECT)
+                CHKVERIFY(pop(v, type))
+            }
+            *out_falls_through = false;
+            return R11F_success;
+        }
+
+        case R11F_athrow: {
+            vtype_t exception;
+            CHKVERIFY(pop_reference(v, &exception))
+            CHKVERIFY(exception.kind == VT_NULL
+                      || (exception.kind == VT_OBJECT
+                          && exception.name[0] != '['))
+            *out_falls_through = false;
+            return R11F_success;
+        }
+
+        case R11F_invokestatic:
+        case R11F_invokespecial:
+        case R11F_invokevirtual:
+            return verify_invoke(v, insc);
+
+        case R11F_new: {
+            char const *name;
+            uint16_t name_len;
+            CHKVERIFY(class_name_at(v->clazz,
+                                    read_unaligned_be2(code + pc + 1),
+                                    &name,
+                                    &name_len))
+            CHKVERIFY(name[0] != '[')
+            CHKVERIFY(push(v, (vtype_t) { .kind = VT_UNINIT, .pc = pc }))
+            return R11F_success;
+        }
+        case R11F_newarray:
+            /* T_INT */
+            if (code[pc + 1] != 10) {
+                return R11F_ERR_not_implemented_instruction;
+            }
+            CHKVERIFY(pop(v, vt_int) && push(v, vt_int_array))
+            return R11F_success;
+        case R11F_arraylength: {
+            vtype_t array;
+            CHKVERIFY(pop_reference(v, &array))
+            CHKVERIFY(array.kind == VT_NULL
+                      || (array.kind == VT_OBJECT && array.name[0] == '['))
+            CHKVERIFY(push(v, vt_int))
+            return R11F_success;
+        }
+        case R11F_iaload:
+            CHKVERIFY(pop(v, vt_int) && pop(v, vt_int_array))
+            CHKVERIFY(push(v, vt_int))
+            return R11F_success;
+        case R11F_iastore:
+            CHKVERIFY(pop(v, vt_int)
+                      && pop(v, vt_int)
+                      && pop(v, vt_int_array))
+            return R11F_success;
+
+        default:
+            return R11F_ERR_not_implemented_instruction;
+    }
+}
+
+static r11f_error_t verify_invoke(verifier_t *v, uint8_t insc) {
+    r11f_cpinfo_t *cpinfo =
+        cp_entry(v->clazz, read_unaligned_be2(v->code + v->pc + 1), 0);
+    CHKVERIFY(cpinfo)
+    CHKVERIFY(cpinfo->tag == R11F_CONSTANT_Methodref
+              || (insc != R11F_invokevirtual
+                  && cpinfo->tag == R11F_CONSTANT_InterfaceMethodref))
+    r11f_constant_methodref_info_t *methodref_info =
+        (r11f_constant_methodref_info_t*)cpinfo;
+
+    char const *class_name;
+    uint16_t class_name_len;
+    CHKVERIFY(class_name_at(v->clazz,
+                            methodref_info->class_index,
+                            &class_name,
+                            &class_name_len))
+    r11f_constant_name_and_type_info_t *name_and_type_info =
+        cp_entry(v->clazz,
+                 methodref_info->name_and_type_index,
+                 R11F_CONSTANT_NameAndType);
+    CHKVERIFY(name_and_type_info)
+    r11f_constant_utf8_info_t *name_info =
+        cp_entry(v->clazz, name_and_type_info->name_index, R11F_CONSTANT_Utf8);
+    r11f_constant_utf8_info_t *desc_info =
+        cp_entry(v->clazz,
+                 name_and_type_info->descriptor_index,
+                 R11F_CONSTANT_Utf8);
+    CHKVERIFY(name_info && desc_info && name_info->length > 0)
+
+    /* the VM has no methods on arrays */
+    if (class_name[0] == '[') {
+        return R11F_ERR_not_implemented_instruction;
+    }
+    bool init = utf8_equals(name_info, "<init>");
+    CHKVERIFY(name_info->bytes[0] != '<'
+              || (init && insc == R11F_invokespecial))
+
+    char const *desc = (char const*)desc_info->bytes;
+    char const *end = desc + desc_info->length;
+    CHKVERIFY(desc < end && *desc == '(')
+    char const *p = desc + 1;
+    uint32_t words = 0;
+    while (p < end && *p != ')') {
+        vtype_t type;
+        CHKVERIFY(parse_type(&p, end, &type))
+        words += is_wide(&type) ? 2 : 1;
+    }
+    CHKVERIFY(p < end && words <= v->cur.sp)
+    char const *ret = p + 1;
+
+    /* the arguments, first one deepest */
+    uint16_t slot = v->cur.sp - words;
+    p = desc + 1;
+    while (*p != ')') {
+        vtype_t type;
+        parse_type(&p, end, &type);
+        CHKVERIFY(assignable(&v->cur.stack[slot], &type))
+        if (is_wide(&type)) {
+            CHKVERIFY(v->cur.stack[slot + 1].kind == VT_HALF)
+        }
+        slot += is_wide(&type) ? 2 : 1;
+    }
+    v->cur.sp -= words;
+
+    if (insc != R11F_invokestatic) {
+        vtype_t receiver;
+        CHKVERIFY(pop_reference(v, &receiver))
+        if (init) {
+            if (receiver.kind == VT_UNINIT_THIS) {
+                initialize(v, &receiver, v->this_type);
+            } else {
+                CHKVERIFY(receiver.kind == VT_UNINIT)
+                vtype_t type = { .kind = VT_OBJECT };
+                class_name_at(v->clazz,
+                              read_unaligned_be2(v->code + receiver.pc + 1),
+                              &type.name,
+                              &type.name_len);
+                CHKVERIFY(type.name_len == class_name_len
+                          && !memcmp(type.name, class_name, class_name_len))
+                initialize(v, &receiver, type);
+            }
+        } else {
+            CHKVERIFY(receiver.kind == VT_NULL || receiver.kind == VT_OBJECT)
+            if (receiver.kind == VT_OBJECT && receiver.name[0] == '[') {
+                return R11F_ERR_not_implemented_instruction;
+            }
+        }
+    }
+
+    if (ret < end && *ret == 'V') {
+        CHKVERIFY(ret + 1 == end)
+        return R11F_success;
+    }
+    vtype_t type;
+    CHKVERIFY(!init && parse_type(&ret, end, &type) && ret == end)
+    CHKVERIFY(push(v, type))
+    return R11F_success;
+}
+
+static r11f_error_t verify_switch(verifier_t *v, uint8_t insc) {
+    CHKVERIFY(pop(v, vt_int))
+
+    /* mark_starts made sure the operands are within the code */
+    uint8_t *operands = v->code + ((v->pc + 4) & ~(uint32_t)3);
+    CHKVERIFY(branch(v, (int32_t)read_unaligned_be4(operands)))
+    if (insc == R11F_tableswitch) {
+        int32_t low = (int32_t)read_unaligned_be4(operands + 4);
+        int32_t high = (int32_t)read_unaligned_be4(operands + 8);
+        uint32_t count = (uint32_t)((int64_t)high - low + 1);
+        for (uint32_t i = 0; i < count; i++) {
+            CHKVERIFY(branch(v,
+                             (int32_t)read_unaligned_be4(operands + 12 + 4 * i)))
+        }
+    } else {
+        uint32_t npairs = read_unaligned_be4(operands + 4);
+        for (uint32_t i = 0; i < npairs; i++) {
+            uint8_t *pair = operands + 8 + 8 * i;
+            CHKVERIFY(i == 0
+                      || (int32_t)read_unaligned_be4(pair)
+                         > (int32_t)read_unaligned_be4(pair - 8))
+            CHKVERIFY(branch(v, (int32_t)read_unaligned_be4(pair + 4)))
+        }
+    }
+    return R11F_success;
+}
+
+/* the target must start an instruction and have a frame the current one
+   is assignable to */
+static bool branch(verifier_t *v, int32_t offset) {
+    int64_t target = (int64_t)v->pc + offset;
+    if (target < 0 || target >= v->code_length) {
+        return false;
+    }
+    vframe_t *frame = find_frame(v, (uint32_t)target);
+    return frame && frame_assignable(v, frame);
+}
+
+static vframe_t *find_frame(verifier_t *v, uint32_t pc) {
+    uint32_t lo = 0;
+    uint32_t hi = v->frame_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (v->frames[mid].pc < pc) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < v->frame_count && v->frames[lo].pc == pc ?
+        &v->frames[lo] :
+        NULL;
+}
+
+static bool frame_assignable(verifier_t *v, vframe_t const *frame) {
+    if (v->cur.sp != frame->sp) {
+        return false;
+    }
+    for (uint16_t i = 0; i < frame->sp; i++) {
+        if (!assignable(&v->cur.stack[i], &frame->stack[i])) {
+            return false;
+        }
+    }
+    for (uint16_t i = 0; i < v->max_locals; i++) {
+        if (!assignable(&v->cur.locals[i], &frame->locals[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* a handler covering the current instruction takes over its locals,
+   the stack is replaced by the exception */
+static bool handlers_assignable(verifier_t *v) {
+    for (uint16_t i = 0; i < v->handler_count; i++) {
+        uint8_t *entry = v->handlers + 8 * (uint32_t)i;
+        if (v->pc < read_unaligned2(entry)
+            || v->pc >= read_unaligned2(entry + 2)) {
+            continue;
+        }
+        /* found by check_handlers */
+        vframe_t *frame = find_frame(v, read_unaligned2(entry + 4));
+        for (uint16_t j = 0; j < v->max_locals; j++) {
+            if (!assignable(&v->cur.locals[j], &frame->locals[j])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void copy_frame(verifier_t *v, vframe_t *dst, vframe_t const *src) {
+    memcpy(dst->locals, src->locals, sizeof(vtype_t) * v->max_locals);
+    memcpy(dst->stack, src->stack, sizeof(vtype_t) * src->sp);
+    dst->sp = src->sp;
+}
+
+static bool push(verifier_t *v, vtype_t type) {
+    uint16_t words = is_wide(&type) ? 2 : 1;
+    if ((uint32_t)v->cur.sp + words > v->max_stack) {
+        return false;
+    }
+    v->cur.stack[v->cur.sp++] = type;
+    if (words == 2) {
+        v->cur.stack[v->cur.sp++] = vt_half;
+    }
+    return true;
+}
+
+/* pops a value assignable to `type` */
+static bool pop(verifier_t *v, vtype_t type) {
+    if (is_wide(&type)) {
+        if (v->cur.sp < 2 || v->cur.stack[v->cur.sp - 1].kind != VT_HALF) {
+            return false;
+        }
+        v->cur.sp--;
+    } else if (v->cur.sp < 1) {
+        return false;
+    }
+    v->cur.sp--;
+    return assignable(&v->cur.stack[v->cur.sp], &type);
+}
+
+static bool pop_reference(verifier_t *v, vtype_t *out) {
+    if (v->cur.sp < 1 || !is_reference(&v->cur.stack[v->cur.sp - 1])) {
+        return false;
+    }
+    *out = v->cur.stack[--v->cur.sp];
+    return true;
+}
+
+static bool load(verifier_t *v, uint32_t index, vtype_t type) {
+    uint32_t words = is_wide(&type) ? 2 : 1;
+    if (index + words > v->max_locals
+        || v->cur.locals[index].kind != type.kind
+        || (words == 2 && v->cur.locals[index + 1].kind != VT_HALF)) {
+        return false;
+    }
+    return push(v, type);
+}
+
+static bool store(verifier_t *v, uint32_t index, vtype_t type) {
+    uint32_t words = is_wide(&type) ? 2 : 1;
+    if (index + words > v->max_locals) {
+        return false;
+    }
+    /* overwriting the second slot of a long ruins the long */
+    if (index > 0 && is_wide(&v->cur.locals[index - 1])) {
+        v->cur.locals[index - 1] = vt_top;
+    }
+    v->cur.locals[index] = type;
+    if (words == 2) {
+        v->cur.locals[index + 1] = vt_half;
+    }
+    return true;
+}
+
+/* a constructor call initializes every copy of the object */
+static void initialize(verifier_t *v, vtype_t const *uninit, vtype_t type) {
+    for (uint32_t i = 0; i < (uint32_t)v->max_locals + v->cur.sp; i++) {
+        vtype_t *slot = i < v->max_locals ?
+            &v->cur.locals[i] :
+            &v->cur.stack[i - v->max_locals];
+        if (slot->kind == uninit->kind
+            && (uninit->kind != VT_UNINIT || slot->pc == uninit->pc)) {
+            *slot = type;
+        }
+    }
+}
+
+static bool assignable(vtype_t const *from, vtype_t const *to) {
+    switch (to->kind) {
+        case VT_TOP:
+            return true;
+        case VT_UNINIT:
+            return from->kind == VT_UNINIT && from->pc == to->pc;
+        case VT_OBJECT:
+            if (from->kind == VT_NULL) {
+                return true;
+            }
+            if (from->kind != VT_OBJECT) {
+                return false;
+            }
+            if (to->name[0] == '[') {
+                return from->name_len == to->name_len
+                       && !memcmp(from->name, to->name, to->name_len);
+            }
+            if (from->name[0] == '[') {
+                return (to->name_len == 16
+                        && !memcmp(to->name, "java/lang/Object", 16))
+                       || (to->name_len == 19
+                           && !memcmp(to->name, "java/lang/Cloneable", 19))
+                       || (to->name_len == 20
+                           && !memcmp(to->name, "java/io/Serializable", 20));
+            }
+            /* see verify.h */
+            return true;
+        default:
+            return from->kind == to->kind;
+    }
+}
+
+static bool is_wide(vtype_t const *type) {
+    return type->kind == VT_LONG || type->kind == VT_DOUBLE;
+}
+
+static bool is_reference(vtype_t const *type) {
+    return type->kind >= VT_NULL;
+}
+
+/* the field type at `*p`, which moves past it */
+static bool parse_type(char const **p, char const *end, vtype_t *out) {
+    char const *start = *p;
+    if (start >= end) {
+        return false;
+    }
+    switch (*start) {
+        case 'B':
+        case 'C':
+        case 'I':
+        case 'S':
+        case 'Z':
+            *out = vt_int;
+            break;
+        case 'F':
+            *out = (vtype_t) { .kind = VT_FLOAT };
+            break;
+        case 'J':
+            *out = vt_long;
+            break;
+        case 'D':
+            *out = (vtype_t) { .kind = VT_DOUBLE };
+            break;
+        case 'L': {
+            char const *semicolon = memchr(start, ';', end - start);
+            if (!semicolon || semicolon == start + 1) {
+                return false;
+            }
+            *out = (vtype_t) {
+                .kind = VT_OBJECT,
+                .name_len = semicolon - start - 1,
+                .name = start + 1
+            };
+            *p = semicolon + 1;
+            return true;
+        }
+        case '[': {
+            char const *element = start;
+            while (element < end && *element == '[') {
+                element++;
+            }
+            vtype_t element_type;
+            if (element - start > 255
+                || !parse_type(&element, end, &element_type)) {
+                return false;
+            }
+            *out = (vtype_t) {
+                .kind = VT_OBJECT,
+                .name_len = element - start,
+                .name = start
+            };
+            *p = element;
+            return true;
+        }
+        default:
+            return false;
+    }
+    *p = start + 1;
+    return true;
+}
+
+/* the constant pool entry at `index` if it is there and has tag `tag`,
+   or any tag for 0 */
+static void *cp_entry(r11f_class_t *clazz, uint16_t index, uint8_t tag) {
+    if (index == 0 || index >= clazz->constant_pool_count) {
+        return NULL;
+    }
+    r11f_cpinfo_t *cpinfo = clazz->constant_pool[index];
+    if (!cpinfo || (tag && cpinfo->tag != tag)) {
+        return NULL;
+    }
+    return cpinfo;
+}
+
+static bool class_name_at(r11f_class_t *clazz,
+                          uint16_t index,
+                          char const **out_name,
+                          uint16_t *out_name_len) {
+    r11f_constant_class_info_t *class_info =
+        cp_entry(clazz, index, R11F_CONSTANT_Class);
+    if (!class_info) {
+        return false;
+    }
+    r11f_constant_utf8_info_t *name_info =
+        cp_entry(clazz, class_info->name_index, R11F_CONSTANT_Utf8);
+    if (!name_info || name_info->length == 0) {
+        return false;
+    }
+    *out_name = (char const*)name_info->bytes;
+    *out_name_len = name_info->length;
+    return true;
+}
+
+static bool utf8_equals(r11f_constant_utf8_info_t const *utf8_info,
+                        char const *str) {
+    return utf8_info->length == strlen(str)
+           && !memcmp(utf8_info->bytes, str, utf8_info->length);
+}
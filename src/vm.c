@@ -5,56 +5,1993 @@
 #include <stdio.h>
 #include <string.h>
 #include "alloc.h"
+#include "aot.h"
 #include "bytecode.h"
+#include "byteutil.h"
 #include "class.h"
 #include "class/cpool.h"
 #include "clsfile.h"
 #include "clsmgr.h"
+#include "except.h"
 #include "forward.h"
 #include "frame.h"
+#include "jit.h"
+#include "jitcache.h"
+#include "link.h"
+#include "nativefn.h"
+#include "object.h"
+#include "opt.h"
+#include "regir.h"
+#include "switch.h"
+#include "tier.h"
+#include "tos.h"
+#include "trace.h"
+#include "verify.h"
+#include "vthread.h"
+
+#ifndef WIN32
+#   include <pthread.h>
+#endif
+
+/* what frame->pc of the frame an exception starts at holds */
+enum {
+    /* the interpreter's own, a bytecode pc or register IR instruction */
+    THROW_PC_FRAME = 0,
+    /* a register IR instruction stored by baseline code */
+    THROW_PC_INSN = 1,
+    THROW_PC_UNKNOWN = 2,
+    /* the frame has called, its pc is past the invoke */
+    THROW_PC_CALLER = 3
+};
 
 static r11f_error_t vm_execute(r11f_vm_t *vm, void *output);
+static r11f_error_t vm_execute_regir(r11f_vm_t *vm, void *output);
+static r11f_error_t vm_execute_jit(r11f_vm_t *vm,
+                                   r11f_jit_entry_t entry,
+                                   void *output);
 static r11f_error_t vm_exec_invokestatic(r11f_vm_t *vm);
-static void invoke_copyargs(r11f_frame_t *src,
-                            r11f_frame_t *dst,
-                            char const* descriptor);
+static r11f_error_t vm_exec_invokeinstance(r11f_vm_t *vm, uint8_t insc);
+static r11f_error_t vm_new_object(r11f_vm_t *vm,
+                                  r11f_class_t *caller,
+                                  uint16_t class_index,
+                                  r11f_object_t **output);
+static r11f_error_t vm_resolve_static(r11f_vm_t *vm,
+                                      r11f_class_t *caller,
+                                      uint16_t methodref_index,
+                                      r11f_class_t **out_class,
+                                      r11f_method_info_t **out_method_info);
+static r11f_error_t vm_resolve_virtual(r11f_vm_t *vm,
+                                       r11f_class_t *caller,
+                                       uint16_t methodref_index,
+                                       r11f_value_t receiver,
+                                       r11f_class_t **out_class,
+                                       r11f_method_info_t **out_method_info);
+static r11f_error_t vm_find_method(r11f_vm_t *vm,
+                                   r11f_class_t *clazz,
+                                   r11f_method_qual_name_t const *qual_name,
+                                   r11f_class_t **out_class,
+                                   r11f_method_info_t **out_method_info);
+static r11f_error_t vm_check_static(r11f_method_info_t *method_info);
+static r11f_error_t vm_check_virtual(r11f_method_info_t *method_info);
+static r11f_error_t vm_new_frame(r11f_vm_t *vm,
+                                 r11f_class_t *clazz,
+                                 r11f_method_info_t *method_info,
+                                 r11f_value_t *args,
+                                 r11f_frame_t **output);
+static r11f_error_t vm_init_stack(r11f_vm_t *vm);
+static r11f_error_t vm_link(r11f_vm_t *vm,
+                            r11f_class_t *clazz,
+                            r11f_method_info_t *method_info,
+                            r11f_linked_method_t **output);
+static bool vm_is_trivial(r11f_vm_t *vm, r11f_linked_method_t *linked);
+static r11f_jit_code_t *vm_valid_opt(r11f_linked_method_t *linked);
+static void vm_load_aot(r11f_vm_t *vm, r11f_linked_method_t *linked);
+static r11f_jit_entry_t vm_jump(r11f_vm_t *vm, r11f_frame_t *frame);
+static r11f_jit_entry_t vm_jump_to(r11f_vm_t *vm,
+                                   r11f_frame_t *frame,
+                                   uint32_t target);
+static void vm_return(r11f_vm_t *vm,
+                      r11f_frame_t *frame,
+                      uint8_t insc,
+                      r11f_value_t value,
+                      void *output);
+static void vm_unwind(r11f_vm_t *vm);
+static r11f_error_t vm_yield(r11f_vm_t *vm);
+static r11f_error_t vm_throw(r11f_vm_t *vm, r11f_error_t err, uint8_t pc_kind);
+static uint8_t vm_pc_kind(r11f_linked_method_t *linked,
+                          r11f_jit_entry_t entry);
+static uint32_t vm_throw_pc(r11f_frame_t *frame, uint8_t pc_kind);
+static bool vm_catches(r11f_vm_t *vm,
+                       r11f_object_t *exception,
+                       r11f_handler_t const *handler);
+static r11f_object_t *vm_fast_exception(r11f_vm_t *vm, uint16_t builtin);
+static void vm_resolve_handlers(r11f_vm_t *vm, r11f_linked_method_t *linked);
+static r11f_error_t vm_link_locked(r11f_vm_t *vm,
+                                   r11f_class_t *clazz,
+                                   r11f_method_info_t *method_info,
+                                   r11f_linked_method_t **output);
 static void invoke_copyargs2(r11f_value_t *src_stack,
                              r11f_value_t *dst_locals,
-                             char const* descriptor);
+                             r11f_linked_method_t const *linked);
 static r11f_error_t vm_get_class(r11f_vm_t *vm,
                                  char const *class_name,
                                  uint16_t class_name_len,
                                  r11f_class_t **output);
+static r11f_error_t vm_load_class(r11f_vm_t *vm,
+                                  char const *class_name,
+                                  uint16_t class_name_len,
+                                  r11f_class_t **output);
+static r11f_error_t vm_load_builtin(r11f_vm_t *vm,
+                                    uint16_t builtin,
+                                    r11f_class_t **output);
 static void get_class_name(r11f_class_t *class,
                            r11f_constant_methodref_info_t *methodref_info,
                            char const **out_class_name,
                            uint16_t *out_class_name_len);
+static bool is_object_class(char const *class_name, uint16_t class_name_len);
+static r11f_error_t vm_call(r11f_vm_t *vm,
+                            r11f_method_handle_t const *handle,
+                            r11f_value_t argv[],
+                            void *output);
+static r11f_error_t vm_run(r11f_vm_t *vm,
+                           r11f_frame_t *frame,
+                           void *output);
+
+/* rows [begin, end) of a batch of a trivial method */
+typedef struct {
+    r11f_linked_method_t const *linked;
+    r11f_value_t const* const* columns;
+    size_t begin;
+    size_t end;
+    r11f_value_t *results;
+} batch_chunk_t;
+
+static void batch_trivial(r11f_vm_t *vm,
+                          r11f_linked_method_t const *linked,
+                          r11f_value_t const* const* columns,
+                          size_t nrows,
+                          r11f_value_t *results);
+static void *batch_run_chunk(void *arg);
+
+R11F_EXPORT
+r11f_error_t r11f_vm_invoke_static(r11f_vm_t *vm,
+                                   char const *class_name,
+                                   char const *method_name,
+                                   char const *method_descriptor,
+                                   r11f_value_t argv[],
+                                   void *output) {
+    vm->exception = NULL;
+
+    r11f_method_handle_t handle;
+    r11f_error_t err = r11f_vm_prepare_static(vm,
+                                              class_name,
+                                              method_name,
+                                              method_descriptor,
+                                              &handle);
+    if (err != R11F_success) {
+        return err;
+    }
+    return vm_call(vm, &handle, argv, output);
+}
+
+R11F_EXPORT
+r11f_error_t r11f_vm_prepare_static(r11f_vm_t *vm,
+                                    char const *class_name,
+                                    char const *method_name,
+                                    char const *method_descriptor,
+                                    r11f_method_handle_t *handle) {
+    r11f_class_t *clazz;
+    r11f_error_t err =
+        vm_get_class(vm, class_name, strlen(class_name), &clazz);
+    if (err != R11F_success) {
+        return err;
+    }
+
+    r11f_method_info_t *method_info = r11f_class_resolve_method(
+        clazz,
+        method_name,
+        strlen(method_name),
+        method_descriptor,
+        strlen(method_descriptor)
+    );
+    if (!method_info) {
+        return R11F_ERR_method_not_found;
+    }
+
+    err = vm_check_static(method_info);
+    if (err != R11F_success) {
+        return err;
+    }
+
+    r11f_linked_method_t *linked;
+    err = vm_link(vm, clazz, method_info, &linked);
+    if (err != R11F_success) {
+        return err;
+    }
+
+    handle->clazz = clazz;
+    handle->method_info = method_info;
+    handle->linked = linked;
+    return R11F_success;
+}
+
+R11F_EXPORT
+r11f_error_t r11f_vm_call(r11f_vm_t *vm,
+                          r11f_method_handle_t const *handle,
+                          r11f_value_t argv[],
+                          r11f_value_t *result) {
+    r11f_value_t value = { .i64 = 0 };
+    r11f_error_t err = vm_call(vm, handle, argv, &value);
+    if (err == R11F_success && result) {
+        *result = value;
+    }
+    return err;
+}
+
+/* runs a prepared method, storing its result to `output` as its type */
+static r11f_error_t vm_call(r11f_vm_t *vm,
+                            r11f_method_handle_t const *handle,
+                            r11f_value_t argv[],
+                            void *output) {
+    vm->exception = NULL;
+
+    r11f_linked_method_t *linked = handle->linked;
+    if (vm_is_trivial(vm, linked)) {
+        r11f_value_t value = r11f_method_run_trivial(linked, argv);
+        if (linked->return_type == 'J' || linked->return_type == 'L') {
+            *(int64_t*)output = value.i64;
+        }
+        else {
+            *(int32_t*)output = value.i32;
+        }
+        return R11F_success;
+    }
+
+    r11f_frame_t *frame;
+    r11f_error_t err =
+        vm_new_frame(vm, handle->clazz, handle->method_info, NULL, &frame);
+    if (err != R11F_success) {
+        return err;
+    }
+
+    invoke_copyargs2(argv, frame->locals, linked);
+    return vm_run(vm, frame, output);
+}
+
+R11F_EXPORT
+r11f_error_t r11f_vm_invoke_batch(r11f_vm_t *vm,
+                                  r11f_method_handle_t const *handle,
+                                  r11f_value_t const* const* columns,
+                                  size_t nrows,
+                                  r11f_value_t *results) {
+    vm->exception = NULL;
+
+    r11f_linked_method_t *linked = handle->linked;
+    if (vm_is_trivial(vm, linked)) {
+        /* computed from the arguments alone, nothing to do without
+           results and any row can run on any thread */
+        if (results) {
+            batch_trivial(vm, linked, columns, nrows, results);
+        }
+        return R11F_success;
+    }
+
+    /* the local each argument goes to, worked out once */
+    uint16_t slots[UINT8_MAX];
+    bool wide[UINT8_MAX];
+    uint16_t argc = 0;
+    uint16_t slot = 0;
+    for (char const *desc = linked->descriptor + 1; *desc != ')'; desc++) {
+        wide[argc] = (*desc == 'J' || *desc == 'D') && linked->wide_args;
+        slots[argc] = slot;
+        slot += wide[argc++] ? 2 : 1;
+        while (*desc == '[') {
+            desc++;
+        }
+        if (*desc == 'L') {
+            while (*desc != ';') {
+                desc++;
+            }
+        }
+    }
+
+    /* every row's frame takes the same place on the VM stack */
+    for (size_t row = 0; row < nrows; row++) {
+        r11f_frame_t *frame;
+        r11f_error_t err = vm_new_frame(vm,
+                                        handle->clazz,
+                                        handle->method_info,
+                                        NULL,
+                                        &frame);
+        if (err != R11F_success) {
+            return err;
+        }
+        for (uint16_t i = 0; i < argc; i++) {
+            frame->locals[slots[i]] = columns[i][row];
+            if (wide[i]) {
+                frame->locals[slots[i] + 1] = columns[i][row];
+            }
+        }
+
+        r11f_value_t value = { .i64 = 0 };
+        err = vm_run(vm, frame, &value);
+        if (err != R11F_success) {
+            return err;
+        }
+        if (results) {
+            results[row] = value;
+        }
+    }
+    return R11F_success;
+}
+
+static void batch_trivial(r11f_vm_t *vm,
+                          r11f_linked_method_t const *linked,
+                          r11f_value_t const* const* columns,
+                          size_t nrows,
+                          r11f_value_t *results) {
+    size_t threads = vm->batch_threads < R11F_MAX_BATCH_THREADS ?
+        vm->batch_threads :
+        R11F_MAX_BATCH_THREADS;
+    if (threads > nrows / R11F_BATCH_MIN_ROWS) {
+        threads = nrows / R11F_BATCH_MIN_ROWS;
+    }
+    if (threads < 2) {
+        batch_run_chunk(&(batch_chunk_t) {
+            .linked = linked,
+            .columns = columns,
+            .begin = 0,
+            .end = nrows,
+            .results = results
+        });
+        return;
+    }
+
+    batch_chunk_t chunks[R11F_MAX_BATCH_THREADS];
+    for (size_t i = 0; i < threads; i++) {
+        chunks[i] = (batch_chunk_t) {
+            .linked = linked,
+            .columns = columns,
+            .begin = nrows * i / threads,
+            .end = nrows * (i + 1) / threads,
+            .results = results
+        };
+    }
+
+#ifndef WIN32
+    /* the first chunk runs here, any thread that does not start too */
+    pthread_t workers[R11F_MAX_BATCH_THREADS];
+    bool started[R11F_MAX_BATCH_THREADS] = { false };
+    for (size_t i = 1; i < threads; i++) {
+        started[i] =
+            !pthread_create(&workers[i], NULL, batch_run_chunk, &chunks[i]);
+    }
+    for (size_t i = 0; i < threads; i++) {
+        if (!started[i]) {
+            batch_run_chunk(&chunks[i]);
+        }
+    }
+    for (size_t i = 1; i < threads; i++) {
+        if (started[i]) {
+            pthread_join(workers[i], NULL);
+        }
+    }
+#else
+    for (size_t i = 0; i < threads; i++) {
+        batch_run_chunk(&chunks[i]);
+    }
+#endif
+}
+
+static void *batch_run_chunk(void *arg) {
+    batch_chunk_t const *chunk = arg;
+    r11f_value_t args[UINT8_MAX];
+    uint16_t argc = chunk->linked->argc;
+    for (size_t row = chunk->begin; row < chunk->end; row++) {
+        for (uint16_t i = 0; i < argc; i++) {
+            args[i] = chunk->columns[i][row];
+        }
+        chunk->results[row] = r11f_method_run_trivial(chunk->linked, args);
+    }
+    return NULL;
+}
+
+/* runs `frame`, pushed with its arguments, to completion */
+static r11f_error_t vm_run(r11f_vm_t *vm,
+                           r11f_frame_t *frame,
+                           void *output) {
+    vm->current_frame = frame;
+
+    /* failed calls leave no frames behind */
+    r11f_error_t err = vm_execute(vm, output);
+    if (err == R11F_ERR_uncaught_exception && vm->exception->clazz->builtin) {
+        /* the VM's own exceptions keep reporting their error */
+        char const *name;
+        uint16_t name_len;
+        r11f_class_get_class_name(vm->exception->clazz,
+                                  vm->exception->clazz->this_class,
+                                  &name,
+                                  &name_len);
+        err = r11f_except_error(r11f_except_find(name, name_len));
+    }
+    return err;
+}
+
+R11F_INTERNAL r11f_error_t r11f_vm_run_vthread(r11f_vm_t *vm,
+                                               r11f_vthread_t *vthread) {
+    r11f_error_t err;
+    vm->vthread = vthread;
+    if (vthread->cont.bytes) {
+        vm->exception = NULL;
+        err = vm_init_stack(vm);
+        if (err == R11F_success) {
+            r11f_frame_t *frame =
+                r11f_stack_attach(&vm->stack, &vthread->cont);
+            err = frame ?
+                vm_run(vm, frame, &vthread->result) :
+                R11F_ERR_stack_overflow;
+        }
+    }
+    else {
+        err = vm_call(vm, &vthread->handle, vthread->argv, &vthread->result);
+    }
+    vm->vthread = NULL;
+
+    /* nothing but its frames is on the stack, see vm_yield */
+    if (err == R11F_ERR_parked) {
+        err = r11f_stack_detach(&vm->stack, &vthread->cont);
+        if (err != R11F_success) {
+            vm_unwind(vm);
+            return err;
+        }
+        vm->current_frame = NULL;
+        return R11F_ERR_parked;
+    }
+    return err;
+}
+
+R11F_EXPORT size_t r11f_vm_format_stack_trace(r11f_vm_t *vm,
+                                              char *buf,
+                                              size_t size) {
+    if (!vm->exception) {
+        if (size) {
+            buf[0] = '\0';
+        }
+        return 0;
+    }
+
+    /* snprintf counts what did not fit, so one pass gives the length */
+    char const *name = "[I";
+    uint16_t name_len = 2;
+    r11f_class_t *clazz = vm->exception->clazz;
+    if (clazz) {
+        r11f_class_get_class_name(clazz, clazz->this_class, &name, &name_len);
+    }
+    size_t length = 0;
+    int n = snprintf(buf, size, "%.*s\n", (int)name_len, name);
+    length += n > 0 ? (size_t)n : 0;
+    for (uint32_t i = 0; i < vm->backtrace.count; i++) {
+        r11f_stack_entry_t *entry = &vm->backtrace.entries[i];
+        r11f_linked_method_t *method = entry->method;
+        r11f_class_get_class_name(method->clazz,
+                                  method->clazz->this_class,
+                                  &name,
+                                  &name_len);
+        char *at = length < size ? buf + length : NULL;
+        size_t left = length < size ? size - length : 0;
+        if (entry->pc == UINT32_MAX) {
+            n = snprintf(at, left, "\tat %.*s.%.*s%.*s (compiled code)\n",
+                         (int)name_len, name,
+                         (int)method->name_len, method->name,
+                         (int)method->descriptor_len, method->descriptor);
+        }
+        else {
+            n = snprintf(at, left, "\tat %.*s.%.*s%.*s (pc %u)\n",
+                         (int)name_len, name,
+                         (int)method->name_len, method->name,
+                         (int)method->descriptor_len, method->descriptor,
+                         entry->pc);
+        }
+        length += n > 0 ? (size_t)n : 0;
+    }
+    return length;
+}
+
+R11F_EXPORT void r11f_vm_cleanup(r11f_vm_t *vm) {
+    r11f_tier_shutdown(vm);
+    r11f_trace_cleanup(vm);
+    r11f_aot_unload(vm);
+    while (vm->objects) {
+        r11f_object_t *next = vm->objects->next;
+        r11f_free(vm->objects);
+        vm->objects = next;
+    }
+    vm->exception = NULL;
+    memset(vm->fast_exceptions, 0, sizeof(vm->fast_exceptions));
+    r11f_backtrace_free(&vm->backtrace);
+    r11f_stack_free(&vm->stack);
+}
+
+/* runs until the current frame at the start returns, or until an
+   exception or error leaves it; frames are gone then */
+static r11f_error_t vm_execute(r11f_vm_t *vm, void *output) {
+    while (vm->current_frame) {
+        r11f_frame_t *frame = vm->current_frame;
+        r11f_error_t err;
+        if (frame->jit) {
+            r11f_jit_entry_t entry = frame->jit->entry;
+            err = vm_execute_jit(vm, entry, output);
+            if (err != R11F_success) {
+                err = vm_throw(vm,
+                               err,
+                               vm_pc_kind(frame->method_info->linked, entry));
+                if (err != R11F_success) {
+                    return err;
+                }
+            }
+            continue;
+        }
+        if (frame->regir) {
+            err = vm_execute_regir(vm, output);
+            if (err != R11F_success) {
+                err = vm_throw(vm, err, THROW_PC_FRAME);
+                if (err != R11F_success) {
+                    return err;
+                }
+            }
+            continue;
+        }
+
+        if (vm->exec_mode == R11F_EXEC_TOSCACHE) {
+            /* returns at the first instruction it does not handle */
+            r11f_tos_execute(frame);
+        }
+
+        r11f_value_t *stack = frame->stack;
+        r11f_value_t *locals = frame->locals;
+        uint8_t *code = frame->code;
+
+        /* set when a back edge hands the frame over to compiled code */
+        r11f_jit_entry_t osr = NULL;
+        uint8_t insc = code[frame->pc];
+        switch (insc) {
+            case R11F_nop:
+                frame->pc += 1;
+                break;
+
+            case R11F_aconst_null:
+                stack[frame->sp] = (r11f_value_t) { .ptr = NULL };
+                frame->sp++;
+                frame->pc += 1;
+                break;
+            case R11F_iconst_m1:
+            case R11F_iconst_0:
+            case R11F_iconst_1:
+            case R11F_iconst_2:
+            case R11F_iconst_3:
+            case R11F_iconst_4:
+            case R11F_iconst_5:
+                stack[frame->sp] =
+                    (r11f_value_t) { .i32 = (int32_t)insc - R11F_iconst_0 };
+                frame->sp++;
+                frame->pc += 1;
+                break;
+            case R11F_lconst_0:
+            case R11F_lconst_1:
+                stack[frame->sp] =
+                    (r11f_value_t) { .i64 = (int64_t)insc - R11F_lconst_0 };
+                frame->sp++;
+                frame->pc += 1;
+                break;
+            case R11F_bipush:
+                stack[frame->sp] =
+                    (r11f_value_t) { .i32 = (int8_t)code[frame->pc + 1] };
+                frame->sp++;
+                frame->pc += 2;
+                break;
+            case R11F_sipush:
+                stack[frame->sp] = (r11f_value_t) {
+                    .i32 = (int16_t)read_unaligned_be2(code + frame->pc + 1)
+                };
+                frame->sp++;
+                frame->pc += 3;
+                break;
+            case R11F_ldc:
+            case R11F_ldc_w: {
+                uint16_t index = insc == R11F_ldc ?
+                    code[frame->pc + 1] :
+                    read_unaligned_be2(code + frame->pc + 1);
+                /* verified to be a CONSTANT_Integer */
+                r11f_constant_integer_info_t *integer_info =
+                    frame->clazz->constant_pool[index];
+                stack[frame->sp] =
+                    (r11f_value_t) { .i32 = (int32_t)integer_info->bytes };
+                frame->sp++;
+                frame->pc += insc == R11F_ldc ? 2 : 3;
+                break;
+            }
+            case R11F_ldc2_w: {
+                /* verified to be a CONSTANT_Long */
+                uint16_t index = read_unaligned_be2(code + frame->pc + 1);
+                r11f_constant_long_info_t *long_info =
+                    frame->clazz->constant_pool[index];
+                stack[frame->sp] = (r11f_value_t) {
+                    .i64 = (int64_t)(((uint64_t)long_info->high_bytes << 32)
+                                     | long_info->low_bytes)
+                };
+                frame->sp++;
+                frame->pc += 3;
+                break;
+            }
+
+            case R11F_iload_0:
+            case R11F_lload_0:
+            case R11F_aload_0:
+                stack[frame->sp] = locals[0];
+                frame->sp++;
+                frame->pc += 1;
+                break;
+            case R11F_iload_1:
+            case R11F_lload_1:
+            case R11F_aload_1:
+                stack[frame->sp] = locals[1];
+                frame->sp++;
+                frame->pc += 1;
+                break;
+            case R11F_iload_2:
+            case R11F_lload_2:
+            case R11F_aload_2:
+                stack[frame->sp] = locals[2];
+                frame->sp++;
+                frame->pc += 1;
+                break;
+            case R11F_iload_3:
+            case R11F_lload_3:
+            case R11F_aload_3:
+                stack[frame->sp] = locals[3];
+                frame->sp++;
+                frame->pc += 1;
+                break;
+            case R11F_iload:
+            case R11F_lload:
+            case R11F_aload:
+                stack[frame->sp] = locals[code[frame->pc + 1]];
+                frame->sp++;
+                frame->pc += 2;
+                break;
+
+            case R11F_istore_0:
+            case R11F_lstore_0:
+            case R11F_astore_0:
+                frame->sp--;
+                locals[0] = stack[frame->sp];
+                frame->pc += 1;
+                break;
+            case R11F_istore_1:
+            case R11F_lstore_1:
+            case R11F_astore_1:
+                frame->sp--;
+                locals[1] = stack[frame->sp];
+                frame->pc += 1;
+                break;
+            case R11F_istore_2:
+            case R11F_lstore_2:
+            case R11F_astore_2:
+                frame->sp--;
+                locals[2] = stack[frame->sp];
+                frame->pc += 1;
+                break;
+            case R11F_istore_3:
+            case R11F_lstore_3:
+            case R11F_astore_3:
+                frame->sp--;
+                locals[3] = stack[frame->sp];
+                frame->pc += 1;
+                break;
+            case R11F_istore:
+            case R11F_lstore:
+            case R11F_astore:
+                frame->sp--;
+                locals[code[frame->pc + 1]] = stack[frame->sp];
+                frame->pc += 2;
+                break;
+
+            case R11F_iinc: {
+                uint8_t index = code[frame->pc + 1];
+                int8_t delta = (int8_t)code[frame->pc + 2];
+                locals[index].i32 =
+                    (int32_t)((uint32_t)locals[index].i32 + (uint32_t)delta);
+                frame->pc += 3;
+                break;
+            }
+
+            case R11F_pop:
+                frame->sp--;
+                frame->pc += 1;
+                break;
+            case R11F_dup:
+                stack[frame->sp] = stack[frame->sp - 1];
+                frame->sp++;
+                frame->pc += 1;
+                break;
+
+#define INT_BINOP(CODE, EXPR) \
+            case R11F_##CODE: { \
+                int32_t a = stack[frame->sp - 2].i32; \
+                int32_t b = stack[frame->sp - 1].i32; \
+                (void)a; (void)b; \
+                stack[frame->sp - 2] = (r11f_value_t) { .i32 = (EXPR) }; \
+                frame->sp--; \
+                frame->pc++; \
+                break; \
+            }
+#define LONG_BINOP(CODE, EXPR) \
+            case R11F_##CODE: { \
+                int64_t a = stack[frame->sp - 2].i64; \
+                int64_t b = stack[frame->sp - 1].i64; \
+                (void)a; (void)b; \
+                stack[frame->sp - 2] = (r11f_value_t) { .i64 = (EXPR) }; \
+                frame->sp--; \
+                frame->pc++; \
+                break; \
+            }
+#define LONG_SHIFT(CODE, EXPR) \
+            case R11F_##CODE: { \
+                int64_t a = stack[frame->sp - 2].i64; \
+                int32_t b = stack[frame->sp - 1].i32; \
+                stack[frame->sp - 2] = (r11f_value_t) { .i64 = (EXPR) }; \
+                frame->sp--; \
+                frame->pc++; \
+                break; \
+            }
+
+            INT_BINOP(iadd, (int32_t)((uint32_t)a + (uint32_t)b))
+            INT_BINOP(isub, (int32_t)((uint32_t)a - (uint32_t)b))
+            INT_BINOP(imul, (int32_t)((uint32_t)a * (uint32_t)b))
+            INT_BINOP(ishl, (int32_t)((uint32_t)a << (b & 31)))
+            INT_BINOP(ishr, a >> (b & 31))
+            INT_BINOP(iushr, (int32_t)((uint32_t)a >> (b & 31)))
+            INT_BINOP(iand, a & b)
+            INT_BINOP(ior, a | b)
+            INT_BINOP(ixor, a ^ b)
+            LONG_BINOP(ladd, (int64_t)((uint64_t)a + (uint64_t)b))
+            LONG_BINOP(lsub, (int64_t)((uint64_t)a - (uint64_t)b))
+            LONG_BINOP(lmul, (int64_t)((uint64_t)a * (uint64_t)b))
+            LONG_BINOP(land, a & b)
+            LONG_BINOP(lor, a | b)
+            LONG_BINOP(lxor, a ^ b)
+            LONG_SHIFT(lshl, (int64_t)((uint64_t)a << (b & 63)))
+            LONG_SHIFT(lshr, a >> (b & 63))
+            LONG_SHIFT(lushr, (int64_t)((uint64_t)a >> (b & 63)))
+
+#undef INT_BINOP
+#undef LONG_BINOP
+#undef LONG_SHIFT
+
+            case R11F_idiv:
+            case R11F_irem: {
+                int32_t a = stack[frame->sp - 2].i32;
+                int32_t b = stack[frame->sp - 1].i32;
+                if (b == 0) {
+                    err = R11F_ERR_division_by_zero;
+                    goto exception;
+                }
+
+                int32_t result;
+                if (b == -1) {
+                    /* INT32_MIN / -1 overflows in C but not in Java */
+                    result = insc == R11F_idiv ?
+                        (int32_t)(0u - (uint32_t)a) :
+                        0;
+                }
+                else {
+                    result = insc == R11F_idiv ? a / b : a % b;
+                }
+
+                stack[frame->sp - 2] = (r11f_value_t) { .i32 = result };
+                frame->sp--;
+                frame->pc++;
+                break;
+            }
+            case R11F_ldiv:
+            case R11F_lrem: {
+                int64_t a = stack[frame->sp - 2].i64;
+                int64_t b = stack[frame->sp - 1].i64;
+                if (b == 0) {
+                    err = R11F_ERR_division_by_zero;
+                    goto exception;
+                }
+
+                int64_t result;
+                if (b == -1) {
+                    result = insc == R11F_ldiv ?
+                        (int64_t)(0ull - (uint64_t)a) :
+                        0;
+                }
+                else {
+                    result = insc == R11F_ldiv ? a / b : a % b;
+                }
+
+                stack[frame->sp - 2] = (r11f_value_t) { .i64 = result };
+                frame->sp--;
+                frame->pc++;
+                break;
+            }
+            case R11F_lcmp: {
+                int64_t a = stack[frame->sp - 2].i64;
+                int64_t b = stack[frame->sp - 1].i64;
+
+                stack[frame->sp - 2] =
+                    (r11f_value_t) { .i32 = (a > b) - (a < b) };
+                frame->sp--;
+                frame->pc++;
+                break;
+            }
+
+            case R11F_ineg:
+                stack[frame->sp - 1].i32 =
+                    (int32_t)(0u - (uint32_t)stack[frame->sp - 1].i32);
+                frame->pc++;
+                break;
+            case R11F_lneg:
+                stack[frame->sp - 1].i64 =
+                    (int64_t)(0ull - (uint64_t)stack[frame->sp - 1].i64);
+                frame->pc++;
+                break;
+            case R11F_i2l: {
+                stack[frame->sp - 1] =
+                    (r11f_value_t) { .i64 = stack[frame->sp - 1].i32 };
+
+                frame->pc++;
+                break;
+            }
+            case R11F_l2i:
+                stack[frame->sp - 1] =
+                    (r11f_value_t) { .i32 = (int32_t)stack[frame->sp - 1].i64 };
+                frame->pc++;
+                break;
+            case R11F_i2b:
+                stack[frame->sp - 1].i32 = (int8_t)stack[frame->sp - 1].i32;
+                frame->pc++;
+                break;
+            case R11F_i2c:
+                stack[frame->sp - 1].i32 = (uint16_t)stack[frame->sp - 1].i32;
+                frame->pc++;
+                break;
+            case R11F_i2s:
+                stack[frame->sp - 1].i32 = (int16_t)stack[frame->sp - 1].i32;
+                frame->pc++;
+                break;
+
+#define IF_BRANCH(CODE, COND) \
+            case R11F_##CODE: { \
+                int32_t a = stack[frame->sp - 1].i32; \
+                frame->sp--; \
+                if (COND) { \
+                    osr = vm_jump(vm, frame); \
+                } \
+                else { \
+                    frame->pc += 3; \
+                } \
+                break; \
+            }
+#define IF_ICMP_BRANCH(CODE, COND) \
+            case R11F_##CODE: { \
+                int32_t a = stack[frame->sp - 2].i32; \
+                int32_t b = stack[frame->sp - 1].i32; \
+                frame->sp -= 2; \
+                if (COND) { \
+                    osr = vm_jump(vm, frame); \
+                } \
+                else { \
+                    frame->pc += 3; \
+                } \
+                break; \
+            }
+
+            IF_BRANCH(ifeq, a == 0)
+            IF_BRANCH(ifne, a != 0)
+            IF_BRANCH(iflt, a < 0)
+            IF_BRANCH(ifge, a >= 0)
+            IF_BRANCH(ifgt, a > 0)
+            IF_BRANCH(ifle, a <= 0)
+            IF_ICMP_BRANCH(if_icmpeq, a == b)
+            IF_ICMP_BRANCH(if_icmpne, a != b)
+            IF_ICMP_BRANCH(if_icmplt, a < b)
+            IF_ICMP_BRANCH(if_icmpge, a >= b)
+            IF_ICMP_BRANCH(if_icmpgt, a > b)
+            IF_ICMP_BRANCH(if_icmple, a <= b)
+
+#undef IF_BRANCH
+#undef IF_ICMP_BRANCH
+
+            case R11F_goto:
+                osr = vm_jump(vm, frame);
+                break;
+            case R11F_tableswitch:
+            case R11F_lookupswitch: {
+                r11f_switch_t *sw =
+                    r11f_method_find_switch(frame->method_info->linked,
+                                            frame->pc);
+                frame->sp--;
+                osr = vm_jump_to(vm, frame,
+                                 r11f_switch_lookup(sw, stack[frame->sp].i32));
+                break;
+            }
+
+            case R11F_ireturn:
+            case R11F_lreturn:
+            case R11F_areturn:
+                vm_return(vm, frame, insc, stack[frame->sp - 1], output);
+                break;
+            case R11F_return:
+                vm_return(vm, frame, insc, (r11f_value_t) { .i64 = 0 }, output);
+                break;
+            case R11F_athrow:
+                err = r11f_vm_athrow(vm, stack[frame->sp - 1].ptr);
+                goto exception;
+            case R11F_invokestatic:
+                err = vm_exec_invokestatic(vm);
+                if (err != R11F_success) {
+                    goto exception;
+                }
+                break;
+            case R11F_invokespecial:
+            case R11F_invokevirtual:
+                err = vm_exec_invokeinstance(vm, insc);
+                if (err != R11F_success) {
+                    goto exception;
+                }
+                break;
+            case R11F_new: {
+                r11f_object_t *object;
+                err = vm_new_object(vm,
+                                    frame->clazz,
+                                    read_unaligned_be2(code + frame->pc + 1),
+                                    &object);
+                if (err != R11F_success) {
+                    goto exception;
+                }
+
+                stack[frame->sp] = (r11f_value_t) { .ptr = object };
+                frame->sp++;
+                frame->pc += 3;
+                break;
+            }
+            case R11F_newarray: {
+                /* verified to be T_INT */
+                err = r11f_vm_new_array(vm,
+                                        stack[frame->sp - 1].i32,
+                                        &stack[frame->sp - 1]);
+                if (err != R11F_success) {
+                    goto exception;
+                }
+                frame->pc += 2;
+                break;
+            }
+            case R11F_arraylength: {
+                r11f_array_t *array = stack[frame->sp - 1].ptr;
+                if (!array) {
+                    err = R11F_ERR_null_pointer;
+                    goto exception;
+                }
+                stack[frame->sp - 1] = (r11f_value_t) { .i32 = array->length };
+                frame->pc += 1;
+                break;
+            }
+            case R11F_iaload: {
+                r11f_array_t *array = stack[frame->sp - 2].ptr;
+                int32_t index = stack[frame->sp - 1].i32;
+                if (!array) {
+                    err = R11F_ERR_null_pointer;
+                    goto exception;
+                }
+                if ((uint32_t)index >= (uint32_t)array->length) {
+                    err = R11F_ERR_array_index_out_of_bounds;
+                    goto exception;
+                }
+                stack[frame->sp - 2] =
+                    (r11f_value_t) { .i32 = array->data[index] };
+                frame->sp--;
+                frame->pc += 1;
+                break;
+            }
+            case R11F_iastore: {
+                r11f_array_t *array = stack[frame->sp - 3].ptr;
+                int32_t index = stack[frame->sp - 2].i32;
+                if (!array) {
+                    err = R11F_ERR_null_pointer;
+                    goto exception;
+                }
+                if ((uint32_t)index >= (uint32_t)array->length) {
+                    err = R11F_ERR_array_index_out_of_bounds;
+                    goto exception;
+                }
+                array->data[index] = stack[frame->sp - 1].i32;
+                frame->sp -= 3;
+                frame->pc += 1;
+                break;
+            }
+            default: {
+                err = R11F_ERR_malformed_classfile;
+                goto exception;
+            }
+        }
+
+        if (osr) {
+            err = vm_execute_jit(vm, osr, output);
+            if (err != R11F_success) {
+                err = vm_throw(vm,
+                               err,
+                               vm_pc_kind(frame->method_info->linked, osr));
+                if (err != R11F_success) {
+                    return err;
+                }
+            }
+        }
+        continue;
+
+    exception:
+        /* the pc is still at the instruction that failed */
+        err = vm_throw(vm, err, THROW_PC_FRAME);
+        if (err != R11F_success) {
+            return err;
+        }
+    }
+
+    return R11F_success;
+}
+
+/* runs the register IR of the current frame until it calls or returns */
+static r11f_error_t vm_execute_regir(r11f_vm_t *vm, void *output) {
+    r11f_frame_t *frame = vm->current_frame;
+    r11f_regir_insn_t *insns = frame->regir->insns;
+    r11f_value_t *r = frame->data;
+    uint32_t pc = frame->pc;
+
+    /* R11F_EXEC_TRACE sees every jump, a back edge may hand the frame
+       over to the trace of its loop */
+#define TRACE_JUMP(TARGET) \
+    if (vm->exec_mode == R11F_EXEC_TRACE) { \
+        r11f_jit_entry_t trace = r11f_trace_jump(vm, frame, pc, (TARGET)); \
+        if (trace) { \
+            frame->pc = (TARGET); \
+            return vm_execute_jit(vm, trace, output); \
+        } \
+    }
+
+    for (;;) {
+        r11f_regir_insn_t *insn = &insns[pc];
+        switch (insn->op) {
+            case R11F_RI_nop:
+                pc++;
+                break;
+            case R11F_RI_mov:
+                r[insn->dst] = r[insn->a];
+                pc++;
+                break;
+            case R11F_RI_movi:
+                r[insn->dst].i64 = insn->imm;
+                pc++;
+                break;
+
+#define INT_OP(CODE, EXPR) \
+            case R11F_RI_##CODE: { \
+                int32_t a = r[insn->a].i32; \
+                int32_t b = r[insn->b].i32; \
+                int32_t imm = (int32_t)insn->imm; \
+                (void)a; (void)b; (void)imm; \
+                r[insn->dst] = (r11f_value_t) { .i32 = (EXPR) }; \
+                pc++; \
+                break; \
+            }
+#define LONG_OP(CODE, EXPR) \
+            case R11F_RI_##CODE: { \
+                int64_t a = r[insn->a].i64; \
+                int64_t b = r[insn->b].i64; \
+                int32_t s = r[insn->b].i32; \
+                int64_t imm = insn->imm; \
+                (void)a; (void)b; (void)s; (void)imm; \
+                r[insn->dst] = (r11f_value_t) { .i64 = (EXPR) }; \
+                pc++; \
+                break; \
+            }
+
+            INT_OP(iadd, (int32_t)((uint32_t)a + (uint32_t)b))
+            INT_OP(iaddi, (int32_t)((uint32_t)a + (uint32_t)imm))
+            INT_OP(isub, (int32_t)((uint32_t)a - (uint32_t)b))
+            INT_OP(imul, (int32_t)((uint32_t)a * (uint32_t)b))
+            INT_OP(imuli, (int32_t)((uint32_t)a * (uint32_t)imm))
+            INT_OP(ineg, (int32_t)(0u - (uint32_t)a))
+            INT_OP(ishl, (int32_t)((uint32_t)a << (b & 31)))
+            INT_OP(ishli, (int32_t)((uint32_t)a << (imm & 31)))
+            INT_OP(ishr, a >> (b & 31))
+            INT_OP(ishri, a >> (imm & 31))
+            INT_OP(iushr, (int32_t)((uint32_t)a >> (b & 31)))
+            INT_OP(iushri, (int32_t)((uint32_t)a >> (imm & 31)))
+            INT_OP(iand, a & b)
+            INT_OP(iandi, a & imm)
+            INT_OP(ior, a | b)
+            INT_OP(iori, a | imm)
+            INT_OP(ixor, a ^ b)
+            INT_OP(ixori, a ^ imm)
+            INT_OP(i2b, (int8_t)a)
+            INT_OP(i2c, (uint16_t)a)
+            INT_OP(i2s, (int16_t)a)
+            LONG_OP(ladd, (int64_t)((uint64_t)a + (uint64_t)b))
+            LONG_OP(laddi, (int64_t)((uint64_t)a + (uint64_t)imm))
+            LONG_OP(lsub, (int64_t)((uint64_t)a - (uint64_t)b))
+            LONG_OP(lmul, (int64_t)((uint64_t)a * (uint64_t)b))
+            LONG_OP(lneg, (int64_t)(0ull - (uint64_t)a))
+            LONG_OP(lshl, (int64_t)((uint64_t)a << (s & 63)))
+            LONG_OP(lshr, a >> (s & 63))
+            LONG_OP(lushr, (int64_t)((uint64_t)a >> (s & 63)))
+            LONG_OP(land, a & b)
+            LONG_OP(lor, a | b)
+            LONG_OP(lxor, a ^ b)
+            LONG_OP(i2l, r[insn->a].i32)
+
+#undef INT_OP
+#undef LONG_OP
+
+            case R11F_RI_l2i:
+                r[insn->dst] = (r11f_value_t) { .i32 = (int32_t)r[insn->a].i64 };
+                pc++;
+                break;
+            case R11F_RI_lcmp: {
+                int64_t a = r[insn->a].i64;
+                int64_t b = r[insn->b].i64;
+                r[insn->dst] = (r11f_value_t) { .i32 = (a > b) - (a < b) };
+                pc++;
+                break;
+            }
+            case R11F_RI_intrinsic:
+                r[insn->dst] = r11f_nativefn_call((uint16_t)insn->imm,
+                                                  r + insn->a);
+                pc++;
+                break;
+            case R11F_RI_newarray: {
+                r11f_error_t err =
+                    r11f_vm_new_array(vm, r[insn->a].i32, &r[insn->dst]);
+                if (err != R11F_success) {
+                    frame->pc = pc;
+                    return err;
+                }
+                pc++;
+                break;
+            }
+            case R11F_RI_arraylength: {
+                r11f_array_t *array = r[insn->a].ptr;
+                if (!array) {
+                    frame->pc = pc;
+                    return R11F_ERR_null_pointer;
+                }
+                r[insn->dst] = (r11f_value_t) { .i32 = array->length };
+                pc++;
+                break;
+            }
+            case R11F_RI_iaload:
+            case R11F_RI_iastore: {
+                r11f_array_t *array = r[insn->a].ptr;
+                int32_t index = r[insn->b].i32;
+                if (!array) {
+                    frame->pc = pc;
+                    return R11F_ERR_null_pointer;
+                }
+                if ((uint32_t)index >= (uint32_t)array->length) {
+                    frame->pc = pc;
+                    return R11F_ERR_array_index_out_of_bounds;
+                }
+                if (insn->op == R11F_RI_iaload) {
+                    r[insn->dst] =
+                        (r11f_value_t) { .i32 = array->data[index] };
+                }
+                else {
+                    array->data[index] = r[insn->dst].i32;
+                }
+                pc++;
+                break;
+            }
+            case R11F_RI_idiv:
+            case R11F_RI_irem: {
+                int32_t a = r[insn->a].i32;
+                int32_t b = r[insn->b].i32;
+                if (b == 0) {
+                    frame->pc = pc;
+                    return R11F_ERR_division_by_zero;
+                }
+
+                int32_t result;
+                if (b == -1) {
+                    result = insn->op == R11F_RI_idiv ?
+                        (int32_t)(0u - (uint32_t)a) :
+                        0;
+                }
+                else {
+                    result = insn->op == R11F_RI_idiv ? a / b : a % b;
+                }
+                r[insn->dst] = (r11f_value_t) { .i32 = result };
+                pc++;
+                break;
+            }
+            case R11F_RI_ldiv:
+            case R11F_RI_lrem: {
+                int64_t a = r[insn->a].i64;
+                int64_t b = r[insn->b].i64;
+                if (b == 0) {
+                    frame->pc = pc;
+                    return R11F_ERR_division_by_zero;
+                }
+
+                int64_t result;
+                if (b == -1) {
+                    result = insn->op == R11F_RI_ldiv ?
+                        (int64_t)(0ull - (uint64_t)a) :
+                        0;
+                }
+                else {
+                    result = insn->op == R11F_RI_ldiv ? a / b : a % b;
+                }
+                r[insn->dst] = (r11f_value_t) { .i64 = result };
+                pc++;
+                break;
+            }
+
+#define IF_OP(CODE, COND) \
+            case R11F_RI_##CODE: { \
+                int32_t a = r[insn->a].i32; \
+                int32_t b = r[insn->b].i32; \
+                int32_t imm = (int32_t)insn->imm; \
+                (void)b; (void)imm; \
+                uint32_t next = (COND) ? insn->dst : pc + 1; \
+                TRACE_JUMP(next) \
+                pc = next; \
+                break; \
+            }
+
+            IF_OP(ifeq, a == 0)
+            IF_OP(ifne, a != 0)
+            IF_OP(iflt, a < 0)
+            IF_OP(ifge, a >= 0)
+            IF_OP(ifgt, a > 0)
+            IF_OP(ifle, a <= 0)
+            IF_OP(if_icmpeq, a == b)
+            IF_OP(if_icmpne, a != b)
+            IF_OP(if_icmplt, a < b)
+            IF_OP(if_icmpge, a >= b)
+            IF_OP(if_icmpgt, a > b)
+            IF_OP(if_icmple, a <= b)
+            IF_OP(if_icmpeqi, a == imm)
+            IF_OP(if_icmpnei, a != imm)
+            IF_OP(if_icmplti, a < imm)
+            IF_OP(if_icmpgei, a >= imm)
+            IF_OP(if_icmpgti, a > imm)
+            IF_OP(if_icmplei, a <= imm)
+
+#undef IF_OP
+
+            case R11F_RI_goto:
+                TRACE_JUMP(insn->dst)
+                pc = insn->dst;
+                break;
+            case R11F_RI_switch:
+                if (vm->exec_mode == R11F_EXEC_TRACE) {
+                    r11f_trace_abort(vm);
+                }
+                pc = r11f_switch_lookup(frame->regir->switches[insn->imm],
+                                        r[insn->a].i32);
+                break;
+
+            case R11F_RI_return:
+                vm_return(vm, frame, R11F_return, r[0], output);
+                return R11F_success;
+            case R11F_RI_ireturn:
+                vm_return(vm, frame, R11F_ireturn, r[insn->a], output);
+                return R11F_success;
+            case R11F_RI_lreturn:
+                vm_return(vm, frame, R11F_lreturn, r[insn->a], output);
+                return R11F_success;
+            case R11F_RI_athrow:
+                frame->pc = pc;
+                return r11f_vm_athrow(vm, r[insn->a].ptr);
+            case R11F_RI_yield: {
+                frame->pc = pc + 1;
+                r11f_error_t err = vm_yield(vm);
+                if (err != R11F_success) {
+                    return err;
+                }
+                pc++;
+                break;
+            }
+
+            case R11F_RI_invokestatic:
+            case R11F_RI_invokevirtual: {
+                r11f_class_t *clazz;
+                r11f_method_info_t *method_info;
+                frame->pc = pc;
+                /* the receiver of a virtual call comes before the args */
+                uint16_t self = insn->op == R11F_RI_invokevirtual;
+                r11f_error_t err = self ?
+                    vm_resolve_virtual(vm,
+                                       frame->clazz,
+                                       (uint16_t)insn->imm,
+                                       r[insn->a],
+                                       &clazz,
+                                       &method_info) :
+                    vm_resolve_static(vm,
+                                      frame->clazz,
+                                      (uint16_t)insn->imm,
+                                      &clazz,
+                                      &method_info);
+                if (err != R11F_success) {
+                    return err;
+                }
+
+                r11f_linked_method_t *linked;
+                err = vm_link(vm, clazz, method_info, &linked);
+                if (err != R11F_success) {
+                    return err;
+                }
+                if (vm_is_trivial(vm, linked)) {
+                    r[insn->dst] =
+                        r11f_method_run_trivial(linked, r + insn->a);
+                    pc++;
+                    break;
+                }
+
+                /* the arguments are the last registers in use */
+                r11f_frame_t *callee;
+                err = vm_new_frame(vm, clazz, method_info, r + insn->a,
+                                   &callee);
+                if (err != R11F_success) {
+                    return err;
+                }
+
+                if (vm->exec_mode == R11F_EXEC_TRACE) {
+                    r11f_trace_invoke(vm, frame, pc, self ? NULL : linked);
+                }
+
+                /* the callee returns into register sp */
+                frame->sp = insn->dst;
+                frame->pc = pc + 1;
+                callee->parent = frame;
+                vm->current_frame = callee;
+                return R11F_success;
+            }
+
+            default:
+                frame->pc = pc;
+                return R11F_ERR_malformed_classfile;
+        }
+    }
+#undef TRACE_JUMP
+}
+
+/* errors leave the frame current for vm_throw */
+static r11f_error_t vm_execute_jit(r11f_vm_t *vm,
+                                   r11f_jit_entry_t entry,
+                                   void *output) {
+    r11f_frame_t *frame = vm->current_frame;
+    r11f_value_t value = { .i64 = 0 };
+    r11f_error_t err = entry(vm, frame, &value);
+    if (err == R11F_ERR_deoptimized) {
+        /* the frame and its inlined callees continue in the interpreter */
+        return R11F_success;
+    }
+    if (err != R11F_success) {
+        return err;
+    }
+
+    char return_type = frame->method_info->linked->return_type;
+    uint8_t insc = return_type == 'V' ? R11F_return :
+        return_type == 'J' ? R11F_lreturn :
+        return_type == 'L' ? R11F_areturn :
+        R11F_ireturn;
+    vm_return(vm, frame, insc, value, output);
+    return R11F_success;
+}
+
+R11F_INTERNAL r11f_error_t r11f_vm_jit_invoke(r11f_vm_t *vm,
+                                              r11f_jit_callsite_t *callsite,
+                                              r11f_value_t *args,
+                                              r11f_value_t *result) {
+    uint16_t self = callsite->is_virtual;
+    if (self) {
+        /* monomorphic inline cache, re-resolved when the receiver class
+           differs from the last one */
+        r11f_object_t *receiver = args[0].ptr;
+        if (!receiver) {
+            return R11F_ERR_null_pointer;
+        }
+        if (receiver->clazz != callsite->receiver_class) {
+            callsite->method_info = NULL;
+        }
+        if (!callsite->method_info) {
+            r11f_error_t err = vm_resolve_virtual(vm,
+                                                  callsite->caller,
+                                                  callsite->methodref_index,
+                                                  args[0],
+                                                  &callsite->clazz,
+                                                  &callsite->method_info);
+            if (err != R11F_success) {
+                callsite->method_info = NULL;
+                return err;
+            }
+            callsite->receiver_class = receiver->clazz;
+        }
+    }
+    else if (!callsite->method_info) {
+        r11f_error_t err = vm_resolve_static(vm,
+                                             callsite->caller,
+                                             callsite->methodref_index,
+                                             &callsite->clazz,
+                                             &callsite->method_info);
+        if (err != R11F_success) {
+            callsite->method_info = NULL;
+            return err;
+        }
+    }
+
+    r11f_linked_method_t *linked;
+    r11f_error_t err = vm_link(vm,
+                               callsite->clazz,
+                               callsite->method_info,
+                               &linked);
+    if (err != R11F_success) {
+        return err;
+    }
+    if (vm_is_trivial(vm, linked)) {
+        if (callsite->has_result) {
+            *result = r11f_method_run_trivial(linked, args);
+        }
+        return R11F_success;
+    }
+
+    r11f_frame_t *callee;
+    err = vm_new_frame(vm,
+                       callsite->clazz,
+                       callsite->method_info,
+                       callsite->args_in_frame ? args : NULL,
+                       &callee);
+    if (err != R11F_success) {
+        return err;
+    }
+
+    if (!callsite->args_in_frame) {
+        if (self) {
+            callee->locals[0] = args[0];
+        }
+        invoke_copyargs2(args + self,
+                         callee->locals + self,
+                         callsite->method_info->linked);
+    }
+
+    r11f_value_t value = { .i64 = 0 };
+    r11f_frame_t *current = vm->current_frame;
+    if (callee->jit) {
+        /* compiled to compiled, no trip through the interpreter loop */
+        r11f_jit_entry_t entry = callee->jit->entry;
+        err = entry(vm, callee, &value);
+        if (err == R11F_ERR_deoptimized) {
+            /* the rebuilt frames end with the callee, which returns here */
+            err = vm_execute(vm, &value);
+            vm->current_frame = current;
+        }
+        else if (err != R11F_success) {
+            /* a handler of the callee continues in the interpreter */
+            vm->current_frame = callee;
+            err = vm_throw(vm,
+                           err,
+                           vm_pc_kind(callsite->method_info->linked, entry));
+            if (err == R11F_success) {
+                err = vm_execute(vm, &value);
+            }
+            vm->current_frame = current;
+        }
+        else {
+            r11f_frame_pop(&vm->stack, callee);
+        }
+    }
+    else {
+        /* the interpreter stops once the parentless callee returns */
+        vm->current_frame = callee;
+        err = vm_execute(vm, &value);
+        vm->current_frame = current;
+    }
+
+    if (err == R11F_success && callsite->has_result) {
+        *result = value;
+    }
+    return err;
+}
+
+R11F_INTERNAL r11f_error_t r11f_vm_athrow(r11f_vm_t *vm,
+                                          r11f_object_t *exception) {
+    if (!exception) {
+        return R11F_ERR_null_pointer;
+    }
+    vm->exception = exception;
+    vm->backtrace.count = 0;
+    return R11F_ERR_uncaught_exception;
+}
+
+R11F_INTERNAL r11f_error_t r11f_vm_deoptimize(r11f_vm_t *vm,
+                                              r11f_frame_t *frame,
+                                              r11f_deopt_point_t *point,
+                                              r11f_value_t *values) {
+    /* arrays the code kept in registers come back before the frames
+       referring to them, slots of one array share it */
+    for (uint32_t i = 0; i < point->object_count; i++) {
+        r11f_deopt_object_t *object = &point->objects[i];
+        uint32_t first = 0;
+        while (point->objects[first].elements != object->elements) {
+            first++;
+        }
+        if (first < i) {
+            values[object->slot] = values[point->objects[first].slot];
+            continue;
+        }
+        r11f_value_t ref;
+        r11f_error_t err = r11f_vm_new_array(vm, (int32_t)object->length, &ref);
+        if (err != R11F_success) {
+            return err;
+        }
+        r11f_array_t *array = ref.ptr;
+        for (uint32_t k = 0; k < object->length; k++) {
+            array->data[k] = values[object->elements + k].i32;
+        }
+        values[object->slot] = ref;
+    }
+
+    /* allocate first, the compiled frame stays intact on failure; it is
+       the top of the stack while its code runs */
+    r11f_frame_t *innermost = frame;
+    for (uint32_t i = 1; i < point->frame_count; i++) {
+        r11f_frame_t *inner =
+            r11f_frame_push(&vm->stack, point->frames[i].method, NULL);
+        if (!inner) {
+            /* drops the frames pushed so far along with the first */
+            while (innermost->parent != frame && innermost != frame) {
+                innermost = innermost->parent;
+            }
+            if (innermost != frame) {
+                r11f_frame_pop(&vm->stack, innermost);
+            }
+            return R11F_ERR_stack_overflow;
+        }
+        inner->parent = innermost;
+        innermost = inner;
+    }
+
+    /* walk back out, the values of the outermost frame come first */
+    r11f_frame_t *cur = innermost;
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < point->frame_count; i++) {
+        r11f_linked_method_t *method = point->frames[i].method;
+        offset += method->max_stack + method->max_locals;
+    }
+    for (uint32_t i = point->frame_count; i > 0; i--) {
+        r11f_deopt_frame_t *state = &point->frames[i - 1];
+        uint32_t count = state->method->max_stack + state->method->max_locals;
+        offset -= count;
+        memcpy(cur->data, values + offset, count * sizeof(r11f_value_t));
+        cur->pc = state->pc;
+        cur->sp = state->sp;
+        cur->regir = state->method->regir;
+        cur->jit = NULL;
+        cur = cur->parent;
+    }
+
+    __atomic_store_n(&point->armed, 0, __ATOMIC_RELAXED);
+    vm->current_frame = innermost;
+    return R11F_ERR_deoptimized;
+}
+
+R11F_INTERNAL r11f_linked_method_t*
+r11f_vm_link_static(r11f_vm_t *vm,
+                    r11f_class_t *caller,
+                    uint16_t methodref_index) {
+    r11f_class_t *clazz;
+    r11f_method_info_t *method_info;
+    r11f_linked_method_t *linked = NULL;
+
+    r11f_tier_lock(vm);
+    if (vm_resolve_static(vm,
+                          caller,
+                          methodref_index,
+                          &clazz,
+                          &method_info) == R11F_success) {
+        if (vm_link_locked(vm, clazz, method_info, &linked)
+            != R11F_success) {
+            linked = NULL;
+        }
+    }
+    if (linked && linked->code && !linked->regir && !linked->regir_failed) {
+        if (r11f_regir_compile(linked, &linked->regir) != R11F_success) {
+            linked->regir = NULL;
+            linked->regir_failed = true;
+        }
+    }
+    r11f_tier_unlock(vm);
+    return linked;
+}
+
+R11F_INTERNAL r11f_linked_method_t*
+r11f_vm_link_virtual(r11f_vm_t *vm,
+                     r11f_class_t *caller,
+                     uint16_t methodref_index,
+                     r11f_cha_dependency_t *out_dependency) {
+    r11f_constant_methodref_info_t *methodref_info =
+        caller->constant_pool[methodref_index];
+    char const *class_name;
+    uint16_t class_name_len;
+    get_class_name(caller, methodref_info, &class_name, &class_name_len);
+    r11f_method_qual_name_t qual_name =
+        r11f_class_get_method_name(caller, methodref_info);
+
+    r11f_linked_method_t *linked = NULL;
+    r11f_class_t *clazz;
+    r11f_class_t *owner;
+    r11f_method_info_t *method_info = NULL;
+
+    r11f_tier_lock(vm);
+    if (vm_load_class(vm, class_name, class_name_len, &clazz)
+        == R11F_success) {
+        method_info = r11f_classmgr_unique_method(vm->classmgr,
+                                                  clazz,
+                                                  qual_name.name,
+                                                  qual_name.name_len,
+                                                  qual_name.descriptor,
+                                                  qual_name.descriptor_len,
+                                                  &owner);
+    }
+    if (method_info && vm_check_virtual(method_info) == R11F_success) {
+        if (vm_link_locked(vm, owner, method_info, &linked)
+            != R11F_success) {
+            linked = NULL;
+        }
+    }
+    if (linked && linked->code && !linked->regir && !linked->regir_failed) {
+        if (r11f_regir_compile(linked, &linked->regir) != R11F_success) {
+            linked->regir = NULL;
+            linked->regir_failed = true;
+        }
+    }
+    r11f_tier_unlock(vm);
+
+    if (linked) {
+        *out_dependency = (r11f_cha_dependency_t) {
+            .clazz = clazz,
+            .name = qual_name.name,
+            .name_len = qual_name.name_len,
+            .descriptor = qual_name.descriptor,
+            .descriptor_len = qual_name.descriptor_len,
+            .target = method_info
+        };
+    }
+    return linked;
+}
+
+R11F_INTERNAL r11f_error_t
+r11f_vm_add_dependencies(r11f_vm_t *vm,
+                         r11f_jit_code_t *code,
+                         r11f_cha_dependency_t const *dependencies,
+                         uint32_t count) {
+    r11f_error_t err = R11F_success;
+    r11f_tier_lock(vm);
+    for (uint32_t i = 0; i < count && err == R11F_success; i++) {
+        err = r11f_classmgr_add_dependency(vm->classmgr,
+                                           &dependencies[i],
+                                           code);
+    }
+    r11f_tier_unlock(vm);
+    return err;
+}
+
+static r11f_error_t vm_exec_invokestatic(r11f_vm_t *vm) {
+    assert(vm->current_frame->code[vm->current_frame->pc] == R11F_invokestatic);
+
+    uint16_t methodref_index =
+        (vm->current_frame->code[vm->current_frame->pc + 1] << 8)
+        |  vm->current_frame->code[vm->current_frame->pc + 2];
+
+    /* intrinsics replace the call with its result, their class is never
+       loaded */
+    r11f_frame_t *caller = vm->current_frame;
+    uint16_t fn = r11f_nativefn_find_ref(caller->clazz, methodref_index);
+    if (fn == R11F_NATIVEFN_yield) {
+        caller->pc += 3;
+        return vm_yield(vm);
+    }
+    if (fn != R11F_NATIVEFN_NONE) {
+        uint16_t base = caller->sp - r11f_nativefn_argc(fn);
+        caller->stack[base] = r11f_nativefn_call(fn, caller->stack + base);
+        caller->sp = base + 1;
+        caller->pc += 3;
+        return R11F_success;
+    }
+
+    r11f_class_t *clazz;
+    r11f_method_info_t *method_info;
+    r11f_error_t err = vm_resolve_static(vm,
+                                         vm->current_frame->clazz,
+                                         methodref_index,
+                                         &clazz,
+                                         &method_info);
+    if (err != R11F_success) {
+        return err;
+    }
+
+    r11f_linked_method_t *linked;
+    err = vm_link(vm, clazz, method_info, &linked);
+    if (err != R11F_success) {
+        return err;
+    }
+    uint16_t base = caller->sp - linked->argc;
+    if (vm_is_trivial(vm, linked)) {
+        caller->stack[base] =
+            r11f_method_run_trivial(linked, caller->stack + base);
+        caller->sp = base + 1;
+        caller->pc += 3;
+        return R11F_success;
+    }
+
+    r11f_frame_t *frame;
+    err = vm_new_frame(vm, clazz, method_info, caller->stack + base, &frame);
+    if (err != R11F_success) {
+        return err;
+    }
+
+    /* only now, a failed call throws at the invoke */
+    caller->sp = base;
+    caller->pc += 3;
+    frame->parent = caller;
+    vm->current_frame = frame;
+    return R11F_success;
+}
+
+/* invokespecial and invokevirtual, which pop their receiver along with
+   the arguments off the caller's operand stack */
+static r11f_error_t vm_exec_invokeinstance(r11f_vm_t *vm, uint8_t insc) {
+    r11f_frame_t *caller = vm->current_frame;
+    uint16_t methodref_index =
+        read_unaligned_be2(caller->code + caller->pc + 1);
+
+    r11f_constant_methodref_info_t *methodref_info =
+        caller->clazz->constant_pool[methodref_index];
+    r11f_method_qual_name_t qual_name =
+        r11f_class_get_method_name(caller->clazz, methodref_info);
+    uint16_t base =
+        caller->sp - r11f_descriptor_argc(qual_name.descriptor) - 1;
+    r11f_value_t receiver = caller->stack[base];
+
+    r11f_class_t *clazz;
+    r11f_method_info_t *method_info;
+    r11f_error_t err;
+    if (insc == R11F_invokevirtual) {
+        err = vm_resolve_virtual(vm,
+                                 caller->clazz,
+                                 methodref_index,
+                                 receiver,
+                                 &clazz,
+                                 &method_info);
+    }
+    else {
+        char const *class_name;
+        uint16_t class_name_len;
+        get_class_name(caller->clazz,
+                       methodref_info,
+                       &class_name,
+                       &class_name_len);
+        if (!receiver.ptr) {
+            return R11F_ERR_null_pointer;
+        }
+        if (is_object_class(class_name, class_name_len)) {
+            /* java/lang/Object is never loaded, its <init> does nothing */
+            caller->sp = base;
+            caller->pc += 3;
+            return R11F_success;
+        }
+
+        err = vm_get_class(vm, class_name, class_name_len, &clazz);
+        if (err == R11F_success && clazz->builtin) {
+            /* nor do the constructors of built in exceptions */
+            caller->sp = base;
+            caller->pc += 3;
+            return R11F_success;
+        }
+        if (err == R11F_success) {
+            err = vm_find_method(vm, clazz, &qual_name, &clazz, &method_info);
+        }
+        if (err == R11F_success) {
+            err = vm_check_virtual(method_info);
+        }
+    }
+    if (err != R11F_success) {
+        return err;
+    }
+
+    r11f_linked_method_t *linked;
+    err = vm_link(vm, clazz, method_info, &linked);
+    if (err != R11F_success) {
+        return err;
+    }
+    if (vm_is_trivial(vm, linked)) {
+        caller->stack[base] =
+            r11f_method_run_trivial(linked, caller->stack + base);
+        caller->sp = base + 1;
+        caller->pc += 3;
+        return R11F_success;
+    }
+
+    r11f_frame_t *frame;
+    err = vm_new_frame(vm, clazz, method_info, caller->stack + base, &frame);
+    if (err != R11F_success) {
+        return err;
+    }
+
+    caller->sp = base;
+    caller->pc += 3;
+    frame->parent = caller;
+    vm->current_frame = frame;
+    return R11F_success;
+}
+
+static r11f_error_t vm_new_object(r11f_vm_t *vm,
+                                  r11f_class_t *caller,
+                                  uint16_t class_index,
+                                  r11f_object_t **output) {
+    char const *class_name;
+    uint16_t class_name_len;
+    if (!r11f_class_get_class_name(caller,
+                                   class_index,
+                                   &class_name,
+                                   &class_name_len)) {
+        return R11F_ERR_malformed_classfile;
+    }
+
+    r11f_class_t *clazz;
+    r11f_error_t err = vm_get_class(vm, class_name, class_name_len, &clazz);
+    if (err != R11F_success) {
+        return err;
+    }
+
+    r11f_object_t *object = r11f_alloc(sizeof(r11f_object_t));
+    if (!object) {
+        return R11F_ERR_out_of_memory;
+    }
+    object->clazz = clazz;
+    object->next = vm->objects;
+    vm->objects = object;
+    *output = object;
+    return R11F_success;
+}
+
+R11F_INTERNAL r11f_error_t r11f_vm_new_array(r11f_vm_t *vm,
+                                             int32_t length,
+                                             r11f_value_t *result) {
+    if (length < 0) {
+        return R11F_ERR_negative_array_size;
+    }
+    r11f_array_t *array = r11f_alloc_zeroed(
+        sizeof(r11f_array_t) + (size_t)length * sizeof(int32_t)
+    );
+    if (!array) {
+        return R11F_ERR_out_of_memory;
+    }
+    array->object.clazz = NULL;
+    array->object.next = vm->objects;
+    array->length = length;
+    vm->objects = &array->object;
+    result->ptr = array;
+    return R11F_success;
+}
+
+static r11f_error_t vm_resolve_static(r11f_vm_t *vm,
+                                      r11f_class_t *caller,
+                                      uint16_t methodref_index,
+                                      r11f_class_t **out_class,
+                                      r11f_method_info_t **out_method_info) {
+    r11f_constant_methodref_info_t *methodref_info =
+        caller->constant_pool[methodref_index];
+
+    char const *class_name;
+    uint16_t class_name_len;
+    get_class_name(caller, methodref_info, &class_name, &class_name_len);
 
-R11F_EXPORT
-r11f_error_t r11f_vm_invoke_static(r11f_vm_t *vm,
-                                   char const *class_name,
-                                   char const *method_name,
-                                   char const *method_descriptor,
-                                   r11f_value_t argv[],
-                                   void *output) {
     r11f_class_t *clazz;
-    r11f_error_t err =
-        vm_get_class(vm, class_name, strlen(class_name), &clazz);
+    r11f_error_t err = vm_get_class(vm, class_name, class_name_len, &clazz);
     if (err != R11F_success) {
         return err;
     }
 
-    r11f_method_info_t *method_info = r11f_class_resolve_method(
-        clazz,
-        method_name,
-        strlen(method_name),
-        method_descriptor,
-        strlen(method_descriptor)
+    r11f_method_qual_name_t method_qual_name =
+        r11f_class_get_method_name(caller, methodref_info);
+    r11f_method_info_t *method_info;
+    err = vm_find_method(vm, clazz, &method_qual_name, &clazz, &method_info);
+    if (err != R11F_success) {
+        return err;
+    }
+
+    err = vm_check_static(method_info);
+    if (err != R11F_success) {
+        return err;
+    }
+
+    *out_class = clazz;
+    *out_method_info = method_info;
+    return R11F_success;
+}
+
+/* dispatches on the class of `receiver`, which must not be null */
+static r11f_error_t vm_resolve_virtual(r11f_vm_t *vm,
+                                       r11f_class_t *caller,
+                                       uint16_t methodref_index,
+                                       r11f_value_t receiver,
+                                       r11f_class_t **out_class,
+                                       r11f_method_info_t **out_method_info) {
+    r11f_object_t *object = receiver.ptr;
+    if (!object) {
+        return R11F_ERR_null_pointer;
+    }
+    /* arrays have no methods of their own to call yet */
+    if (!object->clazz) {
+        return R11F_ERR_not_implemented_instruction;
+    }
+
+    r11f_method_qual_name_t method_qual_name = r11f_class_get_method_name(
+        caller,
+        caller->constant_pool[methodref_index]
     );
-    if (!method_info) {
-        return R11F_ERR_method_not_found;
+    r11f_error_t err = vm_find_method(vm,
+                                      object->clazz,
+                                      &method_qual_name,
+                                      out_class,
+                                      out_method_info);
+    if (err != R11F_success) {
+        return err;
+    }
+    return vm_check_virtual(*out_method_info);
+}
+
+/* looks the method up in `clazz`, then in its superclasses */
+static r11f_error_t vm_find_method(r11f_vm_t *vm,
+                                   r11f_class_t *clazz,
+                                   r11f_method_qual_name_t const *qual_name,
+                                   r11f_class_t **out_class,
+                                   r11f_method_info_t **out_method_info) {
+    for (;;) {
+        r11f_method_info_t *method_info =
+            r11f_class_resolve_method(clazz,
+                                      qual_name->name,
+                                      qual_name->name_len,
+                                      qual_name->descriptor,
+                                      qual_name->descriptor_len);
+        if (method_info) {
+            *out_class = clazz;
+            *out_method_info = method_info;
+            return R11F_success;
+        }
+
+        char const *super_name;
+        uint16_t super_name_len;
+        if (!r11f_class_get_class_name(clazz,
+                                       clazz->super_class,
+                                       &super_name,
+                                       &super_name_len)
+            || is_object_class(super_name, super_name_len)) {
+            return R11F_ERR_method_not_found;
+        }
+
+        r11f_error_t err =
+            vm_get_class(vm, super_name, super_name_len, &clazz);
+        if (err != R11F_success) {
+            return err;
+        }
     }
+}
 
+static r11f_error_t vm_check_static(r11f_method_info_t *method_info) {
     if (method_info->access_flags & R11F_ACC_ABSTRACT) {
         return R11F_ERR_cannot_invoke_abstract_method;
     }
@@ -67,177 +2004,483 @@ r11f_error_t r11f_vm_invoke_static(r11f_vm_t *vm,
         return R11F_ERR_cannot_invoke_non_static_method;
     }
 
-    r11f_frame_t *frame = r11f_frame_alloc(clazz, method_info);
-    if (!frame) {
-        return R11F_ERR_out_of_memory;
+    return method_info->verify_error;
+}
+
+static r11f_error_t vm_check_virtual(r11f_method_info_t *method_info) {
+    if (method_info->access_flags & R11F_ACC_ABSTRACT) {
+        return R11F_ERR_cannot_invoke_abstract_method;
     }
 
-    invoke_copyargs2(argv, frame->locals, method_descriptor);
-    vm->current_frame = frame;
+    if (method_info->access_flags & R11F_ACC_NATIVE) {
+        return R11F_ERR_cannot_invoke_native_method;
+    }
 
-    return vm_execute(vm, output);
-}
+    if (method_info->access_flags & R11F_ACC_STATIC) {
+        return R11F_ERR_method_not_found;
+    }
 
-static r11f_error_t vm_execute(r11f_vm_t *vm, void *output) {
-    while (vm->current_frame) {
-        r11f_frame_t *frame = vm->current_frame;
-        r11f_value_t *stack = frame->stack;
-        r11f_value_t *locals = frame->locals;
+    return method_info->verify_error;
+}
 
-        uint8_t insc = frame->code[frame->pc];
-        switch (insc) {
-            case R11F_iload_0:
-            case R11F_lload_0:
-                stack[frame->sp] = locals[0];
-                frame->sp++;
-                frame->pc += 1;
-                break;
-            case R11F_iload_1:
-            case R11F_lload_1:
-                stack[frame->sp] = locals[1];
-                frame->sp++;
-                frame->pc += 1;
-                break;
-            case R11F_iload_2:
-            case R11F_lload_2:
-                stack[frame->sp] = locals[2];
-                frame->sp++;
-                frame->pc += 1;
-                break;
-            case R11F_iadd: {
-                int32_t a = stack[frame->sp - 1].i32;
-                int32_t b = stack[frame->sp - 2].i32;
+/* `args` are the receiver and arguments at the end of the caller's
+   values, the callee's locals start on them. Longs and doubles take two
+   locals though, those arguments are copied over instead */
+static r11f_error_t vm_new_frame(r11f_vm_t *vm,
+                                 r11f_class_t *clazz,
+                                 r11f_method_info_t *method_info,
+                                 r11f_value_t *args,
+                                 r11f_frame_t **output) {
+    r11f_linked_method_t *linked;
+    r11f_error_t err = vm_link(vm, clazz, method_info, &linked);
+    if (err != R11F_success) {
+        return err;
+    }
 
-                stack[frame->sp - 2].i32 = a + b;
-                frame->sp--;
-                frame->pc++;
-                break;
-            }
-            case R11F_ladd: {
-                int64_t a = stack[frame->sp - 1].i64;
-                int64_t b = stack[frame->sp - 2].i64;
+    err = vm_init_stack(vm);
+    if (err != R11F_success) {
+        return err;
+    }
+    bool in_place = args && !linked->wide_args;
+    r11f_frame_t *frame =
+        r11f_frame_push(&vm->stack, linked, in_place ? args : NULL);
+    if (!frame) {
+        return R11F_ERR_stack_overflow;
+    }
+    if (args && !in_place) {
+        uint16_t self = !(method_info->access_flags & R11F_ACC_STATIC);
+        if (self) {
+            frame->locals[0] = args[0];
+        }
+        invoke_copyargs2(args + self, frame->locals + self, linked);
+    }
+    *output = frame;
 
-                stack[frame->sp - 2] =
-                    (r11f_value_t) { .i64 = a + b };
-                frame->sp -= 1;
-                frame->pc++;
-                break;
-            }
-            case R11F_i2l: {
-                stack[frame->sp - 1] =
-                    (r11f_value_t) { .i64 = stack[frame->sp - 1].i32 };
+    if (vm->exec_mode == R11F_EXEC_TIERED) {
+        if (clazz->aot_module && !linked->aot_checked) {
+            vm_load_aot(vm, linked);
+        }
+        /* compile threads publish their code whenever they are done */
+        r11f_tier_invoke(vm, linked);
+        frame->jit = vm_valid_opt(linked);
+        if (!frame->jit) {
+            frame->jit = __atomic_load_n(&linked->jit, __ATOMIC_ACQUIRE);
+        }
+        return R11F_success;
+    }
 
-                frame->pc++;
-                break;
-            }
-            case R11F_ireturn:
-            case R11F_lreturn: {
-                vm->current_frame = frame->parent;
-                if (vm->current_frame) {
-                    vm->current_frame->stack[vm->current_frame->sp]
-                        = stack[frame->sp - 1];
-                    vm->current_frame->sp++;
+    if ((vm->exec_mode == R11F_EXEC_REGIR
+         || vm->exec_mode == R11F_EXEC_JIT
+         || vm->exec_mode == R11F_EXEC_OPT
+         || vm->exec_mode == R11F_EXEC_TRACE)
+        && !linked->regir_failed) {
+        if (!__atomic_load_n(&linked->regir, __ATOMIC_ACQUIRE)) {
+            /* carriers of a scheduler may get here at once */
+            r11f_tier_lock(vm);
+            if (!linked->regir && !linked->regir_failed) {
+                /* methods the translator cannot handle stay on bytecode */
+                r11f_regir_t *regir;
+                if (r11f_regir_compile(linked, &regir) == R11F_success) {
+                    __atomic_store_n(&linked->regir, regir, __ATOMIC_RELEASE);
                 }
                 else {
-                    switch (insc) {
-                        case R11F_ireturn:
-                            *(int32_t*)output = stack[frame->sp - 1].i32;
-                            break;
-                        case R11F_lreturn:
-                            *(int64_t*)output = stack[frame->sp - 1].i64;
-                            break;
-                    }
+                    linked->regir_failed = true;
                 }
-                r11f_free(frame);
-                break;
             }
-            case R11F_invokestatic: {
-                r11f_error_t err = vm_exec_invokestatic(vm);
-                if (err != R11F_success) {
-                    return err;
-                }
-                break;
+            r11f_tier_unlock(vm);
+        }
+        frame->regir = linked->regir;
+    }
+
+    if (vm->exec_mode == R11F_EXEC_OPT
+        && linked->regir
+        && !linked->opt_failed) {
+        if (!linked->opt) {
+            /* methods the optimizer gives up on get the baseline JIT */
+            if (r11f_opt_compile(vm, linked, &linked->opt) != R11F_success) {
+                linked->opt = NULL;
+                linked->opt_failed = true;
             }
-            default: {
-                return R11F_ERR_malformed_classfile;
+        }
+        frame->jit = vm_valid_opt(linked);
+    }
+
+    if ((vm->exec_mode == R11F_EXEC_JIT || vm->exec_mode == R11F_EXEC_OPT)
+        && !frame->jit
+        && linked->regir
+        && !linked->jit_failed) {
+        if (!linked->jit && clazz->aot_module && !linked->aot_checked) {
+            vm_load_aot(vm, linked);
+        }
+        if (!linked->jit) {
+            /* and those the compiler cannot handle run register IR */
+            if (r11f_jitcache_compile(vm->jit_cache_dir, linked, &linked->jit)
+                != R11F_success) {
+                linked->jit = NULL;
+                linked->jit_failed = true;
             }
         }
+        frame->jit = linked->jit;
     }
 
     return R11F_success;
 }
 
-static r11f_error_t vm_exec_invokestatic(r11f_vm_t *vm) {
-    assert(vm->current_frame->code[vm->current_frame->pc] == R11F_invokestatic);
+/* the VM stack is reserved on first use */
+static r11f_error_t vm_init_stack(r11f_vm_t *vm) {
+    if (vm->stack.base) {
+        return R11F_success;
+    }
+    return r11f_stack_init(
+        &vm->stack,
+        vm->stack_size ? vm->stack_size : R11F_STACK_DEFAULT_SIZE
+    );
+}
 
-    uint16_t methodref_index =
-        (vm->current_frame->code[vm->current_frame->pc + 1] << 8)
-        |  vm->current_frame->code[vm->current_frame->pc + 2];
-    vm->current_frame->pc += 3;
+/* AOT code stands in for the baseline tier from the first call on */
+static void vm_load_aot(r11f_vm_t *vm, r11f_linked_method_t *linked) {
+    r11f_tier_lock(vm);
+    if (!linked->aot_checked) {
+        linked->aot_checked = true;
+        if (!linked->regir && !linked->regir_failed) {
+            if (r11f_regir_compile(linked, &linked->regir) != R11F_success) {
+                linked->regir = NULL;
+                linked->regir_failed = true;
+            }
+        }
 
-    r11f_constant_methodref_info_t *methodref_info =
-        vm->current_frame->clazz->constant_pool[methodref_index];
+        r11f_jit_code_t *code = linked->jit ? NULL : r11f_aot_load(linked);
+        if (code) {
+            if (linked->tier_requested < R11F_TIER_BASELINE) {
+                linked->tier_requested = R11F_TIER_BASELINE;
+            }
+            __atomic_store_n(&linked->jit, code, __ATOMIC_RELEASE);
+        }
+    }
+    r11f_tier_unlock(vm);
+}
 
-    char const *class_name;
-    uint16_t class_name_len;
-    get_class_name(vm->current_frame->clazz,
-                   methodref_info,
-                   &class_name,
-                   &class_name_len);
+/* invalidated code only finishes the frames already running it */
+static r11f_jit_code_t *vm_valid_opt(r11f_linked_method_t *linked) {
+    r11f_jit_code_t *opt = __atomic_load_n(&linked->opt, __ATOMIC_ACQUIRE);
+    if (opt && __atomic_load_n(&opt->invalidated, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return opt;
+}
 
-    r11f_class_t *clazz;
-    r11f_error_t err = vm_get_class(vm, class_name, class_name_len, &clazz);
-    if (err != R11F_success) {
+static r11f_error_t vm_link(r11f_vm_t *vm,
+                            r11f_class_t *clazz,
+                            r11f_method_info_t *method_info,
+                            r11f_linked_method_t **output) {
+    r11f_linked_method_t *linked =
+        __atomic_load_n(&method_info->linked, __ATOMIC_ACQUIRE);
+    if (linked) {
+        *output = linked;
+        return R11F_success;
+    }
+
+    r11f_tier_lock(vm);
+    r11f_error_t err = vm_link_locked(vm, clazz, method_info, output);
+    r11f_tier_unlock(vm);
+    return err;
+}
+
+/* trivial callees run on the caller's values without a frame, except
+   in R11F_EXEC_TRACE, whose recorder follows every call into its callee */
+static bool vm_is_trivial(r11f_vm_t *vm, r11f_linked_method_t *linked) {
+    return linked->trivial.kind != R11F_TRIVIAL_NONE
+        && vm->exec_mode != R11F_EXEC_TRACE;
+}
+
+/* links with the catch types resolved, the caller holds the VM lock */
+static r11f_error_t vm_link_locked(r11f_vm_t *vm,
+                                   r11f_class_t *clazz,
+                                   r11f_method_info_t *method_info,
+                                   r11f_linked_method_t **output) {
+    r11f_error_t err = r11f_method_link(clazz, method_info, output);
+    if (err == R11F_success && !(*output)->handlers_resolved) {
+        vm_resolve_handlers(vm, *output);
+    }
+    return err;
+}
+
+/* loads the class of each catch type once, classes that cannot be
+   loaded are never thrown either */
+static void vm_resolve_handlers(r11f_vm_t *vm, r11f_linked_method_t *linked) {
+    linked->handlers_resolved = true;
+    for (uint16_t i = 0; i < linked->handler_count; i++) {
+        r11f_handler_t *handler = &linked->handlers[i];
+        char const *class_name;
+        uint16_t class_name_len;
+        if (r11f_class_get_class_name(linked->clazz,
+                                      handler->catch_type,
+                                      &class_name,
+                                      &class_name_len)
+            && vm_load_class(vm,
+                             class_name,
+                             class_name_len,
+                             &handler->catch_class) != R11F_success) {
+            handler->catch_class = NULL;
+        }
+    }
+}
+
+/* takes the branch at frame->pc, counting back edges for tiering. The
+   returned entry, if any, continues the frame from the new pc */
+static r11f_jit_entry_t vm_jump(r11f_vm_t *vm, r11f_frame_t *frame) {
+    int16_t offset = (int16_t)read_unaligned_be2(frame->code + frame->pc + 1);
+    return vm_jump_to(vm, frame, frame->pc + offset);
+}
+
+/* as vm_jump, for a switch at frame->pc that picked `target` */
+static r11f_jit_entry_t vm_jump_to(r11f_vm_t *vm,
+                                   r11f_frame_t *frame,
+                                   uint32_t target) {
+    bool backward = target <= frame->pc;
+    frame->pc = target;
+    if (backward && vm->exec_mode == R11F_EXEC_TIERED) {
+        return r11f_tier_backedge(vm, frame->method_info->linked, target);
+    }
+    return NULL;
+}
+
+static void vm_return(r11f_vm_t *vm,
+                      r11f_frame_t *frame,
+                      uint8_t insc,
+                      r11f_value_t value,
+                      void *output) {
+    if (vm->exec_mode == R11F_EXEC_TRACE) {
+        r11f_trace_return(vm, frame);
+    }
+    vm->current_frame = frame->parent;
+    if (vm->current_frame) {
+        if (insc != R11F_return) {
+            /* register IR callers wait for the result in register sp */
+            r11f_frame_t *caller = vm->current_frame;
+            r11f_value_t *values = caller->regir ? caller->data : caller->stack;
+            values[caller->sp] = value;
+            caller->sp++;
+        }
+    }
+    else {
+        switch (insc) {
+            case R11F_ireturn:
+                *(int32_t*)output = value.i32;
+                break;
+            case R11F_lreturn:
+                *(int64_t*)output = value.i64;
+                break;
+            case R11F_areturn:
+                *(void**)output = value.ptr;
+                break;
+        }
+    }
+    r11f_frame_pop(&vm->stack, frame);
+}
+
+/* looks for a handler of the exception in vm->exception, or of the
+   built in exception of `err`, from the current frame outwards. The
+   frames left are freed and remembered in vm->backtrace; a handler
+   becomes the current frame's pc, with the exception as the only stack
+   value. Errors that are not exceptions unwind everything, up to the
+   parentless frame the call started with, and are returned as they are;
+   so is R11F_ERR_uncaught_exception with no handler found */
+static r11f_error_t vm_throw(r11f_vm_t *vm, r11f_error_t err, uint8_t pc_kind) {
+    /* a parked virtual thread keeps its frames */
+    if (err == R11F_ERR_parked) {
         return err;
     }
+    if (err != R11F_ERR_uncaught_exception) {
+        uint16_t builtin = r11f_except_from_error(err);
+        r11f_object_t *exception = builtin != R11F_EXCEPT_NONE ?
+            vm_fast_exception(vm, builtin) :
+            NULL;
+        if (!exception) {
+            vm->exception = NULL;
+            vm_unwind(vm);
+            return builtin != R11F_EXCEPT_NONE ? R11F_ERR_out_of_memory : err;
+        }
+        vm->exception = exception;
+        vm->backtrace.count = 0;
+    }
+    if (vm->exec_mode == R11F_EXEC_TRACE) {
+        r11f_trace_abort(vm);
+    }
 
-    r11f_method_qual_name_t method_qual_name =
-        r11f_class_get_method_name(vm->current_frame->clazz, methodref_info);
-    r11f_method_info_t *method_info =
-        r11f_class_resolve_method(clazz,
-                                  method_qual_name.name,
-                                  method_qual_name.name_len,
-                                  method_qual_name.descriptor,
-                                  method_qual_name.descriptor_len);
+    r11f_frame_t *frame = vm->current_frame;
+    while (frame) {
+        r11f_linked_method_t *linked = frame->method_info->linked;
+        uint32_t pc = vm_throw_pc(frame, pc_kind);
+        pc_kind = THROW_PC_CALLER;
+        if (!r11f_backtrace_push(&vm->backtrace, linked, pc)) {
+            vm->exception = NULL;
+            vm_unwind(vm);
+            return R11F_ERR_out_of_memory;
+        }
 
-    if (!method_info) {
-        return R11F_ERR_method_not_found;
+        r11f_handler_range_t *range = pc != UINT32_MAX ?
+            r11f_method_find_handlers(linked, pc) :
+            NULL;
+        for (uint32_t i = 0; range && i < range->count; i++) {
+            uint16_t index = linked->handler_order[range->first + i];
+            r11f_handler_t *handler = &linked->handlers[index];
+            if (!vm_catches(vm, vm->exception, handler)) {
+                continue;
+            }
+
+            /* compiled frames continue in the interpreter */
+            frame->jit = NULL;
+            if (frame->regir) {
+                frame->pc = frame->regir->handler_insns[index];
+            }
+            else {
+                frame->pc = handler->handler_pc;
+                frame->sp = 1;
+            }
+            frame->stack[0] = (r11f_value_t) { .ptr = vm->exception };
+            vm->exception = NULL;
+            return R11F_success;
+        }
+
+        r11f_frame_t *parent = frame->parent;
+        r11f_frame_pop(&vm->stack, frame);
+        frame = parent;
+        vm->current_frame = frame;
     }
+    return R11F_ERR_uncaught_exception;
+}
 
-    if (method_info->access_flags & R11F_ACC_ABSTRACT) {
-        return R11F_ERR_cannot_invoke_abstract_method;
+/* baseline code tells the register IR instruction that failed, the
+   optimizing compilers keep no pc */
+static uint8_t vm_pc_kind(r11f_linked_method_t *linked,
+                          r11f_jit_entry_t entry) {
+    r11f_jit_code_t *jit = __atomic_load_n(&linked->jit, __ATOMIC_ACQUIRE);
+    uint8_t *code = jit ? (uint8_t*)jit->entry : NULL;
+    if (code
+        && (uint8_t*)entry >= code
+        && (uint8_t*)entry < code + jit->code_size) {
+        return THROW_PC_INSN;
     }
+    return THROW_PC_UNKNOWN;
+}
 
-    if (method_info->access_flags & R11F_ACC_NATIVE) {
-        return R11F_ERR_cannot_invoke_native_method;
+/* the bytecode pc `frame` throws at, UINT32_MAX if unknown */
+static uint32_t vm_throw_pc(r11f_frame_t *frame, uint8_t pc_kind) {
+    r11f_regir_t *regir = frame->regir;
+    uint32_t pc = frame->pc;
+    switch (pc_kind) {
+        case THROW_PC_CALLER:
+            /* callers are past the invoke already, which takes one
+               instruction or three bytes */
+            pc -= regir ? 1 : 3;
+            break;
+        case THROW_PC_INSN:
+            regir = frame->method_info->linked->regir;
+            break;
+        case THROW_PC_UNKNOWN:
+            return UINT32_MAX;
     }
+    return regir ? regir->pcs[pc] : pc;
+}
 
-    if (!(method_info->access_flags & R11F_ACC_STATIC)) {
-        return R11F_ERR_cannot_invoke_non_static_method;
+static bool vm_catches(r11f_vm_t *vm,
+                       r11f_object_t *exception,
+                       r11f_handler_t const *handler) {
+    if (!handler->catch_type) {
+        return true;
     }
 
-    r11f_frame_t *frame = r11f_frame_alloc(clazz, method_info);
-    if (!frame) {
-        return R11F_ERR_out_of_memory;
+    r11f_class_t *clazz = exception->clazz;
+    while (clazz && handler->catch_class) {
+        if (clazz == handler->catch_class) {
+            return true;
+        }
+
+        /* superclasses are loaded along with their subclasses */
+        char const *super_name;
+        uint16_t super_name_len;
+        if (!r11f_class_get_class_name(clazz,
+                                       clazz->super_class,
+                                       &super_name,
+                                       &super_name_len)
+            || is_object_class(super_name, super_name_len)
+            || vm_get_class(vm, super_name, super_name_len, &clazz)
+               != R11F_success) {
+            return false;
+        }
+    }
+    return false;
+}
+
+/* shared by every throw of `builtin`, the exception carries no state */
+static r11f_object_t *vm_fast_exception(r11f_vm_t *vm, uint16_t builtin) {
+    if (vm->fast_exceptions[builtin]) {
+        return vm->fast_exceptions[builtin];
     }
 
-    invoke_copyargs(vm->current_frame,
-                    frame,
-                    method_qual_name.descriptor);
-    frame->parent = vm->current_frame;
-    vm->current_frame = frame;
-    return R11F_success;
+    char const *name = r11f_except_name(builtin);
+    r11f_class_t *clazz;
+    if (vm_get_class(vm, name, (uint16_t)strlen(name), &clazz)
+        != R11F_success) {
+        return NULL;
+    }
+    r11f_object_t *object = r11f_alloc(sizeof(r11f_object_t));
+    if (!object) {
+        return NULL;
+    }
+    object->clazz = clazz;
+    object->next = vm->objects;
+    vm->objects = object;
+    vm->fast_exceptions[builtin] = object;
+    return object;
+}
+
+/* drops the frames a failed call left behind, up to the parentless one
+   it started with */
+static void vm_unwind(r11f_vm_t *vm) {
+    if (vm->exec_mode == R11F_EXEC_TRACE) {
+        r11f_trace_abort(vm);
+    }
+    r11f_frame_t *frame = vm->current_frame;
+    while (frame) {
+        r11f_frame_t *parent = frame->parent;
+        r11f_frame_pop(&vm->stack, frame);
+        frame = parent;
+    }
+    vm->current_frame = NULL;
 }
 
-static void invoke_copyargs(r11f_frame_t *src,
-                            r11f_frame_t *dst,
-                            char const* descriptor) {
-    invoke_copyargs2(src->stack, dst->locals, descriptor);
+/* Thread.yield() parks the virtual thread running, with the pc past the
+   call, unless other runs of the interpreter or compiled code are on
+   the stack between its first frame and the current one */
+static r11f_error_t vm_yield(r11f_vm_t *vm) {
+    if (!vm->vthread || vm->exec_mode == R11F_EXEC_TRACE) {
+        return R11F_success;
+    }
+    r11f_frame_t *frame = vm->current_frame;
+    while (frame->parent) {
+        frame = frame->parent;
+    }
+    return frame == (r11f_frame_t*)vm->stack.limit - 1 ?
+        R11F_ERR_parked :
+        R11F_success;
 }
 
 static void invoke_copyargs2(r11f_value_t *src_stack,
                              r11f_value_t *dst_locals,
-                             char const* descriptor) {
+                             r11f_linked_method_t const *linked) {
+    /* compacted locals are one per value like the arguments */
+    if (!linked->wide_args) {
+        if (linked->argc) {
+            memcpy(dst_locals,
+                   src_stack,
+                   linked->argc * sizeof(r11f_value_t));
+        }
+        return;
+    }
+
+    char const *descriptor = linked->descriptor;
     assert(*descriptor == '(');
 
     uint16_t src_idx = 0;
@@ -304,6 +2547,16 @@ static r11f_error_t vm_get_class(r11f_vm_t *vm,
                                  char const *class_name,
                                  uint16_t class_name_len,
                                  r11f_class_t **output) {
+    r11f_tier_lock(vm);
+    r11f_error_t err = vm_load_class(vm, class_name, class_name_len, output);
+    r11f_tier_unlock(vm);
+    return err;
+}
+
+static r11f_error_t vm_load_class(r11f_vm_t *vm,
+                                  char const *class_name,
+                                  uint16_t class_name_len,
+                                  r11f_class_t **output) {
     r11f_class_t *clazz = r11f_classmgr_find_class2(vm->classmgr,
                                                     class_name,
                                                     class_name_len);
@@ -312,8 +2565,9 @@ static r11f_error_t vm_get_class(r11f_vm_t *vm,
         return R11F_success;
     }
 
-    char const* const* classpath = vm->classpath;
-    while (*classpath) {
+    for (char const* const* classpath = vm->classpath;
+         *classpath;
+         classpath++) {
         size_t classpath_len = strlen(*classpath);
 
         // file_name = classpath + '/' + class_name + ".class"
@@ -340,6 +2594,31 @@ static r11f_error_t vm_get_class(r11f_vm_t *vm,
             r11f_free(class);
             return err;
         }
+        /* before anything can run or compile the code, see verify.h */
+        err = r11f_class_verify(class);
+        if (err != R11F_success) {
+            r11f_class_cleanup(class);
+            r11f_free(class);
+            return err;
+        }
+        r11f_aot_attach(vm, class);
+
+        /* superclasses go first, class hierarchy analysis relies on it */
+        char const *super_name;
+        uint16_t super_name_len;
+        if (r11f_class_get_class_name(class,
+                                      class->super_class,
+                                      &super_name,
+                                      &super_name_len)
+            && !is_object_class(super_name, super_name_len)) {
+            r11f_class_t *super;
+            err = vm_load_class(vm, super_name, super_name_len, &super);
+            if (err != R11F_success) {
+                r11f_class_cleanup(class);
+                r11f_free(class);
+                return err;
+            }
+        }
 
         uint32_t classid;
         err = r11f_classmgr_add_class(vm->classmgr, class, &classid);
@@ -354,9 +2633,47 @@ static r11f_error_t vm_get_class(r11f_vm_t *vm,
         return R11F_success;
     }
 
+    uint16_t builtin = r11f_except_find(class_name, class_name_len);
+    if (builtin != R11F_EXCEPT_NONE) {
+        return vm_load_builtin(vm, builtin, output);
+    }
     return R11F_ERR_class_not_found;
 }
 
+/* see except.h, the superclass goes first here as well */
+static r11f_error_t vm_load_builtin(r11f_vm_t *vm,
+                                    uint16_t builtin,
+                                    r11f_class_t **output) {
+    r11f_class_t *class;
+    r11f_error_t err = r11f_except_make_class(builtin, &class);
+    if (err != R11F_success) {
+        return err;
+    }
+
+    char const *super_name;
+    uint16_t super_name_len;
+    r11f_class_get_class_name(class,
+                              class->super_class,
+                              &super_name,
+                              &super_name_len);
+    if (!is_object_class(super_name, super_name_len)) {
+        r11f_class_t *super;
+        err = vm_load_class(vm, super_name, super_name_len, &super);
+    }
+
+    uint32_t classid;
+    if (err == R11F_success) {
+        err = r11f_classmgr_add_class(vm->classmgr, class, &classid);
+    }
+    if (err != R11F_success) {
+        r11f_class_cleanup(class);
+        r11f_free(class);
+        return err;
+    }
+    *output = class;
+    return R11F_success;
+}
+
 static void get_class_name(r11f_class_t *clazz,
                            r11f_constant_methodref_info_t *methodref_info,
                            char const **out_class_name,
@@ -368,3 +2685,8 @@ static void get_class_name(r11f_class_t *clazz,
     *out_class_name = (char const*)utf8_info->bytes;
     *out_class_name_len = utf8_info->length;
 }
+
+static bool is_object_class(char const *class_name, uint16_t class_name_len) {
+    return class_name_len == 16
+           && memcmp(class_name, "java/lang/Object", 16) == 0;
+}
@@ -0,0 +1,419 @@
+#include "vthread.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+#include "alloc.h"
+#include "aot.h"
+#include "link.h"
+#include "object.h"
+
+#ifndef WIN32
+#   include <pthread.h>
+#endif
+
+typedef struct {
+    r11f_sched_t *sched;
+    uint8_t index;
+    /* the scheduler's VM with a single carrier, `view` otherwise: the
+       VM with a stack, objects and exceptions of the carrier's own */
+    r11f_vm_t *vm;
+    r11f_vm_t view;
+#ifndef WIN32
+    pthread_t thread;
+    bool started;
+    /* guards the run queue */
+    pthread_mutex_t queue_lock;
+#endif
+    r11f_vthread_t *head;
+    r11f_vthread_t *tail;
+    size_t queued;
+} carrier_t;
+
+struct st_r11f_sched {
+    r11f_vm_t *vm;
+    uint8_t carrier_count;
+    carrier_t carriers[R11F_MAX_CARRIERS];
+    /* the carrier the next spawned virtual thread is queued to */
+    uint8_t next_carrier;
+
+    r11f_vthread_t *spawned;
+    /* spawned and not done yet */
+    size_t live;
+
+#ifndef WIN32
+    /* recursive, guards class loading, linking and translation */
+    pthread_mutex_t vm_lock;
+    /* carriers out of work wait for idle_cond */
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+    uint32_t idle;
+#endif
+};
+
+static bool sched_parallel(r11f_vm_t *vm);
+static void *carrier_main(void *arg);
+static void carrier_push(carrier_t *carrier, r11f_vthread_t *vthread);
+static r11f_vthread_t *carrier_pop(carrier_t *carrier);
+static r11f_vthread_t *carrier_steal(carrier_t *carrier);
+static void carrier_wait(carrier_t *carrier);
+static void carrier_wake(r11f_sched_t *sched);
+static void vthread_keep_exception(r11f_vthread_t *vthread, r11f_vm_t *vm);
+static void view_init(carrier_t *carrier);
+static void view_merge(carrier_t *carrier);
+
+R11F_EXPORT r11f_sched_t *r11f_sched_alloc(r11f_vm_t *vm, uint8_t carriers) {
+    r11f_sched_t *sched = r11f_alloc_zeroed(sizeof(r11f_sched_t));
+    if (!sched) {
+        return NULL;
+    }
+
+    sched->vm = vm;
+    sched->carrier_count = carriers < R11F_MAX_CARRIERS ?
+        carriers :
+        R11F_MAX_CARRIERS;
+    if (!sched->carrier_count || !sched_parallel(vm)) {
+        sched->carrier_count = 1;
+    }
+    for (uint8_t i = 0; i < sched->carrier_count; i++) {
+        sched->carriers[i].sched = sched;
+        sched->carriers[i].index = i;
+#ifndef WIN32
+        pthread_mutex_init(&sched->carriers[i].queue_lock, NULL);
+#endif
+    }
+
+#ifndef WIN32
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&sched->vm_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    pthread_mutex_init(&sched->idle_lock, NULL);
+    pthread_cond_init(&sched->idle_cond, NULL);
+#endif
+    return sched;
+}
+
+R11F_EXPORT r11f_vthread_t *r11f_sched_spawn(r11f_sched_t *sched,
+                                             r11f_method_handle_t const *handle,
+                                             r11f_value_t const *argv) {
+    uint16_t argc = handle->linked->argc;
+    r11f_vthread_t *vthread = r11f_alloc_zeroed(
+        sizeof(r11f_vthread_t) + argc * sizeof(r11f_value_t)
+    );
+    if (!vthread) {
+        return NULL;
+    }
+    vthread->handle = *handle;
+    if (argc) {
+        memcpy(vthread->argv, argv, argc * sizeof(r11f_value_t));
+    }
+
+    vthread->spawned_before = sched->spawned;
+    sched->spawned = vthread;
+    sched->live++;
+    carrier_push(&sched->carriers[sched->next_carrier], vthread);
+    sched->next_carrier = (sched->next_carrier + 1) % sched->carrier_count;
+    return vthread;
+}
+
+R11F_EXPORT void r11f_sched_run(r11f_sched_t *sched) {
+    r11f_vm_t *vm = sched->vm;
+    assert(!vm->current_frame && !vm->sched);
+    if (!sched->live) {
+        return;
+    }
+
+    vm->sched = sched;
+    if (sched->carrier_count == 1) {
+        sched->carriers[0].vm = vm;
+        carrier_main(&sched->carriers[0]);
+        vm->sched = NULL;
+        return;
+    }
+
+    /* views share the modules of the VM rather than open their own */
+    r11f_aot_open(vm);
+    for (uint8_t i = 0; i < sched->carrier_count; i++) {
+        view_init(&sched->carriers[i]);
+    }
+#ifndef WIN32
+    /* the first carrier is this thread; the queue of one that does not
+       start is left to the others to steal from */
+    for (uint8_t i = 1; i < sched->carrier_count; i++) {
+        carrier_t *carrier = &sched->carriers[i];
+        carrier->started =
+            !pthread_create(&carrier->thread, NULL, carrier_main, carrier);
+    }
+#endif
+    carrier_main(&sched->carriers[0]);
+#ifndef WIN32
+    for (uint8_t i = 1; i < sched->carrier_count; i++) {
+        if (sched->carriers[i].started) {
+            pthread_join(sched->carriers[i].thread, NULL);
+            sched->carriers[i].started = false;
+        }
+    }
+#endif
+    for (uint8_t i = 0; i < sched->carrier_count; i++) {
+        view_merge(&sched->carriers[i]);
+    }
+    vm->sched = NULL;
+}
+
+R11F_EXPORT r11f_error_t r11f_vthread_result(r11f_vthread_t const *vthread,
+                                             r11f_value_t *result) {
+    if (!vthread->done) {
+        return R11F_ERR_parked;
+    }
+    if (vthread->error == R11F_success && result) {
+        *result = vthread->result;
+    }
+    return vthread->error;
+}
+
+R11F_EXPORT void r11f_sched_free(r11f_sched_t *sched) {
+    if (!sched) {
+        return;
+    }
+
+    r11f_vthread_t *vthread = sched->spawned;
+    while (vthread) {
+        r11f_vthread_t *before = vthread->spawned_before;
+        r11f_free(vthread->cont.bytes);
+        r11f_backtrace_free(&vthread->backtrace);
+        r11f_free(vthread);
+        vthread = before;
+    }
+#ifndef WIN32
+    for (uint8_t i = 0; i < sched->carrier_count; i++) {
+        pthread_mutex_destroy(&sched->carriers[i].queue_lock);
+    }
+    pthread_mutex_destroy(&sched->vm_lock);
+    pthread_mutex_destroy(&sched->idle_lock);
+    pthread_cond_destroy(&sched->idle_cond);
+#endif
+    r11f_free(sched);
+}
+
+R11F_INTERNAL void r11f_sched_lock(r11f_sched_t *sched) {
+#ifndef WIN32
+    if (sched->carrier_count > 1) {
+        pthread_mutex_lock(&sched->vm_lock);
+    }
+#else
+    (void)sched;
+#endif
+}
+
+R11F_INTERNAL void r11f_sched_unlock(r11f_sched_t *sched) {
+#ifndef WIN32
+    if (sched->carrier_count > 1) {
+        pthread_mutex_unlock(&sched->vm_lock);
+    }
+#else
+    (void)sched;
+#endif
+}
+
+/* the interpreters resolve every call anew, the compilers keep inline
+   caches, profiles and traces of the VM's */
+static bool sched_parallel(r11f_vm_t *vm) {
+#ifndef WIN32
+    return vm->exec_mode == R11F_EXEC_BYTECODE
+        || vm->exec_mode == R11F_EXEC_REGIR
+        || vm->exec_mode == R11F_EXEC_TOSCACHE;
+#else
+    (void)vm;
+    return false;
+#endif
+}
+
+static void *carrier_main(void *arg) {
+    carrier_t *carrier = arg;
+    r11f_sched_t *sched = carrier->sched;
+    while (__atomic_load_n(&sched->live, __ATOMIC_SEQ_CST)) {
+        r11f_vthread_t *vthread = carrier_pop(carrier);
+        if (!vthread) {
+            vthread = carrier_steal(carrier);
+        }
+        if (!vthread) {
+            carrier_wait(carrier);
+            continue;
+        }
+
+        r11f_error_t err = r11f_vm_run_vthread(carrier->vm, vthread);
+        if (err == R11F_ERR_parked) {
+            carrier_push(carrier, vthread);
+            carrier_wake(sched);
+            continue;
+        }
+
+        vthread->error = err;
+        vthread_keep_exception(vthread, carrier->vm);
+        vthread->done = true;
+        if (!__atomic_sub_fetch(&sched->live, 1, __ATOMIC_SEQ_CST)) {
+            carrier_wake(sched);
+        }
+    }
+    return NULL;
+}
+
+static void carrier_push(carrier_t *carrier, r11f_vthread_t *vthread) {
+#ifndef WIN32
+    pthread_mutex_lock(&carrier->queue_lock);
+#endif
+    vthread->next = NULL;
+    if (carrier->tail) {
+        carrier->tail->next = vthread;
+    }
+    else {
+        carrier->head = vthread;
+    }
+    carrier->tail = vthread;
+    __atomic_add_fetch(&carrier->queued, 1, __ATOMIC_SEQ_CST);
+#ifndef WIN32
+    pthread_mutex_unlock(&carrier->queue_lock);
+#endif
+}
+
+static r11f_vthread_t *carrier_pop(carrier_t *carrier) {
+#ifndef WIN32
+    pthread_mutex_lock(&carrier->queue_lock);
+#endif
+    r11f_vthread_t *vthread = carrier->head;
+    if (vthread) {
+        carrier->head = vthread->next;
+        if (!carrier->head) {
+            carrier->tail = NULL;
+        }
+        __atomic_sub_fetch(&carrier->queued, 1, __ATOMIC_SEQ_CST);
+    }
+#ifndef WIN32
+    pthread_mutex_unlock(&carrier->queue_lock);
+#endif
+    return vthread;
+}
+
+/* takes the front half of the first other queue with any, the first of
+   them to run and the rest to queue */
+static r11f_vthread_t *carrier_steal(carrier_t *carrier) {
+    r11f_sched_t *sched = carrier->sched;
+    for (uint8_t i = 1; i < sched->carrier_count; i++) {
+        carrier_t *victim =
+            &sched->carriers[(carrier->index + i) % sched->carrier_count];
+        if (!__atomic_load_n(&victim->queued, __ATOMIC_SEQ_CST)) {
+            continue;
+        }
+
+#ifndef WIN32
+        pthread_mutex_lock(&victim->queue_lock);
+#endif
+        size_t count = (victim->queued + 1) / 2;
+        r11f_vthread_t *first = victim->head;
+        r11f_vthread_t *last = first;
+        for (size_t n = 1; n < count; n++) {
+            last = last->next;
+        }
+        if (first) {
+            victim->head = last->next;
+            if (!victim->head) {
+                victim->tail = NULL;
+            }
+            __atomic_sub_fetch(&victim->queued, count, __ATOMIC_SEQ_CST);
+        }
+#ifndef WIN32
+        pthread_mutex_unlock(&victim->queue_lock);
+#endif
+        if (!first) {
+            continue;
+        }
+
+        last->next = NULL;
+        r11f_vthread_t *vthread = first->next;
+        while (vthread) {
+            r11f_vthread_t *next = vthread->next;
+            carrier_push(carrier, vthread);
+            vthread = next;
+        }
+        return first;
+    }
+    return NULL;
+}
+
+/* sleeps until a queue gets a virtual thread or none is left. A carrier
+   queueing one wakes the idle after counting it, and the idle look at
+   the queues again after counting themselves, so no wakeup is lost */
+static void carrier_wait(carrier_t *carrier) {
+#ifndef WIN32
+    r11f_sched_t *sched = carrier->sched;
+    pthread_mutex_lock(&sched->idle_lock);
+    __atomic_add_fetch(&sched->idle, 1, __ATOMIC_SEQ_CST);
+    bool work = !__atomic_load_n(&sched->live, __ATOMIC_SEQ_CST);
+    for (uint8_t i = 0; i < sched->carrier_count && !work; i++) {
+        work = __atomic_load_n(&sched->carriers[i].queued, __ATOMIC_SEQ_CST);
+    }
+    if (!work) {
+        pthread_cond_wait(&sched->idle_cond, &sched->idle_lock);
+    }
+    __atomic_sub_fetch(&sched->idle, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&sched->idle_lock);
+#else
+    (void)carrier;
+#endif
+}
+
+static void carrier_wake(r11f_sched_t *sched) {
+#ifndef WIN32
+    if (__atomic_load_n(&sched->idle, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&sched->idle_lock);
+        pthread_cond_broadcast(&sched->idle_cond);
+        pthread_mutex_unlock(&sched->idle_lock);
+    }
+#else
+    (void)sched;
+#endif
+}
+
+/* a copy of the VM sharing its classes and their code */
+/* the backtrace moves to the virtual thread, the next one to fail on
+   the same carrier would overwrite it */
+static void vthread_keep_exception(r11f_vthread_t *vthread, r11f_vm_t *vm) {
+    vthread->exception = vm->exception;
+    if (vm->exception) {
+        vthread->backtrace = vm->backtrace;
+        memset(&vm->backtrace, 0, sizeof(vm->backtrace));
+    }
+}
+
+static void view_init(carrier_t *carrier) {
+    r11f_vm_t *view = &carrier->view;
+    *view = *carrier->sched->vm;
+    view->current_frame = NULL;
+    memset(&view->stack, 0, sizeof(view->stack));
+    view->vthread = NULL;
+    view->objects = NULL;
+    view->exception = NULL;
+    memset(&view->backtrace, 0, sizeof(view->backtrace));
+    memset(view->fast_exceptions, 0, sizeof(view->fast_exceptions));
+    carrier->vm = view;
+}
+
+/* hands the objects of a carrier's view over to the VM */
+static void view_merge(carrier_t *carrier) {
+    r11f_vm_t *view = &carrier->view;
+    r11f_vm_t *vm = carrier->sched->vm;
+    if (view->objects) {
+        r11f_object_t *last = view->objects;
+        while (last->next) {
+            last = last->next;
+        }
+        last->next = vm->objects;
+        vm->objects = view->objects;
+        view->objects = NULL;
+    }
+    r11f_backtrace_free(&view->backtrace);
+    r11f_stack_free(&view->stack);
+    carrier->vm = NULL;
+}
@@ -0,0 +1,29 @@
+package com.example;
+
+public class Arith {
+    public static int div(int a, int b) {
+        return a / b;
+    }
+
+    public static long ldiv(long a, long b) {
+        return a / b;
+    }
+
+    public static long mix(int n) {
+        long acc = 0;
+        for (int i = -n; i < n; i++) {
+            int x = i * 7919;
+            int q = x / (i | 1);
+            int r = x % 13;
+            long y = (long)x << (i & 63);
+            acc ^= y >>> 3;
+            acc += (long)(q ^ r) - (acc >> 17);
+            acc += (byte)x + (char)x + (short)x;
+            acc = acc * 31 + acc / ((long)i | 1) + acc % 1000003L;
+            if (acc < y) {
+                acc -= (x >>> 5) + (x >> 3) + (x << 2);
+            }
+        }
+        return acc;
+    }
+}
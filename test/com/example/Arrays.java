@@ -0,0 +1,49 @@
+package com.example;
+
+public class Arrays {
+    public static int sum_to(int[] a, int n) {
+        int s = 0;
+        for (int i = 0; i < n; i++) {
+            s += a[i];
+        }
+        return s;
+    }
+
+    public static int fill_sum(int n) {
+        int[] a = new int[n];
+        for (int i = 0; i < a.length; i++) {
+            a[i] = i * 3;
+        }
+        int s = 0;
+        for (int i = 0; i < a.length; i++) {
+            s += a[i];
+        }
+        return s;
+    }
+
+    public static int prefix(int n, int m) {
+        int[] a = new int[n];
+        for (int i = 0; i < n; i++) {
+            a[i] = i;
+        }
+        return sum_to(a, m);
+    }
+
+    public static int gather(int n) {
+        int[] a = new int[n];
+        for (int i = 0; i < n; i++) {
+            a[i] = (i * 7 + 3) % n;
+        }
+        int s = 0;
+        int j = 0;
+        for (int i = 0; i < n; i++) {
+            j = a[j];
+            s += j;
+        }
+        return s;
+    }
+
+    public static int sum_null(int n) {
+        return sum_to(null, n);
+    }
+}
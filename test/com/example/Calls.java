@@ -0,0 +1,47 @@
+package com.example;
+
+public class Calls {
+    public static int fib(int n) {
+        if (n < 2) {
+            return n;
+        }
+        return fib(n - 1) + fib(n - 2);
+    }
+
+    static long scale(long x, int k) {
+        return x * k;
+    }
+
+    public static long wide(long x) {
+        return scale(x, 3) - scale(x + 1, 2);
+    }
+
+    static int seven() {
+        return 7;
+    }
+
+    static int same(int x) {
+        return x;
+    }
+
+    static int shl3(int x) {
+        return x << 3;
+    }
+
+    static int sub_from(int x) {
+        return 100 - x;
+    }
+
+    static long widen(int x, long y) {
+        return x + y;
+    }
+
+    public static int trivial(int n) {
+        int acc = 0;
+        for (int i = 0; i < n; i++) {
+            acc += seven() + same(i) + shl3(i) + sub_from(i)
+                + (int) widen(i, 1L << 33);
+        }
+        return acc;
+    }
+}
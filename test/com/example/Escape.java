@@ -0,0 +1,45 @@
+package com.example;
+
+public class Escape {
+    static int norm(int[] p) {
+        return p[0] * p[0] + p[1] * p[1];
+    }
+
+    public static int pairs(int n) {
+        int s = 0;
+        for (int i = 0; i < n; i++) {
+            int[] p = new int[2];
+            p[0] = i;
+            p[1] = i * 3;
+            s += p[0] * p[1] - p.length;
+        }
+        return s;
+    }
+
+    public static int holder(int n) {
+        int[] acc = new int[2];
+        for (int i = 0; i < n; i++) {
+            if ((i & 1) == 0) {
+                acc[0] = acc[0] + i;
+            } else {
+                acc[1] = acc[1] - i;
+            }
+        }
+        return acc[0] * 7 + acc[1];
+    }
+
+    public static int helper(int a) {
+        int[] p = new int[2];
+        p[0] = a;
+        p[1] = a + 1;
+        return norm(p);
+    }
+
+    public static int histogram(int n) {
+        int[] h = new int[4];
+        for (int i = 0; i < n; i++) {
+            h[i & 3] = h[i & 3] + i;
+        }
+        return h[0] + 2 * h[1] + 3 * h[2] + 4 * h[3];
+    }
+}
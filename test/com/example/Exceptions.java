@@ -0,0 +1,100 @@
+package com.example;
+
+public class Exceptions {
+    public static int safe_div(int a, int b) {
+        try {
+            return a / b;
+        } catch (ArithmeticException e) {
+            return -1;
+        }
+    }
+
+    public static int probe(int n) {
+        int[] a = new int[4];
+        int s = 0;
+        int misses = 0;
+        for (int i = 0; i < n; i++) {
+            try {
+                s += a[i & 7] + 1;
+            } catch (ArrayIndexOutOfBoundsException e) {
+                misses++;
+            }
+        }
+        return s * 100 + misses;
+    }
+
+    static void check(int i, int key) {
+        if (i % key == 0) {
+            throw new IllegalStateException();
+        }
+    }
+
+    public static int find(int n, int key) {
+        int count = 0;
+        for (int i = 0; i < n; i++) {
+            try {
+                check(i, key);
+                count++;
+            } catch (RuntimeException e) {
+                count += 3;
+            }
+        }
+        return count;
+    }
+
+    static int down(int n) {
+        if (n == 0) {
+            throw new Stop();
+        }
+        return down(n - 1) + 1;
+    }
+
+    public static int deep(int n) {
+        try {
+            return down(n);
+        } catch (Stop e) {
+            return -n;
+        }
+    }
+
+    public static int escape(int n) {
+        return down(n);
+    }
+
+    public static int guarded(int n) {
+        int r = 0;
+        try {
+            r = 100 / n;
+        } finally {
+            r += 1;
+        }
+        return r;
+    }
+
+    public static int reject(int n) {
+        if (n < 0) {
+            throw new IllegalArgumentException();
+        }
+        return n;
+    }
+
+    public static int throw_null() {
+        throw null;
+    }
+
+    static int forever(int n) {
+        return forever(n + 1) + 1;
+    }
+
+    public static int overflow(int n) {
+        return forever(n);
+    }
+
+    public static int recover(int n) {
+        try {
+            return forever(n);
+        } catch (StackOverflowError e) {
+            return -n;
+        }
+    }
+}
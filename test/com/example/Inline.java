@@ -0,0 +1,59 @@
+package com.example;
+
+public class Inline {
+    public static int sq(int x) {
+        return x * x;
+    }
+
+    public static int clamp(int x, int lo, int hi) {
+        if (x < lo) {
+            return lo;
+        }
+        if (x > hi) {
+            return hi;
+        }
+        return x;
+    }
+
+    public static int depth(int n) {
+        if (n == 0) {
+            return 0;
+        }
+        int r = depth(n - 1);
+        return r + n;
+    }
+
+    public static int shape(int n) {
+        int acc = 0;
+        for (int i = 0; i < n; i++) {
+            int t = clamp(sq(i) - 50, 0, 1000);
+            acc += t;
+        }
+        int d = depth(n & 63);
+        return acc + d;
+    }
+
+    public static int quad(int x) {
+        return sq(sq(x)) + 1;
+    }
+
+    public static int chain(int n) {
+        if (n == 0) {
+            return 0;
+        }
+        int r = chain(n - 1);
+        int q = quad(n);
+        return r + q;
+    }
+
+    public static int scaled(int n, int k) {
+        int acc = 0;
+        for (int i = 0; i < n; i++) {
+            if (k > 100) {
+                acc -= 1;
+            }
+            acc += clamp(i, 0, 50) * sq(k);
+        }
+        return acc;
+    }
+}
@@ -0,0 +1,30 @@
+package com.example;
+
+public class Intrinsics {
+    public static int ints(int n) {
+        int s = 0;
+        for (int i = 0; i < n; i++) {
+            int x = i * -1640531527;
+            s += Integer.bitCount(x) + Integer.numberOfLeadingZeros(i)
+                + Integer.numberOfTrailingZeros(x) + Math.abs(i << 31);
+            s = Integer.reverseBytes(s) ^ Math.min(x, s) + Math.max(i, 5);
+        }
+        return s;
+    }
+
+    public static long longs(int n) {
+        long s = 0;
+        for (int i = 0; i < n; i++) {
+            long x = i * -7046029254386353131L;
+            s += Long.bitCount(x) + Long.numberOfLeadingZeros(i)
+                + Long.numberOfTrailingZeros(x) + Math.abs(x >> 3);
+            s = Long.reverseBytes(s) ^ Math.min(x, s) + Math.max(s, (long) i);
+        }
+        return s;
+    }
+
+    public static int folded() {
+        return Integer.bitCount(255) + Math.abs(-7)
+            + Long.numberOfTrailingZeros(1024L);
+    }
+}
@@ -0,0 +1,52 @@
+package com.example;
+
+public class Loop {
+    public static int sum(int n) {
+        int s = 0;
+        for (int i = 0; i < n; i++) {
+            s += i;
+        }
+        return s;
+    }
+
+    public static long sum_squares(int n) {
+        long s = 0;
+        for (int i = 0; i < n; i++) {
+            s += (long)i * i;
+        }
+        return s;
+    }
+
+    public static int collatz_steps(int n) {
+        int total = 0;
+        for (int i = 1; i < n; i++) {
+            int x = i;
+            while (x != 1) {
+                if ((x & 1) == 0) {
+                    x = x >> 1;
+                }
+                else {
+                    x = 3 * x + 1;
+                }
+                total++;
+            }
+        }
+        return total;
+    }
+
+    public static int gcd(int a, int b) {
+        while (b != 0) {
+            int t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+
+    public static long lcg(long seed, int n) {
+        for (int i = 0; i < n; i++) {
+            seed = seed * 6364136223846793005L + 1442695040888963407L;
+        }
+        return seed;
+    }
+}
@@ -0,0 +1,18 @@
+package com.example;
+
+public class Reuse {
+    /* the drill moves y into the second half of x, a local javac never
+       reuses, so the argument cannot be compacted away */
+    static int low(long x) {
+        int y = (int) x;
+        return y + 1;
+    }
+
+    public static int sum(int n) {
+        int acc = 0;
+        for (int i = 0; i < n; i++) {
+            acc += low((long) i << 32 | i);
+        }
+        return acc;
+    }
+}
@@ -0,0 +1,37 @@
+package com.example;
+
+public class Shape {
+    public int sides() {
+        return 0;
+    }
+
+    public static Shape make(int kind) {
+        if (kind < 5) {
+            return new Shape();
+        }
+        if (kind < 8) {
+            return new Triangle();
+        }
+        return new Square();
+    }
+
+    public static int total(Shape s, int n) {
+        int acc = 0;
+        for (int i = 0; i < n; i++) {
+            acc += s.sides();
+        }
+        return acc;
+    }
+
+    public static int run(int kind, int n) {
+        return total(make(kind), n);
+    }
+
+    public static int mixed(int n) {
+        int acc = 0;
+        for (int i = 0; i < n; i++) {
+            acc += make(i).sides();
+        }
+        return acc;
+    }
+}
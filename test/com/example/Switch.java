@@ -0,0 +1,67 @@
+package com.example;
+
+public class Switch {
+    public static int day_kind(int day) {
+        switch (day) {
+            case 0: return 10;
+            case 1: case 2: case 3: case 4: return 20;
+            case 5: return 30;
+            case 6: return 40;
+            default: return -1;
+        }
+    }
+
+    public static int keyword(int hash) {
+        // String.hashCode() of "if", "for", "while", "return", "class",
+        // "switch", "case" and "break"
+        switch (hash) {
+            case 3357: return 1;
+            case 101577: return 2;
+            case 113101617: return 3;
+            case -934396624: return 4;
+            case 94742904: return 5;
+            case -889473228: return 6;
+            case 3046192: return 7;
+            case 94001407: return 8;
+            default: return 0;
+        }
+    }
+
+    public static int sparse(int x) {
+        switch (x) {
+            case -1000: return 1;
+            case 7: return 2;
+            case 1000000: return 3;
+            default: return 0;
+        }
+    }
+
+    public static int classify(int n) {
+        int total = 0;
+        for (int i = 0; i < n; i++) {
+            switch ((i * 31) & 1023) {
+                case 3: total += 1; break;
+                case 97: total += 2; break;
+                case 211: total += 3; break;
+                case 389: total += 4; break;
+                case 512: total += 5; break;
+                case 677: total += 6; break;
+                case 800: total += 7; break;
+                case 1001: total += 8; break;
+                default: total -= 1;
+            }
+        }
+        return total;
+    }
+
+    public static int spin(int n) {
+        int i = 0;
+        while (true) {
+            i++;
+            switch (i < n ? 1 : 0) {
+                case 1: continue;
+                default: return i;
+            }
+        }
+    }
+}
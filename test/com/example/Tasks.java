@@ -0,0 +1,41 @@
+package com.example;
+
+public class Tasks {
+    public static int count(int n) {
+        int s = 0;
+        for (int i = 0; i < n; i++) {
+            s += i;
+            Thread.yield();
+        }
+        return s;
+    }
+
+    static long down(int n, long s) {
+        if (n == 0) {
+            Thread.yield();
+            return s;
+        }
+        long r = down(n - 1, s + n);
+        Thread.yield();
+        return r + 1;
+    }
+
+    public static long nested(int n) {
+        return down(n, 0);
+    }
+
+    public static int fail(int n) {
+        Thread.yield();
+        return 100 / n;
+    }
+
+    public static int caught(int n) {
+        try {
+            Thread.yield();
+            return 100 / n;
+        } catch (ArithmeticException e) {
+            Thread.yield();
+            return -1;
+        }
+    }
+}
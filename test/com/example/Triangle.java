@@ -0,0 +1,8 @@
+package com.example;
+
+public class Triangle extends Shape {
+    @Override
+    public int sides() {
+        return 3;
+    }
+}
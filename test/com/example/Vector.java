@@ -0,0 +1,66 @@
+package com.example;
+
+public class Vector {
+    public static int[] iota(int n) {
+        int[] a = new int[n];
+        for (int i = 0; i < a.length; i++) {
+            a[i] = i;
+        }
+        return a;
+    }
+
+    public static int sum(int reps) {
+        int[] a = iota(1003);
+        int s = 0;
+        for (int r = 0; r < reps; r++) {
+            for (int i = 0; i < a.length; i++) {
+                s += a[i];
+            }
+        }
+        return s;
+    }
+
+    public static int dot(int reps) {
+        int[] a = iota(1003);
+        int[] b = new int[a.length];
+        for (int i = 0; i < a.length; i++) {
+            b[i] = a[i] ^ 5;
+        }
+        int s = 0;
+        for (int r = 0; r < reps; r++) {
+            for (int i = 0; i < a.length; i++) {
+                s += a[i] * b[i];
+            }
+        }
+        return s;
+    }
+
+    public static int saxpy(int reps) {
+        int[] x = iota(1003);
+        int[] y = new int[x.length];
+        for (int r = 0; r < reps; r++) {
+            for (int i = 0; i < x.length; i++) {
+                y[i] = 3 * x[i] + y[i];
+            }
+        }
+        int s = 0;
+        for (int i = 0; i < y.length; i++) {
+            s += y[i];
+        }
+        return s;
+    }
+
+    public static int map(int reps) {
+        int[] a = iota(1003);
+        for (int r = 0; r < reps; r++) {
+            for (int i = 0; i < a.length; i++) {
+                a[i] = (a[i] << 2) ^ (a[i] + 7);
+            }
+        }
+        int s = 0;
+        for (int i = 0; i < a.length; i++) {
+            s += a[i];
+        }
+        return s;
+    }
+}